@@ -0,0 +1,734 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "apputils.c"
+#include <segyio/segy.h>
+
+static int help() {
+    puts( "Usage: segyio-sort [OPTION]... SRC DST\n"
+          "Copy SRC to DST with the traces sorted on header words\n"
+          "\n"
+          "-k, --key=NUM              header word byte offset to sort on.\n"
+          "                           repeat for more keys, most significant\n"
+          "                           first\n"
+          "    --inline-sorted        sort on inline, crossline, offset\n"
+          "    --crossline-sorted     sort on crossline, inline, offset\n"
+          "    --offset-sorted        sort on offset, inline, crossline\n"
+          "-b, --il=NUM               inline header word byte offset\n"
+          "-B, --xl=NUM               crossline header word byte offset\n"
+          "-o, --offset=NUM           offset header word byte offset\n"
+          "-m, --memory=SIZE          memory to use for sorting, in bytes.\n"
+          "                           accepts the suffixes k, M and G.\n"
+          "                           defaults to 512M\n"
+          "-f  --format=FORMAT        override sample format. defaults to\n"
+          "                           inferring from the binary header.\n"
+          "                           formats: ibm ieee short long char\n"
+          "    --lsb                  the file is little-endian (LSB)\n"
+          "-v, --verbose              increase verbosity\n"
+          "    --version              output version information and exit\n"
+          "    --help                 display this help and exit\n"
+          "\n"
+          "If no keys are given, the traces are sorted inline-first.\n"
+          "Files larger than the memory budget are sorted in runs that are\n"
+          "written next to DST and merged, so sorting needs temporary disk\n"
+          "space about the size of SRC. Traces with equal keys keep their\n"
+          "order from SRC.\n"
+        );
+    return 0;
+}
+
+#define TRHSIZE  SEGY_TRACE_HEADER_SIZE
+#define BINSIZE  SEGY_BINARY_HEADER_SIZE
+#define TEXTSIZE SEGY_TEXT_HEADER_SIZE
+
+#define MAXKEYS 8
+
+/*
+ * The most runs merged at once. Larger inputs are merged in several passes,
+ * to stay clear of the open-files limit.
+ */
+#define MAXFANOUT 128
+
+struct options {
+    int keys[ MAXKEYS ];
+    int nkeys;
+    int order;
+    int il, xl, offset;
+    long long memory;
+    int format;
+    int lsb;
+    char* src;
+    char* dst;
+    int verbosity;
+    int version, help;
+    const char* errmsg;
+};
+
+enum {
+    ORDER_KEYS,
+    ORDER_INLINE,
+    ORDER_CROSSLINE,
+    ORDER_OFFSET,
+};
+
+static int parsesize( const char* str, long long* x ) {
+    char* endptr;
+    *x = strtoll( str, &endptr, 10 );
+
+    switch( *endptr ) {
+        case 'k': *x *= 1024LL;               ++endptr; break;
+        case 'M': *x *= 1024LL * 1024;        ++endptr; break;
+        case 'G': *x *= 1024LL * 1024 * 1024; ++endptr; break;
+        default: break;
+    }
+
+    if( *endptr != '\0' ) return 1;
+    if( *x < 0 ) return 2;
+    return 0;
+}
+
+static struct options parse_options( int argc, char** argv ) {
+    struct options opts;
+    opts.nkeys = 0;
+    opts.order = ORDER_INLINE;
+    opts.il = SEGY_TR_INLINE;
+    opts.xl = SEGY_TR_CROSSLINE;
+    opts.offset = SEGY_TR_OFFSET;
+    opts.memory = 512LL * 1024 * 1024;
+    opts.format = 0;
+    opts.lsb = 0;
+    opts.verbosity = 0;
+    opts.version = 0, opts.help = 0;
+    opts.errmsg = NULL;
+
+    struct options opthelp, optversion;
+    opthelp.help = 1, opthelp.errmsg = NULL;
+    optversion.version = 1, optversion.errmsg = NULL;
+
+    static struct option long_options[] = {
+        { "key",                required_argument, 0, 'k' },
+        { "inline-sorted",      no_argument,       0, 'I' },
+        { "crossline-sorted",   no_argument,       0, 'X' },
+        { "offset-sorted",      no_argument,       0, 'O' },
+
+        { "il",                 required_argument, 0, 'b' },
+        { "xl",                 required_argument, 0, 'B' },
+        { "offset",             required_argument, 0, 'o' },
+
+        { "memory",             required_argument, 0, 'm' },
+        { "format",             required_argument, 0, 'f' },
+        { "lsb",                no_argument,       0, 'L' },
+
+        { "verbose",            no_argument,       0, 'v' },
+        { "version",            no_argument,       0, 'V' },
+        { "help",               no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    static const char* parsenum_errmsg[] = { "", "num must be an integer",
+                                                 "num must be non-negative" };
+
+    opterr = 1;
+
+    while( true ) {
+        int option_index = 0;
+        int c = getopt_long( argc, argv, "vk:b:B:o:m:f:",
+                             long_options, &option_index );
+
+        if( c == -1 ) break;
+
+        int ret;
+        switch( c ) {
+            case  0: break;
+            case 'h': return opthelp;
+            case 'V': return optversion;
+            case 'v': ++opts.verbosity; break;
+            case 'L': opts.lsb = 1; break;
+
+            case 'k':
+                if( opts.nkeys == MAXKEYS ) {
+                    opts.errmsg = "too many sort keys";
+                    return opts;
+                }
+
+                ret = parseint( optarg, opts.keys + opts.nkeys );
+                if( ret != 0 ) {
+                    opts.errmsg = parsenum_errmsg[ ret ];
+                    return opts;
+                }
+                ++opts.nkeys;
+                opts.order = ORDER_KEYS;
+                break;
+
+            case 'I': opts.order = ORDER_INLINE;    opts.nkeys = 0; break;
+            case 'X': opts.order = ORDER_CROSSLINE; opts.nkeys = 0; break;
+            case 'O': opts.order = ORDER_OFFSET;    opts.nkeys = 0; break;
+
+            case 'b':
+                ret = parseint( optarg, &opts.il );
+                if( ret == 0 ) break;
+                opts.errmsg = parsenum_errmsg[ ret ];
+                return opts;
+
+            case 'B':
+                ret = parseint( optarg, &opts.xl );
+                if( ret == 0 ) break;
+                opts.errmsg = parsenum_errmsg[ ret ];
+                return opts;
+
+            case 'o':
+                ret = parseint( optarg, &opts.offset );
+                if( ret == 0 ) break;
+                opts.errmsg = parsenum_errmsg[ ret ];
+                return opts;
+
+            case 'm':
+                ret = parsesize( optarg, &opts.memory );
+                if( ret == 0 ) break;
+                opts.errmsg = "size must be a non-negative integer, "
+                              "optionally followed by k, M or G";
+                return opts;
+
+            case 'f':
+                if( strcmp( optarg, "ibm" ) == 0 )
+                    opts.format = SEGY_IBM_FLOAT_4_BYTE;
+                if( strcmp( optarg, "ieee" ) == 0 )
+                    opts.format = SEGY_IEEE_FLOAT_4_BYTE;
+                if( strcmp( optarg, "short" ) == 0 )
+                    opts.format = SEGY_SIGNED_SHORT_2_BYTE;
+                if( strcmp( optarg, "long" ) == 0 )
+                    opts.format = SEGY_SIGNED_INTEGER_4_BYTE;
+                if( strcmp( optarg, "char" ) == 0 )
+                    opts.format = SEGY_SIGNED_CHAR_1_BYTE;
+                if( opts.format == 0 ) {
+                    opts.errmsg = "invalid format argument. valid formats: "
+                                  "ibm ieee short long char";
+                    return opts;
+                }
+                break;
+
+            default:
+                opthelp.errmsg = "";
+                return opthelp;
+        }
+    }
+
+    if( argc - optind != 2 ) {
+        errmsg( 0, "Wrong number of files" );
+        return opthelp;
+    }
+
+    opts.src = argv[ optind + 0 ];
+    opts.dst = argv[ optind + 1 ];
+    return opts;
+}
+
+/*
+ * The width in bytes of a header word, found by writing -1 (all bits set) to
+ * an empty header and counting the bytes it covers
+ */
+static int wordsize( int field, int binary ) {
+    char header[ BINSIZE ] = { 0 };
+    const int err = binary ? segy_set_bfield( header, field, -1 )
+                           : segy_set_field( header, field, -1 );
+    if( err != SEGY_OK ) return 0;
+
+    const int offset = binary ? field - TEXTSIZE - 1 : field - 1;
+    int size = 0;
+    while( offset + size < BINSIZE && header[ offset + size ] != 0 ) ++size;
+    return size;
+}
+
+/*
+ * Assemble a little-endian header word of size bytes
+ */
+static int32_t leword( const char* header, int size ) {
+    const unsigned char* word = (const unsigned char*)header;
+    if( size == 1 ) return word[ 0 ];
+    if( size == 2 ) return (int16_t)( word[ 0 ] | word[ 1 ] << 8 );
+
+    return (int32_t)( (uint32_t)word[ 0 ]
+                    | (uint32_t)word[ 1 ] << 8
+                    | (uint32_t)word[ 2 ] << 16
+                    | (uint32_t)word[ 3 ] << 24 );
+}
+
+/*
+ * Read a binary header word. segy_get_bfield assumes big-endian headers, so
+ * little-endian words are assembled here.
+ */
+static int binword( const char* binheader, int field, int lsb ) {
+    if( !lsb ) return bfield( binheader, field );
+
+    const int size = wordsize( field, 1 );
+    if( size == 0 ) return -1;
+    return leword( binheader + field - TEXTSIZE - 1, size );
+}
+
+/*
+ * The sort keys are global, because qsort has no context argument
+ */
+static int sortkeys[ MAXKEYS ];
+static int sortkeysizes[ MAXKEYS ];
+static int nsortkeys;
+static int sortlsb;
+
+static void readkeys( const char* trheader, int32_t* keys ) {
+    for( int i = 0; i < nsortkeys; ++i ) {
+        keys[ i ] = sortlsb
+                  ? leword( trheader + sortkeys[ i ] - 1, sortkeysizes[ i ] )
+                  : trfield( trheader, sortkeys[ i ] );
+    }
+}
+
+static int keycmp( const int32_t* a, const int32_t* b ) {
+    for( int i = 0; i < nsortkeys; ++i ) {
+        if( a[ i ] != b[ i ] ) return a[ i ] < b[ i ] ? -1 : 1;
+    }
+    return 0;
+}
+
+struct entry {
+    int32_t keys[ MAXKEYS ];
+    long long seq;
+    const char* record;
+};
+
+static int entrycmp( const void* x, const void* y ) {
+    const struct entry* a = x;
+    const struct entry* b = y;
+    const int cmp = keycmp( a->keys, b->keys );
+    if( cmp != 0 ) return cmp;
+    if( a->seq != b->seq ) return a->seq < b->seq ? -1 : 1;
+    return 0;
+}
+
+/*
+ * A run being merged, and its current record. Runs are numbered in the order
+ * they hold traces from SRC, so ties are broken on the run number to keep
+ * equal traces in the original order. An intermediate merge takes the place
+ * of the runs it merged, so this holds for every pass.
+ */
+struct cursor {
+    int32_t keys[ MAXKEYS ];
+    int run;
+    FILE* fp;
+    char* record;
+};
+
+static int cursorless( const struct cursor* a, const struct cursor* b ) {
+    const int cmp = keycmp( a->keys, b->keys );
+    if( cmp != 0 ) return cmp < 0;
+    return a->run < b->run;
+}
+
+static void siftdown( struct cursor* heap, int n, int i ) {
+    while( true ) {
+        int least = i;
+        const int left  = 2 * i + 1;
+        const int right = 2 * i + 2;
+        if( left  < n && cursorless( heap + left,  heap + least ) ) least = left;
+        if( right < n && cursorless( heap + right, heap + least ) ) least = right;
+        if( least == i ) return;
+
+        struct cursor tmp = heap[ i ];
+        heap[ i ] = heap[ least ];
+        heap[ least ] = tmp;
+        i = least;
+    }
+}
+
+/*
+ * Read the next record of a run. Returns 1 on a record, 0 on end-of-run and
+ * -1 on error.
+ */
+static int advance( struct cursor* c, size_t recsize ) {
+    const size_t sz = fread( c->record, recsize, 1, c->fp );
+    if( sz == 1 ) {
+        readkeys( c->record, c->keys );
+        return 1;
+    }
+
+    return ferror( c->fp ) ? -1 : 0;
+}
+
+/*
+ * Merge the sorted runs in paths into out, with bufsize bytes of buffer for
+ * every run.
+ */
+static int merge( char** paths,
+                  int nruns,
+                  FILE* out,
+                  size_t recsize,
+                  size_t bufsize ) {
+
+    struct cursor* heap = calloc( nruns, sizeof( struct cursor ) );
+    if( !heap ) return errmsg( ENOMEM, "Unable to allocate merge buffers" );
+
+    int err = 0;
+    int n = 0;
+    for( int i = 0; i < nruns && !err; ++i ) {
+        struct cursor* c = heap + n;
+        c->run = i;
+        c->fp = fopen( paths[ i ], "rb" );
+        c->record = malloc( recsize );
+        if( !c->fp || !c->record ) {
+            err = errmsg2( errno, "Unable to open run", strerror( errno ) );
+            if( c->fp ) fclose( c->fp );
+            free( c->record );
+            break;
+        }
+
+        setvbuf( c->fp, NULL, _IOFBF, bufsize );
+
+        const int ok = advance( c, recsize );
+        if( ok < 0 ) err = errmsg( EIO, "Unable to read run" );
+        if( ok <= 0 ) {
+            fclose( c->fp );
+            free( c->record );
+            continue;
+        }
+
+        ++n;
+    }
+
+    for( int i = n / 2 - 1; i >= 0; --i )
+        siftdown( heap, n, i );
+
+    while( n > 0 && !err ) {
+        struct cursor* c = heap;
+        if( fwrite( c->record, recsize, 1, out ) != 1 ) {
+            err = errmsg2( errno, "Unable to write trace", strerror( errno ) );
+            break;
+        }
+
+        const int ok = advance( c, recsize );
+        if( ok < 0 ) {
+            err = errmsg( EIO, "Unable to read run" );
+            break;
+        }
+
+        if( ok == 0 ) {
+            fclose( c->fp );
+            free( c->record );
+            heap[ 0 ] = heap[ --n ];
+        }
+
+        siftdown( heap, n, 0 );
+    }
+
+    for( int i = 0; i < n; ++i ) {
+        fclose( heap[ i ].fp );
+        free( heap[ i ].record );
+    }
+
+    free( heap );
+    return err;
+}
+
+static char* runpath( const char* dst, int run ) {
+    const size_t len = strlen( dst ) + 32;
+    char* path = malloc( len );
+    if( path ) snprintf( path, len, "%s.sort-run-%d", dst, run );
+    return path;
+}
+
+/*
+ * Remove the run files runs[first, last) and release their paths. Used both
+ * when the runs are merged and when sorting fails, so no runs are left on
+ * disk. Returns err, so that it can be passed on to exit.
+ */
+static int removeruns( char** runs, int first, int last, int err ) {
+    for( int i = first; i < last; ++i ) {
+        remove( runs[ i ] );
+        free( runs[ i ] );
+    }
+    return err;
+}
+
+static int copy_headers( FILE* src,
+                         FILE* dst,
+                         char* binheader,
+                         int lsb,
+                         int verbosity ) {
+    char textheader[ TEXTSIZE ];
+
+    if( verbosity > 0 ) puts( "Copying text header" );
+    if( fread( textheader, TEXTSIZE, 1, src ) != 1 )
+        return errmsg2( errno, "Unable to read text header", strerror( errno ) );
+
+    if( fwrite( textheader, TEXTSIZE, 1, dst ) != 1 )
+        return errmsg2( errno, "Unable to write text header", strerror( errno ) );
+
+    if( verbosity > 0 ) puts( "Copying binary header" );
+    if( fread( binheader, BINSIZE, 1, src ) != 1 )
+        return errmsg2( errno, "Unable to read binary header", strerror( errno ) );
+
+    if( fwrite( binheader, BINSIZE, 1, dst ) != 1 )
+        return errmsg2( errno, "Unable to write binary header", strerror( errno ) );
+
+    const int ext_headers = binword( binheader, SEGY_BIN_EXT_HEADERS, lsb );
+    if( ext_headers < 0 ) return errmsg( -1, "Malformed binary header" );
+
+    for( int i = 0; i < ext_headers; ++i ) {
+        if( verbosity > 0 ) puts( "Copying extended text header" );
+        if( fread( textheader, TEXTSIZE, 1, src ) != 1 )
+            return errmsg2( errno, "Unable to read ext text header",
+                                   strerror( errno ) );
+
+        if( fwrite( textheader, TEXTSIZE, 1, dst ) != 1 )
+            return errmsg2( errno, "Unable to write ext text header",
+                                   strerror( errno ) );
+    }
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+
+    struct options opts = parse_options( argc, argv );
+
+    if( opts.help ) exit( help() + (opts.errmsg ? 2 : 0) );
+    if( opts.version ) exit( printversion( "segyio-sort" ) );
+    if( opts.errmsg ) exit( errmsg( EINVAL, opts.errmsg ) );
+
+    const int verbosity = opts.verbosity;
+
+    switch( opts.order ) {
+        case ORDER_INLINE:
+            sortkeys[ 0 ] = opts.il;
+            sortkeys[ 1 ] = opts.xl;
+            sortkeys[ 2 ] = opts.offset;
+            nsortkeys = 3;
+            break;
+
+        case ORDER_CROSSLINE:
+            sortkeys[ 0 ] = opts.xl;
+            sortkeys[ 1 ] = opts.il;
+            sortkeys[ 2 ] = opts.offset;
+            nsortkeys = 3;
+            break;
+
+        case ORDER_OFFSET:
+            sortkeys[ 0 ] = opts.offset;
+            sortkeys[ 1 ] = opts.il;
+            sortkeys[ 2 ] = opts.xl;
+            nsortkeys = 3;
+            break;
+
+        default:
+            memcpy( sortkeys, opts.keys, sizeof( sortkeys ) );
+            nsortkeys = opts.nkeys;
+            break;
+    }
+
+    for( int i = 0; i < nsortkeys; ++i ) {
+        sortkeysizes[ i ] = wordsize( sortkeys[ i ], 0 );
+        if( sortkeysizes[ i ] == 0 )
+            exit( errmsg( -3, "Invalid sort key byte offset" ) );
+    }
+    sortlsb = opts.lsb;
+
+    if( !strcmp( opts.src, opts.dst ) )
+        exit( errmsg( 1, "segyio-sort: "
+                         "output file must be different from input file" ) );
+
+    FILE* src = fopen( opts.src, "rb" );
+    if( !src )
+        exit( errmsg2( errno, "Unable to open src", strerror( errno ) ) );
+
+    FILE* dst = fopen( opts.dst, "wb" );
+    if( !dst )
+        exit( errmsg2( errno, "Unable to open dst", strerror( errno ) ) );
+
+    /* write in large blocks, but leave most of the budget for the chunk */
+    setvbuf( dst, NULL, _IOFBF, 4 * 1024 * 1024 );
+
+    char binheader[ BINSIZE ] = { 0 };
+    int err = copy_headers( src, dst, binheader, opts.lsb, verbosity );
+    if( err ) exit( err );
+
+    const int samples = binword( binheader, SEGY_BIN_SAMPLES, opts.lsb );
+    if( samples < 0 )
+        exit( errmsg( -2, "Could not determine samples per trace" ) );
+
+    int format = opts.format ? opts.format
+                             : binword( binheader, SEGY_BIN_FORMAT, opts.lsb );
+    if( segy_trsize( format, 1 ) < 0 ) {
+        if( format != 0 )
+            errmsg( 1, "sample format field is garbage. "
+                       "falling back to 4-byte float. "
+                       "override with --format" );
+        format = SEGY_IBM_FLOAT_4_BYTE;
+    }
+
+    const int trace_bsize = segy_trsize( format, samples );
+    const size_t recsize = TRHSIZE + trace_bsize;
+    if( verbosity > 2 ) printf( "Found %d bytes per trace\n", trace_bsize );
+
+    /*
+     * Phase 1: read SRC sequentially in chunks that fit in memory, sort every
+     * chunk and write it as a run. If SRC fits in a single chunk, the sorted
+     * chunk goes straight to DST.
+     */
+    long long capacity = opts.memory
+                       / (long long)( recsize + sizeof( struct entry ) );
+    if( capacity < 1 ) capacity = 1;
+
+    char* chunk = malloc( capacity * recsize );
+    struct entry* entries = malloc( capacity * sizeof( struct entry ) );
+    if( !chunk || !entries )
+        exit( errmsg( ENOMEM, "Unable to allocate sort buffer" ) );
+
+    char** runs = NULL;
+    int nruns = 0;
+    long long seq = 0;
+
+    if( verbosity > 0 ) puts( "Sorting traces" );
+    while( true ) {
+        /*
+         * read bytes, not records, so that a trailing partial trace is
+         * noticed. fread on records silently drops it
+         */
+        const size_t bytes = fread( chunk, 1, capacity * recsize, src );
+        if( ferror( src ) )
+            exit( removeruns( runs, 0, nruns,
+                              errmsg( EIO, "Unable to read trace" ) ) );
+        if( bytes % recsize != 0 )
+            exit( removeruns( runs, 0, nruns,
+                              errmsg( -1, "Unable to read trace: "
+                                          "file is truncated" ) ) );
+
+        const size_t n = bytes / recsize;
+        if( n == 0 ) break;
+
+        const int c = fgetc( src );
+        const int last = c == EOF;
+        if( !last ) ungetc( c, src );
+        if( last && ferror( src ) )
+            exit( removeruns( runs, 0, nruns,
+                              errmsg( EIO, "Unable to read trace" ) ) );
+
+        for( size_t i = 0; i < n; ++i ) {
+            entries[ i ].record = chunk + i * recsize;
+            entries[ i ].seq = seq++;
+            readkeys( entries[ i ].record, entries[ i ].keys );
+        }
+
+        qsort( entries, n, sizeof( struct entry ), entrycmp );
+
+        FILE* out = dst;
+        if( !( last && nruns == 0 ) ) {
+            char** tmp = realloc( runs, ( nruns + 1 ) * sizeof( char* ) );
+            if( !tmp ) {
+                err = errmsg( ENOMEM, "Unable to allocate run" );
+                exit( removeruns( runs, 0, nruns, err ) );
+            }
+            runs = tmp;
+            runs[ nruns ] = runpath( opts.dst, nruns );
+            if( !runs[ nruns ] ) {
+                err = errmsg( ENOMEM, "Unable to allocate run" );
+                exit( removeruns( runs, 0, nruns, err ) );
+            }
+
+            out = fopen( runs[ nruns++ ], "wb" );
+            if( !out )
+                exit( removeruns( runs, 0, nruns,
+                                  errmsg2( errno, "Unable to create run",
+                                                  strerror( errno ) ) ) );
+            setvbuf( out, NULL, _IOFBF, 4 * 1024 * 1024 );
+
+            if( verbosity > 1 )
+                printf( "Writing run %d of %zu traces\n", nruns, n );
+        }
+
+        for( size_t i = 0; i < n; ++i ) {
+            if( fwrite( entries[ i ].record, recsize, 1, out ) != 1 )
+                exit( removeruns( runs, 0, nruns,
+                                  errmsg2( errno, "Unable to write trace",
+                                                  strerror( errno ) ) ) );
+        }
+
+        if( out != dst && fclose( out ) != 0 )
+            exit( removeruns( runs, 0, nruns,
+                              errmsg2( errno, "Unable to write run",
+                                              strerror( errno ) ) ) );
+
+        if( last ) break;
+    }
+
+    free( entries );
+    free( chunk );
+    fclose( src );
+
+    /*
+     * Phase 2: merge the runs, at most MAXFANOUT at a time, until the last
+     * merge can go straight to DST. The runs are read sequentially through
+     * their own buffers, so the merge is sequential I/O too.
+     *
+     * An intermediate merge replaces the runs it merged, in front of the runs
+     * that are still waiting, so the runs stay in SRC order.
+     */
+    int first = 0;
+    int nextrun = nruns;
+    while( nruns - first > MAXFANOUT ) {
+        char* path = runpath( opts.dst, nextrun++ );
+        if( !path )
+            exit( removeruns( runs, first, nruns,
+                              errmsg( ENOMEM, "Unable to allocate run" ) ) );
+
+        FILE* out = fopen( path, "wb" );
+        if( !out ) {
+            err = errmsg2( errno, "Unable to create run", strerror( errno ) );
+            free( path );
+            exit( removeruns( runs, first, nruns, err ) );
+        }
+
+        if( verbosity > 1 )
+            printf( "Merging runs %d to %d\n", first + 1, first + MAXFANOUT );
+
+        size_t bufsize = opts.memory / ( MAXFANOUT + 1 );
+        if( bufsize < BUFSIZ ) bufsize = BUFSIZ;
+        setvbuf( out, NULL, _IOFBF, bufsize );
+
+        err = merge( runs + first, MAXFANOUT, out, recsize, bufsize );
+        if( fclose( out ) != 0 && !err )
+            err = errmsg2( errno, "Unable to write run", strerror( errno ) );
+        if( err ) {
+            remove( path );
+            free( path );
+            exit( removeruns( runs, first, nruns, err ) );
+        }
+
+        removeruns( runs, first, first + MAXFANOUT, 0 );
+        first += MAXFANOUT - 1;
+        runs[ first ] = path;
+    }
+
+    if( nruns > first ) {
+        if( verbosity > 0 ) printf( "Merging %d runs\n", nruns - first );
+
+        size_t bufsize = opts.memory / ( nruns - first + 1 );
+        if( bufsize < BUFSIZ ) bufsize = BUFSIZ;
+
+        err = merge( runs + first, nruns - first, dst, recsize, bufsize );
+        removeruns( runs, first, nruns, err );
+        if( err ) exit( err );
+    }
+
+    free( runs );
+
+    if( fclose( dst ) != 0 )
+        exit( errmsg2( errno, "Unable to write dst", strerror( errno ) ) );
+
+    if( verbosity > 0 )
+        printf( "Sorted %lld traces\n", seq );
+
+    return 0;
+}
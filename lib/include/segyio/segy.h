@@ -34,11 +34,22 @@ extern "C" {
 struct segy_file_handle;
 typedef struct segy_file_handle segy_file;
 
+struct segy_brick_handle;
+typedef struct segy_brick_handle segy_bricks;
+
 segy_file* segy_open( const char* path, const char* mode );
 int segy_mmap( segy_file* );
 int segy_flush( segy_file*, bool async );
 int segy_close( segy_file* );
 
+/*
+ * The address and size of the whole file after a successful segy_mmap, for
+ * reading the samples in place, e.g. when no conversion is needed. The
+ * mapping is writable if the file is open for writing, and valid until
+ * segy_close. Returns SEGY_MMAP_INVALID if the file is not memory mapped.
+ */
+int segy_mmap_region( segy_file*, void** addr, long long* size );
+
 /* binary header operations */
 /*
  * The binheader buffer passed to these functions must be of *at least*
@@ -92,6 +103,69 @@ int segy_get_bfield( const char* binheader, int field, int32_t* f );
 int segy_set_field( char* traceheader, int field, int32_t val );
 int segy_set_bfield( char* binheader, int field, int32_t val );
 
+/*
+ * Header scans (segy_field_forall, segy_sorting, segy_offsets etc.) on files
+ * that are not memory mapped read the file in blocks of this many bytes, and
+ * pick the headers out of the blocks. This is much faster than one read per
+ * header, in particular on networked file systems. Scans with a large stride
+ * still read header by header. The default is 16MB, and 0 disables block
+ * reads. Each thread of segy_fields_forall has its own block.
+ */
+int segy_set_scan_blocksize( segy_file*, long long bytes );
+
+/*
+ * Keep recently read traces in memory, so that reading the same traces and
+ * headers again, e.g. when scrolling back and forth through gathers, is served
+ * without a read or sample conversion. The cache holds blocks of block_traces
+ * consecutive traces, with headers and samples converted to native `format`,
+ * up to about `bytes` bytes in total (at least one block), and drops the least
+ * recently used block when full. 0 bytes removes the cache, which is the
+ * default.
+ *
+ * segy_traceheader, and segy_readtrace_native, segy_readsubtr_native and
+ * segy_readtraces_native with SEGY_AS_NATIVE and the same `format` are served
+ * from the cache. Writes through the handle drop all cached traces. Like the
+ * rest of segy_file, the cache is not safe to use from multiple threads.
+ *
+ * segy_cache_stats gives the number of traces and headers read from the cache
+ * (hits) and the number that needed a read from the file (misses) since the
+ * cache was set.
+ */
+int segy_set_cache( segy_file*,
+                    long long bytes,
+                    int block_traces,
+                    int format );
+
+int segy_cache_stats( const segy_file*, long long* hits, long long* misses );
+
+/*
+ * Prefetch for sequential and constant-stride reads. When reads of single
+ * traces or trace headers, or whole lines, follow a pattern, i.e. the same
+ * distance between consecutive reads, the next reads along the pattern, up to
+ * `bytes` bytes ahead, are handed to the OS to be read in the background
+ * (posix_fadvise, or madvise for memory mapped files). Header scans likewise
+ * prefetch the next block. Random reads never match a pattern, and are not
+ * prefetched. The default is 0, which is off.
+ */
+int segy_set_readahead( segy_file*, long long bytes );
+
+/*
+ * Scratch memory for the reads and writes that need a buffer of their own,
+ * e.g. strided and reversed segy_readsubtr and segy_writesubtr without mmap
+ * when rangebuf is NULL. By default the handle owns this memory, grows it as
+ * needed and keeps it until segy_close, so repeated reads don't allocate.
+ *
+ * segy_set_scratch attaches buf of size bytes to be used instead. The buffer
+ * still belongs to the caller, and must outlive the handle or the next call
+ * to segy_set_scratch. If a read needs more than size bytes, the handle goes
+ * back to memory of its own. With buf NULL, size bytes are reserved up
+ * front, and 0 frees the scratch memory.
+ *
+ * Like the rest of segy_file, the scratch memory is not safe to use from
+ * multiple threads.
+ */
+int segy_set_scratch( segy_file*, void* buf, long long size );
+
 int segy_field_forall( segy_file*,
                        int field,
                        int start,
@@ -101,6 +175,76 @@ int segy_field_forall( segy_file*,
                        long trace0,
                        int trace_bsize );
 
+/*
+ * Read several header words of the traces in [start, stop) by step in a
+ * single pass over the headers. `out` has `nfields` arrays, and the word
+ * fields[i] of the k-th trace in the range is written to out[i][k].
+ *
+ * The range is split between `threads` threads, which read the headers with
+ * positional I/O. Pass 1 to do all work on the calling thread. On platforms
+ * without thread support, or without concurrency-safe positional reads, all
+ * work is done on the calling thread regardless.
+ */
+int segy_fields_forall( segy_file*,
+                        const int* fields,
+                        int nfields,
+                        int start,
+                        int stop,
+                        int step,
+                        int threads,
+                        int32_t** out,
+                        long trace0,
+                        int trace_bsize );
+
+/*
+ * Like segy_fields_forall, but the word fields[i] of the k-th trace is written
+ * to out[i][k * stride]. With out[i] = table + i and stride = nfields, this
+ * fills a row-major table with one row per trace and one column per field,
+ * e.g. the memory of a numpy structured array.
+ */
+int segy_fields_forall_strided( segy_file*,
+                                const int* fields,
+                                int nfields,
+                                int start,
+                                int stop,
+                                int step,
+                                int threads,
+                                int32_t** out,
+                                long long stride,
+                                long trace0,
+                                int trace_bsize );
+
+/*
+ * Read the header words `fields` of the `n` traces in `indices`, and write
+ * the word fields[i] of the trace indices[k] to out[i][k]. The indices can be
+ * in any order, and duplicates are allowed.
+ *
+ * The fields and indices are checked before anything is read, and the headers
+ * are read in file order, with traces close together served from the same
+ * read. Like segy_fields_forall, this does not use the handle's cursor.
+ */
+int segy_field_gather( segy_file*,
+                       const int* fields,
+                       int nfields,
+                       const int64_t* indices,
+                       long long n,
+                       int32_t** out,
+                       long trace0,
+                       int trace_bsize );
+
+/*
+ * Read the whole trace headers of the `n` traces in `indices` into buf, the
+ * header of indices[k] at buf + k * SEGY_TRACE_HEADER_SIZE, like
+ * segy_traceheader would. The reads are ordered and merged like in
+ * segy_field_gather.
+ */
+int segy_traceheader_gather( segy_file*,
+                             const int64_t* indices,
+                             long long n,
+                             char* buf,
+                             long trace0,
+                             int trace_bsize );
+
 /*
  * exception: segy_trace_bsize computes the size of the traces in bytes. Cannot
  * fail. Equivalent to segy_trsize(SEGY_IBM_FLOAT_4_BYTE, samples);
@@ -270,6 +414,67 @@ int segy_writesubtr( segy_file*,
                      long trace0,
                      int trace_bsize );
 
+/*
+ * Positional (cursor-free) reads. These behave like segy_traceheader,
+ * segy_readtrace and segy_readsubtr, but compute the file offset of the trace
+ * directly and read with pread (or straight from the memory map) instead of
+ * seeking. They never modify the handle, so it is safe to call them
+ * concurrently from multiple threads on the same segy_file, as long as no
+ * other thread is writing to it or calling any of the cursor-based functions.
+ *
+ * If the file has been written to through the non-mmap interface, call
+ * segy_flush before reading with these functions, as buffered writes are not
+ * visible to pread.
+ *
+ * On platforms without pread (or an equivalent), non-mmap'd files fall back
+ * to seek + read, and the concurrency guarantee does not hold.
+ */
+int segy_pread_traceheader( segy_file*,
+                            int traceno,
+                            char* buf,
+                            long trace0,
+                            int trace_bsize );
+
+int segy_pread_trace( segy_file*,
+                      int traceno,
+                      void* buf,
+                      long trace0,
+                      int trace_bsize );
+
+int segy_pread_subtr( segy_file*,
+                      int traceno,
+                      int start,
+                      int stop,
+                      int step,
+                      void* buf,
+                      void* rangebuf,
+                      long trace0,
+                      int trace_bsize );
+
+/*
+ * Read the samples of the `n` traces in `tracenos` into `buf`, which must be
+ * at least n * trace_bsize bytes. The traces are written to buf in the order
+ * they are requested in, and duplicates are allowed. The data is not converted
+ * to native format, just like segy_readtrace.
+ *
+ * The traces are read in file order, and traces that are close together are
+ * merged into a single large read, discarding the trace headers and any
+ * unrequested traces in between. Two requested traces are merged when there
+ * are at most `max_gap` bytes of unrequested traces between them; a max_gap of
+ * 0 merges only traces that are directly adjacent on disk. Larger values trade
+ * bandwidth for fewer reads, which pays off on high-latency storage like
+ * network file systems and spinning disks.
+ *
+ * Like the segy_pread family, this function does not use the handle's cursor.
+ */
+int segy_readtraces( segy_file*,
+                     const int64_t* tracenos,
+                     long long n,
+                     long long max_gap,
+                     void* buf,
+                     long trace0,
+                     int trace_bsize );
+
 /*
  * convert to/from native float from segy formats (likely IBM or IEEE).  Size
  * parameter is long long because it needs to know the number of *samples*,
@@ -289,6 +494,23 @@ int segy_from_native( int format,
                       long long size,
                       void* buf );
 
+/*
+ * Convert size samples of format from the on-disk (big-endian) representation
+ * in src to outtype (SEGY_OUTTYPE) in dst, e.g. 2-byte integers to float. The
+ * samples are stored as x * scale + bias, so that e.g. float data in [-1, 1]
+ * can be stored as int16 with a scale of 32767. Narrowing to int16 rounds to
+ * nearest and saturates. SEGY_AS_NATIVE can't be scaled, and must be used
+ * with scale 1 and bias 0. src and dst can be the same buffer, as long as it
+ * is large enough for either representation, but must otherwise not overlap.
+ */
+int segy_to_type( int format,
+                  int outtype,
+                  double scale,
+                  double bias,
+                  long long size,
+                  const void* src,
+                  void* dst );
+
 int segy_read_line( segy_file* fp,
                     int line_trace0,
                     int line_length,
@@ -307,6 +529,338 @@ int segy_write_line( segy_file* fp,
                     long trace0,
                     int trace_bsize );
 
+/*
+ * Read and convert to native in one go. These functions behave like their
+ * non-native counterparts followed by segy_to_native, but the byteswap and
+ * format conversion is done in a single pass, and memory mapped files are
+ * converted straight from the mapping into `buf`.
+ *
+ * `format` is the SEGY_FORMAT of the samples, and its size must match the
+ * format set with segy_set_format, or SEGY_INVALID_ARGS is returned.
+ *
+ * `outtype` is the SEGY_OUTTYPE written to `buf`, which must be large enough
+ * for the samples in that type. SEGY_AS_NATIVE gives the same result as
+ * segy_to_native, the other types convert and scale with `scale` and `bias`
+ * as segy_to_type, in the same pass.
+ */
+int segy_readtrace_native( segy_file*,
+                           int traceno,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize );
+
+int segy_readsubtr_native( segy_file*,
+                           int traceno,
+                           int start,
+                           int stop,
+                           int step,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           void* rangebuf,
+                           long trace0,
+                           int trace_bsize );
+
+int segy_readtraces_native( segy_file*,
+                            const int64_t* tracenos,
+                            long long n,
+                            long long max_gap,
+                            int format,
+                            int outtype,
+                            double scale,
+                            double bias,
+                            void* buf,
+                            long trace0,
+                            int trace_bsize );
+
+/*
+ * Read the samples [sample_start, sample_stop) by sample_step of the `count`
+ * traces start, start + step, start + 2*step ..., converted to `outtype` like
+ * segy_readsubtr_native, into `buf`. The traces are written one after the
+ * other, each with the samples of the slice. Both steps may be negative.
+ *
+ * The traces are equally far apart, so the range is read with one plan: in
+ * file order, in large reads spanning many traces when the unrequested bytes
+ * between the sample windows are at most `max_gap`, and one window per read
+ * otherwise. Like segy_readtraces, this does not use the handle's cursor.
+ */
+int segy_read_trace_range( segy_file*,
+                           int start,
+                           int step,
+                           int count,
+                           int sample_start,
+                           int sample_stop,
+                           int sample_step,
+                           long long max_gap,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize );
+
+int segy_read_line_native( segy_file* fp,
+                           int line_trace0,
+                           int line_length,
+                           int stride,
+                           int offsets,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize );
+
+/*
+ * Read depth (time) slices, i.e. the samples sample_indices[0..n) of every
+ * trace in [start, stop) by step, in a single pass over the file. The slice
+ * of sample_indices[k] is written as plane k of `buf`, so that sample
+ * sample_indices[k] of the i-th trace in the range ends up at
+ * buf[k * slicelen + i], where slicelen is the number of traces in the range.
+ *
+ * The traces are read in large blocks when they are close enough together,
+ * so that extracting many slices costs about the same as reading the file
+ * once. `format` and `outtype` work like for segy_readtrace_native.
+ *
+ * The range is split between `threads` threads, like segy_fields_forall.
+ */
+int segy_read_depth_slices( segy_file*,
+                            const int* sample_indices,
+                            int n,
+                            int start,
+                            int stop,
+                            int step,
+                            int format,
+                            int outtype,
+                            double scale,
+                            double bias,
+                            int threads,
+                            void* buf,
+                            long trace0,
+                            int trace_bsize );
+
+/*
+ * Read the samples of the traces [start, stop), converted to `outtype` like
+ * segy_readtrace_native, into `buf`, one trace after the other. For all the
+ * traces of a sorted file, this is the cube in the (fast, slow, offset,
+ * sample) layout of the file.
+ *
+ * The range is split between `threads` threads, like segy_fields_forall. Each
+ * thread reads its part in large blocks with positional reads, and converts
+ * the samples straight into buf, so buf can be any memory, e.g. a memory
+ * mapped file.
+ */
+int segy_read_cube( segy_file*,
+                    int start,
+                    int stop,
+                    int format,
+                    int outtype,
+                    double scale,
+                    double bias,
+                    int threads,
+                    void* buf,
+                    long trace0,
+                    int trace_bsize );
+
+/*
+ * Read a sub volume of a sorted file: the window of samples [s0, s1) of the
+ * traces of inlines [il0, il1) and crosslines [xl0, xl1) at offset `offset`.
+ * Lines and offsets are given by their position (0-based index), not their
+ * number, and the geometry is described by sorting, inline_count,
+ * crossline_count and offsets, like for segy_line_trace0.
+ *
+ * The sub volume is written to buf inline-major, regardless of sorting, so
+ * the sample s of inline il and crossline xl ends up at
+ * buf[((il - il0) * (xl1 - xl0) + (xl - xl0)) * (s1 - s0) + (s - s0)].
+ *
+ * Only the sample windows are read, and traces that are close together in
+ * the file are read in a single request. `format` and `outtype` work like for
+ * segy_readtrace_native.
+ */
+int segy_read_subvolume( segy_file*,
+                         int sorting,
+                         int inline_count,
+                         int crossline_count,
+                         int offsets,
+                         int offset,
+                         int il0,
+                         int il1,
+                         int xl0,
+                         int xl1,
+                         int s0,
+                         int s1,
+                         int format,
+                         int outtype,
+                         double scale,
+                         double bias,
+                         void* buf,
+                         long trace0,
+                         int trace_bsize );
+
+/*
+ * Like segy_read_subvolume, but reads every ilstep-th inline of [il0, il1),
+ * every xlstep-th crossline of [xl0, xl1) and every sstep-th sample of
+ * [s0, s1). The steps must be positive, and only the selected lines are read,
+ * so the shape of buf is the number of selected inlines, crosslines and
+ * samples. segy_read_subvolume is this function with all steps 1.
+ */
+int segy_read_subvolume_strided( segy_file*,
+                                 int sorting,
+                                 int inline_count,
+                                 int crossline_count,
+                                 int offsets,
+                                 int offset,
+                                 int il0,
+                                 int il1,
+                                 int ilstep,
+                                 int xl0,
+                                 int xl1,
+                                 int xlstep,
+                                 int s0,
+                                 int s1,
+                                 int sstep,
+                                 int format,
+                                 int outtype,
+                                 double scale,
+                                 double bias,
+                                 void* buf,
+                                 long trace0,
+                                 int trace_bsize );
+
+/*
+ * Compress blocks of native samples, i.e. samples as they come out of
+ * segy_readtrace_native with SEGY_AS_NATIVE. Every block compresses and
+ * decompresses on its own, so a file of compressed blocks can be read at
+ * random, one block at a time.
+ *
+ * The bytes of the samples are split into planes, one for each byte of the
+ * sample, which are entropy coded independently. The sign and exponent bytes
+ * of floats compress very well on their own, the low bytes of the mantissa
+ * hardly at all. When tolerance is 0 the block is compressed losslessly, for
+ * any element size, and decompresses to the exact same bits.
+ *
+ * When tolerance > 0 the samples must be IEEE floats (elemsize 4), and are
+ * quantised so that every decompressed sample is within tolerance of the
+ * original, up to float rounding. This compresses much better. Blocks with
+ * samples that can't be quantised, e.g. inf or nan, or very large values
+ * relative to tolerance, are compressed losslessly instead.
+ *
+ * segy_compress_bound gives the largest possible size of a compressed block,
+ * and dst should be at least this large. On success, *size is the size of the
+ * compressed block.
+ */
+long long segy_compress_bound( long long samples, int elemsize );
+
+int segy_compress( const void* src,
+                   long long samples,
+                   int elemsize,
+                   double tolerance,
+                   void* dst,
+                   long long* size );
+
+int segy_decompress( const void* src,
+                     long long size,
+                     long long samples,
+                     int elemsize,
+                     void* dst );
+
+/*
+ * Brick cache: a companion file with the samples of a sorted file re-laid as
+ * bricksize^3 cubes, so that lines in either direction and depth slices can
+ * all be read with about the same, small number of reads.
+ *
+ * The geometry is in file order: `lines` lines of `line_length` traces, each
+ * with `offsets` offsets, i.e. trace number
+ * (line * line_length + trace-in-line) * offsets + offset.
+ *
+ * segy_brick_build writes the cache for fp to path. The samples are stored as
+ * native `format`, like segy_readtrace_native with SEGY_AS_NATIVE. It reads
+ * columns of bricksize^2 traces at a time, so memory use is about
+ * bricksize^2 traces. With compression other than SEGY_UNCOMPRESSED every
+ * brick is compressed with segy_compress, and SEGY_LOSSY uses tolerance.
+ * Lossy compression requires a floating point format.
+ *
+ * segy_brick_open opens a cache, and returns NULL if it can't be opened or is
+ * not a brick cache. segy_brick_geometry gives the geometry it was built
+ * with, and segy_brick_source_size the size of the file it was built from.
+ *
+ * segy_brick_read reads the box lines [line0, line1), traces-in-line [pos0,
+ * pos1) and samples [s0, s1) of offset `offset` into buf, in file order, i.e.
+ * like segy_read_subvolume with lines as inlines. Only the parts of the
+ * bricks that overlap the box are read, one read for every run of samples
+ * that are next to each other in the brick, unless the cache is compressed,
+ * in which case whole bricks are read and decompressed.
+ */
+int segy_brick_build( segy_file*,
+                      const char* path,
+                      int lines,
+                      int line_length,
+                      int offsets,
+                      int bricksize,
+                      int compression,
+                      double tolerance,
+                      int format,
+                      long trace0,
+                      int trace_bsize );
+
+segy_bricks* segy_brick_open( const char* path );
+
+int segy_brick_geometry( const segy_bricks*,
+                         int* lines,
+                         int* line_length,
+                         int* offsets,
+                         int* samples,
+                         int* format,
+                         int* bricksize );
+
+int segy_brick_source_size( const segy_bricks*, long long* size );
+
+int segy_brick_read( segy_bricks*,
+                     int offset,
+                     int line0,
+                     int line1,
+                     int pos0,
+                     int pos1,
+                     int s0,
+                     int s1,
+                     void* buf );
+
+int segy_brick_close( segy_bricks* );
+
+/*
+ * Compressed-trace container: a compressed copy of a whole file, which
+ * segy_open reads transparently, i.e. a container opened with segy_open
+ * behaves exactly like the file it was built from, and every read function
+ * works on it. It can only be opened for reading.
+ *
+ * segy_container_build writes the container for fp to path. The traces are
+ * compressed block_traces at a time with segy_compress, trace headers always
+ * losslessly. With SEGY_LOSSLESS the container decodes to a byte-for-byte
+ * copy of the file. With SEGY_LOSSY the samples, which must be 4-byte ibm or
+ * IEEE floats, decode to within tolerance of the original, and the rest of the
+ * file is exact.
+ *
+ * Blocks are decoded when they are read, and the last few are cached, so
+ * reading a trace of a container costs a block, not the whole file. Opened
+ * containers can not be memory mapped.
+ */
+int segy_container_build( segy_file*,
+                          const char* path,
+                          int compression,
+                          double tolerance,
+                          int block_traces,
+                          int format,
+                          long trace0,
+                          int trace_bsize );
+
 /*
  * Count inlines and crosslines. Use this function to determine how large buffer
  * the functions `segy_inline_indices` and `segy_crossline_indices` expect.  If
@@ -382,6 +936,116 @@ int segy_crossline_indices( segy_file*,
                             long trace0,
                             int trace_bsize );
 
+/*
+ * Geometry for files that are not sorted, or have missing or duplicated
+ * traces, which the sorting/offsets/indices functions above reject.
+ *
+ * segy_scan_geometry reads the (il, xl, offset) triple of the traces
+ * [start, stop) into `keys`, which must have room for 3 * (stop - start)
+ * ints. The traces are split between `threads` threads, like
+ * segy_fields_forall.
+ *
+ * segy_sort_geometry orders the traces by line, then trace-in-line, then
+ * offset, and writes the resulting trace numbers to `order`. `n` is the
+ * number of traces in `keys`, and `sorting` picks inline
+ * (SEGY_INLINE_SORTING) or crossline (SEGY_CROSSLINE_SORTING) as the line.
+ * Traces with identical keys are kept in file order.
+ *
+ * segy_geometry_line finds the line `lineno`, which is the `count` trace
+ * numbers in `order` starting at `first`. These can be passed directly to
+ * segy_readtraces or segy_readtraces_native, which reads them in file order.
+ * Returns SEGY_MISSING_LINE_INDEX if there is no such line.
+ *
+ * segy_geometry_find finds the trace number of the trace (il, xl, offset),
+ * or returns SEGY_NOTFOUND.
+ *
+ * segy_geometry_read_line reads the traces of the line `lineno` at `offset`,
+ * ordered by trace-in-line and converted to `outtype` like
+ * segy_readtraces_native, into `buf`, and sets `count` to the number of
+ * traces read. Traces missing from the line are skipped, so `buf` must have
+ * room for the `count` traces segy_geometry_line gives for the line.
+ */
+int segy_scan_geometry( segy_file*,
+                        int il,
+                        int xl,
+                        int offset,
+                        int start,
+                        int stop,
+                        int threads,
+                        int* keys,
+                        long trace0,
+                        int trace_bsize );
+
+int segy_sort_geometry( const int* keys,
+                        long long n,
+                        int sorting,
+                        int64_t* order );
+
+int segy_geometry_line( const int* keys,
+                        const int64_t* order,
+                        long long n,
+                        int sorting,
+                        int lineno,
+                        long long* first,
+                        long long* count );
+
+int segy_geometry_find( const int* keys,
+                        const int64_t* order,
+                        long long n,
+                        int sorting,
+                        int il,
+                        int xl,
+                        int offset,
+                        int64_t* traceno );
+
+int segy_geometry_read_line( segy_file*,
+                             const int* keys,
+                             const int64_t* order,
+                             long long n,
+                             int sorting,
+                             int lineno,
+                             int offset,
+                             long long max_gap,
+                             int format,
+                             int outtype,
+                             double scale,
+                             double bias,
+                             void* buf,
+                             long long* count,
+                             long trace0,
+                             int trace_bsize );
+
+/*
+ * Sorting and grouping of traces by arbitrary header words, like the ones read
+ * with segy_fields_forall_strided. `rows` is a row-major table of int32 with
+ * `ncols` columns, one row per trace, and the first column is the most
+ * significant.
+ *
+ * segy_sort_rows sorts the `n` row numbers in `index` by their rows, in
+ * place. The sort is stable, so rows with identical values keep their order
+ * in `index`.
+ *
+ * segy_group_rows groups the rows [0, n) with identical values. The row
+ * numbers are written to `index` group by group, with the groups in order of
+ * their first row, and the rows of a group in ascending order. The k-th group
+ * is index[offsets[k]] to index[offsets[k + 1]], and `ngroups` is the number
+ * of groups. `offsets` must have room for n + 1 elements.
+ *
+ * Both are linear in the number of rows, and return SEGY_MEMORY_ERROR if the
+ * scratch space could not be allocated.
+ */
+int segy_sort_rows( const int32_t* rows,
+                    int ncols,
+                    long long n,
+                    int64_t* index );
+
+int segy_group_rows( const int32_t* rows,
+                     int ncols,
+                     long long n,
+                     int64_t* index,
+                     int64_t* offsets,
+                     long long* ngroups );
+
 /*
  * Find the first `traceno` of the line `lineno`. `linenos` should be the line
  * indices returned by `segy_inline_indices` or `segy_crossline_indices`. The
@@ -614,6 +1278,19 @@ typedef enum {
     SEGY_INLINE_SORTING = 2,
 } SEGY_SORTING;
 
+typedef enum {
+    SEGY_AS_NATIVE = 0,
+    SEGY_AS_FLOAT32 = 1,
+    SEGY_AS_FLOAT64 = 2,
+    SEGY_AS_INT16 = 3,
+} SEGY_OUTTYPE;
+
+typedef enum {
+    SEGY_UNCOMPRESSED = 0,
+    SEGY_LOSSLESS = 1,
+    SEGY_LOSSY = 2,
+} SEGY_COMPRESSION;
+
 typedef enum {
     SEGY_OK = 0,
     SEGY_FOPEN_ERROR,
@@ -630,6 +1307,7 @@ typedef enum {
     SEGY_MMAP_INVALID,
     SEGY_READONLY,
     SEGY_NOTFOUND,
+    SEGY_MEMORY_ERROR,
 } SEGY_ERROR;
 
 #ifdef __cplusplus
@@ -1,12 +1,20 @@
 #define _POSIX_SOURCE /* fileno */
 
-/* 64-bit off_t in ftello */
-#define _POSIX_C_SOURCE 200808L
+/* 64-bit off_t in ftello, pread */
+#define _POSIX_C_SOURCE 200809L
 #define _FILE_OFFSET_BITS 64
 
+#ifdef HAVE_PREADV
+  /* preadv and pwritev are not POSIX, but available as BSD extensions */
+  #define _DEFAULT_SOURCE
+  #define _DARWIN_C_SOURCE
+#endif //HAVE_PREADV
+
 #if defined(_WIN32) || defined(_MSC_VER)
     /* MultiByteToWideChar */
     #include <windows.h>
+    /* _get_osfhandle */
+    #include <io.h>
 #endif
 
 #ifdef HAVE_MMAP
@@ -19,7 +27,24 @@
   #include <sys/stat.h>
 #endif //HAVE_SYS_STAT_H
 
+#ifdef HAVE_PREAD
+  #include <unistd.h>
+#endif //HAVE_PREAD
+
+#ifdef HAVE_PREADV
+  #include <sys/uio.h>
+#endif //HAVE_PREADV
+
+#ifdef HAVE_POSIX_FADVISE
+  #include <fcntl.h>
+#endif //HAVE_POSIX_FADVISE
+
+#ifdef HAVE_PTHREAD
+  #include <pthread.h>
+#endif //HAVE_PTHREAD
+
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <math.h>
 #include <stdbool.h>
@@ -30,6 +55,21 @@
 #include <segyio/segy.h>
 #include <segyio/util.h>
 
+#if (defined(__x86_64__) || defined(_M_X64)) \
+    && (defined(__GNUC__) || defined(_MSC_VER))
+  #define SEGY_X86_SIMD
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
+#if defined(SEGY_X86_SIMD) && defined(__GNUC__)
+  #define SEGY_TARGET(isa) __attribute__((target(isa)))
+#else
+  #define SEGY_TARGET(isa)
+#endif
+
 static const unsigned char a2e[256] = {
     0,  1,  2,  3,  55, 45, 46, 47, 22, 5,  37, 11, 12, 13, 14, 15,
     16, 17, 18, 19, 60, 61, 50, 38, 24, 25, 63, 39, 28, 29, 30, 31,
@@ -112,6 +152,15 @@ static int encode( char* dst,
                        )
 #endif // __GNUC__
 
+/*
+ * The BSD extensions (preadv) can make <endian.h> define macros by the same
+ * names as these helpers
+ */
+#undef htobe16
+#undef htobe32
+#undef be16toh
+#undef be32toh
+
 static uint16_t htobe16( uint16_t v ) {
 #if HOST_LSB
     return bswap16(v);
@@ -430,6 +479,70 @@ static int formatsize( int format ) {
  */
 
 #define MODEBUF_SIZE 5
+
+/*
+ * The trace cache holds blocks of block_traces consecutive traces as they are
+ * in the file, header followed by samples, in slots that are reused least
+ * recently used first. Headers are byteswapped when the block is read, but the
+ * samples are only converted to native the first time samples from the block
+ * are read, so reading only headers doesn't pay for the conversion.
+ */
+struct trace_cache {
+    long long bytes;
+    int block_traces;
+    int format;
+
+    /* the layout the cached blocks were read with, reset when it changes */
+    long trace0;
+    int trace_bsize;
+    int lsb;
+    long long tracecount;
+
+    int slots;
+    long long blocks;
+    int* index;             /* block -> slot, or -1 if not cached */
+    long long* blockno;     /* slot -> block, or -1 if empty */
+    char* converted;        /* slot -> samples are converted to native */
+    int* prev;              /* LRU list, most recently used at head */
+    int* next;
+    int head;
+    int tail;
+    char* data;
+
+    long long hits;
+    long long misses;
+};
+
+static void trace_cache_clear( struct trace_cache* c ) {
+    free( c->index );
+    free( c->blockno );
+    free( c->converted );
+    free( c->prev );
+    free( c->next );
+    free( c->data );
+    c->index = NULL;
+    c->blockno = NULL;
+    c->converted = NULL;
+    c->prev = NULL;
+    c->next = NULL;
+    c->data = NULL;
+}
+
+/*
+ * Reads are watched for a pattern, i.e. the same distance between the
+ * positions of consecutive reads, and when the pattern holds, the next reads
+ * along it are announced to the OS, which reads them in the background while
+ * the caller works on the current one. Only up to `bytes` bytes are
+ * announced, in batches of about half of that.
+ */
+struct readahead {
+    long long bytes;
+    long long last;     /* position of the previous read */
+    long long delta;    /* distance between the previous two reads */
+    int run;            /* reads in a row with this delta */
+    long long frontier; /* reads up to here are already announced */
+};
+
 struct segy_file_handle {
     void* addr;
     void* cur;
@@ -439,8 +552,445 @@ struct segy_file_handle {
     int writable;
     int elemsize;
     int lsb;
+    long long scan_blocksize;
+    struct trace_cache* cache;
+    struct readahead ra;
+
+    /*
+     * scratch memory for reads and writes that need a buffer of their own,
+     * e.g. strided reads without mmap. Either owned by the handle and grown
+     * as needed, or attached by the caller with segy_set_scratch.
+     */
+    void* scratch;
+    size_t scratchsize;
+    int scratch_attached;
+
+    /*
+     * set if fp is a compressed-trace container, which is then read like the
+     * file it was built from, see struct container
+     */
+    struct container* container;
+};
+
+/*
+ * Header scans on files that are not memory mapped read this many bytes at a
+ * time, see struct header_scan.
+ */
+static const long long scan_default_blocksize = 16 * 1024 * 1024;
+
+/*
+ * When there are more than this many bytes between the headers of a scan,
+ * reading headers one by one is cheaper than reading through the gaps.
+ * Roughly the bytes a networked file system can transfer in the time of one
+ * extra request.
+ */
+static const long long scan_max_gap = 1024 * 1024;
+
+/*
+ * A compressed-trace container, written by segy_container_build, is the magic
+ * string followed by native int32s: a byte order mark, format, element size,
+ * samples per trace, traces per block, compression and whether the samples
+ * are lsb, and at byte 40 the native int64s trace0 and number of traces, and
+ * the tolerance as a native double.
+ *
+ * After the header are the first trace0 bytes of the file as they are, i.e.
+ * the textual and binary headers, and then a table of native int64 file
+ * positions, two for every block of traces and one for the end of the last.
+ * The trace headers of block i are the bytes [table[2i], table[2i + 1]), and
+ * its samples are the bytes [table[2i + 1], table[2i + 2]), each compressed
+ * with segy_compress.
+ *
+ * Trace headers are compressed losslessly as 4-byte samples. Lossless
+ * containers compress the samples as they are on disk, the 3-byte formats as
+ * 1-byte samples, and lossy containers compress them as native floats, which
+ * are converted back to the on-disk format when decoded.
+ */
+#define CONTAINER_MAGIC "SEGYZIP1"
+#define CONTAINER_HEADER_SIZE 64
+#define CONTAINER_BOM 0x01020304
+#define CONTAINER_TRACE0_POS 40
+#define CONTAINER_TOLERANCE_POS 56
+
+/*
+ * Seek fp to the absolute position pos. long is only 32 bits on some
+ * platforms (hello, windows), so larger positions are reached in steps of
+ * LONG_MAX relative to the beginning of the file.
+ */
+static int fseek_abs( FILE* fp, long long pos ) {
+    int err;
+#if LONG_MAX == LLONG_MAX
+    assert( pos <= LONG_MAX );
+    err = fseek( fp, (long)pos, SEEK_SET );
+#else
+    err = SEGY_OK;
+    rewind( fp );
+    while( pos >= LONG_MAX && err == SEGY_OK ) {
+        err = fseek( fp, LONG_MAX, SEEK_CUR );
+        pos -= LONG_MAX;
+    }
+
+    if( err != 0 ) return SEGY_FSEEK_ERROR;
+
+    assert( pos <= LONG_MAX );
+    err = fseek( fp, (long)pos, SEEK_CUR );
+#endif
+
+    if( err != 0 ) return SEGY_FSEEK_ERROR;
+    return SEGY_OK;
+}
+
+/*
+ * The number of decoded blocks an open container keeps. Reads tend to either
+ * walk the file, which needs one block at a time, or go back and forth
+ * between a few lines, so a handful is plenty.
+ */
+#define CONTAINER_CACHE_BLOCKS 4
+
+struct container_block {
+    long long index;          /* -1 if the slot is empty */
+    unsigned long long used;  /* when the block was last read */
+    char* traces;             /* the block's traces, as they are in the file */
+};
+
+/*
+ * An open compressed-trace container, read like the file it was built from.
+ * The block table is kept, and blocks are decoded when they are read, so
+ * opening a container, and reading a trace of it, costs a block, not the
+ * whole file.
+ *
+ * The cache is shared by all reads of the handle, which can come from many
+ * threads, so it is guarded by a lock.
+ */
+struct container {
+    int format;
+    int samples;
+    int block_traces;
+    int compression;
+    int lsb;
+    int codec;
+
+    long long trace0;
+    long long traces;
+    long long tracesize;
+    long long blocks;
+    long long size;     /* the size of the decoded file */
+    long long pos;      /* the cursor, for the fread-like reads */
+
+    char* prefix;       /* the first trace0 bytes of the file */
+    int64_t* table;
+
+    char* packed;
+    long long packedsize;
+    char* unpacked;     /* headers and samples of a block, before interleave */
+
+    unsigned long long clock;
+    struct container_block cache[ CONTAINER_CACHE_BLOCKS ];
+
+#if defined(HAVE_PTHREAD)
+    pthread_mutex_t lock;
+#elif defined(_WIN32)
+    CRITICAL_SECTION lock;
+#endif
 };
 
+static void container_lock( struct container* c ) {
+#if defined(HAVE_PTHREAD)
+    pthread_mutex_lock( &c->lock );
+#elif defined(_WIN32)
+    EnterCriticalSection( &c->lock );
+#else
+    (void)c;
+#endif
+}
+
+static void container_unlock( struct container* c ) {
+#if defined(HAVE_PTHREAD)
+    pthread_mutex_unlock( &c->lock );
+#elif defined(_WIN32)
+    LeaveCriticalSection( &c->lock );
+#else
+    (void)c;
+#endif
+}
+
+static void container_free( struct container* c ) {
+    if( !c ) return;
+
+#if defined(HAVE_PTHREAD)
+    pthread_mutex_destroy( &c->lock );
+#elif defined(_WIN32)
+    DeleteCriticalSection( &c->lock );
+#endif
+
+    for( int i = 0; i < CONTAINER_CACHE_BLOCKS; ++i )
+        free( c->cache[ i ].traces );
+    free( c->unpacked );
+    free( c->packed );
+    free( c->table );
+    free( c->prefix );
+    free( c );
+}
+
+/*
+ * Read the header and block table of the container fp, and make a container
+ * that decodes its blocks on demand.
+ */
+static int container_open( FILE* fp, struct container** out ) {
+    int32_t header[ CONTAINER_HEADER_SIZE / sizeof( int32_t ) ];
+    if( fseek( fp, 0, SEEK_SET ) != 0 ) return SEGY_FSEEK_ERROR;
+    if( fread( header, CONTAINER_HEADER_SIZE, 1, fp ) != 1 )
+        return SEGY_FREAD_ERROR;
+
+    if( memcmp( header, CONTAINER_MAGIC, 8 ) != 0 ) return SEGY_INVALID_ARGS;
+    if( header[ 2 ] != CONTAINER_BOM ) return SEGY_INVALID_ARGS;
+
+    const int format       = header[ 3 ];
+    const int elemsize     = header[ 4 ];
+    const int samples      = header[ 5 ];
+    const int block_traces = header[ 6 ];
+    const int compression  = header[ 7 ];
+    const int lsb          = header[ 8 ];
+
+    int64_t trace0, traces;
+    const char* pos = (const char*)header + CONTAINER_TRACE0_POS;
+    memcpy( &trace0, pos, sizeof( trace0 ) );
+    memcpy( &traces, pos + sizeof( trace0 ), sizeof( traces ) );
+
+    if( formatsize( format ) != elemsize ) return SEGY_INVALID_ARGS;
+    if( samples < 0 || block_traces < 1 ) return SEGY_INVALID_ARGS;
+    if( trace0 < 0 || traces < 0 ) return SEGY_INVALID_ARGS;
+    if( compression != SEGY_LOSSLESS && compression != SEGY_LOSSY )
+        return SEGY_INVALID_ARGS;
+    if( compression == SEGY_LOSSY && elemsize != sizeof( float ) )
+        return SEGY_INVALID_ARGS;
+
+    const long long tracesize = SEGY_TRACE_HEADER_SIZE
+                              + (long long)samples * elemsize;
+    if( traces > (LLONG_MAX - trace0) / tracesize ) return SEGY_INVALID_ARGS;
+    if( block_traces > LLONG_MAX / 2 / tracesize ) return SEGY_INVALID_ARGS;
+
+    const long long blocks = (traces + block_traces - 1) / block_traces;
+    const long long positions = 2 * blocks + 1;
+
+    struct container* c = calloc( 1, sizeof( struct container ) );
+    if( !c ) return SEGY_MEMORY_ERROR;
+
+    c->format = format;
+    c->samples = samples;
+    c->block_traces = block_traces;
+    c->compression = compression;
+    c->lsb = lsb;
+    /* the element size the samples are compressed with */
+    c->codec = compression == SEGY_LOSSY ? (int)sizeof( float )
+             : elemsize == 3             ? 1
+             : elemsize;
+    c->trace0 = trace0;
+    c->traces = traces;
+    c->tracesize = tracesize;
+    c->blocks = blocks;
+    c->size = trace0 + traces * tracesize;
+    for( int i = 0; i < CONTAINER_CACHE_BLOCKS; ++i )
+        c->cache[ i ].index = -1;
+
+#if defined(HAVE_PTHREAD)
+    if( pthread_mutex_init( &c->lock, NULL ) != 0 ) {
+        free( c );
+        return SEGY_MEMORY_ERROR;
+    }
+#elif defined(_WIN32)
+    InitializeCriticalSection( &c->lock );
+#endif
+
+    c->prefix = malloc( trace0 > 0 ? trace0 : 1 );
+    c->table = malloc( positions * sizeof( int64_t ) );
+    if( !c->prefix || !c->table ) {
+        container_free( c );
+        return SEGY_MEMORY_ERROR;
+    }
+
+    const size_t prefix = fread( c->prefix, 1, trace0, fp );
+    const size_t entries = fread( c->table, sizeof( int64_t ), positions, fp );
+    if( prefix != (size_t)trace0 || entries != (size_t)positions ) {
+        container_free( c );
+        return SEGY_FREAD_ERROR;
+    }
+
+    /*
+     * the blocks follow the table, in order, and a block is read as one, so
+     * the table must be increasing, and end inside the file
+     */
+    const int64_t* table = c->table;
+    bool ok = table[ 0 ] == CONTAINER_HEADER_SIZE + trace0 + positions * 8;
+    for( long long i = 0; ok && i + 1 < positions; ++i )
+        ok = table[ i ] <= table[ i + 1 ];
+
+#ifdef HAVE_SYS_STAT_H
+    long long fsize;
+    if( ok && file_size( fp, &fsize ) == SEGY_OK )
+        ok = table[ positions - 1 ] <= fsize;
+#endif //HAVE_SYS_STAT_H
+
+    if( !ok ) {
+        container_free( c );
+        return SEGY_INVALID_ARGS;
+    }
+
+    *out = c;
+    return SEGY_OK;
+}
+
+/*
+ * Decode block b of the container read through fp into traces, as it is in
+ * the file. Must be called with the lock held.
+ */
+static int container_decode( struct container* c,
+                             FILE* fp,
+                             long long b,
+                             char* traces ) {
+    const long long first = b * c->block_traces;
+    const long long n = c->traces - first < c->block_traces
+                      ? c->traces - first
+                      : c->block_traces;
+
+    const long long trace_bsize = c->tracesize - SEGY_TRACE_HEADER_SIZE;
+    const long long begin = c->table[ 2 * b ];
+    const long long mid   = c->table[ 2 * b + 1 ];
+    const long long end   = c->table[ 2 * b + 2 ];
+
+    /* the headers and samples of a block are next to each other, one read */
+    if( end - begin > c->packedsize ) {
+        char* packed = realloc( c->packed, end - begin );
+        if( !packed ) return SEGY_MEMORY_ERROR;
+        c->packed = packed;
+        c->packedsize = end - begin;
+    }
+
+    if( !c->unpacked ) {
+        c->unpacked = malloc( c->block_traces * c->tracesize );
+        if( !c->unpacked ) return SEGY_MEMORY_ERROR;
+    }
+
+    int err = fseek_abs( fp, begin );
+    if( err != SEGY_OK ) return err;
+    if( fread( c->packed, 1, end - begin, fp ) != (size_t)(end - begin) )
+        return SEGY_FREAD_ERROR;
+
+    char* headers = c->unpacked;
+    char* data = c->unpacked + n * SEGY_TRACE_HEADER_SIZE;
+
+    err = segy_decompress( c->packed, mid - begin,
+                           n * SEGY_TRACE_HEADER_SIZE / sizeof( int32_t ),
+                           sizeof( int32_t ),
+                           headers );
+    if( err != SEGY_OK ) return err;
+
+    err = segy_decompress( c->packed + (mid - begin), end - mid,
+                           n * trace_bsize / c->codec, c->codec,
+                           data );
+    if( err != SEGY_OK ) return err;
+
+    if( c->compression == SEGY_LOSSY ) {
+        err = segy_from_native( c->format, n * c->samples, data );
+        if( err != SEGY_OK ) return err;
+
+        /* segy_from_native gives msb */
+        for( long long i = 0; c->lsb && i < n * c->samples; ++i ) {
+            uint32_t x;
+            memcpy( &x, data + i * sizeof( x ), sizeof( x ) );
+            x = bswap32( x );
+            memcpy( data + i * sizeof( x ), &x, sizeof( x ) );
+        }
+    }
+
+    for( long long t = 0; t < n; ++t ) {
+        char* dst = traces + t * c->tracesize;
+        memcpy( dst, headers + t * SEGY_TRACE_HEADER_SIZE,
+                SEGY_TRACE_HEADER_SIZE );
+        memcpy( dst + SEGY_TRACE_HEADER_SIZE, data + t * trace_bsize,
+                trace_bsize );
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * The decoded traces of block b, from the cache if it's there, or decoded
+ * into the least recently used slot. Must be called with the lock held.
+ */
+static const char* container_block( struct container* c,
+                                    FILE* fp,
+                                    long long b,
+                                    int* err ) {
+    struct container_block* slot = c->cache;
+    for( int i = 0; i < CONTAINER_CACHE_BLOCKS; ++i ) {
+        struct container_block* x = c->cache + i;
+        if( x->index == b ) {
+            x->used = ++c->clock;
+            return x->traces;
+        }
+
+        if( x->used < slot->used ) slot = x;
+    }
+
+    if( !slot->traces ) {
+        slot->traces = malloc( c->block_traces * c->tracesize );
+        if( !slot->traces ) {
+            *err = SEGY_MEMORY_ERROR;
+            return NULL;
+        }
+    }
+
+    slot->index = -1;
+    *err = container_decode( c, fp, b, slot->traces );
+    if( *err != SEGY_OK ) return NULL;
+
+    slot->index = b;
+    slot->used = ++c->clock;
+    return slot->traces;
+}
+
+/*
+ * Read the n bytes at pos of the decoded file into dst, decoding the blocks
+ * they are in as needed
+ */
+static int container_read( struct container* c,
+                           FILE* fp,
+                           void* dst,
+                           long long pos,
+                           long long n ) {
+    if( pos < 0 || n < 0 || pos > c->size || n > c->size - pos )
+        return SEGY_FREAD_ERROR;
+
+    char* out = dst;
+    if( pos < c->trace0 ) {
+        const long long len = c->trace0 - pos < n ? c->trace0 - pos : n;
+        memcpy( out, c->prefix + pos, len );
+        out += len;
+        pos += len;
+        n -= len;
+    }
+
+    const long long blocksize = c->block_traces * c->tracesize;
+    int err = SEGY_OK;
+
+    container_lock( c );
+    while( n > 0 ) {
+        const long long b = (pos - c->trace0) / blocksize;
+        const long long offset = (pos - c->trace0) % blocksize;
+        const char* traces = container_block( c, fp, b, &err );
+        if( !traces ) break;
+
+        const long long len = blocksize - offset < n ? blocksize - offset : n;
+        memcpy( out, traces + offset, len );
+        out += len;
+        pos += len;
+        n -= len;
+    }
+    container_unlock( c );
+
+    return err;
+}
+
 segy_file* segy_open( const char* path, const char* mode ) {
 
     if( !path || !mode ) return NULL;
@@ -502,10 +1052,95 @@ segy_file* segy_open( const char* path, const char* mode ) {
     // assume a size of 4-bytes-per-element, until the set_format function
     // tells us otherwise.
     file->elemsize = 4;
+    file->scan_blocksize = scan_default_blocksize;
+
+    /*
+     * compressed-trace containers are read transparently, by decoding their
+     * blocks as they are read. They can't be written to.
+     */
+    char magic[ 8 ];
+    if( binary_mode[ 0 ] != 'r' ) return file;
+    if( fread( magic, sizeof( magic ), 1, fp ) != 1
+     || memcmp( magic, CONTAINER_MAGIC, sizeof( magic ) ) != 0 ) {
+        rewind( fp );
+        return file;
+    }
+
+    const int err = rw ? SEGY_READONLY : container_open( fp, &file->container );
+    if( err != SEGY_OK ) {
+        switch( err ) {
+            case SEGY_READONLY:     errno = EROFS;  break;
+            case SEGY_MEMORY_ERROR: errno = ENOMEM; break;
+            default:                errno = EINVAL; break;
+        }
+
+        fclose( file->fp );
+        free( file );
+        return NULL;
+    }
 
     return file;
 }
 
+int segy_set_scan_blocksize( segy_file* fp, long long bytes ) {
+    if( bytes < 0 ) return SEGY_INVALID_ARGS;
+    fp->scan_blocksize = bytes;
+    return SEGY_OK;
+}
+
+int segy_set_readahead( segy_file* fp, long long bytes ) {
+    if( bytes < 0 ) return SEGY_INVALID_ARGS;
+    memset( &fp->ra, 0, sizeof( fp->ra ) );
+    fp->ra.bytes = bytes;
+    return SEGY_OK;
+}
+
+int segy_set_scratch( segy_file* fp, void* buf, long long size ) {
+    if( size < 0 ) return SEGY_INVALID_ARGS;
+
+    if( !fp->scratch_attached ) free( fp->scratch );
+    fp->scratch = NULL;
+    fp->scratchsize = 0;
+    fp->scratch_attached = 0;
+
+    if( buf ) {
+        fp->scratch = buf;
+        fp->scratchsize = size;
+        fp->scratch_attached = 1;
+        return SEGY_OK;
+    }
+
+    if( size == 0 ) return SEGY_OK;
+
+    fp->scratch = malloc( size );
+    if( !fp->scratch ) return SEGY_MEMORY_ERROR;
+    fp->scratchsize = size;
+    return SEGY_OK;
+}
+
+/*
+ * Scratch memory of at least size bytes, valid until the next call. When the
+ * current scratch is too small it is replaced by a larger one owned by the
+ * handle - an attached buffer is then no longer used, but still belongs to
+ * the caller.
+ */
+static void* scratch( segy_file* fp, size_t size ) {
+    if( size <= fp->scratchsize ) return fp->scratch;
+
+    if( fp->scratch_attached ) {
+        fp->scratch = NULL;
+        fp->scratchsize = 0;
+        fp->scratch_attached = 0;
+    }
+
+    void* p = realloc( fp->scratch, size );
+    if( !p ) return NULL;
+
+    fp->scratch = p;
+    fp->scratchsize = size;
+    return p;
+}
+
 int segy_mmap( segy_file* fp ) {
 #ifndef HAVE_MMAP
     return SEGY_MMAP_INVALID;
@@ -514,6 +1149,9 @@ int segy_mmap( segy_file* fp ) {
     /* don't re-map; i.e. multiple consecutive calls should be no-ops */
     if( fp->addr ) return SEGY_OK;
 
+    /* the file on disk is compressed, so there is nothing to map */
+    if( fp->container ) return SEGY_MMAP_INVALID;
+
     long long fsize;
     int err = file_size( fp->fp, &fsize );
 
@@ -536,6 +1174,14 @@ int segy_mmap( segy_file* fp ) {
 #endif //HAVE_MMAP
 }
 
+int segy_mmap_region( segy_file* fp, void** addr, long long* size ) {
+    if( !fp->addr ) return SEGY_MMAP_INVALID;
+
+    *addr = fp->addr;
+    *size = fp->fsize;
+    return SEGY_OK;
+}
+
 int segy_flush( segy_file* fp, bool async ) {
 
     // flush is a no-op for read-only files
@@ -558,6 +1204,8 @@ int segy_flush( segy_file* fp, bool async ) {
 }
 
 long long segy_ftell( segy_file* fp ) {
+    if( fp->container ) return fp->container->pos;
+
 #ifdef HAVE_FTELLO
     off_t pos = ftello( fp->fp );
     assert( pos != -1 );
@@ -574,6 +1222,12 @@ long long segy_ftell( segy_file* fp ) {
 int segy_close( segy_file* fp ) {
     int err = segy_flush( fp, false );
 
+    if( fp->cache ) trace_cache_clear( fp->cache );
+    free( fp->cache );
+    if( !fp->scratch_attached ) free( fp->scratch );
+
+    container_free( fp->container );
+
 #ifdef HAVE_MMAP
     if( !fp->addr ) goto no_mmap;
 
@@ -705,55 +1359,405 @@ static int slicelength( int start, int stop, int step ) {
     return (stop - start - 1) / step + 1;
 }
 
-static int32_t bswap_header_word(int32_t f, int word_size) {
-    if (word_size == 4)
-        return bswap32(f);
-
-    /*
-     * The casts are here are necessary
-     *
-     * First, it must be converted to a *signed* short (to preserve negative
-     * numbers). The narrowing is safe because the source is 2 bytes anyway.
-     *
-     * The behaviour when this is implicitly wrong was discovered in [1].
-     *
-     * Then, it must be byteswapped with bswap16. When using the shifts is
-     * probably fine as the types are also cast in the macro and are
-     * compatible, but the builtins have this signature [2]:
-     *
-     *  uint16_t __builtin_bswap16 (uint16_t x)
-     *
-     * which means that if the value is *negative* it will be interpreted as
-     * unsigned and very much positive. When it is then implicitly converted
-     * in the return type it is widened, and int32 can fit uint16 maximum just
-     * fine.
-     *
-     * [1] https://github.com/equinor/segyio/issues/368
-     * [2] http://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
-     */
-    return (int16_t) bswap16((int16_t) f);
+/*
+ * Pointer to the n bytes at the absolute file offset pos in a memory mapped
+ * file, or NULL if [pos, pos+n) is not inside the file.
+ */
+static const char* mmap_at( const segy_file* fp, long long pos, size_t n ) {
+    if( pos < 0 || (unsigned long long)pos > fp->fsize ) return NULL;
+    if( n > fp->fsize - (size_t)pos ) return NULL;
+    return (const char*)fp->addr + pos;
 }
 
-int segy_field_forall( segy_file* fp,
-                       int field,
-                       int start,
-                       int stop,
-                       int step,
-                       int* buf,
-                       long trace0,
-                       int trace_bsize ) {
-    int err;
-    // do a dummy-read of a zero-init'd buffer to check args
-    int32_t f;
-    char header[ SEGY_TRACE_HEADER_SIZE ] = { 0 };
-    err = segy_get_field( header, field, &f );
-    if( err != SEGY_OK ) return SEGY_INVALID_ARGS;
+/*
+ * Read n bytes at the absolute file offset pos into dest, without going
+ * through (or moving) the handle's cursor. On mmap'd files this is just
+ * address arithmetic, otherwise pread(2) is used, which leaves the file
+ * position untouched and is safe to call from multiple threads on the same
+ * file descriptor.
+ *
+ * On platforms without pread this falls back to seek + fread, which is *not*
+ * safe for concurrent use. Compressed-trace containers are read from their
+ * decoded blocks.
+ */
+static int pread_at( segy_file* fp, void* dest, long long pos, size_t n ) {
+    if( pos < 0 ) return SEGY_FREAD_ERROR;
 
-    // since segy_get_field didn't fail earlier, it is safe to look up the word
-    // size
-    const int word_size = field_size[field];
+    if( fp->addr ) {
+        const char* src = mmap_at( fp, pos, n );
+        if( !src ) return SEGY_FREAD_ERROR;
+        memcpy( dest, src, n );
+        return SEGY_OK;
+    }
 
-    int slicelen = slicelength( start, stop, step );
+    if( fp->container )
+        return container_read( fp->container, fp->fp, dest, pos, n );
+
+#if defined(HAVE_PREAD)
+    const int fd = fileno( fp->fp );
+    char* dst = (char*)dest;
+    while( n > 0 ) {
+        const ssize_t readc = pread( fd, dst, n, (off_t)pos );
+        if( readc <= 0 ) return SEGY_FREAD_ERROR;
+        dst += readc;
+        pos += readc;
+        n -= (size_t)readc;
+    }
+    return SEGY_OK;
+#elif defined(_WIN32)
+    HANDLE h = (HANDLE)_get_osfhandle( _fileno( fp->fp ) );
+    if( h == INVALID_HANDLE_VALUE ) return SEGY_FREAD_ERROR;
+
+    char* dst = (char*)dest;
+    while( n > 0 ) {
+        OVERLAPPED ov;
+        memset( &ov, 0, sizeof( ov ) );
+        ov.Offset     = (DWORD)( pos & 0xFFFFFFFF );
+        ov.OffsetHigh = (DWORD)( pos >> 32 );
+
+        const DWORD chunk = n > 0x40000000 ? 0x40000000 : (DWORD)n;
+        DWORD readc = 0;
+        if( !ReadFile( h, dst, chunk, &readc, &ov ) || readc == 0 )
+            return SEGY_FREAD_ERROR;
+
+        dst += readc;
+        pos += readc;
+        n -= readc;
+    }
+    return SEGY_OK;
+#else
+    int err = segy_seek( fp, 0, (long)pos, 0 );
+    if( err != SEGY_OK ) return err;
+    const size_t readc = fread( dest, 1, n, fp->fp );
+    if( readc != n ) return SEGY_FREAD_ERROR;
+    return SEGY_OK;
+#endif
+}
+
+/*
+ * fread from the handle's cursor, which for compressed-trace containers is a
+ * position in the decoded file. Returns the number of whole elements read.
+ */
+static size_t file_read( segy_file* fp, void* dst, size_t size, size_t count ) {
+    struct container* c = fp->container;
+    if( !c ) return fread( dst, size, count, fp->fp );
+
+    const long long left = c->pos < c->size ? c->size - c->pos : 0;
+    if( (long long)( size * count ) > left ) count = left / size;
+
+    const long long len = (long long)( size * count );
+    if( container_read( c, fp->fp, dst, c->pos, len ) != SEGY_OK ) return 0;
+    c->pos += len;
+    return count;
+}
+
+/*
+ * Move the handle's cursor to the absolute position pos
+ */
+static int file_seek( segy_file* fp, long long pos ) {
+    if( fp->container ) {
+        fp->container->pos = pos;
+        return SEGY_OK;
+    }
+
+    return fseek_abs( fp->fp, pos );
+}
+
+/*
+ * The size of the file the handle reads, which for compressed-trace
+ * containers is the size of the decoded file
+ */
+static int handle_size( segy_file* fp, long long* size ) {
+    if( fp->addr ) {
+        *size = fp->fsize;
+        return SEGY_OK;
+    }
+
+    if( fp->container ) {
+        *size = fp->container->size;
+        return SEGY_OK;
+    }
+
+    return file_size( fp->fp, size );
+}
+
+static long long trace_offset( long long traceno, long trace0, int trace_bsize ) {
+    const long long bsize = trace_bsize + SEGY_TRACE_HEADER_SIZE;
+    return (long long)trace0 + traceno * bsize;
+}
+
+/*
+ * Tell the OS that [pos, pos + len) will be read soon. This is only a hint,
+ * and does nothing where there's no way to give it.
+ */
+static void prefetch( segy_file* fp, long long pos, long long len ) {
+    if( pos < 0 ) {
+        len += pos;
+        pos = 0;
+    }
+    if( len <= 0 ) return;
+
+    /* positions in a container are not positions in the file on disk */
+    if( fp->container ) return;
+
+#ifdef HAVE_MMAP
+    if( fp->addr ) {
+        const long long fsize = fp->fsize;
+        if( pos >= fsize ) return;
+        if( pos + len > fsize ) len = fsize - pos;
+
+        /* madvise wants page aligned addresses, and 64k covers any page size */
+        const long long begin = pos & ~((1LL << 16) - 1);
+        posix_madvise( (char*)fp->addr + begin,
+                       (size_t)( pos + len - begin ),
+                       POSIX_MADV_WILLNEED );
+        return;
+    }
+#endif //HAVE_MMAP
+
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise( fileno( fp->fp ), pos, len, POSIX_FADV_WILLNEED );
+#endif //HAVE_POSIX_FADVISE
+}
+
+/*
+ * Record a read of [pos, pos + len), and prefetch the reads that are
+ * expected to follow it. A pattern is trusted after three reads with the same
+ * distance, so random access is never prefetched.
+ */
+static void readahead( segy_file* fp, long long pos, long long len ) {
+    struct readahead* ra = &fp->ra;
+    if( ra->bytes <= 0 || len <= 0 ) return;
+
+    const long long delta = pos - ra->last;
+    ra->last = pos;
+
+    /* the same record again, e.g. the samples after the header */
+    if( delta == 0 ) return;
+
+    if( delta != ra->delta ) {
+        ra->delta = delta;
+        ra->run = 1;
+        ra->frontier = pos;
+        return;
+    }
+
+    if( ++ra->run < 2 ) return;
+
+    long long count = ra->bytes / len;
+    if( count < 1 ) count = 1;
+
+    /* announce more only when less than half the window is left */
+    const long long ahead = (ra->frontier - pos) / delta;
+    if( ahead > count / 2 ) return;
+
+    const long long k0 = ahead > 0 ? ahead + 1 : 1;
+    const long long first = pos + k0 * delta;
+    const long long last = pos + count * delta;
+    const long long distance = delta < 0 ? -delta : delta;
+
+    if( distance <= len ) {
+        /* the reads overlap or touch, so announce all of them at once */
+        const long long lo = first < last ? first : last;
+        const long long hi = first < last ? last : first;
+        prefetch( fp, lo, hi - lo + len );
+    } else {
+        for( long long k = k0; k <= count; ++k )
+            prefetch( fp, pos + k * delta, len );
+    }
+
+    ra->frontier = last;
+}
+
+/*
+ * Reader for the headers of a header scan, i.e. one that visits traces with a
+ * fixed stride. Without mmap, reading a few bytes per trace means one request
+ * per trace, which is very slow on networked file systems. Instead, read
+ * large blocks (scan_blocksize) and pick the headers from them, unless the
+ * stride is so large that reading headers one by one is cheaper.
+ *
+ * The block is never larger than the part of the file the scan visits. When
+ * the number of headers is not known up front (count = 0), e.g. when looking
+ * for the first trace where a line number changes, the block starts out with
+ * room for a few headers and doubles every time it is refilled, so scans that
+ * stop after a handful of headers don't read megabytes.
+ *
+ * The headers are copied out as-is, i.e. not byteswapped for lsb files.
+ */
+struct header_scan {
+    segy_file* fp;
+    long trace0;
+    int trace_bsize;
+    int reverse;
+    char* block;
+    long long blocksize;
+    long long maxsize;
+    long long fsize;
+    long long begin;
+    long long len;
+};
+
+static int header_scan_init( struct header_scan* scan,
+                             segy_file* fp,
+                             int step,
+                             long long count,
+                             long trace0,
+                             int trace_bsize ) {
+    scan->fp = fp;
+    scan->trace0 = trace0;
+    scan->trace_bsize = trace_bsize;
+    scan->reverse = step < 0;
+    scan->block = NULL;
+    scan->begin = 0;
+    scan->len = 0;
+
+    /* headers are read with pread, which does not see buffered writes */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    /* containers are read from decoded blocks, already a memory copy */
+    if( fp->addr || fp->container || fp->scan_blocksize <= 0 ) return SEGY_OK;
+
+    const long long stride = (long long)(trace_bsize + SEGY_TRACE_HEADER_SIZE)
+                           * (step < 0 ? -(long long)step : step);
+    if( stride - SEGY_TRACE_HEADER_SIZE > scan_max_gap ) return SEGY_OK;
+
+#ifdef HAVE_SYS_STAT_H
+    if( file_size( fp->fp, &scan->fsize ) != SEGY_OK ) return SEGY_OK;
+#else
+    return SEGY_OK;
+#endif
+
+    long long maxsize = fp->scan_blocksize;
+    if( maxsize > scan->fsize ) maxsize = scan->fsize;
+    if( count > 0 && maxsize > (count - 1) * stride + SEGY_TRACE_HEADER_SIZE )
+        maxsize = (count - 1) * stride + SEGY_TRACE_HEADER_SIZE;
+    if( maxsize < SEGY_TRACE_HEADER_SIZE ) maxsize = SEGY_TRACE_HEADER_SIZE;
+
+    long long blocksize = maxsize;
+    if( count <= 0 && blocksize > 8 * stride )
+        blocksize = 8 * stride;
+
+    /* no buffer is not an error, the scan is just slower */
+    scan->block = malloc( blocksize );
+    scan->blocksize = blocksize;
+    scan->maxsize = maxsize;
+    return SEGY_OK;
+}
+
+static void header_scan_free( struct header_scan* scan ) {
+    free( scan->block );
+    scan->block = NULL;
+}
+
+/*
+ * Read the bytes [lo, hi) of the header of traceno into header + lo
+ */
+static int header_scan_read( struct header_scan* scan,
+                             long long traceno,
+                             int lo,
+                             int hi,
+                             char* header ) {
+    const long long pos = trace_offset( traceno,
+                                        scan->trace0,
+                                        scan->trace_bsize ) + lo;
+    const long long n = hi - lo;
+
+    if( !scan->block ) return pread_at( scan->fp, header + lo, pos, n );
+
+    if( pos < scan->begin || pos + n > scan->begin + scan->len ) {
+        if( pos < 0 || pos + n > scan->fsize ) return SEGY_FREAD_ERROR;
+
+        /* the scan goes on past the first block, so read more at a time */
+        if( scan->len > 0 && scan->blocksize < scan->maxsize ) {
+            long long grown = 2 * scan->blocksize;
+            if( grown > scan->maxsize ) grown = scan->maxsize;
+            char* block = realloc( scan->block, grown );
+            if( block ) {
+                scan->block = block;
+                scan->blocksize = grown;
+            }
+        }
+
+        /* place the block so that the next headers of the scan are in it */
+        long long begin = pos;
+        if( scan->reverse ) {
+            begin = pos + n - scan->blocksize;
+            if( begin < 0 ) begin = 0;
+        }
+
+        long long len = scan->fsize - begin;
+        if( len > scan->blocksize ) len = scan->blocksize;
+
+        scan->len = 0;
+        const int err = pread_at( scan->fp, scan->block, begin, len );
+        if( err != SEGY_OK ) return err;
+
+        scan->begin = begin;
+        scan->len = len;
+
+        /* the scan continues in the next block, so have the OS read it now */
+        if( scan->fp->ra.bytes > 0 ) {
+            if( scan->reverse )
+                prefetch( scan->fp, begin - scan->blocksize, scan->blocksize );
+            else
+                prefetch( scan->fp, begin + len, scan->blocksize );
+        }
+    }
+
+    memcpy( header + lo, scan->block + (pos - scan->begin), n );
+    return SEGY_OK;
+}
+
+static int32_t bswap_header_word(int32_t f, int word_size) {
+    if (word_size == 4)
+        return bswap32(f);
+
+    /*
+     * The casts are here are necessary
+     *
+     * First, it must be converted to a *signed* short (to preserve negative
+     * numbers). The narrowing is safe because the source is 2 bytes anyway.
+     *
+     * The behaviour when this is implicitly wrong was discovered in [1].
+     *
+     * Then, it must be byteswapped with bswap16. When using the shifts is
+     * probably fine as the types are also cast in the macro and are
+     * compatible, but the builtins have this signature [2]:
+     *
+     *  uint16_t __builtin_bswap16 (uint16_t x)
+     *
+     * which means that if the value is *negative* it will be interpreted as
+     * unsigned and very much positive. When it is then implicitly converted
+     * in the return type it is widened, and int32 can fit uint16 maximum just
+     * fine.
+     *
+     * [1] https://github.com/equinor/segyio/issues/368
+     * [2] http://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
+     */
+    return (int16_t) bswap16((int16_t) f);
+}
+
+int segy_field_forall( segy_file* fp,
+                       int field,
+                       int start,
+                       int stop,
+                       int step,
+                       int* buf,
+                       long trace0,
+                       int trace_bsize ) {
+    int err;
+    // do a dummy-read of a zero-init'd buffer to check args
+    int32_t f;
+    char header[ SEGY_TRACE_HEADER_SIZE ] = { 0 };
+    err = segy_get_field( header, field, &f );
+    if( err != SEGY_OK ) return SEGY_INVALID_ARGS;
+
+    // since segy_get_field didn't fail earlier, it is safe to look up the word
+    // size
+    const int word_size = field_size[field];
+
+    int slicelen = slicelength( start, stop, step );
 
     // check *once* that we don't look past the end-of-file
     // checking seek error inside the loop is a performance killer
@@ -788,10 +1792,29 @@ int segy_field_forall( segy_file* fp,
      * Always read 4 bytes to be sure, there's no significant cost difference.
      */
     const int zfield = field - 1;
+    struct header_scan scan;
+    err = header_scan_init( &scan, fp, step, slicelen, trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+    if( scan.block ) {
+        for( int i = start; slicelen > 0; i += step, ++buf, --slicelen ) {
+            err = header_scan_read( &scan, i, zfield, zfield + word_size,
+                                    header );
+            if( err != SEGY_OK ) break;
+
+            get_field( header, field_size, field, &f );
+            if (lsb) f = bswap_header_word(f, word_size);
+            *buf = f;
+        }
+
+        header_scan_free( &scan );
+        return err;
+    }
+
     for( int i = start; slicelen > 0; i += step, ++buf, --slicelen ) {
         err = segy_seek( fp, i, trace0 + zfield, trace_bsize );
         if( err != 0 ) return SEGY_FSEEK_ERROR;
-        size_t readc = fread( header + zfield, sizeof(uint32_t), 1, fp->fp );
+        size_t readc = file_read( fp, header + zfield, sizeof(uint32_t), 1 );
         if( readc != 1 ) return SEGY_FREAD_ERROR;
 
         get_field( header, field_size, field, &f );
@@ -909,10 +1932,10 @@ int segy_binheader( segy_file* fp, char* buf ) {
     }
 #endif //HAVE_MMAP
 
-    const int err = fseek( fp->fp, SEGY_TEXT_HEADER_SIZE, SEEK_SET );
+    const int err = file_seek( fp, SEGY_TEXT_HEADER_SIZE );
     if( err != 0 ) return SEGY_FSEEK_ERROR;
 
-    const size_t read_count = fread( buf, 1, SEGY_BINARY_HEADER_SIZE, fp->fp );
+    const size_t read_count = file_read( fp, buf, 1, SEGY_BINARY_HEADER_SIZE );
     if( read_count != SEGY_BINARY_HEADER_SIZE )
         return SEGY_FREAD_ERROR;
 
@@ -1052,31 +2075,7 @@ int segy_seek( segy_file* fp,
     }
 #endif //HAVE_MMAP
 
-    int err;
-#if LONG_MAX == LLONG_MAX
-    assert( pos <= LONG_MAX );
-    err = fseek( fp->fp, (long)pos, SEEK_SET );
-#else
-   /*
-    * If long is 32bit on our platform (hello, windows), we do skips according
-    * to LONG_MAX and seek relative to our cursor rather than absolute on file
-    * begin.
-    */
-    err = SEGY_OK;
-    rewind( fp->fp );
-    while( pos >= LONG_MAX && err == SEGY_OK ) {
-        err = fseek( fp->fp, LONG_MAX, SEEK_CUR );
-        pos -= LONG_MAX;
-    }
-
-    if( err != 0 ) return SEGY_FSEEK_ERROR;
-
-    assert( pos <= LONG_MAX );
-    err = fseek( fp->fp, (long)pos, SEEK_CUR );
-#endif
-
-    if( err != 0 ) return SEGY_FSEEK_ERROR;
-    return SEGY_OK;
+    return file_seek( fp, pos );
 }
 
 static int bswap_th( char* xs, int lsb ) {
@@ -1200,12 +2199,196 @@ static int bswap_th( char* xs, int lsb ) {
     return SEGY_OK;
 }
 
+int segy_set_cache( segy_file* fp,
+                    long long bytes,
+                    int block_traces,
+                    int format ) {
+    if( bytes < 0 || block_traces < 1 ) return SEGY_INVALID_ARGS;
+    if( bytes > 0 && formatsize( format ) != fp->elemsize )
+        return SEGY_INVALID_ARGS;
+
+    struct trace_cache* c = NULL;
+    if( bytes > 0 ) {
+        c = calloc( 1, sizeof( struct trace_cache ) );
+        if( !c ) return SEGY_MEMORY_ERROR;
+        c->bytes = bytes;
+        c->block_traces = block_traces;
+        c->format = format;
+        c->trace_bsize = -1;
+    }
+
+    if( fp->cache ) trace_cache_clear( fp->cache );
+    free( fp->cache );
+    fp->cache = c;
+    return SEGY_OK;
+}
+
+int segy_cache_stats( const segy_file* fp,
+                      long long* hits,
+                      long long* misses ) {
+    *hits   = fp->cache ? fp->cache->hits   : 0;
+    *misses = fp->cache ? fp->cache->misses : 0;
+    return SEGY_OK;
+}
+
+/*
+ * Drop all cached blocks, e.g. because the file was written to. The slots are
+ * allocated again on the next read.
+ */
+static void trace_cache_invalidate( segy_file* fp ) {
+    if( fp->cache ) fp->cache->trace_bsize = -1;
+}
+
+/*
+ * (Re-)allocate the slots for traces of trace_bsize bytes starting at trace0,
+ * which makes an empty cache. The cache never has more slots than the file
+ * has blocks.
+ */
+static int trace_cache_reset( segy_file* fp, long trace0, int trace_bsize ) {
+    struct trace_cache* c = fp->cache;
+    trace_cache_clear( c );
+    c->trace_bsize = -1;
+
+    int traces;
+    const int err = segy_traces( fp, &traces, trace0, trace_bsize );
+    if( err == SEGY_TRACE_SIZE_MISMATCH ) traces = 0;
+    else if( err != SEGY_OK ) return err;
+
+    const long long recsize = SEGY_TRACE_HEADER_SIZE + trace_bsize;
+    const long long blockbytes = recsize * c->block_traces;
+    const long long blocks = (traces + c->block_traces - 1) / c->block_traces;
+
+    long long slots = c->bytes / blockbytes;
+    if( slots > blocks ) slots = blocks;
+    if( slots < 1 ) slots = 1;
+
+    c->index     = malloc( (blocks + 1) * sizeof( int ) );
+    c->blockno   = malloc( slots * sizeof( long long ) );
+    c->converted = malloc( slots );
+    c->prev      = malloc( slots * sizeof( int ) );
+    c->next      = malloc( slots * sizeof( int ) );
+    c->data      = malloc( slots * blockbytes );
+
+    if( !c->index || !c->blockno || !c->converted
+     || !c->prev || !c->next || !c->data ) {
+        trace_cache_clear( c );
+        return SEGY_MEMORY_ERROR;
+    }
+
+    for( long long i = 0; i < blocks; ++i ) c->index[ i ] = -1;
+    for( int i = 0; i < slots; ++i ) {
+        c->blockno[ i ] = -1;
+        c->prev[ i ] = i - 1;
+        c->next[ i ] = i + 1 < slots ? i + 1 : -1;
+    }
+
+    c->slots = slots;
+    c->blocks = blocks;
+    c->head = 0;
+    c->tail = slots - 1;
+    c->tracecount = traces;
+    c->trace0 = trace0;
+    c->trace_bsize = trace_bsize;
+    c->lsb = fp->lsb;
+    return SEGY_OK;
+}
+
+/* move slot to the head of the LRU list */
+static void trace_cache_touch( struct trace_cache* c, int slot ) {
+    if( c->head == slot ) return;
+
+    c->next[ c->prev[ slot ] ] = c->next[ slot ];
+    if( c->next[ slot ] >= 0 ) c->prev[ c->next[ slot ] ] = c->prev[ slot ];
+    else c->tail = c->prev[ slot ];
+
+    c->prev[ slot ] = -1;
+    c->next[ slot ] = c->head;
+    c->prev[ c->head ] = slot;
+    c->head = slot;
+}
+
+/*
+ * The cached record, i.e. header and samples, of traceno, reading its block
+ * into the least recently used slot on a miss. Returns NULL with *err ==
+ * SEGY_OK if the trace can't be served from the cache, and should be read
+ * from the file as usual, e.g. because it's past the end of the file.
+ */
+static char* trace_cache_record( segy_file* fp,
+                                 long long traceno,
+                                 long trace0,
+                                 int trace_bsize,
+                                 int* slot,
+                                 int* err ) {
+    struct trace_cache* c = fp->cache;
+    *err = SEGY_OK;
+
+    if( formatsize( c->format ) != fp->elemsize ) return NULL;
+
+    if( c->trace_bsize != trace_bsize
+     || c->trace0 != trace0
+     || c->lsb != fp->lsb ) {
+        *err = trace_cache_reset( fp, trace0, trace_bsize );
+        if( *err != SEGY_OK ) return NULL;
+    }
+
+    if( traceno < 0 || traceno >= c->tracecount ) return NULL;
+
+    const long long recsize = SEGY_TRACE_HEADER_SIZE + trace_bsize;
+    const long long blockbytes = recsize * c->block_traces;
+    const long long block = traceno / c->block_traces;
+    const long long first = block * c->block_traces;
+    int s = c->index[ block ];
+
+    if( s >= 0 ) {
+        ++c->hits;
+    } else {
+        ++c->misses;
+        s = c->tail;
+        if( c->blockno[ s ] >= 0 ) c->index[ c->blockno[ s ] ] = -1;
+        c->blockno[ s ] = -1;
+
+        const long long left = c->tracecount - first;
+        const long long n = left < c->block_traces ? left : c->block_traces;
+        char* dst = c->data + s * blockbytes;
+
+        *err = pread_at( fp, dst, trace_offset( first, trace0, trace_bsize ),
+                         (size_t)( n * recsize ) );
+        if( *err != SEGY_OK ) return NULL;
+
+        for( long long i = 0; i < n; ++i )
+            bswap_th( dst + i * recsize, fp->lsb );
+
+        c->converted[ s ] = 0;
+        c->blockno[ s ] = block;
+        c->index[ block ] = s;
+    }
+
+    trace_cache_touch( c, s );
+    *slot = s;
+    return c->data + s * blockbytes + (traceno - first) * recsize;
+}
+
 int segy_traceheader( segy_file* fp,
                       int traceno,
                       char* buf,
                       long trace0,
                       int trace_bsize ) {
 
+    readahead( fp, trace_offset( traceno, trace0, trace_bsize ),
+                   SEGY_TRACE_HEADER_SIZE + trace_bsize );
+
+    if( fp->cache ) {
+        int slot, err;
+        const char* rec = trace_cache_record( fp, traceno,
+                                              trace0, trace_bsize,
+                                              &slot, &err );
+        if( err != SEGY_OK ) return err;
+        if( rec ) {
+            memcpy( buf, rec, SEGY_TRACE_HEADER_SIZE );
+            return SEGY_OK;
+        }
+    }
+
     const int err = segy_seek( fp, traceno, trace0, trace_bsize );
     if( err != 0 ) return err;
 
@@ -1215,7 +2398,7 @@ int segy_traceheader( segy_file* fp,
         return bswap_th( buf, fp->lsb );
     }
 
-    const size_t readc = fread( buf, 1, SEGY_TRACE_HEADER_SIZE, fp->fp );
+    const size_t readc = file_read( fp, buf, 1, SEGY_TRACE_HEADER_SIZE );
 
     if( readc != SEGY_TRACE_HEADER_SIZE )
         return SEGY_FREAD_ERROR;
@@ -1229,6 +2412,7 @@ int segy_write_traceheader( segy_file* fp,
                             long trace0,
                             int trace_bsize ) {
     if( !fp->writable ) return SEGY_READONLY;
+    trace_cache_invalidate( fp );
 
     const int err = segy_seek( fp, traceno, trace0, trace_bsize );
     if( err != 0 ) return err;
@@ -1262,12 +2446,8 @@ int segy_traces( segy_file* fp,
     if( trace0 < 0 ) return SEGY_INVALID_ARGS;
 
     long long size;
-    if( fp->addr )
-        size = fp->fsize;
-    else{
-        int err = file_size( fp->fp, &size );
-        if( err != 0 ) return err;
-    }
+    int err = handle_size( fp, &size );
+    if( err != 0 ) return err;
 
     if( trace0 > size ) return SEGY_INVALID_ARGS;
 
@@ -1350,6 +2530,91 @@ int segy_sample_indices( segy_file* fp,
     return SEGY_OK;
 }
 
+/*
+ * The header words `fields` of the traces start, start + step, ..., read with
+ * segy_fields_forall in windows that double in size. This is for scans that
+ * stop at a trace that is not known up front, e.g. the first trace where the
+ * offset wraps around. Row k of keys holds the words of the k-th trace, and
+ * the scan has at most count traces.
+ */
+#define KEY_WINDOW_MAXFIELDS 4
+
+struct key_window {
+    segy_file* fp;
+    const int* fields;
+    int nfields;
+    int start;
+    int step;
+    int count;
+    int32_t* keys;
+    int len;
+    long trace0;
+    int trace_bsize;
+};
+
+static void key_window_init( struct key_window* w,
+                             segy_file* fp,
+                             const int* fields,
+                             int nfields,
+                             int start,
+                             int step,
+                             int count,
+                             long trace0,
+                             int trace_bsize ) {
+    assert( nfields <= KEY_WINDOW_MAXFIELDS );
+    w->fp = fp;
+    w->fields = fields;
+    w->nfields = nfields;
+    w->start = start;
+    w->step = step;
+    w->count = count;
+    w->keys = NULL;
+    w->len = 0;
+    w->trace0 = trace0;
+    w->trace_bsize = trace_bsize;
+}
+
+static void key_window_free( struct key_window* w ) {
+    free( w->keys );
+    w->keys = NULL;
+}
+
+static int key_window_row( struct key_window* w, int k, const int32_t** row ) {
+    if( k < 0 || k >= w->count ) return SEGY_INVALID_ARGS;
+
+    if( k >= w->len ) {
+        int len = w->len < 8 ? 16 : 2 * w->len;
+        if( len < k + 1 ) len = k + 1;
+        if( len > w->count ) len = w->count;
+
+        const int nfields = w->nfields;
+        int32_t* keys = realloc( w->keys, sizeof( int32_t ) * len * nfields );
+        if( !keys ) return SEGY_MEMORY_ERROR;
+        w->keys = keys;
+
+        int32_t* out[ KEY_WINDOW_MAXFIELDS ];
+        for( int i = 0; i < nfields; ++i )
+            out[ i ] = keys + (long long)w->len * nfields + i;
+
+        const int err = segy_fields_forall_strided( w->fp,
+                                                    w->fields,
+                                                    nfields,
+                                                    w->start + w->len * w->step,
+                                                    w->start + len * w->step,
+                                                    w->step,
+                                                    1,
+                                                    out,
+                                                    nfields,
+                                                    w->trace0,
+                                                    w->trace_bsize );
+        if( err != SEGY_OK ) return err;
+        w->len = len;
+    }
+
+    *row = w->keys + (long long)k * w->nfields;
+    return SEGY_OK;
+}
+
 /*
  * Determine how a file is sorted. Expects the following three fields from the
  * trace header to guide sorting: the inline number `il`, the crossline
@@ -1373,10 +2638,6 @@ int segy_sorting( segy_file* fp,
                   long trace0,
                   int trace_bsize ) {
     int err;
-    char traceheader[ SEGY_TRACE_HEADER_SIZE ];
-
-    err = segy_traceheader( fp, 0, traceheader, trace0, trace_bsize );
-    if( err != SEGY_OK ) return err;
 
     /* make sure field is valid, so we don't have to check errors later */
     const int fields[] = { il, xl, tr_offset };
@@ -1400,16 +2661,23 @@ int segy_sorting( segy_file* fp,
         return SEGY_OK;
     }
 
-    int il_first = 0, il_next = 0, il_prev = 0;
-    int xl_first = 0, xl_next = 0, xl_prev = 0;
-    int of_first = 0, of_next = 0;
+    struct key_window keys;
+    key_window_init( &keys, fp, fields, len, 0, 1, traces,
+                     trace0, trace_bsize );
 
-    segy_get_field( traceheader, il, &il_first );
-    segy_get_field( traceheader, xl, &xl_first );
-    segy_get_field( traceheader, tr_offset, &of_first );
+    const int32_t* row;
+    err = key_window_row( &keys, 0, &row );
+    if( err ) {
+        key_window_free( &keys );
+        return err;
+    }
 
-    il_prev = il_first;
-    xl_prev = xl_first;
+    const int il_first = row[ 0 ];
+    const int xl_first = row[ 1 ];
+    const int of_first = row[ 2 ];
+    int il_next = 0, il_prev = il_first;
+    int xl_next = 0, xl_prev = xl_first;
+    int of_next = 0;
 
     /* Iterating through traces, comparing il, xl, and offset values with the
      * values from the previous trace. Several cases is checked when
@@ -1421,45 +2689,49 @@ int segy_sorting( segy_file* fp,
      * unsorted.
      */
 
+    int result = SEGY_CROSSLINE_SORTING;
     int traceno = 1;
     while ( traceno < traces ) {
-        err = segy_traceheader( fp, traceno, traceheader, trace0, trace_bsize );
-        if( err ) return err;
+        err = key_window_row( &keys, traceno, &row );
+        if( err ) break;
         ++traceno;
 
-        segy_get_field( traceheader, il, &il_next );
-        segy_get_field( traceheader, xl, &xl_next );
-        segy_get_field( traceheader, tr_offset, &of_next );
+        il_next = row[ 0 ];
+        xl_next = row[ 1 ];
+        of_next = row[ 2 ];
 
         /* the exit condition - offset has wrapped around. */
         if( of_next == of_first ) {
             if( il_next == il_prev && xl_next != xl_prev ) {
-                *sorting = SEGY_INLINE_SORTING;
-                return SEGY_OK;
+                result = SEGY_INLINE_SORTING;
+                break;
             }
 
             if( xl_next == xl_prev && il_next != il_prev ) {
-                *sorting = SEGY_CROSSLINE_SORTING;
-                return SEGY_OK;
+                result = SEGY_CROSSLINE_SORTING;
+                break;
             }
 
-            *sorting = SEGY_UNKNOWN_SORTING;
-            return SEGY_OK;
+            result = SEGY_UNKNOWN_SORTING;
+            break;
         }
 
         /* something else than offsets also moved, so this is not sorted */
         if( il_prev != il_next ) {
-            *sorting = SEGY_UNKNOWN_SORTING;
-            return SEGY_OK;
+            result = SEGY_UNKNOWN_SORTING;
+            break;
         }
 
         if( xl_prev != xl_next ) {
-            *sorting = SEGY_UNKNOWN_SORTING;
-            return SEGY_OK;
+            result = SEGY_UNKNOWN_SORTING;
+            break;
         }
     }
 
-    *sorting = SEGY_CROSSLINE_SORTING;
+    key_window_free( &keys );
+    if( err ) return err;
+
+    *sorting = result;
     return SEGY_OK;
 }
 
@@ -1477,8 +2749,6 @@ int segy_offsets( segy_file* fp,
                   long trace0,
                   int trace_bsize ) {
     int err;
-    int il0 = 0, il1 = 0, xl0 = 0, xl1 = 0;
-    char header[ SEGY_TRACE_HEADER_SIZE ];
     int offsets = 0;
 
     if( traces == 1 ) {
@@ -1493,24 +2763,36 @@ int segy_offsets( segy_file* fp,
     if( field_size[ il ] == 0 || field_size[ xl ] == 0 )
         return SEGY_INVALID_FIELD;
 
-    err = segy_traceheader( fp, 0, header, trace0, trace_bsize );
-    if( err != 0 ) return SEGY_FREAD_ERROR;
+    const int fields[] = { il, xl };
+    struct key_window keys;
+    key_window_init( &keys, fp, fields, 2, 0, 1, traces, trace0, trace_bsize );
+
+    const int32_t* row;
+    err = key_window_row( &keys, 0, &row );
+    if( err != 0 ) {
+        key_window_free( &keys );
+        return SEGY_FREAD_ERROR;
+    }
 
-    segy_get_field( header, il, &il0 );
-    segy_get_field( header, xl, &xl0 );
+    const int il0 = row[ 0 ];
+    const int xl0 = row[ 1 ];
+    int il1 = 0, xl1 = 0;
 
     do {
         ++offsets;
 
         if( offsets == traces ) break;
 
-        err = segy_traceheader( fp, offsets, header, trace0, trace_bsize );
-        if( err != 0 ) return err;
+        err = key_window_row( &keys, offsets, &row );
+        if( err != 0 ) break;
 
-        segy_get_field( header, il, &il1 );
-        segy_get_field( header, xl, &xl1 );
+        il1 = row[ 0 ];
+        xl1 = row[ 1 ];
     } while( il0 == il1 && xl0 == xl1 );
 
+    key_window_free( &keys );
+    if( err != 0 ) return err;
+
     *out = offsets;
     return SEGY_OK;
 }
@@ -1521,21 +2803,15 @@ int segy_offset_indices( segy_file* fp,
                          int* out,
                          long trace0,
                          int trace_bsize ) {
-    int32_t x = 0;
-    char header[ SEGY_TRACE_HEADER_SIZE ];
-
     if( field_size[ offset_field ] == 0 )
         return SEGY_INVALID_FIELD;
 
-    for( int i = 0; i < offsets; ++i ) {
-        const int err = segy_traceheader( fp, i, header, trace0, trace_bsize );
-        if( err != SEGY_OK ) return err;
-
-        segy_get_field( header, offset_field, &x );
-        *out++ = x;
-    }
-
-    return SEGY_OK;
+    return segy_fields_forall( fp, &offset_field, 1,
+                               0, offsets, 1,
+                               1,
+                               &out,
+                               trace0,
+                               trace_bsize );
 }
 
 static int segy_line_indices( segy_file* fp,
@@ -1546,14 +2822,19 @@ static int segy_line_indices( segy_file* fp,
                               int* buf,
                               long trace0,
                               int trace_bsize ) {
-    return segy_field_forall( fp,
-                              field,
-                              traceno,                          /* start */
-                              traceno + (num_indices * stride), /* stop */
-                              stride,                           /* step */
-                              buf,
-                              trace0,
-                              trace_bsize );
+    if( field < 0 || field >= SEGY_TRACE_HEADER_SIZE || !field_size[ field ] )
+        return SEGY_INVALID_FIELD;
+
+    return segy_fields_forall( fp,
+                               &field,
+                               1,
+                               traceno,                          /* start */
+                               traceno + (num_indices * stride), /* stop */
+                               stride,                           /* step */
+                               1,
+                               &buf,
+                               trace0,
+                               trace_bsize );
 }
 
 static int count_lines( segy_file* fp,
@@ -1564,38 +2845,50 @@ static int count_lines( segy_file* fp,
                         long trace0,
                         int trace_bsize ) {
 
-    int err;
-    char header[ SEGY_TRACE_HEADER_SIZE ];
-    err = segy_traceheader( fp, 0, header, trace0, trace_bsize );
-    if( err != 0 ) return err;
+    if( field < 0 || field >= SEGY_TRACE_HEADER_SIZE || !field_size[ field ] )
+        return SEGY_INVALID_FIELD;
 
-    int first_lineno, first_offset, ln = 0, off = 0;
+    if( offsets < 1 ) return SEGY_INVALID_ARGS;
 
-    err = segy_get_field( header, field, &first_lineno );
-    if( err != 0 ) return err;
+    /* the first trace (of every offset) of every line */
+    const int fields[] = { field, SEGY_TR_OFFSET };
+    struct key_window keys;
+    key_window_init( &keys, fp, fields, 2, 0, offsets,
+                     (traces - 1) / offsets + 1,
+                     trace0, trace_bsize );
 
-    err = segy_get_field( header, 37, &first_offset );
-    if( err != 0 ) return err;
+    const int32_t* row;
+    int err = key_window_row( &keys, 0, &row );
+    if( err != 0 ) {
+        key_window_free( &keys );
+        return err;
+    }
+
+    const int first_lineno = row[ 0 ];
+    const int first_offset = row[ 1 ];
 
     int lines = 1;
     int curr = offsets;
 
     while( true ) {
         if( curr == traces ) break;
-        if( curr >  traces ) return SEGY_NOTFOUND;
-
-        err = segy_traceheader( fp, curr, header, trace0, trace_bsize );
-        if( err != 0 ) return err;
+        if( curr >  traces ) {
+            err = SEGY_NOTFOUND;
+            break;
+        }
 
-        segy_get_field( header, field, &ln );
-        segy_get_field( header, 37, &off );
+        err = key_window_row( &keys, lines, &row );
+        if( err != 0 ) break;
 
-        if( first_offset == off && ln == first_lineno ) break;
+        if( first_offset == row[ 1 ] && first_lineno == row[ 0 ] ) break;
 
         curr += offsets;
         ++lines;
     }
 
+    key_window_free( &keys );
+    if( err != 0 ) return err;
+
     *out = lines;
     return SEGY_OK;
 }
@@ -1833,19 +3126,28 @@ static int bswap16vec( void* vec, long long len ) {
     return SEGY_OK;
 }
 
-int segy_readsubtr( segy_file* fp,
-                    int traceno,
-                    int start,
-                    int stop,
-                    int step,
-                    void* buf,
-                    void* rangebuf,
-                    long trace0,
-                    int trace_bsize ) {
+/*
+ * The implementation of segy_readsubtr, but the byteswapping of LSB files is
+ * optional, so that the conversion functions can do it in the same pass as the
+ * conversion to native.
+ */
+static int readsubtr( segy_file* fp,
+                      int traceno,
+                      int start,
+                      int stop,
+                      int step,
+                      void* buf,
+                      void* rangebuf,
+                      long trace0,
+                      int trace_bsize,
+                      int swap ) {
 
     const int elems = abs( stop - start );
     const int elemsize = fp->elemsize;
 
+    readahead( fp, trace_offset( traceno, trace0, trace_bsize ),
+                   SEGY_TRACE_HEADER_SIZE + trace_bsize );
+
     int err = subtr_seek( fp, traceno, start, stop, elemsize, trace0, trace_bsize );
     if( err != SEGY_OK ) return err;
 
@@ -1856,11 +3158,11 @@ int segy_readsubtr( segy_file* fp,
             err = memread( buf, fp, fp->cur, elemsize * elems );
             if( err != SEGY_OK ) return err;
         } else {
-            const int readc = fread( buf, elemsize, elems, fp->fp );
+            const int readc = file_read( fp, buf, elemsize, elems );
             if( readc != elems ) return SEGY_FREAD_ERROR;
         }
 
-        if (fp->lsb) {
+        if (swap) {
             if (fp->elemsize == 8) bswap64vec(buf, elems);
             if (fp->elemsize == 4) bswap32vec(buf, elems);
             if (fp->elemsize == 3) bswap24vec(buf, elems);
@@ -1886,7 +3188,7 @@ int segy_readsubtr( segy_file* fp,
         for( int i = 0; i < slicelen; cur += step, dst += elemsize, ++i )
             memcpy( dst, cur, elemsize );
 
-        if (fp->lsb) {
+        if (swap) {
             if (fp->elemsize == 8) bswap64vec(buf, slicelen);
             if (fp->elemsize == 4) bswap32vec(buf, slicelen);
             if (fp->elemsize == 3) bswap24vec(buf, slicelen);
@@ -1900,356 +3202,4680 @@ int segy_readsubtr( segy_file* fp,
      * fread fallback: read the full chunk [start, stop) to avoid multiple
      * fread calls (which are VERY expensive, measured to about 10x the cost of
      * a single read when reading every other trace). If rangebuf is NULL, the
-     * caller has not supplied a buffer for us to use (likely if it's a
-     * one-off, and we heap-alloc a buffer. This way the function is safer to
-     * use, but with a significant performance penalty when no buffer is
-     * supplied.
+     * caller has not supplied a buffer for us to use, and the handle's scratch
+     * memory is used instead, so that repeated reads don't allocate.
      */
-    void* tracebuf = rangebuf ? rangebuf : malloc( elems * elemsize );
+    void* tracebuf = rangebuf ? rangebuf
+                              : scratch( fp, (size_t)elems * elemsize );
+    if( !tracebuf ) return SEGY_MEMORY_ERROR;
 
-    const int readc = fread( tracebuf, elemsize, elems, fp->fp );
-    if( readc != elems ) {
-        if( !rangebuf ) free( tracebuf );
-        return SEGY_FREAD_ERROR;
-    }
+    const int readc = file_read( fp, tracebuf, elemsize, elems );
+    if( readc != elems ) return SEGY_FREAD_ERROR;
 
     const char* cur = (char*)tracebuf + elemsize * defstart;
     for( int i = 0; i < slicelen; cur += step, ++i, dst += elemsize )
         memcpy( dst, cur, elemsize );
 
-    if (fp->lsb) {
+    if (swap) {
         if (fp->elemsize == 8) bswap64vec(buf, slicelen);
         if (fp->elemsize == 4) bswap32vec(buf, slicelen);
         if (fp->elemsize == 3) bswap24vec(buf, slicelen);
         if (fp->elemsize == 2) bswap16vec(buf, slicelen);
     }
 
-    if( !rangebuf ) free( tracebuf );
     return SEGY_OK;
 }
 
-int segy_writetrace( segy_file* fp,
-                     int traceno,
-                     const void* buf,
-                     long trace0,
-                     int trace_bsize ) {
-
-    const int stop = trace_bsize / fp->elemsize;
-    return segy_writesubtr( fp, traceno, 0, stop, 1, buf, NULL, trace0, trace_bsize );
-}
-
-static int bswap64vec_strided( char* dst, const char* src, int step, int len ) {
-    const int elemsize = sizeof(int64_t);
-    step *= elemsize;
-
-    uint64_t v;
-    for (; len > 0; dst += step, src += elemsize, --len) {
-        memcpy(&v, src, elemsize);
-        v = bswap64(v);
-        memcpy(dst, &v, elemsize);
-    }
-
-    return SEGY_OK;
+int segy_readsubtr( segy_file* fp,
+                    int traceno,
+                    int start,
+                    int stop,
+                    int step,
+                    void* buf,
+                    void* rangebuf,
+                    long trace0,
+                    int trace_bsize ) {
+    return readsubtr( fp, traceno, start, stop, step,
+                      buf, rangebuf,
+                      trace0, trace_bsize,
+                      fp->lsb );
 }
 
-static int bswap32vec_strided( char* dst, const char* src, int step, int len ) {
-    const int elemsize = sizeof( int32_t );
-    step *= elemsize;
+int segy_pread_traceheader( segy_file* fp,
+                            int traceno,
+                            char* buf,
+                            long trace0,
+                            int trace_bsize ) {
 
-    uint32_t v;
-    for( ; len > 0; dst += step, src += elemsize, --len ) {
-        memcpy( &v, src, elemsize );
-        v = bswap32( v );
-        memcpy( dst, &v, elemsize );
-    }
+    const long long pos = trace_offset( traceno, trace0, trace_bsize );
+    const int err = pread_at( fp, buf, pos, SEGY_TRACE_HEADER_SIZE );
+    if( err != SEGY_OK ) return err;
 
-    return SEGY_OK;
+    return bswap_th( buf, fp->lsb );
 }
 
-static int bswap16vec_strided( char* dst, const char* src, int step, int len ) {
-    const int elemsize = sizeof( int16_t );
-    step *= elemsize;
-
-    uint16_t v;
-    for( ; len > 0; dst += step, src += elemsize, --len ) {
-        memcpy( &v, src, elemsize );
-        v = bswap16( v );
-        memcpy( dst, &v, elemsize );
-    }
-
-    return SEGY_OK;
+int segy_pread_trace( segy_file* fp,
+                      int traceno,
+                      void* buf,
+                      long trace0,
+                      int trace_bsize ) {
+    const int stop = trace_bsize / fp->elemsize;
+    return segy_pread_subtr( fp, traceno, 0, stop, 1, buf, NULL, trace0, trace_bsize );
 }
 
-int segy_writesubtr( segy_file* fp,
-                     int traceno,
-                     int start,
-                     int stop,
-                     int step,
-                     const void* buf,
-                     void* rangebuf,
-                     long trace0,
-                     int trace_bsize ) {
-
-    if( !fp->writable ) return SEGY_READONLY;
+int segy_pread_subtr( segy_file* fp,
+                      int traceno,
+                      int start,
+                      int stop,
+                      int step,
+                      void* buf,
+                      void* rangebuf,
+                      long trace0,
+                      int trace_bsize ) {
 
     const int elems = abs( stop - start );
     const int elemsize = fp->elemsize;
+    const int min = start < stop ? start : stop + 1;
+    assert( start >= 0 );
+    assert( stop >= -1 );
+    assert( elems * elemsize <= trace_bsize );
 
-    int err = subtr_seek( fp, traceno, start, stop, elemsize, trace0, trace_bsize );
-    if( err != SEGY_OK ) return err;
+    const long long pos = trace_offset( traceno, trace0, trace_bsize )
+                        + SEGY_TRACE_HEADER_SIZE
+                        + (long long)min * elemsize;
 
+    if( step == 1 || step == -1 ) {
+        const int err = pread_at( fp, buf, pos, elems * elemsize );
+        if( err != SEGY_OK ) return err;
 
-    if( step == 1 && !fp->lsb ) {
-        /*
-         * most common case: step == 1, writing contiguously
-         * -1 is not covered here as it would require reversing the input buffer
-         * (which is const), which in turn may require a memory allocation. It will
-         * be handled by the stride-aware code path
-         */
-        if( fp->addr ) {
-            err = memwrite( fp, fp->cur, buf, elemsize * elems );
-            if( err ) return err;
-        } else {
-            const int writec = fwrite( buf, elemsize, elems, fp->fp );
-            if( writec != elems ) return SEGY_FWRITE_ERROR;
+        if (fp->lsb) {
+            if (fp->elemsize == 8) bswap64vec(buf, elems);
+            if (fp->elemsize == 4) bswap32vec(buf, elems);
+            if (fp->elemsize == 3) bswap24vec(buf, elems);
+            if (fp->elemsize == 2) bswap16vec(buf, elems);
         }
 
+        if( step == -1 ) reverse( buf, elems, elemsize );
+
         return SEGY_OK;
     }
 
+    const int defstart = start < stop ? 0 : elems - 1;
+    const int slicelen = slicelength( start, stop, step );
+
     /*
-     * contiguous, but require memory either because reversing, or byte
-     * swapping
+     * Like segy_readsubtr, read the full [start, stop) range in one go and
+     * pick out the strided samples afterwards. With mmap, the samples are
+     * picked directly from the mapping, after the range has been bounds
+     * checked.
      */
-    if( !fp->addr && (step == 1 || step == -1) && fp->lsb ) {
-        void* tracebuf = rangebuf ? rangebuf : malloc( elems * elemsize );
-        memcpy( tracebuf, buf, elemsize * elems );
+    void* tracebuf = NULL;
+    const char* src;
+    if( fp->addr ) {
+        src = mmap_at( fp, pos, (size_t)elems * elemsize );
+        if( !src ) return SEGY_FREAD_ERROR;
+    } else {
+        tracebuf = rangebuf ? rangebuf : malloc( elems * elemsize );
+        if( !tracebuf ) return SEGY_MEMORY_ERROR;
 
-        if (step == -1) reverse(tracebuf, elems, elemsize);
-        if (fp->elemsize == 8) bswap64vec(tracebuf, elems);
-        if (fp->elemsize == 4) bswap32vec(tracebuf, elems);
-        if (fp->elemsize == 3) bswap24vec(tracebuf, elems);
-        if (fp->elemsize == 2) bswap16vec(tracebuf, elems);
+        const int err = pread_at( fp, tracebuf, pos, elems * elemsize );
+        if( err != SEGY_OK ) {
+            if( !rangebuf ) free( tracebuf );
+            return err;
+        }
+        src = (const char*)tracebuf;
+    }
 
+    step *= elemsize;
+    char* dst = (char*)buf;
+    const char* cur = src + elemsize * defstart;
+    for( int i = 0; i < slicelen; cur += step, dst += elemsize, ++i )
+        memcpy( dst, cur, elemsize );
 
-        /*
-         * only handle fstream path - the mmap is handled comfortably by the
-         * stride-aware code path
-         */
-        const int writec = fwrite( tracebuf, elemsize, elems, fp->fp );
-        if( !rangebuf ) free( tracebuf );
-        if( writec != elems ) return SEGY_FWRITE_ERROR;
-        return SEGY_OK;
+    if (fp->lsb) {
+        if (fp->elemsize == 8) bswap64vec(buf, slicelen);
+        if (fp->elemsize == 4) bswap32vec(buf, slicelen);
+        if (fp->elemsize == 3) bswap24vec(buf, slicelen);
+        if (fp->elemsize == 2) bswap16vec(buf, slicelen);
     }
 
-    // step != 1, i.e. do strided reads
-    int defstart = start < stop ? 0 : elems - 1;
-    int slicelen = slicelength( start, stop, step );
+    if( tracebuf && !rangebuf ) free( tracebuf );
+    return SEGY_OK;
+}
 
-    // step is the distance between elems, but we're counting bytes
-    const char* src = (const char*)buf;
+/*
+ * A unit of work split into parts, for run_parallel. Part `part` of `parts`
+ * is processed by fn( arg, part, parts ), which returns a SEGY_ERROR.
+ */
+typedef int (*segy_task)( void* arg, int part, int parts );
+
+struct task_thread {
+    segy_task fn;
+    void* arg;
+    int part;
+    int parts;
+    int result;
+    int started;
+#if defined(HAVE_PTHREAD)
+    pthread_t id;
+#elif defined(_WIN32)
+    HANDLE id;
+#endif
+};
 
-    if( fp->addr ) {
-        /* if mmap is on, strided write is trivial and fast */
-        char* cur = (char*)fp->cur + elemsize * defstart;
+#if defined(HAVE_PTHREAD)
+static void* task_thread_main( void* x ) {
+    struct task_thread* t = x;
+    t->result = t->fn( t->arg, t->part, t->parts );
+    return NULL;
+}
+#elif defined(_WIN32)
+static DWORD WINAPI task_thread_main( LPVOID x ) {
+    struct task_thread* t = x;
+    t->result = t->fn( t->arg, t->part, t->parts );
+    return 0;
+}
+#endif
 
-        if( !fp->lsb ) {
-            step *= elemsize;
-            for( ; slicelen > 0; cur += step, src += elemsize, --slicelen )
-                memcpy( cur, src, elemsize );
-        } else if( elemsize == 8 ) {
-            bswap64vec_strided( cur, src, step, slicelen );
-        } else if( elemsize == 4 ) {
-            bswap32vec_strided( cur, src, step, slicelen );
-        } else if( elemsize == 2 ) {
-            bswap16vec_strided( cur, src, step, slicelen );
-        }
+/*
+ * Run all parts of a task, each on its own thread, with part 0 on the calling
+ * thread. Without thread support, or if a thread can't be started, the parts
+ * are run on the calling thread instead. Returns the error of the first
+ * failing part, if any.
+ */
+static int run_parallel( segy_task fn, void* arg, int parts ) {
+    if( parts <= 1 ) return fn( arg, 0, 1 );
 
-        return SEGY_OK;
-    }
+    struct task_thread* ts = calloc( parts, sizeof( struct task_thread ) );
+    if( !ts ) return SEGY_MEMORY_ERROR;
 
-    void* tracebuf = rangebuf ? rangebuf : malloc( elems * elemsize );
+    for( int i = 0; i < parts; ++i ) {
+        ts[ i ].fn = fn;
+        ts[ i ].arg = arg;
+        ts[ i ].part = i;
+        ts[ i ].parts = parts;
+    }
 
-    // like in readsubtr, read a larger chunk and then step through that
-    const int readc = fread( tracebuf, elemsize, elems, fp->fp );
-    if( readc != elems ) { free( tracebuf ); return SEGY_FREAD_ERROR; }
-    /* rewind, because fread advances the file pointer */
-    err = fseek( fp->fp, -(elems * elemsize), SEEK_CUR );
-    if( err != 0 ) {
-        if( !rangebuf ) free( tracebuf );
-        return SEGY_FSEEK_ERROR;
+    for( int i = 1; i < parts; ++i ) {
+#if defined(HAVE_PTHREAD)
+        ts[ i ].started = pthread_create( &ts[ i ].id, NULL,
+                                          task_thread_main, ts + i ) == 0;
+#elif defined(_WIN32)
+        ts[ i ].id = CreateThread( NULL, 0, task_thread_main, ts + i, 0, NULL );
+        ts[ i ].started = ts[ i ].id != NULL;
+#endif
     }
 
-    char* cur = (char*)tracebuf + elemsize * defstart;
-    if( !fp->lsb ) {
-        step *= elemsize;
-        for( ; slicelen > 0; cur += step, --slicelen, src += elemsize )
-            memcpy( cur, src, elemsize );
-    } else if( elemsize == 8 ) {
-        bswap64vec_strided( cur, src, step, slicelen );
-    } else if( elemsize == 4 ) {
-        bswap32vec_strided( cur, src, step, slicelen );
-    } else if( elemsize == 2 ) {
-        bswap16vec_strided( cur, src, step, slicelen );
+    for( int i = 0; i < parts; ++i ) {
+        if( !ts[ i ].started )
+            ts[ i ].result = fn( arg, i, parts );
     }
 
-    const int writec = fwrite( tracebuf, elemsize, elems, fp->fp );
-    if( !rangebuf ) free( tracebuf );
+    int err = SEGY_OK;
+    for( int i = 0; i < parts; ++i ) {
+        if( ts[ i ].started ) {
+#if defined(HAVE_PTHREAD)
+            pthread_join( ts[ i ].id, NULL );
+#elif defined(_WIN32)
+            WaitForSingleObject( ts[ i ].id, INFINITE );
+            CloseHandle( ts[ i ].id );
+#endif
+        }
 
-    if( writec != elems ) return SEGY_FWRITE_ERROR;
+        if( err == SEGY_OK ) err = ts[ i ].result;
+    }
 
-    return SEGY_OK;
+    free( ts );
+    return err;
 }
 
 /*
- * The to/from native functions are aware of the underlying architecture and
- * the endianness of the input data (through the format enumerator).
- *
- * LSB - little endian (least-significant)
- * MSB - big endian (most-significant)
- *
- * For the 4-byte IEEE formats, there are the following scenarios:
- *
- *          +  HOST LSB | HOST MSB
+ * Whether positional reads are safe to issue from multiple threads at once.
+ * The seek + fread fallback of pread_at is not.
+ */
+static int concurrent_reads( const segy_file* fp ) {
+    if( fp->addr ) return 1;
+#if defined(HAVE_PREAD) || defined(_WIN32)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+struct fields_task {
+    segy_file* fp;
+    const int* fields;
+    int nfields;
+    int start;
+    int step;
+    int slicelen;
+    int32_t** out;
+    long long stride;
+    long trace0;
+    int trace_bsize;
+    /* bytes [lo, hi) of the header cover all requested fields */
+    int lo;
+    int hi;
+};
+
+static int fields_forall_part( void* arg, int part, int parts ) {
+    const struct fields_task* t = arg;
+    segy_file* fp = t->fp;
+
+    const long long first = (long long)t->slicelen * part / parts;
+    const long long last  = (long long)t->slicelen * (part + 1) / parts;
+
+    char header[ SEGY_TRACE_HEADER_SIZE ] = { 0 };
+
+    struct header_scan scan;
+    int err = header_scan_init( &scan, fp, t->step, last - first,
+                                t->trace0, t->trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+    for( long long k = first; k < last; ++k ) {
+        const long long traceno = t->start + k * t->step;
+        err = header_scan_read( &scan, traceno, t->lo, t->hi, header );
+        if( err != SEGY_OK ) break;
+
+        for( int i = 0; i < t->nfields; ++i ) {
+            const int field = t->fields[ i ];
+            int32_t f;
+            get_field( header, field_size, field, &f );
+            if( fp->lsb ) f = bswap_header_word( f, field_size[ field ] );
+            t->out[ i ][ k * t->stride ] = f;
+        }
+    }
+
+    header_scan_free( &scan );
+    return err;
+}
+
+/*
+ * Check that all fields are trace header words, and find the bytes [lo, hi)
+ * of the header that cover them
+ */
+static int fields_span( const int* fields, int nfields, int* lo, int* hi ) {
+    *lo = SEGY_TRACE_HEADER_SIZE;
+    *hi = 0;
+
+    for( int i = 0; i < nfields; ++i ) {
+        const int field = fields[ i ];
+        if( field < 0 || field >= SEGY_TRACE_HEADER_SIZE )
+            return SEGY_INVALID_ARGS;
+        if( field_size[ field ] == 0 ) return SEGY_INVALID_ARGS;
+
+        const int first = field - 1;
+        const int last = first + field_size[ field ];
+        if( first < *lo ) *lo = first;
+        if( last  > *hi ) *hi = last;
+    }
+
+    return SEGY_OK;
+}
+
+int segy_fields_forall( segy_file* fp,
+                        const int* fields,
+                        int nfields,
+                        int start,
+                        int stop,
+                        int step,
+                        int threads,
+                        int32_t** out,
+                        long trace0,
+                        int trace_bsize ) {
+    return segy_fields_forall_strided( fp, fields, nfields,
+                                       start, stop, step,
+                                       threads,
+                                       out, 1,
+                                       trace0, trace_bsize );
+}
+
+int segy_fields_forall_strided( segy_file* fp,
+                                const int* fields,
+                                int nfields,
+                                int start,
+                                int stop,
+                                int step,
+                                int threads,
+                                int32_t** out,
+                                long long stride,
+                                long trace0,
+                                int trace_bsize ) {
+
+    if( nfields < 0 || stride < 1 ) return SEGY_INVALID_ARGS;
+    if( step == 0 ) return SEGY_INVALID_ARGS;
+
+    struct fields_task task;
+    if( fields_span( fields, nfields, &task.lo, &task.hi ) != SEGY_OK )
+        return SEGY_INVALID_ARGS;
+
+    const int slicelen = slicelength( start, stop, step );
+    if( slicelen <= 0 || nfields == 0 ) return SEGY_OK;
+
+    /*
+     * check once that the first and last trace are inside the file, so a
+     * partial result is never produced because of a bad range
+     */
+    const int end = start + step * (slicelen - 1);
+    if( start < 0 || end < 0 ) return SEGY_INVALID_ARGS;
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    int err = segy_pread_traceheader( fp, start, header, trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+    err = segy_pread_traceheader( fp, end, header, trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+    if( !concurrent_reads( fp ) ) threads = 1;
+    if( threads > slicelen ) threads = slicelen;
+
+    task.fp = fp;
+    task.fields = fields;
+    task.nfields = nfields;
+    task.start = start;
+    task.step = step;
+    task.slicelen = slicelen;
+    task.out = out;
+    task.stride = stride;
+    task.trace0 = trace0;
+    task.trace_bsize = trace_bsize;
+
+    return run_parallel( fields_forall_part, &task, threads );
+}
+
+/*
+ * The largest single read segy_readtraces will issue when merging traces. The
+ * scratch buffer is sized after this, so it bounds the memory use too.
+ */
+static const long long readtraces_chunk = 16 * 1024 * 1024;
+
+struct trace_request {
+    int64_t traceno;
+    long long index;
+};
+
+static int trace_request_cmp( const void* x, const void* y ) {
+    const struct trace_request* a = x;
+    const struct trace_request* b = y;
+    if( a->traceno != b->traceno ) return a->traceno < b->traceno ? -1 : 1;
+    if( a->index != b->index ) return a->index < b->index ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Walk the traces in file order and grow runs of traces that are close enough
+ * that reading the unrequested traces in between is cheaper than another
+ * read. A run is read with a single pread into scratch, from the first sample
+ * of the first trace to the last sample of the last trace, and the samples of
+ * every requested trace are scattered into dst. Runs are capped at
+ * readtraces_chunk bytes, unless a single trace is larger.
+ */
+static int readtraces_merged( segy_file* fp,
+                              const int64_t* tracenos,
+                              long long n,
+                              long long max_gap,
+                              char* dst,
+                              long trace0,
+                              int trace_bsize ) {
+
+    struct trace_request* reqs = malloc( n * sizeof( struct trace_request ) );
+    if( !reqs ) return SEGY_MEMORY_ERROR;
+
+    for( long long i = 0; i < n; ++i ) {
+        reqs[ i ].traceno = tracenos[ i ];
+        reqs[ i ].index = i;
+    }
+    qsort( reqs, n, sizeof( struct trace_request ), trace_request_cmp );
+
+    const long long stride = (long long)trace_bsize + SEGY_TRACE_HEADER_SIZE;
+    char* scratch = NULL;
+    long long scratchsize = 0;
+    int err = SEGY_OK;
+
+    long long first = 0;
+    while( err == SEGY_OK && first < n ) {
+        const int64_t base = reqs[ first ].traceno;
+
+        long long last = first;
+        while( last + 1 < n ) {
+            const int64_t prev = reqs[ last ].traceno;
+            const int64_t next = reqs[ last + 1 ].traceno;
+            const long long gap = (next - prev - 1) * stride;
+            const long long span = (next - base) * stride + trace_bsize;
+
+            if( next != prev && gap > max_gap ) break;
+            if( span > readtraces_chunk ) break;
+            ++last;
+        }
+
+        const long long pos = trace_offset( base, trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE;
+        const long long span = (reqs[ last ].traceno - base) * stride
+                             + trace_bsize;
+
+        if( span == trace_bsize ) {
+            /* single trace, possibly requested many times */
+            err = pread_at( fp, dst + reqs[ first ].index * trace_bsize,
+                                pos, trace_bsize );
+            const char* src = dst + reqs[ first ].index * trace_bsize;
+            for( long long i = first + 1; !err && i <= last; ++i )
+                memcpy( dst + reqs[ i ].index * trace_bsize, src, trace_bsize );
+
+            first = last + 1;
+            continue;
+        }
+
+        if( span > scratchsize ) {
+            char* tmp = realloc( scratch, span );
+            if( !tmp ) {
+                err = SEGY_MEMORY_ERROR;
+                break;
+            }
+            scratch = tmp;
+            scratchsize = span;
+        }
+
+        err = pread_at( fp, scratch, pos, span );
+        for( long long i = first; !err && i <= last; ++i ) {
+            const char* src = scratch + (reqs[ i ].traceno - base) * stride;
+            memcpy( dst + reqs[ i ].index * trace_bsize, src, trace_bsize );
+        }
+
+        first = last + 1;
+    }
+
+    free( scratch );
+    free( reqs );
+    return err;
+}
+
+int segy_readtraces( segy_file* fp,
+                     const int64_t* tracenos,
+                     long long n,
+                     long long max_gap,
+                     void* buf,
+                     long trace0,
+                     int trace_bsize ) {
+
+    if( n < 0 || max_gap < 0 ) return SEGY_INVALID_ARGS;
+    if( n == 0 ) return SEGY_OK;
+
+    for( long long i = 0; i < n; ++i )
+        if( tracenos[ i ] < 0 ) return SEGY_INVALID_ARGS;
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    char* dst = (char*)buf;
+    int err = SEGY_OK;
+
+    if( fp->addr ) {
+        /*
+         * With mmap there are no syscalls to save, so just copy straight from
+         * the mapping in the requested order
+         */
+        for( long long i = 0; err == SEGY_OK && i < n; ++i ) {
+            const long long pos = trace_offset( tracenos[ i ], trace0, trace_bsize )
+                                + SEGY_TRACE_HEADER_SIZE;
+            err = pread_at( fp, dst + i * trace_bsize, pos, trace_bsize );
+        }
+    } else {
+        err = readtraces_merged( fp, tracenos, n, max_gap,
+                                 dst, trace0, trace_bsize );
+    }
+
+    if( err != SEGY_OK ) return err;
+
+    if( fp->lsb ) {
+        const long long elems = n * (trace_bsize / fp->elemsize);
+        if (fp->elemsize == 8) bswap64vec(buf, elems);
+        if (fp->elemsize == 4) bswap32vec(buf, elems);
+        if (fp->elemsize == 3) bswap24vec(buf, elems);
+        if (fp->elemsize == 2) bswap16vec(buf, elems);
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * Read the headers of the traces in indices in file order, and either pick
+ * the words fields out of them into out, or, when headers is not NULL, copy
+ * the whole (byte swapped) header of indices[k] to headers + k * 240. Only
+ * the bytes [lo, hi) of every header are read.
+ */
+static int header_gather( segy_file* fp,
+                          const int* fields,
+                          int nfields,
+                          int lo,
+                          int hi,
+                          const int64_t* indices,
+                          long long n,
+                          int32_t** out,
+                          char* headers,
+                          long trace0,
+                          int trace_bsize ) {
+
+    struct trace_request* reqs = malloc( n * sizeof( struct trace_request ) );
+    if( !reqs ) return SEGY_MEMORY_ERROR;
+
+    for( long long i = 0; i < n; ++i ) {
+        if( indices[ i ] < 0 || indices[ i ] > INT_MAX ) {
+            free( reqs );
+            return SEGY_INVALID_ARGS;
+        }
+
+        reqs[ i ].traceno = indices[ i ];
+        reqs[ i ].index = i;
+    }
+
+    qsort( reqs, n, sizeof( struct trace_request ), trace_request_cmp );
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 ) {
+        free( reqs );
+        return SEGY_FWRITE_ERROR;
+    }
+
+    /*
+     * check once that the last trace is inside the file, so a partial result
+     * is never produced because of a bad index
+     */
+    char header[ SEGY_TRACE_HEADER_SIZE ] = { 0 };
+    int err = segy_pread_traceheader( fp, (int)reqs[ n - 1 ].traceno,
+                                      header, trace0, trace_bsize );
+    if( err != SEGY_OK ) {
+        free( reqs );
+        return err;
+    }
+
+    /*
+     * the traces are visited in file order, so scan with the average distance
+     * between them - close traces are served from a single block read, and
+     * sparse ones read only the bytes of the header that hold the fields
+     */
+    const long long span = reqs[ n - 1 ].traceno - reqs[ 0 ].traceno;
+    struct header_scan scan;
+    err = header_scan_init( &scan, fp, (int)(1 + span / n), n,
+                            trace0, trace_bsize );
+    if( err != SEGY_OK ) {
+        free( reqs );
+        return err;
+    }
+
+    for( long long k = 0; k < n; ++k ) {
+        /* duplicates are already in the header buffer */
+        if( k == 0 || reqs[ k ].traceno != reqs[ k - 1 ].traceno ) {
+            err = header_scan_read( &scan, reqs[ k ].traceno, lo, hi, header );
+            if( err != SEGY_OK ) break;
+        }
+
+        if( headers ) {
+            char* dst = headers + reqs[ k ].index * SEGY_TRACE_HEADER_SIZE;
+            memcpy( dst, header, SEGY_TRACE_HEADER_SIZE );
+            bswap_th( dst, fp->lsb );
+            continue;
+        }
+
+        for( int i = 0; i < nfields; ++i ) {
+            const int field = fields[ i ];
+            int32_t f;
+            get_field( header, field_size, field, &f );
+            if( fp->lsb ) f = bswap_header_word( f, field_size[ field ] );
+            out[ i ][ reqs[ k ].index ] = f;
+        }
+    }
+
+    header_scan_free( &scan );
+    free( reqs );
+    return err;
+}
+
+int segy_field_gather( segy_file* fp,
+                       const int* fields,
+                       int nfields,
+                       const int64_t* indices,
+                       long long n,
+                       int32_t** out,
+                       long trace0,
+                       int trace_bsize ) {
+
+    if( nfields < 0 || n < 0 ) return SEGY_INVALID_ARGS;
+
+    int lo, hi;
+    if( fields_span( fields, nfields, &lo, &hi ) != SEGY_OK )
+        return SEGY_INVALID_ARGS;
+
+    if( n == 0 || nfields == 0 ) return SEGY_OK;
+
+    return header_gather( fp, fields, nfields, lo, hi, indices, n,
+                          out, NULL, trace0, trace_bsize );
+}
+
+int segy_traceheader_gather( segy_file* fp,
+                             const int64_t* indices,
+                             long long n,
+                             char* buf,
+                             long trace0,
+                             int trace_bsize ) {
+
+    if( n < 0 ) return SEGY_INVALID_ARGS;
+    if( n == 0 ) return SEGY_OK;
+
+    return header_gather( fp, NULL, 0, 0, SEGY_TRACE_HEADER_SIZE, indices, n,
+                          NULL, buf, trace0, trace_bsize );
+}
+
+int segy_writetrace( segy_file* fp,
+                     int traceno,
+                     const void* buf,
+                     long trace0,
+                     int trace_bsize ) {
+
+    const int stop = trace_bsize / fp->elemsize;
+    return segy_writesubtr( fp, traceno, 0, stop, 1, buf, NULL, trace0, trace_bsize );
+}
+
+static int bswap64vec_strided( char* dst, const char* src, int step, int len ) {
+    const int elemsize = sizeof(int64_t);
+    step *= elemsize;
+
+    uint64_t v;
+    for (; len > 0; dst += step, src += elemsize, --len) {
+        memcpy(&v, src, elemsize);
+        v = bswap64(v);
+        memcpy(dst, &v, elemsize);
+    }
+
+    return SEGY_OK;
+}
+
+static int bswap32vec_strided( char* dst, const char* src, int step, int len ) {
+    const int elemsize = sizeof( int32_t );
+    step *= elemsize;
+
+    uint32_t v;
+    for( ; len > 0; dst += step, src += elemsize, --len ) {
+        memcpy( &v, src, elemsize );
+        v = bswap32( v );
+        memcpy( dst, &v, elemsize );
+    }
+
+    return SEGY_OK;
+}
+
+static int bswap16vec_strided( char* dst, const char* src, int step, int len ) {
+    const int elemsize = sizeof( int16_t );
+    step *= elemsize;
+
+    uint16_t v;
+    for( ; len > 0; dst += step, src += elemsize, --len ) {
+        memcpy( &v, src, elemsize );
+        v = bswap16( v );
+        memcpy( dst, &v, elemsize );
+    }
+
+    return SEGY_OK;
+}
+
+int segy_writesubtr( segy_file* fp,
+                     int traceno,
+                     int start,
+                     int stop,
+                     int step,
+                     const void* buf,
+                     void* rangebuf,
+                     long trace0,
+                     int trace_bsize ) {
+
+    if( !fp->writable ) return SEGY_READONLY;
+    trace_cache_invalidate( fp );
+
+    const int elems = abs( stop - start );
+    const int elemsize = fp->elemsize;
+
+    int err = subtr_seek( fp, traceno, start, stop, elemsize, trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+
+    if( step == 1 && !fp->lsb ) {
+        /*
+         * most common case: step == 1, writing contiguously
+         * -1 is not covered here as it would require reversing the input buffer
+         * (which is const), which in turn may require a memory allocation. It will
+         * be handled by the stride-aware code path
+         */
+        if( fp->addr ) {
+            err = memwrite( fp, fp->cur, buf, elemsize * elems );
+            if( err ) return err;
+        } else {
+            const int writec = fwrite( buf, elemsize, elems, fp->fp );
+            if( writec != elems ) return SEGY_FWRITE_ERROR;
+        }
+
+        return SEGY_OK;
+    }
+
+    /*
+     * contiguous, but require memory either because reversing, or byte
+     * swapping
+     */
+    if( !fp->addr && (step == 1 || step == -1) && fp->lsb ) {
+        void* tracebuf = rangebuf ? rangebuf
+                                  : scratch( fp, (size_t)elems * elemsize );
+        if( !tracebuf ) return SEGY_MEMORY_ERROR;
+        memcpy( tracebuf, buf, elemsize * elems );
+
+        if (step == -1) reverse(tracebuf, elems, elemsize);
+        if (fp->elemsize == 8) bswap64vec(tracebuf, elems);
+        if (fp->elemsize == 4) bswap32vec(tracebuf, elems);
+        if (fp->elemsize == 3) bswap24vec(tracebuf, elems);
+        if (fp->elemsize == 2) bswap16vec(tracebuf, elems);
+
+
+        /*
+         * only handle fstream path - the mmap is handled comfortably by the
+         * stride-aware code path
+         */
+        const int writec = fwrite( tracebuf, elemsize, elems, fp->fp );
+        if( writec != elems ) return SEGY_FWRITE_ERROR;
+        return SEGY_OK;
+    }
+
+    // step != 1, i.e. do strided reads
+    int defstart = start < stop ? 0 : elems - 1;
+    int slicelen = slicelength( start, stop, step );
+
+    // step is the distance between elems, but we're counting bytes
+    const char* src = (const char*)buf;
+
+    if( fp->addr ) {
+        /* if mmap is on, strided write is trivial and fast */
+        char* cur = (char*)fp->cur + elemsize * defstart;
+
+        if( !fp->lsb ) {
+            step *= elemsize;
+            for( ; slicelen > 0; cur += step, src += elemsize, --slicelen )
+                memcpy( cur, src, elemsize );
+        } else if( elemsize == 8 ) {
+            bswap64vec_strided( cur, src, step, slicelen );
+        } else if( elemsize == 4 ) {
+            bswap32vec_strided( cur, src, step, slicelen );
+        } else if( elemsize == 2 ) {
+            bswap16vec_strided( cur, src, step, slicelen );
+        }
+
+        return SEGY_OK;
+    }
+
+    void* tracebuf = rangebuf ? rangebuf
+                              : scratch( fp, (size_t)elems * elemsize );
+    if( !tracebuf ) return SEGY_MEMORY_ERROR;
+
+    // like in readsubtr, read a larger chunk and then step through that
+    const int readc = fread( tracebuf, elemsize, elems, fp->fp );
+    if( readc != elems ) return SEGY_FREAD_ERROR;
+    /* rewind, because fread advances the file pointer */
+    err = fseek( fp->fp, -(elems * elemsize), SEEK_CUR );
+    if( err != 0 ) return SEGY_FSEEK_ERROR;
+
+    char* cur = (char*)tracebuf + elemsize * defstart;
+    if( !fp->lsb ) {
+        step *= elemsize;
+        for( ; slicelen > 0; cur += step, --slicelen, src += elemsize )
+            memcpy( cur, src, elemsize );
+    } else if( elemsize == 8 ) {
+        bswap64vec_strided( cur, src, step, slicelen );
+    } else if( elemsize == 4 ) {
+        bswap32vec_strided( cur, src, step, slicelen );
+    } else if( elemsize == 2 ) {
+        bswap16vec_strided( cur, src, step, slicelen );
+    }
+
+    const int writec = fwrite( tracebuf, elemsize, elems, fp->fp );
+    if( writec != elems ) return SEGY_FWRITE_ERROR;
+
+    return SEGY_OK;
+}
+
+/*
+ * The to/from native functions are aware of the underlying architecture and
+ * the endianness of the input data (through the format enumerator).
+ *
+ * LSB - little endian (least-significant)
+ * MSB - big endian (most-significant)
+ *
+ * For the 4-byte IEEE formats, there are the following scenarios:
+ *
+ *          +  HOST LSB | HOST MSB
  * FILE LSB |   no-op   |  bswap
  * FILE MSB |   bswap   |  no-op
  *
- * the ntohs/ntohl functions gracefully handle all FILE MSB, regardless of host
- * endianness. This does not work when host is MSB, because ntohl would be a
- * no-op for MSB platforms. Therefore, the final table is:
+ * the ntohs/ntohl functions gracefully handle all FILE MSB, regardless of host
+ * endianness. This does not work when host is MSB, because ntohl would be a
+ * no-op for MSB platforms. Therefore, the final table is:
+ *
+ *          +  HOST LSB | HOST MSB
+ * FILE LSB |   no-op   |  bswap
+ * FILE MSB |   bswap   |  no-op
+ */
+
+/*
+ * Vectorised IBM float conversion.
+ *
+ * The kernels are bit-for-bit translations of ibm_native and native_ibm, with
+ * the table lookups replaced by compare-and-select, and the byteswap of the
+ * big-endian on-disk representation fused into the same pass. They are only
+ * available on x86-64, which is always little endian, so the byteswap is
+ * unconditional.
+ *
+ * The kernel is chosen at runtime from what the CPU supports, and the scalar
+ * implementation is used for the tail and when no kernel is available.
+ */
+
+static int ibm_native_scalar( void* dst, const void* src, long long size ) {
+    for( long long i = 0; i < size; ++i ) {
+        uint32_t u;
+        memcpy( &u, (const char*)src + i * 4, sizeof( u ) );
+        u = be32toh( u );
+        ibm_native( &u );
+        memcpy( (char*)dst + i * 4, &u, sizeof( u ) );
+    }
+
+    return SEGY_OK;
+}
+
+static int native_ibm_scalar( void* dst, const void* src, long long size ) {
+    for( long long i = 0; i < size; ++i ) {
+        uint32_t u;
+        memcpy( &u, (const char*)src + i * 4, sizeof( u ) );
+        native_ibm( &u );
+        u = htobe32( u );
+        memcpy( (char*)dst + i * 4, &u, sizeof( u ) );
+    }
+
+    return SEGY_OK;
+}
+
+#ifdef SEGY_X86_SIMD
+
+SEGY_TARGET("sse2")
+static inline __m128i bswap32_sse2( __m128i x ) {
+    x = _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) );
+    x = _mm_shufflelo_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    return _mm_shufflehi_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+}
+
+SEGY_TARGET("sse2")
+static inline __m128i select_sse2( __m128i mask, __m128i a, __m128i b ) {
+    /* mask ? a : b */
+    return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+
+SEGY_TARGET("sse2")
+static int ibm_native_sse2( void* dst, const void* src, long long size ) {
+    const __m128i mantmask = _mm_set1_epi32( 0x00ffffff );
+    const __m128i expmask  = _mm_set1_epi32( 0x7f000000 );
+    const __m128i absmask  = _mm_set1_epi32( 0x7fffffff );
+    const __m128i signmask = _mm_set1_epi32( (int)0x80000000 );
+    const __m128i ge1      = _mm_set1_epi32( 0x001fffff );
+    const __m128i ge2      = _mm_set1_epi32( 0x003fffff );
+    const __m128i ge4      = _mm_set1_epi32( 0x007fffff );
+    const __m128i it0      = _mm_set1_epi32( 0x21800000 );
+    const __m128i it1      = _mm_set1_epi32( 0x21400000 );
+    const __m128i it2      = _mm_set1_epi32( 0x21000000 );
+    const __m128i it4      = _mm_set1_epi32( 0x20c00000 );
+    const __m128i ieeemax  = _mm_set1_epi32( IEEEMAX );
+    const __m128i maxib    = _mm_set1_epi32( IEMAXIB );
+    const __m128i minib    = _mm_set1_epi32( IEMINIB );
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 4 <= size; i += 4 ) {
+        const __m128i u = bswap32_sse2(
+            _mm_loadu_si128( (const __m128i*)(in + i * 4) )
+        );
+
+        const __m128i manthi = _mm_and_si128( u, mantmask );
+        const __m128i m1 = _mm_cmpgt_epi32( manthi, ge1 );
+        const __m128i m2 = _mm_cmpgt_epi32( manthi, ge2 );
+        const __m128i m4 = _mm_cmpgt_epi32( manthi, ge4 );
+
+        __m128i mant = _mm_slli_epi32( manthi, 3 );
+        mant = select_sse2( m1, _mm_slli_epi32( manthi, 2 ), mant );
+        mant = select_sse2( m2, _mm_slli_epi32( manthi, 1 ), mant );
+        mant = select_sse2( m4, manthi, mant );
+
+        __m128i it = it0;
+        it = select_sse2( m1, it1, it );
+        it = select_sse2( m2, it2, it );
+        it = select_sse2( m4, it4, it );
+
+        const __m128i iexp = _mm_slli_epi32(
+            _mm_sub_epi32( _mm_and_si128( u, expmask ), it ), 1
+        );
+
+        __m128i x = _mm_add_epi32( mant, iexp );
+        const __m128i inabs = _mm_and_si128( u, absmask );
+        x = select_sse2( _mm_cmpgt_epi32( inabs, maxib ), ieeemax, x );
+        x = _mm_or_si128( x, _mm_and_si128( u, signmask ) );
+        x = _mm_andnot_si128( _mm_cmpgt_epi32( minib, inabs ), x );
+
+        _mm_storeu_si128( (__m128i*)(out + i * 4), x );
+    }
+
+    return ibm_native_scalar( out + i * 4, in + i * 4, size - i );
+}
+
+SEGY_TARGET("sse2")
+static int native_ibm_sse2( void* dst, const void* src, long long size ) {
+    const __m128i ixmask   = _mm_set1_epi32( 0x01800000 );
+    const __m128i expmask  = _mm_set1_epi32( 0x7e000000 );
+    const __m128i mantmask = _mm_set1_epi32( 0x007fffff );
+    const __m128i absmask  = _mm_set1_epi32( 0x7fffffff );
+    const __m128i signmask = _mm_set1_epi32( (int)0x80000000 );
+    const __m128i ix1      = _mm_set1_epi32( 0x00800000 );
+    const __m128i ix2      = _mm_set1_epi32( 0x01000000 );
+    const __m128i ix3      = _mm_set1_epi32( 0x01800000 );
+    const __m128i it0      = _mm_set1_epi32( 0x21200000 );
+    const __m128i it1      = _mm_set1_epi32( 0x21400000 );
+    const __m128i it2      = _mm_set1_epi32( 0x21800000 );
+    const __m128i it3      = _mm_set1_epi32( 0x22100000 );
+    const __m128i zero     = _mm_setzero_si128();
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 4 <= size; i += 4 ) {
+        const __m128i u = _mm_loadu_si128( (const __m128i*)(in + i * 4) );
+
+        const __m128i ix = _mm_and_si128( u, ixmask );
+        const __m128i e1 = _mm_cmpeq_epi32( ix, ix1 );
+        const __m128i e2 = _mm_cmpeq_epi32( ix, ix2 );
+        const __m128i e3 = _mm_cmpeq_epi32( ix, ix3 );
+
+        __m128i it = it0;
+        it = select_sse2( e1, it1, it );
+        it = select_sse2( e2, it2, it );
+        it = select_sse2( e3, it3, it );
+
+        const __m128i m = _mm_and_si128( u, mantmask );
+        __m128i mant = _mm_slli_epi32( m, 1 );
+        mant = select_sse2( e1, _mm_slli_epi32( m, 2 ), mant );
+        mant = select_sse2( e2, _mm_slli_epi32( m, 3 ), mant );
+        mant = select_sse2( e3, m, mant );
+        mant = _mm_srli_epi32( mant, 3 );
+
+        const __m128i iexp = _mm_add_epi32(
+            _mm_srli_epi32( _mm_and_si128( u, expmask ), 1 ), it
+        );
+
+        __m128i x = _mm_add_epi32( mant, iexp );
+        x = _mm_or_si128( x, _mm_and_si128( u, signmask ) );
+        const __m128i iszero = _mm_cmpeq_epi32( _mm_and_si128( u, absmask ), zero );
+        x = _mm_andnot_si128( iszero, x );
+
+        _mm_storeu_si128( (__m128i*)(out + i * 4), bswap32_sse2( x ) );
+    }
+
+    return native_ibm_scalar( out + i * 4, in + i * 4, size - i );
+}
+
+SEGY_TARGET("avx2")
+static inline __m256i bswap32_avx2( __m256i x ) {
+    const __m256i shuffle = _mm256_setr_epi8(
+         3,  2,  1,  0,  7,  6,  5,  4, 11, 10,  9,  8, 15, 14, 13, 12,
+         3,  2,  1,  0,  7,  6,  5,  4, 11, 10,  9,  8, 15, 14, 13, 12
+    );
+    return _mm256_shuffle_epi8( x, shuffle );
+}
+
+SEGY_TARGET("avx2")
+static int ibm_native_avx2( void* dst, const void* src, long long size ) {
+    const __m256i mantmask = _mm256_set1_epi32( 0x00ffffff );
+    const __m256i expmask  = _mm256_set1_epi32( 0x7f000000 );
+    const __m256i absmask  = _mm256_set1_epi32( 0x7fffffff );
+    const __m256i signmask = _mm256_set1_epi32( (int)0x80000000 );
+    const __m256i ge1      = _mm256_set1_epi32( 0x001fffff );
+    const __m256i ge2      = _mm256_set1_epi32( 0x003fffff );
+    const __m256i ge4      = _mm256_set1_epi32( 0x007fffff );
+    const __m256i it0      = _mm256_set1_epi32( 0x21800000 );
+    const __m256i it1      = _mm256_set1_epi32( 0x21400000 );
+    const __m256i it2      = _mm256_set1_epi32( 0x21000000 );
+    const __m256i it4      = _mm256_set1_epi32( 0x20c00000 );
+    const __m256i ieeemax  = _mm256_set1_epi32( IEEEMAX );
+    const __m256i maxib    = _mm256_set1_epi32( IEMAXIB );
+    const __m256i minib    = _mm256_set1_epi32( IEMINIB );
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 8 <= size; i += 8 ) {
+        const __m256i u = bswap32_avx2(
+            _mm256_loadu_si256( (const __m256i*)(in + i * 4) )
+        );
+
+        const __m256i manthi = _mm256_and_si256( u, mantmask );
+        const __m256i m1 = _mm256_cmpgt_epi32( manthi, ge1 );
+        const __m256i m2 = _mm256_cmpgt_epi32( manthi, ge2 );
+        const __m256i m4 = _mm256_cmpgt_epi32( manthi, ge4 );
+
+        __m256i mant = _mm256_slli_epi32( manthi, 3 );
+        mant = _mm256_blendv_epi8( mant, _mm256_slli_epi32( manthi, 2 ), m1 );
+        mant = _mm256_blendv_epi8( mant, _mm256_slli_epi32( manthi, 1 ), m2 );
+        mant = _mm256_blendv_epi8( mant, manthi, m4 );
+
+        __m256i it = it0;
+        it = _mm256_blendv_epi8( it, it1, m1 );
+        it = _mm256_blendv_epi8( it, it2, m2 );
+        it = _mm256_blendv_epi8( it, it4, m4 );
+
+        const __m256i iexp = _mm256_slli_epi32(
+            _mm256_sub_epi32( _mm256_and_si256( u, expmask ), it ), 1
+        );
+
+        __m256i x = _mm256_add_epi32( mant, iexp );
+        const __m256i inabs = _mm256_and_si256( u, absmask );
+        x = _mm256_blendv_epi8( x, ieeemax, _mm256_cmpgt_epi32( inabs, maxib ) );
+        x = _mm256_or_si256( x, _mm256_and_si256( u, signmask ) );
+        x = _mm256_andnot_si256( _mm256_cmpgt_epi32( minib, inabs ), x );
+
+        _mm256_storeu_si256( (__m256i*)(out + i * 4), x );
+    }
+
+    return ibm_native_sse2( out + i * 4, in + i * 4, size - i );
+}
+
+SEGY_TARGET("avx2")
+static int native_ibm_avx2( void* dst, const void* src, long long size ) {
+    const __m256i ixmask   = _mm256_set1_epi32( 0x01800000 );
+    const __m256i expmask  = _mm256_set1_epi32( 0x7e000000 );
+    const __m256i mantmask = _mm256_set1_epi32( 0x007fffff );
+    const __m256i absmask  = _mm256_set1_epi32( 0x7fffffff );
+    const __m256i signmask = _mm256_set1_epi32( (int)0x80000000 );
+    const __m256i ix1      = _mm256_set1_epi32( 0x00800000 );
+    const __m256i ix2      = _mm256_set1_epi32( 0x01000000 );
+    const __m256i ix3      = _mm256_set1_epi32( 0x01800000 );
+    const __m256i it0      = _mm256_set1_epi32( 0x21200000 );
+    const __m256i it1      = _mm256_set1_epi32( 0x21400000 );
+    const __m256i it2      = _mm256_set1_epi32( 0x21800000 );
+    const __m256i it3      = _mm256_set1_epi32( 0x22100000 );
+    const __m256i zero     = _mm256_setzero_si256();
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 8 <= size; i += 8 ) {
+        const __m256i u = _mm256_loadu_si256( (const __m256i*)(in + i * 4) );
+
+        const __m256i ix = _mm256_and_si256( u, ixmask );
+        const __m256i e1 = _mm256_cmpeq_epi32( ix, ix1 );
+        const __m256i e2 = _mm256_cmpeq_epi32( ix, ix2 );
+        const __m256i e3 = _mm256_cmpeq_epi32( ix, ix3 );
+
+        __m256i it = it0;
+        it = _mm256_blendv_epi8( it, it1, e1 );
+        it = _mm256_blendv_epi8( it, it2, e2 );
+        it = _mm256_blendv_epi8( it, it3, e3 );
+
+        const __m256i m = _mm256_and_si256( u, mantmask );
+        __m256i mant = _mm256_slli_epi32( m, 1 );
+        mant = _mm256_blendv_epi8( mant, _mm256_slli_epi32( m, 2 ), e1 );
+        mant = _mm256_blendv_epi8( mant, _mm256_slli_epi32( m, 3 ), e2 );
+        mant = _mm256_blendv_epi8( mant, m, e3 );
+        mant = _mm256_srli_epi32( mant, 3 );
+
+        const __m256i iexp = _mm256_add_epi32(
+            _mm256_srli_epi32( _mm256_and_si256( u, expmask ), 1 ), it
+        );
+
+        __m256i x = _mm256_add_epi32( mant, iexp );
+        x = _mm256_or_si256( x, _mm256_and_si256( u, signmask ) );
+        const __m256i iszero = _mm256_cmpeq_epi32(
+            _mm256_and_si256( u, absmask ), zero
+        );
+        x = _mm256_andnot_si256( iszero, x );
+
+        _mm256_storeu_si256( (__m256i*)(out + i * 4), bswap32_avx2( x ) );
+    }
+
+    return native_ibm_sse2( out + i * 4, in + i * 4, size - i );
+}
+
+SEGY_TARGET("avx512f")
+static inline __m512i bswap32_avx512( __m512i x ) {
+    /* AVX-512F has no byte shuffle, but rotates do the trick */
+    const __m512i hi = _mm512_set1_epi32( (int)0xff00ff00 );
+    const __m512i lo = _mm512_set1_epi32( 0x00ff00ff );
+    return _mm512_or_si512( _mm512_rol_epi32( _mm512_and_si512( x, hi ), 8 ),
+                            _mm512_ror_epi32( _mm512_and_si512( x, lo ), 8 ) );
+}
+
+SEGY_TARGET("avx512f")
+static int ibm_native_avx512( void* dst, const void* src, long long size ) {
+    const __m512i mantmask = _mm512_set1_epi32( 0x00ffffff );
+    const __m512i expmask  = _mm512_set1_epi32( 0x7f000000 );
+    const __m512i absmask  = _mm512_set1_epi32( 0x7fffffff );
+    const __m512i signmask = _mm512_set1_epi32( (int)0x80000000 );
+    const __m512i ge1      = _mm512_set1_epi32( 0x001fffff );
+    const __m512i ge2      = _mm512_set1_epi32( 0x003fffff );
+    const __m512i ge4      = _mm512_set1_epi32( 0x007fffff );
+    const __m512i it0      = _mm512_set1_epi32( 0x21800000 );
+    const __m512i it1      = _mm512_set1_epi32( 0x21400000 );
+    const __m512i it2      = _mm512_set1_epi32( 0x21000000 );
+    const __m512i it4      = _mm512_set1_epi32( 0x20c00000 );
+    const __m512i ieeemax  = _mm512_set1_epi32( IEEEMAX );
+    const __m512i maxib    = _mm512_set1_epi32( IEMAXIB );
+    const __m512i minib    = _mm512_set1_epi32( IEMINIB );
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 16 <= size; i += 16 ) {
+        const __m512i u = bswap32_avx512( _mm512_loadu_si512( in + i * 4 ) );
+
+        const __m512i manthi = _mm512_and_si512( u, mantmask );
+        const __mmask16 m1 = _mm512_cmpgt_epi32_mask( manthi, ge1 );
+        const __mmask16 m2 = _mm512_cmpgt_epi32_mask( manthi, ge2 );
+        const __mmask16 m4 = _mm512_cmpgt_epi32_mask( manthi, ge4 );
+
+        __m512i mant = _mm512_slli_epi32( manthi, 3 );
+        mant = _mm512_mask_blend_epi32( m1, mant, _mm512_slli_epi32( manthi, 2 ) );
+        mant = _mm512_mask_blend_epi32( m2, mant, _mm512_slli_epi32( manthi, 1 ) );
+        mant = _mm512_mask_blend_epi32( m4, mant, manthi );
+
+        __m512i it = it0;
+        it = _mm512_mask_blend_epi32( m1, it, it1 );
+        it = _mm512_mask_blend_epi32( m2, it, it2 );
+        it = _mm512_mask_blend_epi32( m4, it, it4 );
+
+        const __m512i iexp = _mm512_slli_epi32(
+            _mm512_sub_epi32( _mm512_and_si512( u, expmask ), it ), 1
+        );
+
+        __m512i x = _mm512_add_epi32( mant, iexp );
+        const __m512i inabs = _mm512_and_si512( u, absmask );
+        const __mmask16 big = _mm512_cmpgt_epi32_mask( inabs, maxib );
+        const __mmask16 small = _mm512_cmpgt_epi32_mask( minib, inabs );
+        x = _mm512_mask_blend_epi32( big, x, ieeemax );
+        x = _mm512_or_si512( x, _mm512_and_si512( u, signmask ) );
+        x = _mm512_maskz_mov_epi32( (__mmask16)~small, x );
+
+        _mm512_storeu_si512( out + i * 4, x );
+    }
+
+    return ibm_native_avx2( out + i * 4, in + i * 4, size - i );
+}
+
+SEGY_TARGET("avx512f")
+static int native_ibm_avx512( void* dst, const void* src, long long size ) {
+    const __m512i ixmask   = _mm512_set1_epi32( 0x01800000 );
+    const __m512i expmask  = _mm512_set1_epi32( 0x7e000000 );
+    const __m512i mantmask = _mm512_set1_epi32( 0x007fffff );
+    const __m512i absmask  = _mm512_set1_epi32( 0x7fffffff );
+    const __m512i signmask = _mm512_set1_epi32( (int)0x80000000 );
+    const __m512i ix1      = _mm512_set1_epi32( 0x00800000 );
+    const __m512i ix2      = _mm512_set1_epi32( 0x01000000 );
+    const __m512i ix3      = _mm512_set1_epi32( 0x01800000 );
+    const __m512i it0      = _mm512_set1_epi32( 0x21200000 );
+    const __m512i it1      = _mm512_set1_epi32( 0x21400000 );
+    const __m512i it2      = _mm512_set1_epi32( 0x21800000 );
+    const __m512i it3      = _mm512_set1_epi32( 0x22100000 );
+
+    char* out = (char*)dst;
+    const char* in = (const char*)src;
+    long long i = 0;
+    for( ; i + 16 <= size; i += 16 ) {
+        const __m512i u = _mm512_loadu_si512( in + i * 4 );
+
+        const __m512i ix = _mm512_and_si512( u, ixmask );
+        const __mmask16 e1 = _mm512_cmpeq_epi32_mask( ix, ix1 );
+        const __mmask16 e2 = _mm512_cmpeq_epi32_mask( ix, ix2 );
+        const __mmask16 e3 = _mm512_cmpeq_epi32_mask( ix, ix3 );
+
+        __m512i it = it0;
+        it = _mm512_mask_blend_epi32( e1, it, it1 );
+        it = _mm512_mask_blend_epi32( e2, it, it2 );
+        it = _mm512_mask_blend_epi32( e3, it, it3 );
+
+        const __m512i m = _mm512_and_si512( u, mantmask );
+        __m512i mant = _mm512_slli_epi32( m, 1 );
+        mant = _mm512_mask_blend_epi32( e1, mant, _mm512_slli_epi32( m, 2 ) );
+        mant = _mm512_mask_blend_epi32( e2, mant, _mm512_slli_epi32( m, 3 ) );
+        mant = _mm512_mask_blend_epi32( e3, mant, m );
+        mant = _mm512_srli_epi32( mant, 3 );
+
+        const __m512i iexp = _mm512_add_epi32(
+            _mm512_srli_epi32( _mm512_and_si512( u, expmask ), 1 ), it
+        );
+
+        __m512i x = _mm512_add_epi32( mant, iexp );
+        x = _mm512_or_si512( x, _mm512_and_si512( u, signmask ) );
+        const __mmask16 nonzero = _mm512_test_epi32_mask( u, absmask );
+        x = _mm512_maskz_mov_epi32( nonzero, x );
+
+        _mm512_storeu_si512( out + i * 4, bswap32_avx512( x ) );
+    }
+
+    return native_ibm_avx2( out + i * 4, in + i * 4, size - i );
+}
+
+#ifdef _MSC_VER
+static int msvc_cpu_supports( int level ) {
+    int info[ 4 ];
+    __cpuid( info, 0 );
+    const int maxleaf = info[ 0 ];
+
+    __cpuid( info, 1 );
+    const int osxsave = (info[ 2 ] >> 27) & 1;
+    const int avx     = (info[ 2 ] >> 28) & 1;
+    if( level == SEGY_SIMD_SSE2 ) return (info[ 3 ] >> 26) & 1;
+    if( !osxsave || !avx || maxleaf < 7 ) return 0;
+
+    const unsigned long long xcr0 = _xgetbv( 0 );
+    __cpuidex( info, 7, 0 );
+    if( level == SEGY_SIMD_AVX2 )
+        return (xcr0 & 0x6) == 0x6 && ((info[ 1 ] >> 5) & 1);
+    if( level == SEGY_SIMD_AVX512 )
+        return (xcr0 & 0xe6) == 0xe6 && ((info[ 1 ] >> 16) & 1);
+    return 0;
+}
+#endif // _MSC_VER
+
+#endif // SEGY_X86_SIMD
+
+static int cpu_supports( int level ) {
+    if( level == SEGY_SIMD_SCALAR ) return 1;
+
+#if defined(SEGY_X86_SIMD) && defined(__GNUC__)
+    __builtin_cpu_init();
+    switch( level ) {
+        case SEGY_SIMD_SSE2:   return __builtin_cpu_supports( "sse2" );
+        case SEGY_SIMD_AVX2:   return __builtin_cpu_supports( "avx2" );
+        case SEGY_SIMD_AVX512: return __builtin_cpu_supports( "avx512f" );
+        default:               return 0;
+    }
+#elif defined(SEGY_X86_SIMD) && defined(_MSC_VER)
+    return msvc_cpu_supports( level );
+#else
+    return 0;
+#endif
+}
+
+int segy_simd_level( void ) {
+    static const int levels[] = {
+        SEGY_SIMD_AVX512, SEGY_SIMD_AVX2, SEGY_SIMD_SSE2,
+    };
+
+    /*
+     * the conversions ask for the level on every call, so only query the CPU
+     * the first time. Threads that race here all store the same value
+     */
+    static volatile int best = -1;
+    if( best >= 0 ) return best;
+
+    int level = SEGY_SIMD_SCALAR;
+    for( size_t i = 0; i < sizeof( levels ) / sizeof( levels[ 0 ] ); ++i ) {
+        if( cpu_supports( levels[ i ] ) ) {
+            level = levels[ i ];
+            break;
+        }
+    }
+
+    best = level;
+    return level;
+}
+
+int segy_ibm_native_simd( int level, long long size, void* buf ) {
+    if( !cpu_supports( level ) ) return SEGY_INVALID_ARGS;
+
+    switch( level ) {
+#ifdef SEGY_X86_SIMD
+        case SEGY_SIMD_SSE2:   return ibm_native_sse2( buf, buf, size );
+        case SEGY_SIMD_AVX2:   return ibm_native_avx2( buf, buf, size );
+        case SEGY_SIMD_AVX512: return ibm_native_avx512( buf, buf, size );
+#endif
+        case SEGY_SIMD_SCALAR: return ibm_native_scalar( buf, buf, size );
+        default:               return SEGY_INVALID_ARGS;
+    }
+}
+
+int segy_native_ibm_simd( int level, long long size, void* buf ) {
+    if( !cpu_supports( level ) ) return SEGY_INVALID_ARGS;
+
+    switch( level ) {
+#ifdef SEGY_X86_SIMD
+        case SEGY_SIMD_SSE2:   return native_ibm_sse2( buf, buf, size );
+        case SEGY_SIMD_AVX2:   return native_ibm_avx2( buf, buf, size );
+        case SEGY_SIMD_AVX512: return native_ibm_avx512( buf, buf, size );
+#endif
+        case SEGY_SIMD_SCALAR: return native_ibm_scalar( buf, buf, size );
+        default:               return SEGY_INVALID_ARGS;
+    }
+}
+
+static int segy_native_byteswap(int format, long long size, void* buf) {
+
+    if (HOST_LSB) {
+        const int elemsize = formatsize( format );
+
+        switch (elemsize) {
+            case 8: bswap64vec(buf, size); break;
+            case 4: bswap32vec(buf, size); break;
+            case 3: bswap24vec(buf, size); break;
+            case 2: bswap16vec(buf, size); break;
+            default:                       break;
+        }
+    }
+
+    return SEGY_OK;
+}
+
+static int ibm_native_best( void* dst, const void* src, long long size ) {
+#ifdef SEGY_X86_SIMD
+    switch( segy_simd_level() ) {
+        case SEGY_SIMD_AVX512: return ibm_native_avx512( dst, src, size );
+        case SEGY_SIMD_AVX2:   return ibm_native_avx2( dst, src, size );
+        case SEGY_SIMD_SSE2:   return ibm_native_sse2( dst, src, size );
+        default:               break;
+    }
+#endif // SEGY_X86_SIMD
+    return ibm_native_scalar( dst, src, size );
+}
+
+static int native_ibm_best( void* dst, const void* src, long long size ) {
+#ifdef SEGY_X86_SIMD
+    switch( segy_simd_level() ) {
+        case SEGY_SIMD_AVX512: return native_ibm_avx512( dst, src, size );
+        case SEGY_SIMD_AVX2:   return native_ibm_avx2( dst, src, size );
+        case SEGY_SIMD_SSE2:   return native_ibm_sse2( dst, src, size );
+        default:               break;
+    }
+#endif // SEGY_X86_SIMD
+    return native_ibm_scalar( dst, src, size );
+}
+
+/*
+ * Convert size samples of format in the on-disk representation in src to
+ * native in dst, in a single pass where possible. lsb is the byte order of
+ * src, and src and dst can be the same buffer, but must otherwise not overlap.
+ */
+static int convert_native( int format,
+                           int lsb,
+                           long long size,
+                           void* dst,
+                           const void* src ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize < 0 ) return SEGY_INVALID_ARGS;
+
+    /* msb ibm is by far the most common, and has fused swap+convert kernels */
+    if( format == SEGY_IBM_FLOAT_4_BYTE && !lsb )
+        return ibm_native_best( dst, src, size );
+
+    if( dst != src ) memcpy( dst, src, size * elemsize );
+
+    const int swap = lsb ? HOST_MSB : HOST_LSB;
+    if( swap ) {
+        switch( elemsize ) {
+            case 8: bswap64vec( dst, size ); break;
+            case 4: bswap32vec( dst, size ); break;
+            case 3: bswap24vec( dst, size ); break;
+            case 2: bswap16vec( dst, size ); break;
+            default:                         break;
+        }
+    }
+
+    if( format == SEGY_IBM_FLOAT_4_BYTE ) {
+        char* xs = (char*)dst;
+        for( long long i = 0; i < size; ++i )
+            ibm_native( xs + i * elemsize );
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * Size of the samples of outtype, or -1 if outtype is unknown. The native
+ * type can't be scaled, so that is rejected too.
+ */
+static int outtype_size( int outtype,
+                         double scale,
+                         double bias,
+                         int elemsize ) {
+    switch( outtype ) {
+        case SEGY_AS_NATIVE:
+            return scale == 1.0 && bias == 0.0 ? elemsize : -1;
+
+        case SEGY_AS_FLOAT32: return sizeof( float );
+        case SEGY_AS_FLOAT64: return sizeof( double );
+        case SEGY_AS_INT16:   return sizeof( int16_t );
+        default:              return -1;
+    }
+}
+
+/*
+ * True if the native representation of format already is outtype, so that
+ * convert_native alone does the job.
+ */
+static int native_is( int format, int outtype ) {
+    switch( outtype ) {
+        case SEGY_AS_NATIVE:
+            return 1;
+
+        case SEGY_AS_FLOAT32:
+            return format == SEGY_IBM_FLOAT_4_BYTE
+                || format == SEGY_IEEE_FLOAT_4_BYTE;
+
+        case SEGY_AS_FLOAT64:
+            return format == SEGY_IEEE_FLOAT_8_BYTE;
+
+        case SEGY_AS_INT16:
+            return format == SEGY_SIGNED_SHORT_2_BYTE;
+
+        default:
+            return 0;
+    }
+}
+
+static int32_t native_int24( const unsigned char* xs, int sign ) {
+    const uint32_t x = HOST_LSB
+        ? (uint32_t)xs[ 0 ] | (uint32_t)xs[ 1 ] << 8 | (uint32_t)xs[ 2 ] << 16
+        : (uint32_t)xs[ 2 ] | (uint32_t)xs[ 1 ] << 8 | (uint32_t)xs[ 0 ] << 16;
+
+    if( sign && (x & 0x800000) ) return (int32_t)(x | 0xFF000000u);
+    return (int32_t)x;
+}
+
+/* round half away from zero, and saturate to the int16 range */
+static inline int16_t saturate_int16( double x ) {
+    if( x != x )          return 0;
+    if( x <= INT16_MIN )  return INT16_MIN;
+    if( x >= INT16_MAX )  return INT16_MAX;
+    return (int16_t)( x < 0 ? x - 0.5 : x + 0.5 );
+}
+
+static inline int16_t saturate_int16f( float x ) {
+    if( x != x )           return 0;
+    if( x <= INT16_MIN )   return INT16_MIN;
+    if( x >= INT16_MAX )   return INT16_MAX;
+    return (int16_t)( x < 0 ? x - 0.5f : x + 0.5f );
+}
+
+#define AS_FLOAT( x )  ((float)(x))
+#define AS_DOUBLE( x ) ((double)(x))
+
+/*
+ * y = x * scale + bias for n samples of TIN into TOUT, computed in TCALC and
+ * stored with STORE. The unscaled loop is kept separate, so that the plain
+ * widening conversions are just casts.
+ */
+#define SCALE_LOOP( TIN, TCALC, TOUT, STORE ) do {                      \
+        const TIN* xs = (const TIN*)src;                                \
+        TOUT* ys = (TOUT*)dst;                                          \
+        const TCALC s = (TCALC)scale;                                   \
+        const TCALC b = (TCALC)bias;                                    \
+        if( unscaled )                                                  \
+            for( long long i = 0; i < n; ++i )                          \
+                ys[ i ] = STORE( (TCALC)xs[ i ] );                      \
+        else                                                            \
+            for( long long i = 0; i < n; ++i )                          \
+                ys[ i ] = STORE( (TCALC)xs[ i ] * s + b );              \
+    } while( 0 )
+
+/*
+ * Convert from TIN to outtype. Narrow inputs are exact in single precision,
+ * so float32 and int16 outputs are computed in TCALC, which is float for
+ * those, and double for the rest. float64 is always computed in double.
+ */
+#define SCALE_TO( TIN, TCALC, SATURATE ) do {                           \
+        switch( outtype ) {                                             \
+            case SEGY_AS_FLOAT32:                                       \
+                SCALE_LOOP( TIN, TCALC, float, AS_FLOAT );              \
+                break;                                                  \
+            case SEGY_AS_FLOAT64:                                       \
+                SCALE_LOOP( TIN, double, double, AS_DOUBLE );           \
+                break;                                                  \
+            case SEGY_AS_INT16:                                         \
+                SCALE_LOOP( TIN, TCALC, int16_t, SATURATE );            \
+                break;                                                  \
+            default:                                                    \
+                assert( false && "outtype should already be checked" ); \
+                break;                                                  \
+        }                                                               \
+    } while( 0 )
+
+/*
+ * Convert n samples, already in their native representation, straight to
+ * outtype as x * scale + bias. Every pair of format and outtype has its own
+ * loop, so there is no per-sample dispatch, and the loops vectorise. src and
+ * dst may be the same buffer when the sizes match.
+ */
+static void native_to( int format,
+                       int outtype,
+                       double scale,
+                       double bias,
+                       long long n,
+                       const void* src,
+                       void* dst ) {
+
+    const int unscaled = scale == 1.0 && bias == 0.0;
+
+    switch( format ) {
+        case SEGY_IBM_FLOAT_4_BYTE:
+        case SEGY_IEEE_FLOAT_4_BYTE:
+            SCALE_TO( float, float, saturate_int16f );
+            break;
+
+        case SEGY_SIGNED_SHORT_2_BYTE:
+            SCALE_TO( int16_t, float, saturate_int16f );
+            break;
+
+        case SEGY_UNSIGNED_SHORT_2_BYTE:
+            SCALE_TO( uint16_t, float, saturate_int16f );
+            break;
+
+        case SEGY_SIGNED_CHAR_1_BYTE:
+            SCALE_TO( int8_t, float, saturate_int16f );
+            break;
+
+        case SEGY_UNSIGNED_CHAR_1_BYTE:
+            SCALE_TO( uint8_t, float, saturate_int16f );
+            break;
+
+        case SEGY_IEEE_FLOAT_8_BYTE:
+            SCALE_TO( double, double, saturate_int16 );
+            break;
+
+        case SEGY_SIGNED_INTEGER_4_BYTE:
+        case SEGY_FIXED_POINT_WITH_GAIN_4_BYTE:
+            SCALE_TO( int32_t, double, saturate_int16 );
+            break;
+
+        case SEGY_UNSIGNED_INTEGER_4_BYTE:
+            SCALE_TO( uint32_t, double, saturate_int16 );
+            break;
+
+        case SEGY_SIGNED_INTEGER_8_BYTE:
+            SCALE_TO( int64_t, double, saturate_int16 );
+            break;
+
+        case SEGY_UNSIGNED_INTEGER_8_BYTE:
+            SCALE_TO( uint64_t, double, saturate_int16 );
+            break;
+
+        default:
+            assert( false && "format should already be checked" );
+            break;
+    }
+}
+
+#undef SCALE_TO
+#undef SCALE_LOOP
+#undef AS_DOUBLE
+#undef AS_FLOAT
+
+/*
+ * Number of samples converted at a time by convert_as. The block of native
+ * samples lives on the stack, and is small enough to stay in L1 between the
+ * passes.
+ */
+#define CONVERT_BLOCK 1024
+
+/*
+ * Convert size samples of format in the on-disk representation in src to
+ * outtype in dst, as x * scale + bias. Works in blocks of CONVERT_BLOCK
+ * samples, so every block is swapped into its native representation and then
+ * converted to outtype while it is still in cache.
+ *
+ * src and dst can share the same start address, even when the output is
+ * wider than the input, since the blocks are then processed back-to-front.
+ * Otherwise they must not overlap.
+ */
+static int convert_as( int format,
+                       int lsb,
+                       int outtype,
+                       double scale,
+                       double bias,
+                       long long size,
+                       void* dst,
+                       const void* src ) {
+
+    const int insize = formatsize( format );
+    if( insize < 0 ) return SEGY_INVALID_ARGS;
+    const int outsize = outtype_size( outtype, scale, bias, insize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+
+    if( native_is( format, outtype ) ) {
+        const int err = convert_native( format, lsb, size, dst, src );
+        if( err != SEGY_OK ) return err;
+        if( scale != 1.0 || bias != 0.0 )
+            native_to( format, outtype, scale, bias, size, dst, dst );
+        return SEGY_OK;
+    }
+
+    /* 3-byte integers are unpacked to int32 before they're scaled */
+    const int int24 = format == SEGY_SIGNED_CHAR_3_BYTE
+                   || format == SEGY_UNSIGNED_INTEGER_3_BYTE;
+    const int informat = int24 ? SEGY_SIGNED_INTEGER_4_BYTE : format;
+
+    double native[ CONVERT_BLOCK ];
+    int32_t unpacked[ CONVERT_BLOCK ];
+
+    const long long blocks = (size + CONVERT_BLOCK - 1) / CONVERT_BLOCK;
+    const int backwards = outsize > insize;
+
+    for( long long k = 0; k < blocks; ++k ) {
+        const long long b = backwards ? blocks - 1 - k : k;
+        const long long first = b * CONVERT_BLOCK;
+        const long long n = size - first < CONVERT_BLOCK
+                          ? size - first
+                          : CONVERT_BLOCK;
+
+        const char* in = (const char*)src + first * insize;
+        char* out = (char*)dst + first * outsize;
+
+        convert_native( format, lsb, n, native, in );
+
+        const void* xs = native;
+        if( int24 ) {
+            const unsigned char* u8 = (const unsigned char*)native;
+            const int sign = format == SEGY_SIGNED_CHAR_3_BYTE;
+            for( long long i = 0; i < n; ++i )
+                unpacked[ i ] = native_int24( u8 + i * 3, sign );
+            xs = unpacked;
+        }
+
+        native_to( informat, outtype, scale, bias, n, xs, out );
+    }
+
+    return SEGY_OK;
+}
+
+int segy_to_native( int format,
+                    long long size,
+                    void* buf ) {
+    return convert_native( format, 0, size, buf, buf );
+}
+
+int segy_to_type( int format,
+                  int outtype,
+                  double scale,
+                  double bias,
+                  long long size,
+                  const void* src,
+                  void* dst ) {
+    return convert_as( format, 0, outtype, scale, bias, size, dst, src );
+}
+
+int segy_from_native( int format,
+                      long long size,
+                      void* buf ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize < 0 ) return SEGY_INVALID_ARGS;
+
+    if( format == SEGY_IBM_FLOAT_4_BYTE )
+        return native_ibm_best( buf, buf, size );
+
+    return segy_native_byteswap( format, size, buf );
+}
+
+/*
+ * Determine the position of the element `x` in `xs`.
+ * Returns -1 if the value cannot be found
+ */
+static int index_of( int x,
+                     const int* xs,
+                     int sz ) {
+    for( int i = 0; i < sz; i++ ) {
+        if( xs[i] == x )
+            return i;
+    }
+
+    return -1;
+}
+
+#ifdef HAVE_PREADV
+
+#ifdef IOV_MAX
+  #define SEGY_IOV_MAX IOV_MAX
+#else
+  #define SEGY_IOV_MAX 1024
+#endif
+
+/*
+ * preadv/pwritev until all of iov has been transferred, advancing the iovecs
+ * on short reads and writes
+ */
+static int preadv_full( int fd, struct iovec* iov, int iovcnt, long long pos ) {
+    while( iovcnt > 0 ) {
+        ssize_t n = preadv( fd, iov, iovcnt, (off_t)pos );
+        if( n <= 0 ) return SEGY_FREAD_ERROR;
+        pos += n;
+
+        for( ; iovcnt > 0 && (size_t)n >= iov->iov_len; ++iov, --iovcnt )
+            n -= iov->iov_len;
+
+        if( iovcnt > 0 ) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return SEGY_OK;
+}
+
+static int pwritev_full( int fd, struct iovec* iov, int iovcnt, long long pos ) {
+    while( iovcnt > 0 ) {
+        ssize_t n = pwritev( fd, iov, iovcnt, (off_t)pos );
+        if( n <= 0 ) return SEGY_FWRITE_ERROR;
+        pos += n;
+
+        for( ; iovcnt > 0 && (size_t)n >= iov->iov_len; ++iov, --iovcnt )
+            n -= iov->iov_len;
+
+        if( iovcnt > 0 ) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * Read line_length traces that are back-to-back on disk with scatter reads,
+ * starting at the samples of the first trace. The samples land directly in
+ * consecutive slots in dst, and the trace headers in between are all read into
+ * the same scratch buffer and discarded. Every preadv reads (up to) IOV_MAX/2
+ * traces.
+ */
+static int read_line_contiguous( segy_file* fp,
+                                 int line_trace0,
+                                 int line_length,
+                                 char* dst,
+                                 long trace0,
+                                 int trace_bsize ) {
+    /* make sure buffered writes are visible */
+    if( fp->writable && fflush( fp->fp ) != 0 ) return SEGY_FWRITE_ERROR;
+
+    const int fd = fileno( fp->fp );
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    struct iovec iov[ SEGY_IOV_MAX ];
+    const int chunk = (SEGY_IOV_MAX + 1) / 2;
+
+    for( int i = 0; i < line_length; i += chunk ) {
+        const int traces = line_length - i < chunk ? line_length - i : chunk;
+        const long long pos = trace_offset( line_trace0 + i, trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE;
+
+        int iovcnt = 0;
+        for( int k = 0; k < traces; ++k ) {
+            if( k > 0 ) {
+                iov[ iovcnt ].iov_base = header;
+                iov[ iovcnt ].iov_len  = SEGY_TRACE_HEADER_SIZE;
+                ++iovcnt;
+            }
+            iov[ iovcnt ].iov_base = dst + (long long)(i + k) * trace_bsize;
+            iov[ iovcnt ].iov_len  = trace_bsize;
+            ++iovcnt;
+        }
+
+        const int err = preadv_full( fd, iov, iovcnt, pos );
+        if( err != SEGY_OK ) return err;
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * The write counterpart of read_line_contiguous. pwritev can't skip bytes, so
+ * every trace gets its own pwritev of just its samples, straight from src (or
+ * the byte-swapped copy), and the trace headers on disk are never touched.
+ */
+static int write_line_contiguous( segy_file* fp,
+                                  int line_trace0,
+                                  int line_length,
+                                  const char* src,
+                                  long trace0,
+                                  int trace_bsize ) {
+    if( fflush( fp->fp ) != 0 ) return SEGY_FWRITE_ERROR;
+
+    const int fd = fileno( fp->fp );
+    char* swapped = NULL;
+
+    if( fp->lsb ) {
+        const long long elems = (long long)line_length
+                              * (trace_bsize / fp->elemsize);
+        swapped = malloc( (size_t)line_length * trace_bsize );
+        if( !swapped ) return SEGY_MEMORY_ERROR;
+
+        memcpy( swapped, src, (size_t)line_length * trace_bsize );
+        if (fp->elemsize == 8) bswap64vec(swapped, elems);
+        if (fp->elemsize == 4) bswap32vec(swapped, elems);
+        if (fp->elemsize == 3) bswap24vec(swapped, elems);
+        if (fp->elemsize == 2) bswap16vec(swapped, elems);
+        src = swapped;
+    }
+
+    int err = SEGY_OK;
+    for( int i = 0; i < line_length && err == SEGY_OK; ++i ) {
+        const long long pos = trace_offset( line_trace0 + i, trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE;
+
+        /* pwritev only reads from iov_base, casting away const is safe */
+        struct iovec iov;
+        iov.iov_base = (void*)(uintptr_t)( src + (long long)i * trace_bsize );
+        iov.iov_len  = trace_bsize;
+        err = pwritev_full( fd, &iov, 1, pos );
+    }
+
+    /*
+     * the stdio read buffer may hold data that is now stale, so flush it to
+     * make sure the next fread goes to disk
+     */
+    if( err == SEGY_OK && fflush( fp->fp ) != 0 )
+        err = SEGY_FWRITE_ERROR;
+
+    free( swapped );
+    return err;
+}
+
+#endif //HAVE_PREADV
+
+/*
+ * Read the inline or crossline `lineno`. If it's an inline or crossline
+ * depends on the parameters. The line has a length of `line_length` traces,
+ * `offsets` are the number of offsets in this file, and `buf` must be of
+ * (minimum) `line_length*samples_per_trace` size.  Reads every `stride` trace,
+ * starting at the trace specified by the *position* of the value `lineno` in
+ * `linenos`. If `lineno` isn't present in `linenos`, SEGY_MISSING_LINE_INDEX
+ * will be returned.
+ *
+ * If reading a trace fails, this function will return whatever error
+ * segy_readtrace returns.
+ */
+static int read_line( segy_file* fp,
+                      int line_trace0,
+                      int line_length,
+                      int stride,
+                      int offsets,
+                      void* buf,
+                      long trace0,
+                      int trace_bsize,
+                      int swap ) {
+
+    char* dst = (char*) buf;
+    stride *= offsets;
+
+#ifdef HAVE_PREADV
+    if( !fp->addr && !fp->container && stride == 1 && line_length > 1 ) {
+        const int err = read_line_contiguous( fp, line_trace0, line_length,
+                                              dst, trace0, trace_bsize );
+        if( err != SEGY_OK ) return err;
+
+        if( swap ) {
+            const long long elems = (long long)line_length
+                                  * (trace_bsize / fp->elemsize);
+            if (fp->elemsize == 8) bswap64vec(dst, elems);
+            if (fp->elemsize == 4) bswap32vec(dst, elems);
+            if (fp->elemsize == 3) bswap24vec(dst, elems);
+            if (fp->elemsize == 2) bswap16vec(dst, elems);
+        }
+
+        return SEGY_OK;
+    }
+#endif //HAVE_PREADV
+
+    const int samples = trace_bsize / fp->elemsize;
+    for( ; line_length--; line_trace0 += stride, dst += trace_bsize ) {
+        int err = readsubtr( fp, line_trace0, 0, samples, 1, dst, NULL,
+                             trace0, trace_bsize, swap );
+        if( err != 0 ) return err;
+    }
+
+    return SEGY_OK;
+}
+
+int segy_read_line( segy_file* fp,
+                    int line_trace0,
+                    int line_length,
+                    int stride,
+                    int offsets,
+                    void* buf,
+                    long trace0,
+                    int trace_bsize ) {
+    return read_line( fp, line_trace0, line_length, stride, offsets,
+                      buf, trace0, trace_bsize, fp->lsb );
+}
+
+/*
+ * Write the inline or crossline `lineno`. If it's an inline or crossline
+ * depends on the parameters. The line has a length of `line_length` traces,
+ * and `buf` must be of (minimum) `line_length*samples_per_trace` size.  Reads
+ * every `stride` trace, starting at the trace specified by the *position* of
+ * the value `lineno` in `linenos`. If `lineno` isn't present in `linenos`,
+ * SEGY_MISSING_LINE_INDEX will be returned.
+ *
+ * If reading a trace fails, this function will return whatever error
+ * segy_readtrace returns.
+ */
+int segy_write_line( segy_file* fp,
+                     int line_trace0,
+                     int line_length,
+                     int stride,
+                     int offsets,
+                     const void* buf,
+                     long trace0,
+                     int trace_bsize ) {
+    if( !fp->writable ) return SEGY_READONLY;
+    trace_cache_invalidate( fp );
+
+    const char* src = (const char*) buf;
+    stride *= offsets;
+
+#ifdef HAVE_PREADV
+    if( !fp->addr && stride == 1 && line_length > 1 )
+        return write_line_contiguous( fp, line_trace0, line_length,
+                                      src, trace0, trace_bsize );
+#endif //HAVE_PREADV
+
+    for( ; line_length--; line_trace0 += stride, src += trace_bsize ) {
+        int err = segy_writetrace( fp, line_trace0, src, trace0, trace_bsize );
+        if( err != 0 ) return err;
+    }
+
+    return SEGY_OK;
+}
+
+/*
+ * The cached native samples of traceno, converting the block they're in on
+ * first use. Returns NULL like trace_cache_record.
+ */
+static const char* trace_cache_samples( segy_file* fp,
+                                        long long traceno,
+                                        int format,
+                                        long trace0,
+                                        int trace_bsize,
+                                        int* err ) {
+    struct trace_cache* c = fp->cache;
+    *err = SEGY_OK;
+    if( format != c->format ) return NULL;
+
+    int slot;
+    char* rec = trace_cache_record( fp, traceno, trace0, trace_bsize,
+                                    &slot, err );
+    if( !rec ) return NULL;
+
+    if( !c->converted[ slot ] ) {
+        const long long recsize = SEGY_TRACE_HEADER_SIZE + trace_bsize;
+        const long long first = c->blockno[ slot ] * c->block_traces;
+        const long long left = c->tracecount - first;
+        const long long n = left < c->block_traces ? left : c->block_traces;
+        const int samples = trace_bsize / fp->elemsize;
+        char* block = c->data + slot * c->block_traces * recsize;
+
+        for( long long i = 0; i < n; ++i ) {
+            char* xs = block + i * recsize + SEGY_TRACE_HEADER_SIZE;
+            convert_native( format, fp->lsb, samples, xs, xs );
+        }
+        c->converted[ slot ] = 1;
+    }
+
+    return rec + SEGY_TRACE_HEADER_SIZE;
+}
+
+int segy_readsubtr_native( segy_file* fp,
+                           int traceno,
+                           int start,
+                           int stop,
+                           int step,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           void* rangebuf,
+                           long trace0,
+                           int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+
+    readahead( fp, trace_offset( traceno, trace0, trace_bsize ),
+                   SEGY_TRACE_HEADER_SIZE + trace_bsize );
+
+    if( fp->cache && outtype == SEGY_AS_NATIVE ) {
+        int err;
+        const char* src = trace_cache_samples( fp, traceno, format,
+                                               trace0, trace_bsize,
+                                               &err );
+        if( err != SEGY_OK ) return err;
+        if( src ) {
+            const int len = slicelength( start, stop, step );
+            char* dst = (char*)buf;
+            for( int i = 0; i < len; ++i )
+                memcpy( dst + (long long)i * elemsize,
+                        src + ((long long)start + (long long)i * step) * elemsize,
+                        elemsize );
+            return SEGY_OK;
+        }
+    }
+
+    if( fp->addr && step == 1 ) {
+        const int elems = stop - start;
+        const long long pos = trace_offset( traceno, trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE
+                            + (long long)start * elemsize;
+
+        const char* src = mmap_at( fp, pos, (size_t)elems * elemsize );
+        if( !src ) return SEGY_FREAD_ERROR;
+        return convert_as( format, fp->lsb, outtype, scale, bias,
+                           elems, buf, src );
+    }
+
+    const int len = slicelength( start, stop, step );
+
+    if( outsize >= elemsize ) {
+        const int err = readsubtr( fp, traceno, start, stop, step,
+                                   buf, rangebuf,
+                                   trace0, trace_bsize,
+                                   0 );
+        if( err != SEGY_OK ) return err;
+
+        return convert_as( format, fp->lsb, outtype, scale, bias,
+                           len, buf, buf );
+    }
+
+    /*
+     * narrowing - the raw samples don't fit in buf. readsubtr may need
+     * scratch memory for the whole range too, so take room for both at once
+     */
+    const size_t rawsize = (size_t)len * elemsize;
+    const size_t range = rangebuf ? 0 : (size_t)abs( stop - start ) * elemsize;
+    char* raw = scratch( fp, rawsize + range );
+    if( !raw ) return SEGY_MEMORY_ERROR;
+    if( !rangebuf ) rangebuf = raw + rawsize;
+
+    const int err = readsubtr( fp, traceno, start, stop, step,
+                               raw, rangebuf,
+                               trace0, trace_bsize,
+                               0 );
+    if( err != SEGY_OK ) return err;
+
+    return convert_as( format, fp->lsb, outtype, scale, bias, len, buf, raw );
+}
+
+int segy_readtrace_native( segy_file* fp,
+                           int traceno,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize ) {
+    const int stop = trace_bsize / fp->elemsize;
+    return segy_readsubtr_native( fp, traceno, 0, stop, 1,
+                                  format, outtype, scale, bias,
+                                  buf, NULL,
+                                  trace0, trace_bsize );
+}
+
+int segy_readtraces_native( segy_file* fp,
+                            const int64_t* tracenos,
+                            long long n,
+                            long long max_gap,
+                            int format,
+                            int outtype,
+                            double scale,
+                            double bias,
+                            void* buf,
+                            long trace0,
+                            int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+    if( n < 0 || max_gap < 0 ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+    if( n == 0 ) return SEGY_OK;
+
+    for( long long i = 0; i < n; ++i )
+        if( tracenos[ i ] < 0 ) return SEGY_INVALID_ARGS;
+
+    char* dst = (char*)buf;
+    const int samples = trace_bsize / elemsize;
+    const long long out_bsize = (long long)samples * outsize;
+
+    /* cached traces are served one by one, and misses fill whole blocks */
+    if( fp->cache && outtype == SEGY_AS_NATIVE ) {
+        for( long long i = 0; i < n; ++i ) {
+            const int err = segy_readtrace_native( fp, tracenos[ i ],
+                                                   format, outtype, scale, bias,
+                                                   dst + i * out_bsize,
+                                                   trace0, trace_bsize );
+            if( err != SEGY_OK ) return err;
+        }
+        return SEGY_OK;
+    }
+
+    if( fp->addr ) {
+        for( long long i = 0; i < n; ++i ) {
+            const long long pos = trace_offset( tracenos[ i ], trace0, trace_bsize )
+                                + SEGY_TRACE_HEADER_SIZE;
+            const char* src = mmap_at( fp, pos, trace_bsize );
+            if( !src ) return SEGY_FREAD_ERROR;
+
+            convert_as( format, fp->lsb, outtype, scale, bias, samples,
+                        dst + i * out_bsize, src );
+        }
+
+        return SEGY_OK;
+    }
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( fp->writable && fflush( fp->fp ) != 0 ) return SEGY_FWRITE_ERROR;
+
+    if( outsize >= elemsize ) {
+        const int err = readtraces_merged( fp, tracenos, n, max_gap,
+                                           dst, trace0, trace_bsize );
+        if( err != SEGY_OK ) return err;
+
+        return convert_as( format, fp->lsb, outtype, scale, bias,
+                           n * samples, buf, buf );
+    }
+
+    /*
+     * narrowing - the raw traces don't fit in buf, so stage them through the
+     * handle's scratch memory a batch at a time
+     */
+    long long batch = readtraces_chunk / trace_bsize;
+    if( batch < 1 ) batch = 1;
+    if( batch > n ) batch = n;
+
+    char* raw = scratch( fp, (size_t)( batch * trace_bsize ) );
+    if( !raw ) return SEGY_MEMORY_ERROR;
+
+    int err = SEGY_OK;
+    for( long long i = 0; i < n && err == SEGY_OK; i += batch ) {
+        const long long len = n - i < batch ? n - i : batch;
+        err = readtraces_merged( fp, tracenos + i, len, max_gap,
+                                 raw, trace0, trace_bsize );
+        if( err == SEGY_OK )
+            err = convert_as( format, fp->lsb, outtype, scale, bias,
+                              len * samples,
+                              dst + i * out_bsize, raw );
+    }
+
+    return err;
+}
+
+/*
+ * Pick the n samples, step elements apart, from the raw window src and
+ * convert them into dst. Strided samples are gathered into tmp first, which
+ * must have room for n raw samples, and may be dst itself when widening.
+ */
+static int gather_as( int format,
+                      int lsb,
+                      int outtype,
+                      double scale,
+                      double bias,
+                      int elemsize,
+                      int n,
+                      int step,
+                      const char* src,
+                      char* tmp,
+                      void* dst ) {
+    if( step == 1 )
+        return convert_as( format, lsb, outtype, scale, bias, n, dst, src );
+
+    const long long stride = (long long)step * elemsize;
+    for( int i = 0; i < n; ++i )
+        memcpy( tmp + (long long)i * elemsize, src + i * stride, elemsize );
+
+    return convert_as( format, lsb, outtype, scale, bias, n, dst, tmp );
+}
+
+int segy_read_trace_range( segy_file* fp,
+                           int start,
+                           int step,
+                           int count,
+                           int sample_start,
+                           int sample_stop,
+                           int sample_step,
+                           long long max_gap,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+    if( count < 0 || max_gap < 0 ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+
+    const long long last = start + (long long)( count - 1 ) * step;
+    if( count > 0 && ( start < 0 || last < 0 || last > INT_MAX ) )
+        return SEGY_INVALID_ARGS;
+
+    const int len = slicelength( sample_start, sample_stop, sample_step );
+    if( count == 0 || len == 0 ) return SEGY_OK;
+
+    /* the window [lo, hi) of samples covered by the slice */
+    const int samples = trace_bsize / elemsize;
+    const int end = sample_start + ( len - 1 ) * sample_step;
+    const int lo = sample_step > 0 ? sample_start : end;
+    const int hi = sample_step > 0 ? end + 1 : sample_start + 1;
+    if( lo < 0 || hi > samples ) return SEGY_INVALID_ARGS;
+
+    char* dst = (char*)buf;
+    const long long out_bsize = (long long)len * outsize;
+    const long long first = ( sample_start - lo ) * (long long)elemsize;
+    const long long window = ( hi - lo ) * (long long)elemsize;
+
+    if( fp->cache && outtype == SEGY_AS_NATIVE ) {
+        for( int i = 0; i < count; ++i ) {
+            const int err = segy_readsubtr_native( fp, start + i * step,
+                                                   sample_start,
+                                                   sample_stop,
+                                                   sample_step,
+                                                   format, outtype, scale, bias,
+                                                   dst + i * out_bsize,
+                                                   NULL,
+                                                   trace0, trace_bsize );
+            if( err != SEGY_OK ) return err;
+        }
+        return SEGY_OK;
+    }
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    /* strided samples are gathered in place, or in scratch when narrowing */
+    char* tmp = NULL;
+    const long long tmpsize = outsize < elemsize ? (long long)len * elemsize : 0;
+
+    if( fp->addr ) {
+        if( tmpsize && !( tmp = scratch( fp, tmpsize ) ) )
+            return SEGY_MEMORY_ERROR;
+
+        for( int i = 0; i < count; ++i ) {
+            const long long pos = trace_offset( start + i * step,
+                                                trace0, trace_bsize )
+                                + SEGY_TRACE_HEADER_SIZE
+                                + (long long)lo * elemsize;
+            const char* src = mmap_at( fp, pos, window );
+            if( !src ) return SEGY_FREAD_ERROR;
+
+            char* out = dst + i * out_bsize;
+            const int err = gather_as( format, fp->lsb,
+                                       outtype, scale, bias, elemsize,
+                                       len, sample_step, src + first,
+                                       tmp ? tmp : out, out );
+            if( err != SEGY_OK ) return err;
+        }
+        return SEGY_OK;
+    }
+
+    /*
+     * The traces are equally far apart, so the whole range is read in file
+     * order, in chunks of the traces that fit in readtraces_chunk bytes,
+     * or one trace window at a time when the gap between the windows is
+     * larger than max_gap.
+     */
+    const long long astep = step < 0 ? -(long long)step : step;
+    const long long distance = astep * ( SEGY_TRACE_HEADER_SIZE + trace_bsize );
+    const long long gap = distance - window;
+
+    long long per_chunk = 1;
+    if( gap <= max_gap && distance > 0 )
+        per_chunk = ( readtraces_chunk - window ) / distance + 1;
+    if( per_chunk < 1 ) per_chunk = 1;
+    if( per_chunk > count ) per_chunk = count;
+
+    const long long chunksize = ( per_chunk - 1 ) * distance + window;
+    char* chunk = scratch( fp, chunksize + tmpsize );
+    if( !chunk ) return SEGY_MEMORY_ERROR;
+    if( tmpsize ) tmp = chunk + chunksize;
+
+    /* walk forwards in the file, also when the traces are requested backwards */
+    const int forward = step >= 0;
+    const int lowest = forward ? start : (int)last;
+
+    for( long long k = 0; k < count; k += per_chunk ) {
+        const long long n = count - k < per_chunk ? count - k : per_chunk;
+        const long long pos = trace_offset( lowest + k * astep,
+                                            trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE
+                            + (long long)lo * elemsize;
+        const long long span = ( n - 1 ) * distance + window;
+
+        readahead( fp, pos, span );
+        int err = pread_at( fp, chunk, pos, span );
+        if( err != SEGY_OK ) return err;
+
+        for( long long j = 0; j < n; ++j ) {
+            const long long i = forward ? k + j : count - 1 - ( k + j );
+            char* out = dst + i * out_bsize;
+            err = gather_as( format, fp->lsb,
+                             outtype, scale, bias, elemsize,
+                             len, sample_step, chunk + j * distance + first,
+                             tmp ? tmp : out, out );
+            if( err != SEGY_OK ) return err;
+        }
+    }
+
+    return SEGY_OK;
+}
+
+int segy_read_line_native( segy_file* fp,
+                           int line_trace0,
+                           int line_length,
+                           int stride,
+                           int offsets,
+                           int format,
+                           int outtype,
+                           double scale,
+                           double bias,
+                           void* buf,
+                           long trace0,
+                           int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+
+    char* dst = (char*)buf;
+    const int samples = trace_bsize / elemsize;
+    const long long out_bsize = (long long)samples * outsize;
+    const int step = stride * offsets;
+
+    /*
+     * only lines with their traces close together are prefetched, the extent
+     * of a strided line is most of the file
+     */
+    if( stride == 1 && line_length > 0 ) {
+        const long long first = trace_offset( line_trace0, trace0, trace_bsize );
+        const long long last = trace_offset( line_trace0
+                                           + (long long)(line_length - 1) * step,
+                                             trace0, trace_bsize );
+        readahead( fp, first, last - first + SEGY_TRACE_HEADER_SIZE + trace_bsize );
+    }
+
+    if( fp->addr ) {
+        for( int i = 0; i < line_length; ++i, dst += out_bsize ) {
+            const long long traceno = line_trace0 + (long long)i * step;
+            const long long pos = trace_offset( traceno, trace0, trace_bsize )
+                                + SEGY_TRACE_HEADER_SIZE;
+            const char* src = mmap_at( fp, pos, trace_bsize );
+            if( !src ) return SEGY_FREAD_ERROR;
+
+            convert_as( format, fp->lsb, outtype, scale, bias,
+                        samples, dst, src );
+        }
+
+        return SEGY_OK;
+    }
+
+    if( outsize >= elemsize ) {
+        const int err = read_line( fp, line_trace0, line_length,
+                                   stride, offsets,
+                                   buf, trace0, trace_bsize, 0 );
+        if( err != SEGY_OK ) return err;
+
+        return convert_as( format, fp->lsb, outtype, scale, bias,
+                           (long long)line_length * samples,
+                           buf, buf );
+    }
+
+    /* narrowing - read the line in batches of traces through the scratch */
+    long long batch = readtraces_chunk / trace_bsize;
+    if( batch < 1 ) batch = 1;
+    if( batch > line_length ) batch = line_length;
+    if( batch < 1 ) return SEGY_OK;
+
+    char* raw = scratch( fp, (size_t)( batch * trace_bsize ) );
+    if( !raw ) return SEGY_MEMORY_ERROR;
+
+    int err = SEGY_OK;
+    for( int i = 0; i < line_length && err == SEGY_OK; i += batch ) {
+        const int len = line_length - i < batch ? line_length - i : batch;
+        err = read_line( fp, line_trace0 + i * step, len, stride, offsets,
+                         raw, trace0, trace_bsize, 0 );
+        if( err == SEGY_OK )
+            err = convert_as( format, fp->lsb, outtype, scale, bias,
+                              (long long)len * samples,
+                              dst + i * out_bsize, raw );
+    }
+
+    return err;
+}
+
+struct depth_task {
+    segy_file* fp;
+    const int* sample_indices;
+    int n;
+    int start;
+    int step;
+    int slicelen;
+    int format;
+    int outtype;
+    double scale;
+    double bias;
+    int outsize;
+    char* out;
+    long trace0;
+    int trace_bsize;
+    /* bytes [lo, hi) of the trace data cover all requested samples */
+    int lo;
+    int hi;
+};
+
+static int depth_slices_part( void* arg, int part, int parts ) {
+    const struct depth_task* t = arg;
+    segy_file* fp = t->fp;
+    const int elemsize = fp->elemsize;
+
+    const long long first = (long long)t->slicelen * part / parts;
+    const long long last  = (long long)t->slicelen * (part + 1) / parts;
+    if( first == last ) return SEGY_OK;
+
+    const long long absstep = t->step < 0 ? -(long long)t->step : t->step;
+    const long long stride = absstep
+                           * ((long long)t->trace_bsize + SEGY_TRACE_HEADER_SIZE);
+    const long long span = t->hi - t->lo;
+
+    /*
+     * Read runs of traces in a single block, unless the traces are so far
+     * apart that reading the bytes in between costs more than a read per
+     * trace. A block holds at least one trace's span, and the staged samples
+     * are bounded the same way.
+     */
+    long long batch = 1;
+    if( stride - span <= scan_max_gap )
+        batch = (readtraces_chunk - span) / stride + 1;
+
+    const long long staged = (long long)t->n * elemsize;
+    if( batch * staged > readtraces_chunk ) batch = readtraces_chunk / staged;
+    if( batch < 1 ) batch = 1;
+    if( batch > last - first ) batch = last - first;
+
+    char* block = NULL;
+    if( !fp->addr ) {
+        block = malloc( (size_t)( (batch - 1) * stride + span ) );
+        if( !block ) return SEGY_MEMORY_ERROR;
+    }
+
+    /* samples of the batch, gathered plane by plane */
+    char* raw = malloc( (size_t)( batch * staged ) );
+    if( !raw ) {
+        free( block );
+        return SEGY_MEMORY_ERROR;
+    }
+
+    int err = SEGY_OK;
+    for( long long k = first; k < last && err == SEGY_OK; k += batch ) {
+        const long long len = last - k < batch ? last - k : batch;
+
+        /* with negative steps, the last trace of the batch is first in the file */
+        const long long low = t->step < 0 ? k + len - 1 : k;
+        const long long traceno = t->start + low * t->step;
+        const long long pos = trace_offset( traceno, t->trace0, t->trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE
+                            + t->lo;
+        const long long n = (len - 1) * stride + span;
+
+        const char* src = block;
+        if( fp->addr ) {
+            src = mmap_at( fp, pos, (size_t)n );
+            if( !src ) err = SEGY_FREAD_ERROR;
+        } else {
+            err = pread_at( fp, block, pos, (size_t)n );
+        }
+        if( err != SEGY_OK ) break;
+
+        for( long long i = 0; i < len; ++i ) {
+            const long long rel = t->step < 0 ? low - (k + i) : i;
+            const char* trace = src + rel * stride;
+
+            for( int j = 0; j < t->n; ++j ) {
+                const long long at = (long long)t->sample_indices[ j ]
+                                   * elemsize - t->lo;
+                memcpy( raw + ((long long)j * len + i) * elemsize,
+                        trace + at,
+                        elemsize );
+            }
+        }
+
+        for( int j = 0; j < t->n && err == SEGY_OK; ++j ) {
+            char* dst = t->out
+                      + ((long long)j * t->slicelen + k) * t->outsize;
+            err = convert_as( t->format, fp->lsb,
+                              t->outtype, t->scale, t->bias, len,
+                              dst, raw + (long long)j * len * elemsize );
+        }
+    }
+
+    free( raw );
+    free( block );
+    return err;
+}
+
+int segy_read_depth_slices( segy_file* fp,
+                            const int* sample_indices,
+                            int n,
+                            int start,
+                            int stop,
+                            int step,
+                            int format,
+                            int outtype,
+                            double scale,
+                            double bias,
+                            int threads,
+                            void* buf,
+                            long trace0,
+                            int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+    if( n < 0 || step == 0 ) return SEGY_INVALID_ARGS;
+
+    struct depth_task task;
+    task.lo = trace_bsize;
+    task.hi = 0;
+
+    const int samples = trace_bsize / elemsize;
+    for( int i = 0; i < n; ++i ) {
+        const int sample = sample_indices[ i ];
+        if( sample < 0 || sample >= samples ) return SEGY_INVALID_ARGS;
+
+        const int lo = sample * elemsize;
+        const int hi = lo + elemsize;
+        if( lo < task.lo ) task.lo = lo;
+        if( hi > task.hi ) task.hi = hi;
+    }
+
+    const int slicelen = slicelength( start, stop, step );
+    if( slicelen <= 0 || n == 0 ) return SEGY_OK;
+
+    const int end = start + step * (slicelen - 1);
+    if( start < 0 || end < 0 ) return SEGY_INVALID_ARGS;
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    if( !concurrent_reads( fp ) ) threads = 1;
+    if( threads > slicelen ) threads = slicelen;
+
+    task.fp = fp;
+    task.sample_indices = sample_indices;
+    task.n = n;
+    task.start = start;
+    task.step = step;
+    task.slicelen = slicelen;
+    task.format = format;
+    task.outtype = outtype;
+    task.scale = scale;
+    task.bias = bias;
+    task.outsize = outsize;
+    task.out = (char*)buf;
+    task.trace0 = trace0;
+    task.trace_bsize = trace_bsize;
+
+    return run_parallel( depth_slices_part, &task, threads );
+}
+
+struct cube_task {
+    segy_file* fp;
+    int start;
+    int count;
+    int format;
+    int outtype;
+    double scale;
+    double bias;
+    int outsize;
+    char* out;
+    long trace0;
+    int trace_bsize;
+};
+
+static int read_cube_part( void* arg, int part, int parts ) {
+    const struct cube_task* t = arg;
+    segy_file* fp = t->fp;
+
+    const long long first = (long long)t->count * part / parts;
+    const long long last  = (long long)t->count * (part + 1) / parts;
+    if( first == last ) return SEGY_OK;
+
+    const int samples = t->trace_bsize / fp->elemsize;
+    const long long stride = (long long)t->trace_bsize + SEGY_TRACE_HEADER_SIZE;
+    const long long out_bsize = (long long)samples * t->outsize;
+
+    /*
+     * Read the traces in blocks, headers and all, and convert the samples of
+     * every trace straight into its place in out. Every thread has its own
+     * block, so the parts are read independently with positional reads.
+     */
+    long long batch = readtraces_chunk / stride;
+    if( batch < 1 ) batch = 1;
+    if( batch > last - first ) batch = last - first;
+
+    char* block = NULL;
+    if( !fp->addr ) {
+        block = malloc( (size_t)( batch * stride ) );
+        if( !block ) return SEGY_MEMORY_ERROR;
+    }
+
+    int err = SEGY_OK;
+    for( long long k = first; k < last && err == SEGY_OK; k += batch ) {
+        const long long len = last - k < batch ? last - k : batch;
+        const long long pos = trace_offset( t->start + k,
+                                            t->trace0,
+                                            t->trace_bsize );
+        const long long n = (len - 1) * stride
+                          + SEGY_TRACE_HEADER_SIZE
+                          + t->trace_bsize;
+
+        const char* src = block;
+        if( fp->addr ) {
+            src = mmap_at( fp, pos, (size_t)n );
+            if( !src ) err = SEGY_FREAD_ERROR;
+        } else {
+            /*
+             * the next block of this part follows right after. The readahead
+             * state belongs to the handle, so the threads prefetch directly
+             */
+            if( fp->ra.bytes > 0 && k + len < last )
+                prefetch( fp, pos + len * stride, n );
+            err = pread_at( fp, block, pos, (size_t)n );
+        }
+
+        for( long long i = 0; i < len && err == SEGY_OK; ++i ) {
+            err = convert_as( t->format, fp->lsb,
+                              t->outtype, t->scale, t->bias, samples,
+                              t->out + (k + i) * out_bsize,
+                              src + i * stride + SEGY_TRACE_HEADER_SIZE );
+        }
+    }
+
+    free( block );
+    return err;
+}
+
+int segy_read_cube( segy_file* fp,
+                    int start,
+                    int stop,
+                    int format,
+                    int outtype,
+                    double scale,
+                    double bias,
+                    int threads,
+                    void* buf,
+                    long trace0,
+                    int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+    if( start < 0 || stop < start ) return SEGY_INVALID_ARGS;
+    if( start == stop ) return SEGY_OK;
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    /*
+     * check once that the last trace is inside the file, so that a short file
+     * fails before anything is read
+     */
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    const int err = segy_pread_traceheader( fp, stop - 1, header,
+                                            trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+    const int count = stop - start;
+    if( !concurrent_reads( fp ) ) threads = 1;
+    if( threads > count ) threads = count;
+
+    struct cube_task task;
+    task.fp = fp;
+    task.start = start;
+    task.count = count;
+    task.format = format;
+    task.outtype = outtype;
+    task.scale = scale;
+    task.bias = bias;
+    task.outsize = outsize;
+    task.out = (char*)buf;
+    task.trace0 = trace0;
+    task.trace_bsize = trace_bsize;
+
+    return run_parallel( read_cube_part, &task, threads );
+}
+
+/*
+ * The k-th trace, in file order, of a sub volume. The traces of a line are
+ * consecutive in the file, so the slow (line) dimension is the outer one.
+ */
+struct subvolume {
+    int sorting;
+    int inline_count;
+    int crossline_count;
+    int offsets;
+    int offset;
+    int il0, ilstep, ils;
+    int xl0, xlstep, xls;
+};
+
+static long long subvolume_traceno( const struct subvolume* v,
+                                    long long k,
+                                    long long* outpos ) {
+    long long i, j;
+    if( v->sorting == SEGY_INLINE_SORTING ) {
+        i = k / v->xls;
+        j = k % v->xls;
+    } else {
+        j = k / v->ils;
+        i = k % v->ils;
+    }
+
+    *outpos = i * v->xls + j;
+
+    const long long il = v->il0 + i * v->ilstep;
+    const long long xl = v->xl0 + j * v->xlstep;
+    const long long line = v->sorting == SEGY_INLINE_SORTING
+                         ? il * v->crossline_count + xl
+                         : xl * v->inline_count + il;
+    return line * v->offsets + v->offset;
+}
+
+/* the number of indices in [start, stop) with a positive step */
+static int strided_count( int start, int stop, int step ) {
+    return (stop - start + step - 1) / step;
+}
+
+int segy_read_subvolume_strided( segy_file* fp,
+                                 int sorting,
+                                 int inline_count,
+                                 int crossline_count,
+                                 int offsets,
+                                 int offset,
+                                 int il0,
+                                 int il1,
+                                 int ilstep,
+                                 int xl0,
+                                 int xl1,
+                                 int xlstep,
+                                 int s0,
+                                 int s1,
+                                 int sstep,
+                                 int format,
+                                 int outtype,
+                                 double scale,
+                                 double bias,
+                                 void* buf,
+                                 long trace0,
+                                 int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+
+    const int outsize = outtype_size( outtype, scale, bias, elemsize );
+    if( outsize < 0 ) return SEGY_INVALID_ARGS;
+
+    if( sorting != SEGY_INLINE_SORTING && sorting != SEGY_CROSSLINE_SORTING )
+        return SEGY_INVALID_ARGS;
+
+    const int samples = trace_bsize / elemsize;
+    if( offset < 0 || offset >= offsets ) return SEGY_INVALID_ARGS;
+    if( il0 < 0 || il0 > il1 || il1 > inline_count )    return SEGY_INVALID_ARGS;
+    if( xl0 < 0 || xl0 > xl1 || xl1 > crossline_count ) return SEGY_INVALID_ARGS;
+    if( s0 < 0 || s0 > s1 || s1 > samples )             return SEGY_INVALID_ARGS;
+    if( ilstep < 1 || xlstep < 1 || sstep < 1 )         return SEGY_INVALID_ARGS;
+
+    const int ils = strided_count( il0, il1, ilstep );
+    const int xls = strided_count( xl0, xl1, xlstep );
+    const int window = strided_count( s0, s1, sstep );
+
+    const long long count = (long long)ils * xls;
+    if( count == 0 || window == 0 ) return SEGY_OK;
+
+    /* make sure buffered writes are visible to the positional reads */
+    if( !fp->addr && fp->writable && fflush( fp->fp ) != 0 )
+        return SEGY_FWRITE_ERROR;
+
+    struct subvolume v;
+    v.sorting = sorting;
+    v.inline_count = inline_count;
+    v.crossline_count = crossline_count;
+    v.offsets = offsets;
+    v.offset = offset;
+    v.il0 = il0;
+    v.ilstep = ilstep;
+    v.ils = ils;
+    v.xl0 = xl0;
+    v.xlstep = xlstep;
+    v.xls = xls;
+
+    /*
+     * the samples of a trace are read from the first to the last selected,
+     * and with a sample step they are converted into a buffer of the whole
+     * span first, and then picked from it
+     */
+    const long long spansamples = (long long)(window - 1) * sstep + 1;
+    const long long stride = (long long)trace_bsize + SEGY_TRACE_HEADER_SIZE;
+    const long long span = spansamples * elemsize;
+    const long long out_window = (long long)window * outsize;
+    char* dst = (char*)buf;
+
+    char* block = NULL;
+    long long blocksize = 0;
+
+    char* picked = NULL;
+    if( sstep > 1 ) {
+        picked = malloc( spansamples * outsize );
+        if( !picked ) return SEGY_MEMORY_ERROR;
+    }
+
+    int err = SEGY_OK;
+
+    /*
+     * Grow runs of traces, in file order, that are close enough that reading
+     * the bytes in between is cheaper than another read, and read each run
+     * from the first sample of the window of its first trace to the last
+     * sample of the window of its last trace. Lines that are stepped over
+     * are far apart, and so are read separately.
+     */
+    long long k = 0;
+    while( k < count && err == SEGY_OK ) {
+        long long outpos;
+        const long long base = subvolume_traceno( &v, k, &outpos );
+
+        long long last = k;
+        long long prev = base;
+        while( last + 1 < count ) {
+            long long ignore;
+            const long long next = subvolume_traceno( &v, last + 1, &ignore );
+            const long long gap = (next - prev) * stride - span;
+            const long long len = (next - base) * stride + span;
+
+            if( gap > scan_max_gap ) break;
+            if( len > readtraces_chunk ) break;
+            prev = next;
+            ++last;
+        }
+
+        const long long pos = trace_offset( base, trace0, trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE
+                            + (long long)s0 * elemsize;
+        const long long len = (prev - base) * stride + span;
+
+        const char* src = NULL;
+        if( fp->addr ) {
+            src = mmap_at( fp, pos, (size_t)len );
+            if( !src ) err = SEGY_FREAD_ERROR;
+        } else {
+            if( len > blocksize ) {
+                char* tmp = realloc( block, (size_t)len );
+                if( !tmp ) {
+                    err = SEGY_MEMORY_ERROR;
+                    break;
+                }
+                block = tmp;
+                blocksize = len;
+            }
+
+            err = pread_at( fp, block, pos, (size_t)len );
+            src = block;
+        }
+
+        for( long long i = k; i <= last && err == SEGY_OK; ++i ) {
+            const long long traceno = subvolume_traceno( &v, i, &outpos );
+            const char* trace = src + (traceno - base) * stride;
+            char* out = dst + outpos * out_window;
+
+            if( sstep == 1 ) {
+                err = convert_as( format, fp->lsb, outtype, scale, bias,
+                                  window, out, trace );
+                continue;
+            }
+
+            err = convert_as( format, fp->lsb, outtype, scale, bias,
+                              spansamples, picked, trace );
+            if( err != SEGY_OK ) break;
+
+            for( int x = 0; x < window; ++x )
+                memcpy( out + (long long)x * outsize,
+                        picked + (long long)x * sstep * outsize,
+                        outsize );
+        }
+
+        k = last + 1;
+    }
+
+    free( picked );
+    free( block );
+    return err;
+}
+
+int segy_read_subvolume( segy_file* fp,
+                         int sorting,
+                         int inline_count,
+                         int crossline_count,
+                         int offsets,
+                         int offset,
+                         int il0,
+                         int il1,
+                         int xl0,
+                         int xl1,
+                         int s0,
+                         int s1,
+                         int format,
+                         int outtype,
+                         double scale,
+                         double bias,
+                         void* buf,
+                         long trace0,
+                         int trace_bsize ) {
+
+    return segy_read_subvolume_strided( fp, sorting,
+                                        inline_count, crossline_count,
+                                        offsets, offset,
+                                        il0, il1, 1,
+                                        xl0, xl1, 1,
+                                        s0, s1, 1,
+                                        format, outtype, scale, bias,
+                                        buf, trace0, trace_bsize );
+}
+
+/*
+ * A compressed block is a small header followed by one plane for each byte of
+ * the sample. The header is
+ *
+ *   u8 method (CODEC_SHUFFLE or CODEC_QUANTISED), u8 elemsize,
+ *   f64 quantisation step (CODEC_QUANTISED only)
  *
- *          +  HOST LSB | HOST MSB
- * FILE LSB |   no-op   |  bswap
- * FILE MSB |   bswap   |  no-op
+ * and every plane is one of
+ *
+ *   u8 PLANE_RAW,      the bytes as they are
+ *   u8 PLANE_CONSTANT, the one byte all samples have
+ *   u8 PLANE_HUFFMAN,  128 bytes of 4-bit code lengths, i64 stream size,
+ *                      the bit stream, least significant bit first
+ *
+ * Multi-byte values are in native byte order. Quantised samples are stored as
+ * zig-zag encoded differences between consecutive samples, which are mostly
+ * small, so their high bytes are mostly zero.
+ */
+enum { CODEC_SHUFFLE = 0, CODEC_QUANTISED = 1 };
+enum { PLANE_RAW = 0, PLANE_CONSTANT = 1, PLANE_HUFFMAN = 2 };
+
+#define HUFFMAN_MAXBITS 12
+#define HUFFMAN_LENGTHS_SIZE 128
+#define HUFFMAN_OVERHEAD (1 + HUFFMAN_LENGTHS_SIZE + sizeof( int64_t ))
+
+/*
+ * Huffman code lengths for the symbols with non-zero frequency, of which
+ * there must be at least two. Codes longer than HUFFMAN_MAXBITS are avoided
+ * by flattening the frequencies until the tree is shallow enough, which costs
+ * very little compression and keeps the decoding table small.
+ */
+static void huffman_lengths( const uint64_t* frequencies, uint8_t* lengths ) {
+    uint64_t freq[ 256 ];
+    memcpy( freq, frequencies, sizeof( freq ) );
+
+    uint64_t weight[ 511 ];
+    int parent[ 511 ];
+    int symbol[ 256 ];
+    bool alive[ 511 ];
+
+    for( ;; ) {
+        int leaves = 0;
+        for( int s = 0; s < 256; ++s ) {
+            if( !freq[ s ] ) continue;
+            weight[ leaves ] = freq[ s ];
+            symbol[ leaves ] = s;
+            alive[ leaves ] = true;
+            ++leaves;
+        }
+
+        int nodes = leaves;
+        for( int active = leaves; active > 1; --active ) {
+            int a = -1, b = -1;
+            for( int i = 0; i < nodes; ++i ) {
+                if( !alive[ i ] ) continue;
+                if( a < 0 || weight[ i ] < weight[ a ] ) { b = a; a = i; }
+                else if( b < 0 || weight[ i ] < weight[ b ] ) b = i;
+            }
+
+            weight[ nodes ] = weight[ a ] + weight[ b ];
+            alive[ nodes ] = true;
+            alive[ a ] = alive[ b ] = false;
+            parent[ a ] = parent[ b ] = nodes;
+            ++nodes;
+        }
+
+        const int root = nodes - 1;
+        int longest = 0;
+        memset( lengths, 0, 256 );
+        for( int i = 0; i < leaves; ++i ) {
+            int depth = 0;
+            for( int node = i; node != root; node = parent[ node ] ) ++depth;
+            lengths[ symbol[ i ] ] = depth;
+            if( depth > longest ) longest = depth;
+        }
+
+        if( longest <= HUFFMAN_MAXBITS ) return;
+
+        for( int s = 0; s < 256; ++s )
+            if( freq[ s ] ) freq[ s ] = (freq[ s ] >> 1) | 1;
+    }
+}
+
+/*
+ * Canonical codes from the code lengths, bit-reversed so they can be written
+ * and read least significant bit first.
+ */
+static void huffman_codes( const uint8_t* lengths, uint16_t* codes ) {
+    int count[ HUFFMAN_MAXBITS + 1 ] = { 0 };
+    for( int s = 0; s < 256; ++s ) ++count[ lengths[ s ] ];
+    count[ 0 ] = 0;
+
+    int next[ HUFFMAN_MAXBITS + 1 ] = { 0 };
+    int code = 0;
+    for( int len = 1; len <= HUFFMAN_MAXBITS; ++len ) {
+        code = (code + count[ len - 1 ]) << 1;
+        next[ len ] = code;
+    }
+
+    for( int s = 0; s < 256; ++s ) {
+        const int len = lengths[ s ];
+        if( !len ) continue;
+
+        const int c = next[ len ]++;
+        int reversed = 0;
+        for( int i = 0; i < len; ++i )
+            reversed |= ((c >> i) & 1) << (len - 1 - i);
+        codes[ s ] = reversed;
+    }
+}
+
+/*
+ * Compress the plane of every stride'th byte of src, and return the end of
+ * the plane written to dst. The plane is never larger than 1 + n bytes.
+ */
+static unsigned char* compress_plane( const unsigned char* src,
+                                      long long n,
+                                      int stride,
+                                      unsigned char* dst ) {
+    uint64_t freq[ 256 ] = { 0 };
+    for( long long i = 0; i < n; ++i ) ++freq[ src[ i * stride ] ];
+
+    int used = 0;
+    int last = 0;
+    for( int s = 0; s < 256; ++s ) {
+        if( !freq[ s ] ) continue;
+        ++used;
+        last = s;
+    }
+
+    if( used == 1 ) {
+        *dst++ = PLANE_CONSTANT;
+        *dst++ = last;
+        return dst;
+    }
+
+    if( used > 1 ) {
+        uint8_t lengths[ 256 ];
+        huffman_lengths( freq, lengths );
+
+        uint64_t bits = 0;
+        for( int s = 0; s < 256; ++s ) bits += freq[ s ] * lengths[ s ];
+        const int64_t bytes = (bits + 7) / 8;
+
+        /*
+         * planes of noise, like the low bytes of floats, barely compress and
+         * are much faster to decode raw, so a code must save at least 1/32
+         */
+        if( (long long)HUFFMAN_OVERHEAD + bytes < 1 + n - n / 32 ) {
+            uint16_t codes[ 256 ];
+            huffman_codes( lengths, codes );
+
+            *dst++ = PLANE_HUFFMAN;
+            for( int k = 0; k < HUFFMAN_LENGTHS_SIZE; ++k )
+                *dst++ = lengths[ 2 * k ] | (lengths[ 2 * k + 1 ] << 4);
+            memcpy( dst, &bytes, sizeof( bytes ) );
+            dst += sizeof( bytes );
+
+            uint64_t acc = 0;
+            int pending = 0;
+            for( long long i = 0; i < n; ++i ) {
+                const int s = src[ i * stride ];
+                acc |= (uint64_t)codes[ s ] << pending;
+                pending += lengths[ s ];
+                while( pending >= 8 ) {
+                    *dst++ = acc & 0xFF;
+                    acc >>= 8;
+                    pending -= 8;
+                }
+            }
+            if( pending > 0 ) *dst++ = acc & 0xFF;
+            return dst;
+        }
+    }
+
+    *dst++ = PLANE_RAW;
+    for( long long i = 0; i < n; ++i ) *dst++ = src[ i * stride ];
+    return dst;
+}
+
+/*
+ * Build the decoding table of a huffman code, indexed by the next
+ * HUFFMAN_MAXBITS bits of the stream. Every entry is
+ *
+ *   first symbol | second symbol << 8 | length of first code << 16
+ *   | length of both codes << 20 | number of symbols << 24
+ *
+ * so that two short codes are decoded with a single lookup. Bit patterns that
+ * are not codes are 0. Returns false if the lengths are not a valid code.
+ */
+static bool huffman_table( const uint8_t* lengths, uint32_t* table ) {
+    /* an over-subscribed code can't be decoded, and is certainly corrupt */
+    long long kraft = 0;
+    for( int s = 0; s < 256; ++s ) {
+        if( lengths[ s ] > HUFFMAN_MAXBITS ) return false;
+        if( lengths[ s ] ) kraft += 1LL << (HUFFMAN_MAXBITS - lengths[ s ]);
+    }
+    if( kraft > (1LL << HUFFMAN_MAXBITS) ) return false;
+
+    uint16_t codes[ 256 ];
+    huffman_codes( lengths, codes );
+
+    memset( table, 0, sizeof( uint32_t ) << HUFFMAN_MAXBITS );
+    for( int s = 0; s < 256; ++s ) {
+        const uint32_t len = lengths[ s ];
+        if( !len ) continue;
+        for( int i = codes[ s ]; i < (1 << HUFFMAN_MAXBITS); i += 1 << len )
+            table[ i ] = s | len << 16 | len << 20 | 1u << 24;
+    }
+
+    /*
+     * The bits after the first code index the second. Only the symbol and
+     * length of the first code are read from the other entries, and those are
+     * never changed here, so the table is extended in place.
+     */
+    for( int i = 0; i < (1 << HUFFMAN_MAXBITS); ++i ) {
+        const uint32_t first = table[ i ];
+        const int len = (first >> 16) & 0xF;
+        if( !len ) continue;
+
+        const uint32_t second = table[ i >> len ];
+        const int len2 = (second >> 16) & 0xF;
+        if( !len2 || len + len2 > HUFFMAN_MAXBITS ) continue;
+
+        table[ i ] = (first & 0xFF)
+                   | (second & 0xFF) << 8
+                   | (uint32_t)len << 16
+                   | (uint32_t)( len + len2 ) << 20
+                   | 2u << 24;
+    }
+
+    return true;
+}
+
+/*
+ * Blocks are decoded DECODE_CHUNK samples at a time. Every plane is decoded
+ * into a small buffer of its own, and the buffers are then interleaved into
+ * the samples, so neither the huffman decoder nor the interleaving strides
+ * through memory.
+ */
+#define DECODE_CHUNK 4096
+
+struct plane_decoder {
+    int kind;
+    const unsigned char* src;   /* the raw bytes, the constant or the stream */
+    const unsigned char* end;   /* end of the huffman stream */
+    uint64_t acc;
+    int bits;
+    const uint32_t* table;
+};
+
+struct decode_work {
+    uint32_t tables[ 8 ][ 1 << HUFFMAN_MAXBITS ];
+    unsigned char planes[ 8 ][ DECODE_CHUNK ];
+};
+
+/*
+ * Set up the decoder of a plane of n bytes, and return the end of the plane
+ * in src, or NULL if the plane is corrupt.
+ */
+static const unsigned char* plane_decoder_init( struct plane_decoder* d,
+                                                const unsigned char* src,
+                                                const unsigned char* end,
+                                                long long n,
+                                                uint32_t* table ) {
+    if( src >= end ) return NULL;
+
+    memset( d, 0, sizeof( *d ) );
+    d->kind = *src++;
+    d->src = src;
+
+    switch( d->kind ) {
+        case PLANE_CONSTANT:
+            if( src >= end ) return NULL;
+            return src + 1;
+
+        case PLANE_RAW:
+            if( end - src < n ) return NULL;
+            return src + n;
+
+        case PLANE_HUFFMAN:
+            break;
+
+        default:
+            return NULL;
+    }
+
+    if( end - src < (long long)HUFFMAN_OVERHEAD - 1 ) return NULL;
+
+    uint8_t lengths[ 256 ];
+    for( int k = 0; k < HUFFMAN_LENGTHS_SIZE; ++k ) {
+        lengths[ 2 * k ]     = src[ k ] & 0x0F;
+        lengths[ 2 * k + 1 ] = src[ k ] >> 4;
+    }
+    src += HUFFMAN_LENGTHS_SIZE;
+
+    int64_t bytes;
+    memcpy( &bytes, src, sizeof( bytes ) );
+    src += sizeof( bytes );
+    if( bytes < 0 || end - src < bytes ) return NULL;
+
+    if( !huffman_table( lengths, table ) ) return NULL;
+
+    d->src = src;
+    d->end = src + bytes;
+    d->table = table;
+    return d->end;
+}
+
+/*
+ * Decode the next n bytes of the plane into dst. Returns false if the plane
+ * is corrupt.
+ */
+static bool plane_decode( struct plane_decoder* d,
+                          unsigned char* dst,
+                          int n ) {
+    switch( d->kind ) {
+        case PLANE_CONSTANT:
+            memset( dst, *d->src, n );
+            return true;
+
+        case PLANE_RAW:
+            memcpy( dst, d->src, n );
+            d->src += n;
+            return true;
+
+        default:
+            break;
+    }
+
+    const uint32_t* table = d->table;
+    const uint32_t mask = (1 << HUFFMAN_MAXBITS) - 1;
+    const unsigned char* in = d->src;
+    uint64_t acc = d->acc;
+    int bits = d->bits;
+    int i = 0;
+
+    /*
+     * While there are 8 bytes left of the stream, refill to at least 56 bits
+     * with a single load, which is enough for four lookups of up to two
+     * symbols each. The bits above the count are the next bits of the stream,
+     * so or'ing them in again on the next refill doesn't change them.
+     */
+    while( i + 8 <= n && d->end - in >= 8 ) {
+        uint64_t next;
+        memcpy( &next, in, sizeof( next ) );
+#if HOST_MSB
+        next = bswap64( next );
+#endif
+        acc |= next << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+
+        uint32_t valid = 1;
+        for( int k = 0; k < 4; ++k ) {
+            const uint32_t e = table[ acc & mask ];
+            const int len = (e >> 20) & 0xF;
+            dst[ i ]     = e & 0xFF;
+            dst[ i + 1 ] = (e >> 8) & 0xFF;
+            acc >>= len;
+            bits -= len;
+            i += e >> 24;
+            valid &= e != 0;
+        }
+
+        if( !valid ) return false;
+    }
+
+    /* the end of the stream, a byte and a symbol at a time */
+    for( ; i < n; ++i ) {
+        while( bits < 56 && in < d->end ) {
+            acc |= (uint64_t)*in++ << bits;
+            bits += 8;
+        }
+
+        const uint32_t e = table[ acc & mask ];
+        const int len = (e >> 16) & 0xF;
+        if( len == 0 || len > bits ) return false;
+
+        dst[ i ] = e & 0xFF;
+        acc >>= len;
+        bits -= len;
+    }
+
+    d->src = in;
+    d->acc = acc;
+    d->bits = bits;
+    return true;
+}
+
+#ifdef SEGY_X86_SIMD
+/*
+ * Interleave the planes into samples, 16 samples at a time. SSE2 is a part of
+ * x86-64, so this needs no dispatch. Returns the number of samples
+ * interleaved, the rest is left to unshuffle.
+ */
+SEGY_TARGET("sse2")
+static int unshuffle_sse2( unsigned char planes[][ DECODE_CHUNK ],
+                           int n,
+                           int elemsize,
+                           unsigned char* dst ) {
+    int i = 0;
+
+#define SEGY_LOADPLANE(k) \
+    _mm_loadu_si128( (const __m128i*)( planes[ (k) ] + i ) )
+#define SEGY_STORE(k, x) \
+    _mm_storeu_si128( (__m128i*)( out + 16 * (k) ), (x) )
+
+    switch( elemsize ) {
+        case 2:
+            for( ; i + 16 <= n; i += 16 ) {
+                unsigned char* out = dst + 2 * i;
+                const __m128i p0 = SEGY_LOADPLANE( 0 );
+                const __m128i p1 = SEGY_LOADPLANE( 1 );
+                SEGY_STORE( 0, _mm_unpacklo_epi8( p0, p1 ) );
+                SEGY_STORE( 1, _mm_unpackhi_epi8( p0, p1 ) );
+            }
+            break;
+
+        case 4:
+            for( ; i + 16 <= n; i += 16 ) {
+                unsigned char* out = dst + 4 * i;
+                const __m128i p0 = SEGY_LOADPLANE( 0 );
+                const __m128i p1 = SEGY_LOADPLANE( 1 );
+                const __m128i p2 = SEGY_LOADPLANE( 2 );
+                const __m128i p3 = SEGY_LOADPLANE( 3 );
+                const __m128i lo01 = _mm_unpacklo_epi8( p0, p1 );
+                const __m128i hi01 = _mm_unpackhi_epi8( p0, p1 );
+                const __m128i lo23 = _mm_unpacklo_epi8( p2, p3 );
+                const __m128i hi23 = _mm_unpackhi_epi8( p2, p3 );
+                SEGY_STORE( 0, _mm_unpacklo_epi16( lo01, lo23 ) );
+                SEGY_STORE( 1, _mm_unpackhi_epi16( lo01, lo23 ) );
+                SEGY_STORE( 2, _mm_unpacklo_epi16( hi01, hi23 ) );
+                SEGY_STORE( 3, _mm_unpackhi_epi16( hi01, hi23 ) );
+            }
+            break;
+
+        case 8:
+            for( ; i + 16 <= n; i += 16 ) {
+                unsigned char* out = dst + 8 * i;
+                __m128i x[ 8 ], y[ 8 ];
+                for( int k = 0; k < 8; ++k ) x[ k ] = SEGY_LOADPLANE( k );
+
+                /* pairs of bytes, quads of bytes, then whole samples */
+                for( int k = 0; k < 4; ++k ) {
+                    const __m128i a = x[ 2 * k ], b = x[ 2 * k + 1 ];
+                    y[ 2 * k ]     = _mm_unpacklo_epi8( a, b );
+                    y[ 2 * k + 1 ] = _mm_unpackhi_epi8( a, b );
+                }
+                for( int k = 0; k < 2; ++k ) {
+                    const __m128i* z = y + 4 * k;
+                    x[ 4 * k ]     = _mm_unpacklo_epi16( z[ 0 ], z[ 2 ] );
+                    x[ 4 * k + 1 ] = _mm_unpackhi_epi16( z[ 0 ], z[ 2 ] );
+                    x[ 4 * k + 2 ] = _mm_unpacklo_epi16( z[ 1 ], z[ 3 ] );
+                    x[ 4 * k + 3 ] = _mm_unpackhi_epi16( z[ 1 ], z[ 3 ] );
+                }
+                for( int k = 0; k < 4; ++k ) {
+                    SEGY_STORE( 2 * k,     _mm_unpacklo_epi32( x[ k ],
+                                                               x[ k + 4 ] ) );
+                    SEGY_STORE( 2 * k + 1, _mm_unpackhi_epi32( x[ k ],
+                                                               x[ k + 4 ] ) );
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+#undef SEGY_STORE
+#undef SEGY_LOADPLANE
+
+    return i;
+}
+#endif // SEGY_X86_SIMD
+
+/*
+ * Interleave n bytes from each of the elemsize planes into n samples in dst
+ */
+static void unshuffle( unsigned char planes[][ DECODE_CHUNK ],
+                       int n,
+                       int elemsize,
+                       unsigned char* dst ) {
+    int i = 0;
+#ifdef SEGY_X86_SIMD
+    i = unshuffle_sse2( planes, n, elemsize, dst );
+#endif
+
+    for( ; i < n; ++i )
+        for( int j = 0; j < elemsize; ++j )
+            dst[ i * elemsize + j ] = planes[ j ][ i ];
+}
+
+/*
+ * Quantise samples to multiples of step, and store the zig-zag encoded
+ * differences between consecutive quanta. Returns false if some sample can't
+ * be quantised, e.g. because it's not finite.
+ */
+static bool quantise( const float* src,
+                      long long n,
+                      double step,
+                      uint32_t* dst ) {
+    const double limit = 1 << 29;
+    int64_t prev = 0;
+
+    for( long long i = 0; i < n; ++i ) {
+        const double x = src[ i ] / step;
+        if( !(fabs( x ) < limit) ) return false;
+
+        const int64_t q = (int64_t)floor( x + 0.5 );
+        const int64_t d = q - prev;
+        prev = q;
+        dst[ i ] = d >= 0 ? (uint32_t)( 2 * d ) : (uint32_t)( -2 * d - 1 );
+    }
+
+    return true;
+}
+
+/*
+ * Dequantise n samples in place. last is the quantum of the sample before
+ * buf, which is updated, so that a block can be dequantised in parts.
  */
+static void dequantise( void* buf, long long n, double step, int64_t* last ) {
+    char* xs = (char*)buf;
+    int64_t prev = *last;
+
+    for( long long i = 0; i < n; ++i ) {
+        uint32_t z;
+        memcpy( &z, xs + i * sizeof( z ), sizeof( z ) );
+        prev += (z & 1) ? -(int64_t)( z >> 1 ) - 1 : (int64_t)( z >> 1 );
+
+        const float x = prev * step;
+        memcpy( xs + i * sizeof( x ), &x, sizeof( x ) );
+    }
+
+    *last = prev;
+}
+
+static bool codec_elemsize( int elemsize ) {
+    return elemsize == 1 || elemsize == 2 || elemsize == 4 || elemsize == 8;
+}
+
+long long segy_compress_bound( long long samples, int elemsize ) {
+    if( samples < 0 || !codec_elemsize( elemsize ) ) return -1;
+    return 2 + sizeof( double ) + elemsize * (samples + 1);
+}
+
+int segy_compress( const void* src,
+                   long long samples,
+                   int elemsize,
+                   double tolerance,
+                   void* dst,
+                   long long* size ) {
+
+    if( samples < 0 || !codec_elemsize( elemsize ) ) return SEGY_INVALID_ARGS;
+    if( !(tolerance >= 0) ) return SEGY_INVALID_ARGS;
+    if( tolerance > 0 && elemsize != sizeof( float ) ) return SEGY_INVALID_ARGS;
+
+    const unsigned char* in = (const unsigned char*)src;
+    unsigned char* out = (unsigned char*)dst;
+    uint32_t* quanta = NULL;
+    const double step = 2 * tolerance;
+
+    int method = CODEC_SHUFFLE;
+    if( tolerance > 0 ) {
+        quanta = malloc( samples * sizeof( uint32_t ) + 1 );
+        if( !quanta ) return SEGY_MEMORY_ERROR;
+
+        if( quantise( (const float*)src, samples, step, quanta ) ) {
+            method = CODEC_QUANTISED;
+            in = (const unsigned char*)quanta;
+        }
+    }
+
+    *out++ = method;
+    *out++ = elemsize;
+    if( method == CODEC_QUANTISED ) {
+        memcpy( out, &step, sizeof( step ) );
+        out += sizeof( step );
+    }
+
+    for( int j = 0; j < elemsize; ++j )
+        out = compress_plane( in + j, samples, elemsize, out );
+
+    free( quanta );
+    *size = out - (unsigned char*)dst;
+    return SEGY_OK;
+}
+
+/*
+ * segy_decompress with the caller's workspace, so that many blocks can be
+ * decompressed without allocating for every one
+ */
+static int decompress_block( const void* src,
+                             long long size,
+                             long long samples,
+                             int elemsize,
+                             void* dst,
+                             struct decode_work* work ) {
+
+    if( samples < 0 || !codec_elemsize( elemsize ) ) return SEGY_INVALID_ARGS;
+    if( size < 2 ) return SEGY_INVALID_ARGS;
+
+    const unsigned char* in = (const unsigned char*)src;
+    const unsigned char* end = in + size;
+    unsigned char* out = (unsigned char*)dst;
+
+    const int method = *in++;
+    if( *in++ != elemsize ) return SEGY_INVALID_ARGS;
+
+    double step = 0;
+    if( method == CODEC_QUANTISED ) {
+        if( elemsize != sizeof( float ) ) return SEGY_INVALID_ARGS;
+        if( end - in < (long long)sizeof( step ) ) return SEGY_INVALID_ARGS;
+        memcpy( &step, in, sizeof( step ) );
+        in += sizeof( step );
+    }
+    else if( method != CODEC_SHUFFLE ) return SEGY_INVALID_ARGS;
+
+    struct plane_decoder planes[ 8 ];
+    for( int j = 0; j < elemsize; ++j ) {
+        in = plane_decoder_init( planes + j, in, end, samples,
+                                 work->tables[ j ] );
+        if( !in ) return SEGY_INVALID_ARGS;
+    }
+
+    if( in != end ) return SEGY_INVALID_ARGS;
+
+    int64_t quantum = 0;
+    for( long long i = 0; i < samples; i += DECODE_CHUNK ) {
+        const int n = samples - i < DECODE_CHUNK
+                    ? (int)( samples - i )
+                    : DECODE_CHUNK;
+
+        if( elemsize == 1 ) {
+            if( !plane_decode( planes, out + i, n ) ) return SEGY_INVALID_ARGS;
+            continue;
+        }
+
+        for( int j = 0; j < elemsize; ++j ) {
+            if( !plane_decode( planes + j, work->planes[ j ], n ) )
+                return SEGY_INVALID_ARGS;
+        }
+
+        unshuffle( work->planes, n, elemsize, out + i * elemsize );
+
+        /* while the chunk is still in cache */
+        if( method == CODEC_QUANTISED )
+            dequantise( out + i * elemsize, n, step, &quantum );
+    }
+
+    return SEGY_OK;
+}
+
+int segy_decompress( const void* src,
+                     long long size,
+                     long long samples,
+                     int elemsize,
+                     void* dst ) {
+
+    struct decode_work* work = malloc( sizeof( struct decode_work ) );
+    if( !work ) return SEGY_MEMORY_ERROR;
+
+    const int err = decompress_block( src, size, samples, elemsize, dst, work );
+    free( work );
+    return err;
+}
+
+/*
+ * The brick cache is a header followed by the bricks. A brick is a cube of
+ * bricksize^3 samples, in native format and byte order, ordered
+ * [line][trace-in-line][sample]. Bricks on the edges of the volume are padded
+ * with zeros to full size, so every brick has the same size and is found by
+ * simple arithmetic. The bricks are ordered by offset, line, trace-in-line
+ * and sample, i.e. like the traces of the file.
+ *
+ * The header is the magic string, followed by native int32s: a byte order
+ * mark, format, element size, lines, line length, offsets, samples, brick
+ * size and compression, and at byte 48 the tolerance as a native double and
+ * at byte 56 the size of the file the cache was built from as a native int64.
+ *
+ * Compressed bricks vary in size, so the header of a compressed cache is
+ * followed by a table of native int64 file positions, one for every brick and
+ * one for the end of the last, and brick i is the bytes [table[i],
+ * table[i+1]).
+ */
+#define BRICK_MAGIC "SEGYBRK1"
+#define BRICK_HEADER_SIZE 64
+#define BRICK_BOM 0x01020304
+#define BRICK_TOLERANCE_POS 48
+#define BRICK_SOURCE_SIZE_POS 56
+
+struct segy_brick_handle {
+    segy_file* fp;
+    int format;
+    int elemsize;
+    int lines;
+    int line_length;
+    int offsets;
+    int samples;
+    int bricksize;
+    int compression;
+    long long source_size;
+    int64_t* table;
+    char* packed;
+    char* scratch;
+    struct decode_work* work;
+};
+
+static long long brick_count( int n, int bricksize ) {
+    return (n + bricksize - 1) / bricksize;
+}
+
+static long long brick_total( int lines,
+                              int line_length,
+                              int offsets,
+                              int samples,
+                              int bricksize ) {
+    return offsets
+         * brick_count( lines, bricksize )
+         * brick_count( line_length, bricksize )
+         * brick_count( samples, bricksize );
+}
+
+static long long brick_index( const segy_bricks* b,
+                              int offset,
+                              int bl,
+                              int bt,
+                              int bz ) {
+    const long long nl = brick_count( b->lines, b->bricksize );
+    const long long nt = brick_count( b->line_length, b->bricksize );
+    const long long nz = brick_count( b->samples, b->bricksize );
+    return ((offset * nl + bl) * nt + bt) * nz + bz;
+}
+
+int segy_brick_build( segy_file* fp,
+                      const char* path,
+                      int lines,
+                      int line_length,
+                      int offsets,
+                      int bricksize,
+                      int compression,
+                      double tolerance,
+                      int format,
+                      long trace0,
+                      int trace_bsize ) {
+
+    const int elemsize = formatsize( format );
+    if( elemsize != fp->elemsize ) return SEGY_INVALID_ARGS;
+    if( lines < 1 || line_length < 1 || offsets < 1 ) return SEGY_INVALID_ARGS;
+    if( bricksize < 1 ) return SEGY_INVALID_ARGS;
+
+    switch( compression ) {
+        case SEGY_UNCOMPRESSED:
+        case SEGY_LOSSLESS:
+            tolerance = 0;
+            break;
+
+        case SEGY_LOSSY:
+            if( !(tolerance > 0) ) return SEGY_INVALID_ARGS;
+            /* only IEEE floats are quantised, and ibm is native float */
+            if( format != SEGY_IBM_FLOAT_4_BYTE
+             && format != SEGY_IEEE_FLOAT_4_BYTE )
+                return SEGY_INVALID_ARGS;
+            break;
 
-static int segy_native_byteswap(int format, long long size, void* buf) {
+        default:
+            return SEGY_INVALID_ARGS;
+    }
 
-    if (HOST_LSB) {
-        const int elemsize = formatsize( format );
+    long long size;
+    const int sizeerr = handle_size( fp, &size );
+    if( sizeerr != SEGY_OK ) return sizeerr;
+    const int64_t source_size = size;
+
+    const int samples = trace_bsize / elemsize;
+    const long long B = bricksize;
+    const long long brickbytes = B * B * B * elemsize;
+    const long long count = brick_total( lines, line_length, offsets,
+                                         samples, bricksize );
+
+    int32_t header[ BRICK_HEADER_SIZE / sizeof( int32_t ) ] = { 0 };
+    memcpy( header, BRICK_MAGIC, 8 );
+    header[ 2 ] = BRICK_BOM;
+    header[ 3 ] = format;
+    header[ 4 ] = elemsize;
+    header[ 5 ] = lines;
+    header[ 6 ] = line_length;
+    header[ 7 ] = offsets;
+    header[ 8 ] = samples;
+    header[ 9 ] = bricksize;
+    header[ 10 ] = compression;
+    memcpy( (char*)header + BRICK_TOLERANCE_POS, &tolerance, sizeof( double ) );
+    memcpy( (char*)header + BRICK_SOURCE_SIZE_POS, &source_size,
+            sizeof( source_size ) );
+
+    const bool compressed = compression != SEGY_UNCOMPRESSED;
+    const long long packedbytes = segy_compress_bound( B * B * B, elemsize );
+
+    /* a column of bricksize x bricksize traces is read at a time */
+    int64_t* tracenos = malloc( B * B * sizeof( int64_t ) );
+    char* traces = malloc( B * B * trace_bsize );
+    char* brick = malloc( brickbytes );
+    int64_t* table = compressed ? calloc( count + 1, sizeof( int64_t ) ) : NULL;
+    char* packed = compressed ? malloc( packedbytes ) : NULL;
+
+    segy_file* out = segy_open( path, "wb" );
+    int err = SEGY_OK;
+    if( !tracenos || !traces || !brick ) err = SEGY_MEMORY_ERROR;
+    else if( compressed && (!table || !packed) ) err = SEGY_MEMORY_ERROR;
+    else if( !out ) err = SEGY_FOPEN_ERROR;
+    else if( fwrite( header, BRICK_HEADER_SIZE, 1, out->fp ) != 1 )
+        err = SEGY_FWRITE_ERROR;
+    /* the table is written as a placeholder, and filled in at the end */
+    else if( compressed
+          && fwrite( table, sizeof( int64_t ), count + 1, out->fp ) != (size_t)count + 1 )
+        err = SEGY_FWRITE_ERROR;
+
+    long long brickno = 0;
+    int64_t pos = BRICK_HEADER_SIZE + (compressed ? (count + 1) * 8 : 0);
+
+    const int nl = brick_count( lines, bricksize );
+    const int nt = brick_count( line_length, bricksize );
+    const int nz = brick_count( samples, bricksize );
+
+    for( int o = 0; o < offsets && err == SEGY_OK; ++o )
+    for( int bl = 0; bl < nl && err == SEGY_OK; ++bl )
+    for( int bt = 0; bt < nt && err == SEGY_OK; ++bt ) {
+        const int l0 = bl * bricksize;
+        const int t0 = bt * bricksize;
+        const int ls = lines - l0 < bricksize ? lines - l0 : bricksize;
+        const int ts = line_length - t0 < bricksize
+                     ? line_length - t0
+                     : bricksize;
+
+        for( int l = 0; l < ls; ++l ) {
+            for( int t = 0; t < ts; ++t ) {
+                const long long line = (long long)l0 + l;
+                tracenos[ l * ts + t ] = (line * line_length + t0 + t)
+                                       * offsets + o;
+            }
+        }
 
-        switch (elemsize) {
-            case 8: bswap64vec(buf, size); break;
-            case 4: bswap32vec(buf, size); break;
-            case 3: bswap24vec(buf, size); break;
-            case 2: bswap16vec(buf, size); break;
-            default:                       break;
+        err = segy_readtraces_native( fp, tracenos, (long long)ls * ts,
+                                      scan_max_gap, format,
+                                      SEGY_AS_NATIVE, 1.0, 0.0,
+                                      traces, trace0, trace_bsize );
+        if( err != SEGY_OK ) break;
+
+        for( int bz = 0; bz < nz && err == SEGY_OK; ++bz ) {
+            const int z0 = bz * bricksize;
+            const int zs = samples - z0 < bricksize ? samples - z0 : bricksize;
+
+            if( ls < bricksize || ts < bricksize || zs < bricksize )
+                memset( brick, 0, brickbytes );
+
+            for( int l = 0; l < ls; ++l ) {
+                for( int t = 0; t < ts; ++t ) {
+                    const long long trace = (long long)l * ts + t;
+                    memcpy( brick + ((l * B + t) * B) * elemsize,
+                            traces + (trace * samples + z0) * elemsize,
+                            (size_t)zs * elemsize );
+                }
+            }
+
+            const char* data = brick;
+            long long size = brickbytes;
+            if( compressed ) {
+                err = segy_compress( brick, B * B * B, elemsize, tolerance,
+                                     packed, &size );
+                if( err != SEGY_OK ) break;
+                data = packed;
+                table[ brickno++ ] = pos;
+                pos += size;
+            }
+
+            if( fwrite( data, size, 1, out->fp ) != 1 )
+                err = SEGY_FWRITE_ERROR;
         }
     }
 
-    return SEGY_OK;
+    if( err == SEGY_OK && compressed ) {
+        table[ count ] = pos;
+        if( fseek( out->fp, BRICK_HEADER_SIZE, SEEK_SET ) != 0 )
+            err = SEGY_FSEEK_ERROR;
+        else if( fwrite( table, sizeof( int64_t ), count + 1, out->fp )
+                 != (size_t)count + 1 )
+            err = SEGY_FWRITE_ERROR;
+    }
+
+    if( out && segy_close( out ) != SEGY_OK && err == SEGY_OK )
+        err = SEGY_FWRITE_ERROR;
+
+    free( packed );
+    free( table );
+    free( brick );
+    free( traces );
+    free( tracenos );
+    return err;
 }
 
-int segy_to_native( int format,
-                    long long size,
-                    void* buf ) {
+segy_bricks* segy_brick_open( const char* path ) {
+    segy_file* fp = segy_open( path, "rb" );
+    if( !fp ) return NULL;
 
-    const int elemsize = formatsize( format );
-    if( elemsize < 0 ) return SEGY_INVALID_ARGS;
+    int32_t header[ BRICK_HEADER_SIZE / sizeof( int32_t ) ];
+    segy_bricks* b = calloc( 1, sizeof( segy_bricks ) );
+    if( !b ) goto fail;
+    b->fp = fp;
+
+    if( pread_at( fp, header, 0, BRICK_HEADER_SIZE ) != SEGY_OK ) goto fail;
+    if( memcmp( header, BRICK_MAGIC, 8 ) != 0 ) goto fail;
+    if( header[ 2 ] != BRICK_BOM ) goto fail;
+
+    b->format      = header[ 3 ];
+    b->elemsize    = header[ 4 ];
+    b->lines       = header[ 5 ];
+    b->line_length = header[ 6 ];
+    b->offsets     = header[ 7 ];
+    b->samples     = header[ 8 ];
+    b->bricksize   = header[ 9 ];
+    b->compression = header[ 10 ];
+
+    int64_t source_size;
+    memcpy( &source_size, (char*)header + BRICK_SOURCE_SIZE_POS,
+            sizeof( source_size ) );
+    b->source_size = source_size;
+
+    if( formatsize( b->format ) != b->elemsize ) goto fail;
+    if( b->lines < 1 || b->line_length < 1 || b->offsets < 1 ) goto fail;
+    if( b->samples < 1 || b->bricksize < 1 ) goto fail;
+    if( b->compression < SEGY_UNCOMPRESSED || b->compression > SEGY_LOSSY )
+        goto fail;
+
+    const long long B = b->bricksize;
+    b->scratch = malloc( B * B * B * b->elemsize );
+    if( !b->scratch ) goto fail;
+
+    if( b->compression != SEGY_UNCOMPRESSED ) {
+        const long long count = brick_total( b->lines,
+                                             b->line_length,
+                                             b->offsets,
+                                             b->samples,
+                                             b->bricksize );
+
+        b->table = malloc( (count + 1) * sizeof( int64_t ) );
+        b->packed = malloc( segy_compress_bound( B * B * B, b->elemsize ) );
+        b->work = malloc( sizeof( struct decode_work ) );
+        if( !b->table || !b->packed || !b->work ) goto fail;
+
+        if( pread_at( fp, b->table, BRICK_HEADER_SIZE,
+                      (count + 1) * sizeof( int64_t ) ) != SEGY_OK )
+            goto fail;
+    }
+
+    /* bricks are read at random, so mmap if possible, but it's not required */
+    segy_mmap( fp );
+    return b;
+
+fail:
+    segy_close( fp );
+    if( b ) {
+        free( b->work );
+        free( b->packed );
+        free( b->table );
+        free( b->scratch );
+    }
+    free( b );
+    return NULL;
+}
+
+int segy_brick_geometry( const segy_bricks* b,
+                         int* lines,
+                         int* line_length,
+                         int* offsets,
+                         int* samples,
+                         int* format,
+                         int* bricksize ) {
+    *lines       = b->lines;
+    *line_length = b->line_length;
+    *offsets     = b->offsets;
+    *samples     = b->samples;
+    *format      = b->format;
+    *bricksize   = b->bricksize;
+    return SEGY_OK;
+}
 
-    segy_native_byteswap( format, size, buf );
+int segy_brick_source_size( const segy_bricks* b, long long* size ) {
+    *size = b->source_size;
+    return SEGY_OK;
+}
 
+int segy_brick_read( segy_bricks* b,
+                     int offset,
+                     int line0,
+                     int line1,
+                     int pos0,
+                     int pos1,
+                     int s0,
+                     int s1,
+                     void* buf ) {
+
+    if( offset < 0 || offset >= b->offsets ) return SEGY_INVALID_ARGS;
+    if( line0 < 0 || line0 > line1 || line1 > b->lines )
+        return SEGY_INVALID_ARGS;
+    if( pos0 < 0 || pos0 > pos1 || pos1 > b->line_length )
+        return SEGY_INVALID_ARGS;
+    if( s0 < 0 || s0 > s1 || s1 > b->samples )
+        return SEGY_INVALID_ARGS;
+
+    if( line0 == line1 || pos0 == pos1 || s0 == s1 ) return SEGY_OK;
+
+    const int B = b->bricksize;
+    const int elemsize = b->elemsize;
+    const long long brickbytes = (long long)B * B * B * elemsize;
+    const long long width = pos1 - pos0;
+    const long long window = s1 - s0;
     char* dst = (char*)buf;
-    if( format == SEGY_IBM_FLOAT_4_BYTE ) {
-        for( long long i = 0; i < size; ++i )
-            ibm_native( dst + i * elemsize );
+
+    for( int bl = line0 / B; bl <= (line1 - 1) / B; ++bl )
+    for( int bt = pos0 / B;  bt <= (pos1 - 1) / B;  ++bt )
+    for( int bz = s0 / B;    bz <= (s1 - 1) / B;    ++bz ) {
+        /* the part of the box inside this brick, in brick coordinates */
+        const int la = line0 > bl * B ? line0 - bl * B : 0;
+        const int ta = pos0  > bt * B ? pos0  - bt * B : 0;
+        const int za = s0    > bz * B ? s0    - bz * B : 0;
+        const int lb = line1 < (bl + 1) * B ? line1 - bl * B : B;
+        const int tb = pos1  < (bt + 1) * B ? pos1  - bt * B : B;
+        const int zb = s1    < (bz + 1) * B ? s1    - bz * B : B;
+
+        const long long brick = brick_index( b, offset, bl, bt, bz );
+
+        if( b->compression == SEGY_UNCOMPRESSED ) {
+            /*
+             * Read only the rows of the box, into their place in scratch.
+             * Rows next to each other in the brick are read together, i.e.
+             * the rows of a line when the box spans all samples of the brick,
+             * and the whole box when it spans all its traces too.
+             */
+            long long run = zb - za;
+            int rows = tb - ta;
+            int lines = lb - la;
+            if( za == 0 && zb == B ) {
+                run *= rows;
+                rows = 1;
+                if( ta == 0 && tb == B ) {
+                    run *= lines;
+                    lines = 1;
+                }
+            }
+
+            const long long pos = BRICK_HEADER_SIZE + brick * brickbytes;
+            for( int l = la; l < la + lines; ++l ) {
+                for( int t = ta; t < ta + rows; ++t ) {
+                    const long long at = ((long long)l * B + t) * B + za;
+                    const int err = pread_at( b->fp,
+                                              b->scratch + at * elemsize,
+                                              pos + at * elemsize,
+                                              (size_t)( run * elemsize ) );
+                    if( err != SEGY_OK ) return err;
+                }
+            }
+        }
+        else {
+            const long long size = b->table[ brick + 1 ] - b->table[ brick ];
+            const long long bound = segy_compress_bound( (long long)B * B * B,
+                                                         elemsize );
+            if( size < 0 || size > bound ) return SEGY_INVALID_ARGS;
+
+            int err = pread_at( b->fp, b->packed, b->table[ brick ], size );
+            if( err != SEGY_OK ) return err;
+
+            err = decompress_block( b->packed, size, (long long)B * B * B,
+                                    elemsize, b->scratch, b->work );
+            if( err != SEGY_OK ) return err;
+        }
+
+        for( int l = la; l < lb; ++l ) {
+            for( int t = ta; t < tb; ++t ) {
+                const long long src = ((long long)l * B + t) * B + za;
+                const long long line = (long long)bl * B + l - line0;
+                const long long trace = (long long)bt * B + t - pos0;
+                const long long z = (long long)bz * B + za - s0;
+                memcpy( dst + ((line * width + trace) * window + z) * elemsize,
+                        b->scratch + src * elemsize,
+                        (size_t)(zb - za) * elemsize );
+            }
+        }
     }
 
     return SEGY_OK;
 }
 
-int segy_from_native( int format,
-                      long long size,
-                      void* buf ) {
+int segy_brick_close( segy_bricks* b ) {
+    if( !b ) return SEGY_OK;
+
+    const int err = segy_close( b->fp );
+    free( b->work );
+    free( b->packed );
+    free( b->table );
+    free( b->scratch );
+    free( b );
+    return err;
+}
+
+int segy_container_build( segy_file* fp,
+                          const char* path,
+                          int compression,
+                          double tolerance,
+                          int block_traces,
+                          int format,
+                          long trace0,
+                          int trace_bsize ) {
 
     const int elemsize = formatsize( format );
-    if( elemsize < 0 ) return SEGY_INVALID_ARGS;
+    if( elemsize < 0 || block_traces < 1 ) return SEGY_INVALID_ARGS;
+    if( trace0 < 0 || trace_bsize < 0 || trace_bsize % elemsize != 0 )
+        return SEGY_INVALID_ARGS;
 
-    char* dst = (char*)buf;
-    if( format == SEGY_IBM_FLOAT_4_BYTE ) {
-        for( long long i = 0; i < size; ++i )
-            native_ibm( dst + i * elemsize );
+    switch( compression ) {
+        case SEGY_LOSSLESS:
+            tolerance = 0;
+            break;
+
+        case SEGY_LOSSY:
+            if( !(tolerance > 0) ) return SEGY_INVALID_ARGS;
+            if( format != SEGY_IBM_FLOAT_4_BYTE
+             && format != SEGY_IEEE_FLOAT_4_BYTE )
+                return SEGY_INVALID_ARGS;
+            break;
+
+        default:
+            return SEGY_INVALID_ARGS;
     }
 
-    return segy_native_byteswap( format, size, buf );
+    int count;
+    int err = segy_traces( fp, &count, trace0, trace_bsize );
+    if( err != SEGY_OK ) return err;
+
+    const int64_t traces = count;
+    const int samples = trace_bsize / elemsize;
+    const long long tracesize = SEGY_TRACE_HEADER_SIZE + trace_bsize;
+    const long long blocks = (traces + block_traces - 1) / block_traces;
+    const long long positions = 2 * blocks + 1;
+    const int codec = compression == SEGY_LOSSY ? (int)sizeof( float )
+                    : elemsize == 3             ? 1
+                    : elemsize;
+
+    int32_t header[ CONTAINER_HEADER_SIZE / sizeof( int32_t ) ] = { 0 };
+    memcpy( header, CONTAINER_MAGIC, 8 );
+    header[ 2 ] = CONTAINER_BOM;
+    header[ 3 ] = format;
+    header[ 4 ] = elemsize;
+    header[ 5 ] = samples;
+    header[ 6 ] = block_traces;
+    header[ 7 ] = compression;
+    header[ 8 ] = fp->lsb;
+    const int64_t first = trace0;
+    char* pos = (char*)header + CONTAINER_TRACE0_POS;
+    memcpy( pos, &first, sizeof( first ) );
+    memcpy( pos + sizeof( first ), &traces, sizeof( traces ) );
+    memcpy( (char*)header + CONTAINER_TOLERANCE_POS, &tolerance,
+            sizeof( tolerance ) );
+
+    /* headers and samples of a block are gathered into one buffer each */
+    const long long hcount = block_traces * SEGY_TRACE_HEADER_SIZE
+                           / (long long)sizeof( int32_t );
+    const long long scount = block_traces * (long long)trace_bsize / codec;
+    const long long hbound = segy_compress_bound( hcount, sizeof( int32_t ) );
+    const long long sbound = segy_compress_bound( scount, codec );
+
+    char* prefix = malloc( trace0 > 0 ? trace0 : 1 );
+    char* raw = malloc( block_traces * tracesize );
+    char* gathered = malloc( block_traces * tracesize );
+    char* packed = malloc( hbound > sbound ? hbound : sbound );
+    int64_t* table = calloc( positions, sizeof( int64_t ) );
+
+    segy_file* out = segy_open( path, "wb" );
+    if( !prefix || !raw || !gathered || !packed || !table )
+        err = SEGY_MEMORY_ERROR;
+    else if( !out ) err = SEGY_FOPEN_ERROR;
+    else err = pread_at( fp, prefix, 0, trace0 );
+
+    /* the table is written as a placeholder, and filled in at the end */
+    if( err == SEGY_OK
+     && ( fwrite( header, CONTAINER_HEADER_SIZE, 1, out->fp ) != 1
+       || fwrite( prefix, 1, trace0, out->fp ) != (size_t)trace0
+       || fwrite( table, sizeof( int64_t ), positions, out->fp )
+          != (size_t)positions ) )
+        err = SEGY_FWRITE_ERROR;
+
+    int64_t offset = CONTAINER_HEADER_SIZE + trace0 + positions * 8;
+
+    for( long long b = 0; b < blocks && err == SEGY_OK; ++b ) {
+        const long long start = b * block_traces;
+        const long long n = traces - start < block_traces
+                          ? traces - start
+                          : block_traces;
+
+        err = pread_at( fp, raw, trace0 + start * tracesize, n * tracesize );
+        if( err != SEGY_OK ) break;
+
+        char* headers = gathered;
+        char* data = gathered + n * SEGY_TRACE_HEADER_SIZE;
+        for( long long t = 0; t < n; ++t ) {
+            const char* src = raw + t * tracesize;
+            memcpy( headers + t * SEGY_TRACE_HEADER_SIZE, src,
+                    SEGY_TRACE_HEADER_SIZE );
+            memcpy( data + t * trace_bsize, src + SEGY_TRACE_HEADER_SIZE,
+                    trace_bsize );
+        }
+
+        if( compression == SEGY_LOSSY ) {
+            err = convert_native( format, fp->lsb, n * samples, data, data );
+            if( err != SEGY_OK ) break;
+        }
+
+        const void* parts[ 2 ] = { headers, data };
+        const long long values[ 2 ] = {
+            n * SEGY_TRACE_HEADER_SIZE / (long long)sizeof( int32_t ),
+            n * trace_bsize / codec,
+        };
+        const int sizes[ 2 ] = { sizeof( int32_t ), codec };
+        const double tolerances[ 2 ] = { 0, tolerance };
+
+        for( int k = 0; k < 2 && err == SEGY_OK; ++k ) {
+            long long size;
+            err = segy_compress( parts[ k ], values[ k ], sizes[ k ],
+                                 tolerances[ k ], packed, &size );
+            if( err != SEGY_OK ) break;
+
+            table[ 2 * b + k ] = offset;
+            offset += size;
+            if( fwrite( packed, size, 1, out->fp ) != 1 )
+                err = SEGY_FWRITE_ERROR;
+        }
+    }
+
+    if( err == SEGY_OK ) {
+        table[ positions - 1 ] = offset;
+        if( fseek( out->fp, CONTAINER_HEADER_SIZE + trace0, SEEK_SET ) != 0 )
+            err = SEGY_FSEEK_ERROR;
+        else if( fwrite( table, sizeof( int64_t ), positions, out->fp )
+                 != (size_t)positions )
+            err = SEGY_FWRITE_ERROR;
+    }
+
+    if( out && segy_close( out ) != SEGY_OK && err == SEGY_OK )
+        err = SEGY_FWRITE_ERROR;
+
+    free( table );
+    free( packed );
+    free( gathered );
+    free( raw );
+    free( prefix );
+    return err;
+}
+
+int segy_scan_geometry( segy_file* fp,
+                        int il,
+                        int xl,
+                        int offset,
+                        int start,
+                        int stop,
+                        int threads,
+                        int* keys,
+                        long trace0,
+                        int trace_bsize ) {
+
+    if( start < 0 || stop < start ) return SEGY_INVALID_ARGS;
+
+    const int fields[ 3 ] = { il, xl, offset };
+    for( int i = 0; i < 3; ++i ) {
+        const int f = fields[ i ];
+        if( f < 0 || f >= SEGY_TRACE_HEADER_SIZE || !field_size[ f ] )
+            return SEGY_INVALID_FIELD;
+    }
+
+    /* keys is a row-major table of (il, xl, offset) */
+    int32_t* out[ 3 ] = { keys + 0, keys + 1, keys + 2 };
+    return segy_fields_forall_strided( fp, fields, 3,
+                                       start, stop, 1,
+                                       threads,
+                                       out,
+                                       3,
+                                       trace0,
+                                       trace_bsize );
+}
+
+struct geometry_key {
+    int32_t major;
+    int32_t minor;
+    int32_t offset;
+    int64_t traceno;
+};
+
+static int geometry_key_cmp( const void* x, const void* y ) {
+    const struct geometry_key* a = x;
+    const struct geometry_key* b = y;
+    if( a->major  != b->major  ) return a->major  < b->major  ? -1 : 1;
+    if( a->minor  != b->minor  ) return a->minor  < b->minor  ? -1 : 1;
+    if( a->offset != b->offset ) return a->offset < b->offset ? -1 : 1;
+    if( a->traceno != b->traceno ) return a->traceno < b->traceno ? -1 : 1;
+    return 0;
 }
 
 /*
- * Determine the position of the element `x` in `xs`.
- * Returns -1 if the value cannot be found
+ * The position of the major (line) and minor (trace-in-line) key in the
+ * (il, xl, offset) triples of segy_scan_geometry, for a sorting.
  */
-static int index_of( int x,
-                     const int* xs,
-                     int sz ) {
-    for( int i = 0; i < sz; i++ ) {
-        if( xs[i] == x )
-            return i;
+static int geometry_axes( int sorting, int* major, int* minor ) {
+    switch( sorting ) {
+        case SEGY_INLINE_SORTING:
+            *major = 0;
+            *minor = 1;
+            return SEGY_OK;
+
+        case SEGY_CROSSLINE_SORTING:
+            *major = 1;
+            *minor = 0;
+            return SEGY_OK;
+
+        default:
+            return SEGY_INVALID_SORTING;
     }
+}
 
-    return -1;
+static struct geometry_key geometry_key_at( const int* keys,
+                                            const int64_t* order,
+                                            long long i,
+                                            int major,
+                                            int minor ) {
+    const int* key = keys + 3 * order[ i ];
+    struct geometry_key k;
+    k.major   = key[ major ];
+    k.minor   = key[ minor ];
+    k.offset  = key[ 2 ];
+    k.traceno = order[ i ];
+    return k;
+}
+
+int segy_sort_geometry( const int* keys,
+                        long long n,
+                        int sorting,
+                        int64_t* order ) {
+    int major, minor;
+    const int err = geometry_axes( sorting, &major, &minor );
+    if( err != SEGY_OK ) return err;
+    if( n < 0 ) return SEGY_INVALID_ARGS;
+    if( n == 0 ) return SEGY_OK;
+
+    struct geometry_key* xs = malloc( n * sizeof( struct geometry_key ) );
+    if( !xs ) return SEGY_MEMORY_ERROR;
+
+    for( long long i = 0; i < n; ++i ) {
+        xs[ i ].major   = keys[ 3 * i + major ];
+        xs[ i ].minor   = keys[ 3 * i + minor ];
+        xs[ i ].offset  = keys[ 3 * i + 2 ];
+        xs[ i ].traceno = i;
+    }
+
+    qsort( xs, n, sizeof( struct geometry_key ), geometry_key_cmp );
+
+    for( long long i = 0; i < n; ++i )
+        order[ i ] = xs[ i ].traceno;
+
+    free( xs );
+    return SEGY_OK;
 }
 
 /*
- * Read the inline or crossline `lineno`. If it's an inline or crossline
- * depends on the parameters. The line has a length of `line_length` traces,
- * `offsets` are the number of offsets in this file, and `buf` must be of
- * (minimum) `line_length*samples_per_trace` size.  Reads every `stride` trace,
- * starting at the trace specified by the *position* of the value `lineno` in
- * `linenos`. If `lineno` isn't present in `linenos`, SEGY_MISSING_LINE_INDEX
- * will be returned.
- *
- * If reading a trace fails, this function will return whatever error
- * segy_readtrace returns.
+ * The first position in order whose key is not less than target, comparing
+ * only the first `depth` components (1 = line, 3 = line, trace and offset).
  */
-int segy_read_line( segy_file* fp,
-                    int line_trace0,
-                    int line_length,
-                    int stride,
-                    int offsets,
-                    void* buf,
-                    long trace0,
-                    int trace_bsize ) {
+static long long geometry_lower_bound( const int* keys,
+                                       const int64_t* order,
+                                       long long n,
+                                       int major,
+                                       int minor,
+                                       struct geometry_key target,
+                                       int depth ) {
+    long long lo = 0;
+    long long hi = n;
+
+    while( lo < hi ) {
+        const long long mid = lo + (hi - lo) / 2;
+        struct geometry_key k = geometry_key_at( keys, order, mid,
+                                                 major, minor );
+        k.traceno = target.traceno;
+        if( depth < 3 ) k.offset = target.offset;
+        if( depth < 2 ) k.minor  = target.minor;
+
+        if( geometry_key_cmp( &k, &target ) < 0 ) lo = mid + 1;
+        else                                      hi = mid;
+    }
 
-    char* dst = (char*) buf;
-    stride *= offsets;
+    return lo;
+}
 
-    for( ; line_length--; line_trace0 += stride, dst += trace_bsize ) {
-        int err = segy_readtrace( fp, line_trace0, dst, trace0, trace_bsize );
-        if( err != 0 ) return err;
+int segy_geometry_line( const int* keys,
+                        const int64_t* order,
+                        long long n,
+                        int sorting,
+                        int lineno,
+                        long long* first,
+                        long long* count ) {
+    int major, minor;
+    const int err = geometry_axes( sorting, &major, &minor );
+    if( err != SEGY_OK ) return err;
+
+    struct geometry_key target = { lineno, INT32_MIN, INT32_MIN, -1 };
+    const long long lo = geometry_lower_bound( keys, order, n,
+                                               major, minor, target, 1 );
+
+    if( lineno == INT32_MAX ) {
+        target.major = lineno;
+        *count = n - lo;
+    } else {
+        target.major = lineno + 1;
+        *count = geometry_lower_bound( keys, order, n,
+                                       major, minor, target, 1 ) - lo;
+    }
+
+    *first = lo;
+    if( *count == 0 ) return SEGY_MISSING_LINE_INDEX;
+    return SEGY_OK;
+}
+
+int segy_geometry_find( const int* keys,
+                        const int64_t* order,
+                        long long n,
+                        int sorting,
+                        int il,
+                        int xl,
+                        int offset,
+                        int64_t* traceno ) {
+    int major, minor;
+    const int err = geometry_axes( sorting, &major, &minor );
+    if( err != SEGY_OK ) return err;
+
+    const int key[ 3 ] = { il, xl, offset };
+    const struct geometry_key target = {
+        key[ major ], key[ minor ], offset, -1
+    };
+
+    const long long i = geometry_lower_bound( keys, order, n,
+                                              major, minor, target, 3 );
+    if( i == n ) return SEGY_NOTFOUND;
+
+    const struct geometry_key k = geometry_key_at( keys, order, i,
+                                                   major, minor );
+    if( k.major != target.major
+     || k.minor != target.minor
+     || k.offset != target.offset )
+        return SEGY_NOTFOUND;
+
+    *traceno = k.traceno;
+    return SEGY_OK;
+}
+
+int segy_geometry_read_line( segy_file* fp,
+                             const int* keys,
+                             const int64_t* order,
+                             long long n,
+                             int sorting,
+                             int lineno,
+                             int offset,
+                             long long max_gap,
+                             int format,
+                             int outtype,
+                             double scale,
+                             double bias,
+                             void* buf,
+                             long long* count,
+                             long trace0,
+                             int trace_bsize ) {
+    long long first, len;
+    int err = segy_geometry_line( keys, order, n, sorting, lineno,
+                                  &first, &len );
+    if( err != SEGY_OK ) return err;
+
+    int64_t* tracenos = malloc( sizeof( int64_t ) * len );
+    if( !tracenos ) return SEGY_MEMORY_ERROR;
+
+    /*
+     * the line is ordered by trace-in-line, then offset, so picking the
+     * traces at offset keeps them ordered by trace-in-line
+     */
+    long long m = 0;
+    for( long long i = first; i < first + len; ++i ) {
+        if( keys[ 3 * order[ i ] + 2 ] == offset )
+            tracenos[ m++ ] = order[ i ];
     }
 
+    err = segy_readtraces_native( fp, tracenos, m, max_gap,
+                                  format, outtype, scale, bias, buf,
+                                  trace0, trace_bsize );
+    free( tracenos );
+    if( err != SEGY_OK ) return err;
+
+    *count = m;
     return SEGY_OK;
 }
 
 /*
- * Write the inline or crossline `lineno`. If it's an inline or crossline
- * depends on the parameters. The line has a length of `line_length` traces,
- * and `buf` must be of (minimum) `line_length*samples_per_trace` size.  Reads
- * every `stride` trace, starting at the trace specified by the *position* of
- * the value `lineno` in `linenos`. If `lineno` isn't present in `linenos`,
- * SEGY_MISSING_LINE_INDEX will be returned.
- *
- * If reading a trace fails, this function will return whatever error
- * segy_readtrace returns.
+ * Stable LSD radix sort of index by keys, a byte at a time. keys is permuted
+ * along with index, and itmp and ktmp are scratch space of n elements. Passes
+ * where all keys share the byte are skipped, which makes sorting narrow
+ * values, like the header words of a survey, much cheaper than the full four
+ * passes.
  */
-int segy_write_line( segy_file* fp,
-                     int line_trace0,
-                     int line_length,
-                     int stride,
-                     int offsets,
-                     const void* buf,
-                     long trace0,
-                     int trace_bsize ) {
-    if( !fp->writable ) return SEGY_READONLY;
+static void radix_sort( int64_t* index,
+                        uint32_t* keys,
+                        long long n,
+                        int64_t* itmp,
+                        uint32_t* ktmp ) {
+    int64_t* isrc = index;
+    uint32_t* ksrc = keys;
+    int64_t* idst = itmp;
+    uint32_t* kdst = ktmp;
+
+    for( int shift = 0; shift < 32; shift += 8 ) {
+        long long count[ 257 ] = { 0 };
+        for( long long i = 0; i < n; ++i )
+            ++count[ ((ksrc[ i ] >> shift) & 0xFF) + 1 ];
+
+        if( count[ ((ksrc[ 0 ] >> shift) & 0xFF) + 1 ] == n ) continue;
+
+        for( int b = 0; b < 256; ++b )
+            count[ b + 1 ] += count[ b ];
+
+        for( long long i = 0; i < n; ++i ) {
+            const long long pos = count[ (ksrc[ i ] >> shift) & 0xFF ]++;
+            idst[ pos ] = isrc[ i ];
+            kdst[ pos ] = ksrc[ i ];
+        }
 
-    const char* src = (const char*) buf;
-    stride *= offsets;
+        int64_t* itmpp = isrc;
+        isrc = idst;
+        idst = itmpp;
+        uint32_t* ktmpp = ksrc;
+        ksrc = kdst;
+        kdst = ktmpp;
+    }
 
-    for( ; line_length--; line_trace0 += stride, src += trace_bsize ) {
-        int err = segy_writetrace( fp, line_trace0, src, trace0, trace_bsize );
-        if( err != 0 ) return err;
+    if( isrc != index )
+        memcpy( index, isrc, n * sizeof( int64_t ) );
+}
+
+int segy_sort_rows( const int32_t* rows,
+                    int ncols,
+                    long long n,
+                    int64_t* index ) {
+    if( ncols < 0 || n < 0 ) return SEGY_INVALID_ARGS;
+    if( ncols == 0 || n == 0 ) return SEGY_OK;
+
+    uint32_t* keys = malloc( 2 * n * sizeof( uint32_t ) );
+    int64_t* itmp = malloc( n * sizeof( int64_t ) );
+    if( !keys || !itmp ) {
+        free( keys );
+        free( itmp );
+        return SEGY_MEMORY_ERROR;
+    }
+
+    /*
+     * sort by the least significant column first - the sort is stable, so the
+     * order of the less significant columns is kept among equal keys. The
+     * sign bit is flipped so that negative values sort before positive ones
+     */
+    for( int c = ncols - 1; c >= 0; --c ) {
+        for( long long i = 0; i < n; ++i ) {
+            const int32_t x = rows[ index[ i ] * ncols + c ];
+            keys[ i ] = (uint32_t)x ^ 0x80000000u;
+        }
+
+        radix_sort( index, keys, n, itmp, keys + n );
+    }
+
+    free( keys );
+    free( itmp );
+    return SEGY_OK;
+}
+
+int segy_group_rows( const int32_t* rows,
+                     int ncols,
+                     long long n,
+                     int64_t* index,
+                     int64_t* offsets,
+                     long long* ngroups ) {
+    if( ncols < 0 || n < 0 ) return SEGY_INVALID_ARGS;
+
+    offsets[ 0 ] = 0;
+    *ngroups = 0;
+    if( n == 0 ) return SEGY_OK;
+
+    for( long long i = 0; i < n; ++i )
+        index[ i ] = i;
+
+    int err = segy_sort_rows( rows, ncols, n, index );
+    if( err != SEGY_OK ) return err;
+
+    /*
+     * equal rows are now next to each other, in row order, so every run is a
+     * group that starts with its first row. Number the runs, then give them
+     * their rank in order of appearance, by walking the rows in order.
+     */
+    int64_t* run = malloc( n * sizeof( int64_t ) );
+    int64_t* rank = malloc( n * sizeof( int64_t ) );
+    int64_t* out = malloc( n * sizeof( int64_t ) );
+    if( !run || !rank || !out ) {
+        free( run );
+        free( rank );
+        free( out );
+        return SEGY_MEMORY_ERROR;
+    }
+
+    const size_t rowsize = ncols * sizeof( int32_t );
+    long long runs = 0;
+    for( long long i = 0; i < n; ++i ) {
+        if( i > 0 && memcmp( rows + index[ i ] * ncols,
+                             rows + index[ i - 1 ] * ncols,
+                             rowsize ) != 0 )
+            ++runs;
+
+        run[ index[ i ] ] = runs;
+    }
+    ++runs;
+
+    for( long long g = 0; g < runs; ++g )
+        rank[ g ] = -1;
+
+    /* offsets[g + 1] counts the size of the group g before the prefix sum */
+    long long groups = 0;
+    for( long long i = 0; i < n; ++i ) {
+        if( rank[ run[ i ] ] == -1 ) {
+            rank[ run[ i ] ] = groups;
+            offsets[ ++groups ] = 0;
+        }
+        ++offsets[ rank[ run[ i ] ] + 1 ];
     }
 
+    for( long long g = 0; g < groups; ++g )
+        offsets[ g + 1 ] += offsets[ g ];
+
+    /*
+     * the rows are visited in order, so the rows of a group are placed in
+     * ascending order. rank is no longer needed per run, so reuse it as the
+     * insertion cursor per group
+     */
+    for( long long i = 0; i < n; ++i )
+        run[ i ] = rank[ run[ i ] ];
+
+    for( long long g = 0; g < groups; ++g )
+        rank[ g ] = offsets[ g ];
+
+    for( long long i = 0; i < n; ++i )
+        out[ rank[ run[ i ] ]++ ] = i;
+
+    memcpy( index, out, n * sizeof( int64_t ) );
+    *ngroups = groups;
+
+    free( run );
+    free( rank );
+    free( out );
     return SEGY_OK;
 }
 
@@ -2326,11 +7952,11 @@ int segy_read_ext_textheader( segy_file* fp, int pos, char *buf) {
     }
 #endif //HAVE_MMAP
 
-    int err = fseek( fp->fp, offset, SEEK_SET );
+    int err = file_seek( fp, offset );
     if( err != 0 ) return SEGY_FSEEK_ERROR;
 
     char localbuf[ SEGY_TEXT_HEADER_SIZE + 1 ] = { 0 };
-    const size_t read = fread( localbuf, 1, SEGY_TEXT_HEADER_SIZE, fp->fp );
+    const size_t read = file_read( fp, localbuf, 1, SEGY_TEXT_HEADER_SIZE );
     if( read != SEGY_TEXT_HEADER_SIZE ) return SEGY_FREAD_ERROR;
 
     encode( buf, localbuf, e2a, SEGY_TEXT_HEADER_SIZE );
@@ -2380,33 +8006,19 @@ int segy_binheader_size( void ) {
     return SEGY_BINARY_HEADER_SIZE;
 }
 
-static int scaled_cdp( segy_file* fp,
-                       int traceno,
-                       float* cdpx,
-                       float* cdpy,
-                       long trace0,
-                       int trace_bsize ) {
-    int32_t x, y, scalar;
-    char trheader[ SEGY_TRACE_HEADER_SIZE ];
-
-    int err = segy_traceheader( fp, traceno, trheader, trace0, trace_bsize );
-    if( err != 0 ) return err;
-
-    err = segy_get_field( trheader, SEGY_TR_CDP_X, &x );
-    if( err != 0 ) return err;
-    err = segy_get_field( trheader, SEGY_TR_CDP_Y, &y );
-    if( err != 0 ) return err;
-    err = segy_get_field( trheader, SEGY_TR_SOURCE_GROUP_SCALAR, &scalar );
-    if( err != 0 ) return err;
+/*
+ * The cdp coordinates of a header row of { cdp-x, cdp-y, scalar }, with the
+ * scalar applied
+ */
+static void scaled_cdp( const int32_t* row, float* cdpx, float* cdpy ) {
+    const int32_t scalar = row[ 2 ];
 
     float scale = scalar;
     if( scalar == 0 ) scale = 1.0;
     if( scalar < 0 )  scale = -1.0 / scale;
 
-    *cdpx = x * scale;
-    *cdpy = y * scale;
-
-    return SEGY_OK;
+    *cdpx = row[ 0 ] * scale;
+    *cdpy = row[ 1 ] * scale;
 }
 
 int segy_rotation_cw( segy_file* fp,
@@ -2431,14 +8043,32 @@ int segy_rotation_cw( segy_file* fp,
                                         &traceno );
     if( err != 0 ) return err;
 
-    err = scaled_cdp( fp, traceno, &sw.x, &sw.y, trace0, trace_bsize );
-    if( err != 0 ) return err;
+    /*
+     * read the first and the last trace in the line in one go, which is the
+     * same trace for lines of one trace
+     */
+    const int last = traceno + (line_length - 1) * stride * offsets;
+    const int step = last > traceno ? last - traceno : 1;
+    const int fields[] = {
+        SEGY_TR_CDP_X,
+        SEGY_TR_CDP_Y,
+        SEGY_TR_SOURCE_GROUP_SCALAR,
+    };
 
-    /* read the last trace in the line */
-    traceno += (line_length - 1) * stride * offsets;
-    err = scaled_cdp( fp, traceno, &nw.x, &nw.y, trace0, trace_bsize );
+    int32_t rows[ 2 ][ 3 ];
+    int32_t* out[] = { rows[ 0 ] + 0, rows[ 0 ] + 1, rows[ 0 ] + 2 };
+    err = segy_fields_forall_strided( fp, fields, 3,
+                                      traceno, last + 1, step,
+                                      1,
+                                      out,
+                                      3,
+                                      trace0,
+                                      trace_bsize );
     if( err != 0 ) return err;
 
+    scaled_cdp( rows[ 0 ], &sw.x, &sw.y );
+    scaled_cdp( rows[ last > traceno ? 1 : 0 ], &nw.x, &nw.y );
+
     float x = nw.x - sw.x;
     float y = nw.y - sw.y;
     float radians = x || y ? atan2( x, y ) : 0;
@@ -21,6 +21,23 @@ void ieee2ibm(void* to, const void* from);
 int segy_seek( struct segy_file_handle*, int, long, int );
 long long segy_ftell( struct segy_file_handle* );
 
+/*
+ * IBM float conversion kernels. segy_to_native and segy_from_native pick the
+ * best level the CPU supports (segy_simd_level), these functions force a
+ * specific one. Returns SEGY_INVALID_ARGS if the level is not supported by
+ * the CPU or the build.
+ */
+enum {
+    SEGY_SIMD_SCALAR = 0,
+    SEGY_SIMD_SSE2,
+    SEGY_SIMD_AVX2,
+    SEGY_SIMD_AVX512,
+};
+
+int segy_simd_level( void );
+int segy_ibm_native_simd( int level, long long size, void* buf );
+int segy_native_ibm_simd( int level, long long size, void* buf );
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
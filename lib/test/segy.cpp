@@ -1,11 +1,17 @@
+#include <algorithm>
 #include <fstream>
 #include <numeric>
+#include <cfloat>
 #include <cmath>
 #include <iomanip>
 #include <memory>
+#include <iterator>
 #include <limits>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 
 #include <catch/catch.hpp>
 #include "matchers.hpp"
@@ -84,6 +90,9 @@ struct StringMaker< Err > {
             case SEGY_INVALID_ARGS: return "SEGY_INVALID_ARGS";
             case SEGY_MMAP_ERROR: return "SEGY_MMAP_ERROR";
             case SEGY_MMAP_INVALID: return "SEGY_MMAP_INVALID";
+            case SEGY_READONLY: return "SEGY_READONLY";
+            case SEGY_NOTFOUND: return "SEGY_NOTFOUND";
+            case SEGY_MEMORY_ERROR: return "SEGY_MEMORY_ERROR";
         }
         return "Unknown error";
     }
@@ -950,6 +959,1928 @@ TEST_CASE_METHOD( smallstep,
     CHECK_THAT( xs, ApproxRange( expected ) );
 }
 
+TEST_CASE_METHOD( smallstep,
+                  "positional reads match cursor-based reads",
+                  "[c.segy]" ) {
+    const std::vector< slice > slices = {
+        { 0, 50, 1 }, { 3, 19, 5 }, { 18, 2, -5 }, { 3, -1, -1 }, { 24, -1, -5 },
+    };
+
+    for( const auto& s : slices ) {
+        const int len = std::abs( s.stop - s.start ) / std::abs( s.step )
+                      + !!( std::abs( s.stop - s.start ) % std::abs( s.step ) );
+        std::vector< float > expected( len );
+        std::vector< float > xs( len );
+
+        INFO( "slice " << str( s ) );
+        Err err = segy_readsubtr( fp, traceno,
+                                  s.start, s.stop, s.step,
+                                  expected.data(), nullptr,
+                                  trace0, trace_bsize );
+        CHECK( success( err ) );
+
+        err = segy_pread_subtr( fp, traceno,
+                                s.start, s.stop, s.step,
+                                xs.data(), nullptr,
+                                trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( xs == expected );
+    }
+
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    char expected_header[ SEGY_TRACE_HEADER_SIZE ];
+    Err err = segy_traceheader( fp, traceno, expected_header, trace0, trace_bsize );
+    CHECK( success( err ) );
+    err = segy_pread_traceheader( fp, traceno, header, trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( std::memcmp( header, expected_header, sizeof( header ) ) == 0 );
+}
+
+TEST_CASE_METHOD( smallbasic,
+                  "mmap region holds the samples in file order",
+                  "[c.segy]" ) {
+    void* addr = nullptr;
+    long long size = 0;
+    Err err = segy_mmap_region( fp, &addr, &size );
+
+    if( !testcfg::config().memmap ) {
+        CHECK( err == SEGY_MMAP_INVALID );
+        return;
+    }
+
+    REQUIRE( success( err ) );
+    CHECK( size == trace0 + 25LL * ( SEGY_TRACE_HEADER_SIZE + trace_bsize ) );
+
+    const char* base = static_cast< const char* >( addr );
+    for( int traceno = 0; traceno < 25; ++traceno ) {
+        std::vector< char > expected( trace_bsize );
+        err = segy_readtrace( fp, traceno, expected.data(),
+                              trace0, trace_bsize );
+        REQUIRE( success( err ) );
+
+        /* segy_readtrace gives big-endian samples, also for lsb files */
+        if( testcfg::config().lsbit ) {
+            for( int i = 0; i < trace_bsize; i += 4 )
+                std::reverse( expected.begin() + i, expected.begin() + i + 4 );
+        }
+
+        INFO( "trace " << traceno );
+        const char* samples = base + trace0
+                            + traceno * ( SEGY_TRACE_HEADER_SIZE + trace_bsize )
+                            + SEGY_TRACE_HEADER_SIZE;
+        CHECK( std::memcmp( samples, expected.data(), trace_bsize ) == 0 );
+    }
+}
+
+TEST_CASE_METHOD( smallstep,
+                  "reads with scratch memory match reads with rangebuf",
+                  "[c.segy]" ) {
+    const std::vector< slice > slices = {
+        { 3, 19, 5 }, { 18, 2, -5 }, { 3, -1, -1 }, { 20, 40, 1 },
+    };
+
+    std::vector< char > arena( 8 );
+    std::vector< char > large( samples * 4 );
+    const std::vector< std::pair< void*, long long > > scratches = {
+        { nullptr, 0 },
+        { large.data(), (long long)large.size() },
+        { arena.data(), (long long)arena.size() },
+        { nullptr, 0 },
+    };
+
+    for( const auto& scratch : scratches ) {
+        Err err = segy_set_scratch( fp,
+                                    scratch.first,
+                                    scratch.second );
+        CHECK( success( err ) );
+
+        for( const auto& s : slices ) {
+            const int len = std::abs( s.stop - s.start ) / std::abs( s.step )
+                          + !!( std::abs( s.stop - s.start ) % std::abs( s.step ) );
+            std::vector< float > expected( len );
+            std::vector< float > xs( len );
+            std::vector< float > rangebuf( samples );
+
+            INFO( "slice " << str( s ) << ", scratch " << scratch.second );
+            err = segy_readsubtr( fp, traceno,
+                                  s.start, s.stop, s.step,
+                                  expected.data(), rangebuf.data(),
+                                  trace0, trace_bsize );
+            CHECK( success( err ) );
+
+            err = segy_readsubtr( fp, traceno,
+                                  s.start, s.stop, s.step,
+                                  xs.data(), nullptr,
+                                  trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( xs == expected );
+
+            segy_to_native( format, len, expected.data() );
+            std::vector< std::int16_t > narrow( len );
+            err = segy_readsubtr_native( fp, traceno,
+                                         s.start, s.stop, s.step,
+                                         format, SEGY_AS_INT16, 1.0, 0.0,
+                                         narrow.data(), nullptr,
+                                         trace0, trace_bsize );
+            CHECK( success( err ) );
+            for( int i = 0; i < len; ++i )
+                CHECK( narrow[ i ] == std::lround( expected[ i ] ) );
+        }
+    }
+
+    Err err = segy_set_scratch( fp, nullptr, -1 );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallsize,
+                  "positional reads from multiple threads",
+                  "[c.segy]" ) {
+    std::vector< float > expected( traces * samples );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace( fp, i,
+                                  expected.data() + i * samples,
+                                  trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    const int nthreads = 4;
+    std::vector< std::vector< float > > results(
+        nthreads, std::vector< float >( traces * samples )
+    );
+    std::vector< std::vector< int > > ilines(
+        nthreads, std::vector< int >( traces )
+    );
+    std::vector< int > errs( nthreads, SEGY_OK );
+
+    std::vector< std::thread > workers;
+    for( int t = 0; t < nthreads; ++t ) {
+        workers.emplace_back( [&, t] {
+            char header[ SEGY_TRACE_HEADER_SIZE ];
+            /* walk the file in different orders to interleave the reads */
+            for( int k = 0; k < traces; ++k ) {
+                const int i = t % 2 ? traces - 1 - k : (k + t) % traces;
+                float* dst = results[ t ].data() + i * samples;
+                int err = segy_pread_trace( fp, i, dst, trace0, trace_bsize );
+                if( !err )
+                    err = segy_pread_traceheader( fp, i, header,
+                                                  trace0, trace_bsize );
+                if( !err )
+                    err = segy_get_field( header, il, &ilines[ t ][ i ] );
+                if( err ) errs[ t ] = err;
+            }
+        });
+    }
+
+    for( auto& w : workers ) w.join();
+
+    for( int t = 0; t < nthreads; ++t ) {
+        CHECK( errs[ t ] == SEGY_OK );
+        CHECK( results[ t ] == expected );
+        for( int i = 0; i < traces; ++i )
+            CHECK( ilines[ t ][ i ] == 1 + i / 5 );
+    }
+}
+
+TEST_CASE_METHOD( smallsize,
+                  "batched trace reads match single trace reads",
+                  "[c.segy]" ) {
+    const std::vector< std::int64_t > tracenos = {
+        24, 0, 3, 4, 5, 3, 12, 10, 11, 23,
+    };
+
+    std::vector< float > expected( tracenos.size() * samples );
+    for( std::size_t i = 0; i < tracenos.size(); ++i ) {
+        Err err = segy_readtrace( fp, tracenos[ i ],
+                                  expected.data() + i * samples,
+                                  trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    for( long long gap : { 0LL, 1000LL, 1LL << 30 } ) {
+        INFO( "max gap " << gap );
+        std::vector< float > xs( tracenos.size() * samples );
+        Err err = segy_readtraces( fp, tracenos.data(), tracenos.size(), gap,
+                                   xs.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( xs == expected );
+    }
+}
+
+TEST_CASE_METHOD( smallsize,
+                  "batched trace reads with invalid trace numbers fail",
+                  "[c.segy]" ) {
+    std::vector< float > xs( 2 * samples );
+
+    const std::int64_t negative[] = { 1, -1 };
+    Err err = segy_readtraces( fp, negative, 2, 0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const std::int64_t past_eof[] = { 24, 25 };
+    err = segy_readtraces( fp, past_eof, 2, 0,
+                           xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+TEST_CASE( "batched trace reads see preceding writes", "[c.segy]" ) {
+    const std::string name = std::string( "readtraces-write" )
+                           + (testcfg::config().memmap ? "-mmap" : "")
+                           + (testcfg::config().lsbit  ? "-lsb"  : "")
+                           + ".sgy";
+    copyfile( "test-data/small.sgy", name );
+    unique_segy ufp( openfile( name, "r+b" ) );
+    auto fp = ufp.get();
+
+    const long trace0 = 3600;
+    const int trace_bsize = 50 * 4;
+
+    std::vector< float > written( 50 );
+    std::iota( written.begin(), written.end(), 1.0f );
+    Err err = segy_writetrace( fp, 3, written.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    const std::int64_t tracenos[] = { 3 };
+    std::vector< float > xs( 50 );
+    err = segy_readtraces( fp, tracenos, 1, 0,
+                           xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( xs == written );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "fused native reads match read-then-convert",
+                  "[c.segy]" ) {
+    const std::vector< std::int64_t > tracenos = { 7, 0, 1, 2, 24, 8 };
+
+    std::vector< float > expected( tracenos.size() * samples );
+    for( std::size_t i = 0; i < tracenos.size(); ++i ) {
+        Err err = segy_readtrace( fp, tracenos[ i ],
+                                  expected.data() + i * samples,
+                                  trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+    segy_to_native( format, expected.size(), expected.data() );
+
+    std::vector< float > trace( samples );
+    Err err = segy_readtrace_native( fp, tracenos.front(),
+                                     format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                     trace.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( std::equal( trace.begin(), trace.end(), expected.begin() ) );
+
+    for( long long gap : { 0LL, 1LL << 30 } ) {
+        INFO( "max gap " << gap );
+        std::vector< float > xs( expected.size() );
+        err = segy_readtraces_native( fp, tracenos.data(), tracenos.size(),
+                                      gap, format, SEGY_AS_NATIVE,
+                                      1.0, 0.0, xs.data(),
+                                      trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( xs == expected );
+    }
+
+    std::vector< float > line( samples * xlines );
+    std::vector< float > nativeline( line.size() );
+    err = segy_read_line( fp, 0, crosslines.size(), stride, offsets,
+                          line.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+    segy_to_native( format, line.size(), line.data() );
+    err = segy_read_line_native( fp, 0, crosslines.size(), stride, offsets,
+                                 format, SEGY_AS_NATIVE,
+                                 1.0, 0.0, nativeline.data(),
+                                 trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( nativeline == line );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "trace ranges match sub-trace reads",
+                  "[c.segy]" ) {
+    struct range { int start, step, count; };
+    const std::vector< range > ranges = {
+        { 0, 1, 25 }, { 3, 2, 10 }, { 24, -1, 25 }, { 20, -5, 5 }, { 7, 1, 1 },
+    };
+    const std::vector< slice > slices = {
+        { 0, 50, 1 }, { 3, 19, 5 }, { 18, 2, -5 }, { 49, -1, -1 }, { 20, 21, 1 },
+    };
+
+    for( const auto& r : ranges ) {
+        for( const auto& s : slices ) {
+            for( const long long gap : { 0LL, 1LL << 20 } ) {
+                const int len = std::abs( s.stop - s.start ) / std::abs( s.step )
+                              + !!( std::abs( s.stop - s.start ) % std::abs( s.step ) );
+
+                INFO( "traces " << r.start << ":" << r.step << "x" << r.count
+                      << ", slice " << str( s ) << ", gap " << gap );
+
+                std::vector< double > expected( r.count * len );
+                for( int i = 0; i < r.count; ++i ) {
+                    Err err = segy_readsubtr_native( fp, r.start + i * r.step,
+                                                     s.start, s.stop, s.step,
+                                                     format, SEGY_AS_FLOAT64,
+                                                     1.0, 0.0,
+                                                     expected.data() + i * len,
+                                                     nullptr,
+                                                     trace0, trace_bsize );
+                    REQUIRE( success( err ) );
+                }
+
+                std::vector< double > xs( r.count * len );
+                Err err = segy_read_trace_range( fp, r.start, r.step, r.count,
+                                                 s.start, s.stop, s.step,
+                                                 gap, format, SEGY_AS_FLOAT64,
+                                                 1.0, 0.0,
+                                                 xs.data(), trace0, trace_bsize );
+                CHECK( success( err ) );
+                CHECK( xs == expected );
+
+                std::vector< std::int16_t > narrow( r.count * len );
+                err = segy_read_trace_range( fp, r.start, r.step, r.count,
+                                             s.start, s.stop, s.step,
+                                             gap, format, SEGY_AS_INT16,
+                                             1.0, 0.0,
+                                             narrow.data(), trace0, trace_bsize );
+                CHECK( success( err ) );
+                for( std::size_t i = 0; i < narrow.size(); ++i )
+                    CHECK( narrow[ i ] == std::lround( expected[ i ] ) );
+            }
+        }
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "trace ranges outside the file fail",
+                  "[c.segy]" ) {
+    std::vector< float > xs( 25 * samples );
+
+    Err err = segy_read_trace_range( fp, 0, -1, 2, 0, samples, 1, 0,
+                                     format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                     xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_trace_range( fp, 0, 1, 1, 0, samples + 1, 1, 0,
+                                 format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_trace_range( fp, 20, 1, 6, 0, samples, 1, 0,
+                                 format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+TEST_CASE( "trace ranges see preceding writes", "[c.segy]" ) {
+    const std::string name = std::string( "trace-range-write" )
+                           + (testcfg::config().memmap ? "-mmap" : "")
+                           + (testcfg::config().lsbit  ? "-lsb"  : "")
+                           + ".sgy";
+    copyfile( "test-data/small.sgy", name );
+    unique_segy ufp( openfile( name, "r+b" ) );
+    auto fp = ufp.get();
+
+    const long trace0 = 3600;
+    const int samples = 50;
+    const int trace_bsize = samples * 4;
+    const int format = SEGY_IBM_FLOAT_4_BYTE;
+
+    std::vector< float > written( samples );
+    std::iota( written.begin(), written.end(), 100.0f );
+    std::vector< float > raw = written;
+    segy_from_native( format, raw.size(), raw.data() );
+    Err err = segy_writetrace( fp, 3, raw.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( 3 * samples );
+    err = segy_read_trace_range( fp, 2, 1, 3, 0, samples, 1, 0,
+                                 format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( std::vector< float >( xs.begin() + samples,
+                                 xs.begin() + 2 * samples ) == written );
+
+    err = segy_writetrace( fp, 4, raw.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    const std::int64_t tracenos[] = { 4 };
+    std::vector< float > ys( samples );
+    err = segy_readtraces_native( fp, tracenos, 1, 0,
+                                  format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                  ys.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( ys == written );
+}
+
+TEST_CASE( "converting to int16 rounds and saturates", "[c.segy]" ) {
+    const std::vector< float > xs = {
+        0.0f, 1.4f, 1.5f, -1.5f, -2.6f, 40000.0f, -40000.0f, 32767.4f,
+        std::numeric_limits< float >::quiet_NaN(),
+    };
+    const std::vector< std::int16_t > expected = {
+        0, 1, 2, -2, -3, 32767, -32768, 32767, 0,
+    };
+
+    std::vector< float > ieee = xs;
+    Err err = segy_from_native( SEGY_IEEE_FLOAT_4_BYTE,
+                                ieee.size(), ieee.data() );
+    REQUIRE( success( err ) );
+
+    std::vector< std::int16_t > out( xs.size() );
+    err = segy_to_type( SEGY_IEEE_FLOAT_4_BYTE, SEGY_AS_INT16, 1.0, 0.0,
+                        xs.size(), ieee.data(), out.data() );
+    CHECK( success( err ) );
+    CHECK( out == expected );
+}
+
+TEST_CASE( "converting in place widens and narrows", "[c.segy]" ) {
+    /* more than one conversion block, to exercise the back-to-front order */
+    const int n = 3000;
+    std::vector< std::int16_t > xs( n );
+    for( int i = 0; i < n; ++i ) xs[ i ] = std::int16_t( i - n / 2 );
+
+    std::vector< double > buf( n );
+    std::memcpy( buf.data(), xs.data(), n * sizeof( std::int16_t ) );
+    segy_from_native( SEGY_SIGNED_SHORT_2_BYTE, n, buf.data() );
+
+    Err err = segy_to_type( SEGY_SIGNED_SHORT_2_BYTE, SEGY_AS_FLOAT64, 1.0, 0.0,
+                            n, buf.data(), buf.data() );
+    CHECK( success( err ) );
+    for( int i = 0; i < n; ++i )
+        CHECK( buf[ i ] == double( xs[ i ] ) );
+
+    /* and back down, from 8-byte doubles to 2-byte ints */
+    segy_from_native( SEGY_IEEE_FLOAT_8_BYTE, n, buf.data() );
+    err = segy_to_type( SEGY_IEEE_FLOAT_8_BYTE, SEGY_AS_INT16, 1.0, 0.0,
+                        n, buf.data(), buf.data() );
+    CHECK( success( err ) );
+    CHECK( std::memcmp( buf.data(), xs.data(),
+                        n * sizeof( std::int16_t ) ) == 0 );
+}
+
+TEST_CASE( "converting scales and biases", "[c.segy]" ) {
+    SECTION( "float in [-1, 1] to int16" ) {
+        std::vector< float > xs = { -1.0f, -0.5f, 0.0f, 0.25f, 1.0f, 2.0f };
+        const std::vector< std::int16_t > expected = {
+            -32766, -16383, 1, 8193, INT16_MAX, INT16_MAX
+        };
+
+        segy_from_native( SEGY_IEEE_FLOAT_4_BYTE, xs.size(), xs.data() );
+        std::vector< std::int16_t > out( xs.size() );
+        Err err = segy_to_type( SEGY_IEEE_FLOAT_4_BYTE, SEGY_AS_INT16,
+                                32767.0, 1.0,
+                                xs.size(), xs.data(), out.data() );
+        CHECK( success( err ) );
+        CHECK( out == expected );
+    }
+
+    SECTION( "integers to float and double" ) {
+        std::vector< std::int8_t > i8 = { -128, -1, 0, 1, 127 };
+        std::vector< float > f32( i8.size() );
+        Err err = segy_to_type( SEGY_SIGNED_CHAR_1_BYTE, SEGY_AS_FLOAT32,
+                                0.5, -2.0,
+                                i8.size(), i8.data(), f32.data() );
+        CHECK( success( err ) );
+        for( std::size_t i = 0; i < i8.size(); ++i )
+            CHECK( f32[ i ] == i8[ i ] * 0.5f - 2.0f );
+
+        std::vector< std::uint32_t > u32 = { 0, 1, 4000000000u };
+        std::vector< double > f64( u32.size() );
+        segy_from_native( SEGY_UNSIGNED_INTEGER_4_BYTE, u32.size(), u32.data() );
+        err = segy_to_type( SEGY_UNSIGNED_INTEGER_4_BYTE, SEGY_AS_FLOAT64,
+                            0.25, 1.0,
+                            u32.size(), u32.data(), f64.data() );
+        CHECK( success( err ) );
+        CHECK( f64 == std::vector< double >{ 1.0, 1.25, 1000000001.0 } );
+    }
+
+    SECTION( "3-byte integers" ) {
+        /* big-endian -1, 2 and -8388608 */
+        const unsigned char raw[] = { 0xFF, 0xFF, 0xFF,
+                                      0x00, 0x00, 0x02,
+                                      0x80, 0x00, 0x00 };
+        std::vector< double > out( 3 );
+        Err err = segy_to_type( SEGY_SIGNED_CHAR_3_BYTE, SEGY_AS_FLOAT64,
+                                2.0, 0.5,
+                                3, raw, out.data() );
+        CHECK( success( err ) );
+        CHECK( out == std::vector< double >{ -1.5, 4.5, -16777215.5 } );
+    }
+
+    SECTION( "in place, when the type is already native" ) {
+        std::vector< double > xs = { 1.0, -2.0, 3.5 };
+        segy_from_native( SEGY_IEEE_FLOAT_8_BYTE, xs.size(), xs.data() );
+        Err err = segy_to_type( SEGY_IEEE_FLOAT_8_BYTE, SEGY_AS_FLOAT64,
+                                -2.0, 1.0,
+                                xs.size(), xs.data(), xs.data() );
+        CHECK( success( err ) );
+        CHECK( xs == std::vector< double >{ -1.0, 5.0, -6.0 } );
+    }
+
+    SECTION( "the native type can't be scaled" ) {
+        std::vector< float > xs( 4 );
+        Err err = segy_to_type( SEGY_IEEE_FLOAT_4_BYTE, SEGY_AS_NATIVE,
+                                2.0, 0.0,
+                                xs.size(), xs.data(), xs.data() );
+        CHECK( err == Err::args() );
+
+        err = segy_to_type( SEGY_IEEE_FLOAT_4_BYTE, SEGY_AS_NATIVE,
+                            1.0, 1.0,
+                            xs.size(), xs.data(), xs.data() );
+        CHECK( err == Err::args() );
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "scaled narrowing reads match scaled native reads",
+                  "[c.segy]" ) {
+    /* small.sgy samples are 1.2 .. 5.24, so a scale of 1000 keeps 3 decimals */
+    std::vector< float > line( crosslines.size() * samples );
+    Err err = segy_read_line_native( fp, 0, crosslines.size(), 1, 1,
+                                     format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                     line.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< std::int16_t > narrow( line.size() );
+    err = segy_read_line_native( fp, 0, crosslines.size(), 1, 1,
+                                 format, SEGY_AS_INT16, 1000.0, -3000.0,
+                                 narrow.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    for( std::size_t i = 0; i < line.size(); ++i )
+        CHECK( narrow[ i ] == std::lround( line[ i ] * 1000.0 - 3000.0 ) );
+
+    std::vector< std::int16_t > trace( samples );
+    err = segy_readtrace_native( fp, 2, format, SEGY_AS_INT16,
+                                 1000.0, -3000.0,
+                                 trace.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( std::equal( trace.begin(), trace.end(),
+                       narrow.begin() + 2 * samples ) );
+
+    err = segy_readtrace_native( fp, 2, format, SEGY_AS_NATIVE,
+                                 1000.0, 0.0,
+                                 line.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallbasic,
+                  "fused native read with mismatched format fails",
+                  "[c.segy]" ) {
+    std::vector< double > xs( samples );
+    Err err = segy_readtrace_native( fp, 0,
+                                     SEGY_IEEE_FLOAT_8_BYTE, SEGY_AS_NATIVE,
+                                     1.0, 0.0,
+                                     xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "depth slices match per-trace reads",
+                  "[c.segy]" ) {
+    const std::vector< int > depths = { 0, 49, 10, 10, 3 };
+
+    std::vector< float > traces_native( traces * samples );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         traces_native.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    const std::vector< slice > ranges = {
+        { 0, 25, 1 }, { 3, 22, 2 }, { 24, -1, -3 },
+    };
+
+    for( const auto& r : ranges ) {
+        for( int threads : { 1, 3 } ) {
+            INFO( "range " << r.start << ":" << r.stop << ":" << r.step
+                  << ", threads " << threads );
+
+            std::vector< int > tracenos;
+            for( int i = r.start; r.step > 0 ? i < r.stop : i > r.stop;
+                 i += r.step )
+                tracenos.push_back( i );
+            const std::size_t len = tracenos.size();
+
+            std::vector< float > xs( depths.size() * len );
+            Err err = segy_read_depth_slices( fp, depths.data(), depths.size(),
+                                              r.start, r.stop, r.step,
+                                              format, SEGY_AS_NATIVE,
+                                              1.0, 0.0, threads,
+                                              xs.data(), trace0, trace_bsize );
+            CHECK( success( err ) );
+
+            std::vector< double > ys( depths.size() * len );
+            err = segy_read_depth_slices( fp, depths.data(), depths.size(),
+                                          r.start, r.stop, r.step,
+                                          format, SEGY_AS_FLOAT64,
+                                          1.0, 0.0, threads,
+                                          ys.data(), trace0, trace_bsize );
+            CHECK( success( err ) );
+
+            for( std::size_t k = 0; k < depths.size(); ++k ) {
+                for( std::size_t i = 0; i < len; ++i ) {
+                    const float expected =
+                        traces_native[ tracenos[ i ] * samples + depths[ k ] ];
+                    CHECK( xs[ k * len + i ] == expected );
+                    CHECK( ys[ k * len + i ] == double( expected ) );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "depth slices with bad arguments fail",
+                  "[c.segy]" ) {
+    std::vector< float > xs( 2 * traces );
+
+    const int outside[] = { 0, 50 };
+    Err err = segy_read_depth_slices( fp, outside, 2, 0, traces, 1,
+                                      format, SEGY_AS_NATIVE, 1.0, 0.0, 1,
+                                      xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const int negative[] = { -1 };
+    err = segy_read_depth_slices( fp, negative, 1, 0, traces, 1,
+                                  format, SEGY_AS_NATIVE, 1.0, 0.0, 1,
+                                  xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const int valid[] = { 0, 49 };
+    err = segy_read_depth_slices( fp, valid, 2, 0, traces + 1, 1,
+                                  format, SEGY_AS_NATIVE, 1.0, 0.0, 2,
+                                  xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "cube reads match per-trace reads",
+                  "[c.segy]" ) {
+    std::vector< float > traces_native( traces * samples );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         traces_native.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    for( int threads : { 1, 2, 4, 40 } ) {
+        INFO( "threads " << threads );
+
+        std::vector< float > xs( traces * samples );
+        Err err = segy_read_cube( fp, 0, traces, format, SEGY_AS_NATIVE,
+                                  1.0, 0.0,
+                                  threads, xs.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( xs == traces_native );
+
+        std::vector< double > ys( 7 * samples );
+        err = segy_read_cube( fp, 3, 10, format, SEGY_AS_FLOAT64, 1.0, 0.0,
+                              threads, ys.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+        for( int i = 0; i < 7 * samples; ++i )
+            CHECK( ys[ i ] == double( traces_native[ 3 * samples + i ] ) );
+    }
+
+    std::vector< float > xs( traces * samples );
+    Err err = segy_read_cube( fp, 0, traces + 1, format, SEGY_AS_NATIVE,
+                              1.0, 0.0,
+                              2, xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+
+    err = segy_read_cube( fp, 5, 4, format, SEGY_AS_NATIVE, 1.0, 0.0,
+                          2, xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "sub volume matches per-trace reads",
+                  "[c.segy]" ) {
+    std::vector< float > traces_native( traces * samples );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         traces_native.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    struct box { int il0, il1, xl0, xl1, s0, s1; };
+    const std::vector< box > boxes = {
+        { 0, 5, 0, 5, 0, 50 },
+        { 1, 4, 2, 5, 10, 20 },
+        { 4, 5, 0, 1, 49, 50 },
+    };
+
+    for( int sorting : { SEGY_INLINE_SORTING, SEGY_CROSSLINE_SORTING } ) {
+        for( const auto& b : boxes ) {
+            INFO( "sorting " << sorting << ", box "
+                  << b.il0 << ":" << b.il1 << ", "
+                  << b.xl0 << ":" << b.xl1 << ", "
+                  << b.s0 << ":" << b.s1 );
+
+            const int ils = b.il1 - b.il0;
+            const int xls = b.xl1 - b.xl0;
+            const int window = b.s1 - b.s0;
+
+            std::vector< float > xs( ils * xls * window );
+            Err err = segy_read_subvolume( fp, sorting, ilines, xlines,
+                                           offsets, 0,
+                                           b.il0, b.il1, b.xl0, b.xl1,
+                                           b.s0, b.s1,
+                                           format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                           xs.data(), trace0, trace_bsize );
+            CHECK( success( err ) );
+
+            std::vector< float > expected;
+            for( int il = b.il0; il < b.il1; ++il ) {
+                for( int xl = b.xl0; xl < b.xl1; ++xl ) {
+                    const int traceno = sorting == SEGY_INLINE_SORTING
+                                      ? il * xlines + xl
+                                      : xl * ilines + il;
+                    const auto* tr = traces_native.data() + traceno * samples;
+                    expected.insert( expected.end(), tr + b.s0, tr + b.s1 );
+                }
+            }
+
+            CHECK( xs == expected );
+        }
+    }
+
+    /* read the file as if it had 5 inlines of 1 crossline with 5 offsets */
+    std::vector< double > ys( 3 * 4 );
+    Err err = segy_read_subvolume( fp, SEGY_INLINE_SORTING, 5, 1, 5, 2,
+                                   1, 4, 0, 1, 6, 10,
+                                   format, SEGY_AS_FLOAT64, 1.0, 0.0,
+                                   ys.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    for( int i = 0; i < 3; ++i ) {
+        for( int s = 0; s < 4; ++s ) {
+            const int traceno = (1 + i) * 5 + 2;
+            const float expected = traces_native[ traceno * samples + 6 + s ];
+            CHECK( ys[ i * 4 + s ] == double( expected ) );
+        }
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "strided sub volume matches per-trace reads",
+                  "[c.segy]" ) {
+    std::vector< float > traces_native( traces * samples );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         traces_native.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    struct box { int il0, il1, ilstep, xl0, xl1, xlstep, s0, s1, sstep; };
+    const std::vector< box > boxes = {
+        { 0, 5, 2, 0, 5, 1, 0, 50, 1 },
+        { 0, 5, 1, 1, 5, 3, 3, 50, 7 },
+        { 1, 4, 4, 0, 5, 2, 10, 11, 5 },
+        { 0, 5, 2, 0, 5, 2, 0, 50, 2 },
+    };
+
+    for( int sorting : { SEGY_INLINE_SORTING, SEGY_CROSSLINE_SORTING } ) {
+        for( const auto& b : boxes ) {
+            INFO( "sorting " << sorting << ", box "
+                  << b.il0 << ":" << b.il1 << ":" << b.ilstep << ", "
+                  << b.xl0 << ":" << b.xl1 << ":" << b.xlstep << ", "
+                  << b.s0 << ":" << b.s1 << ":" << b.sstep );
+
+            std::vector< float > expected;
+            for( int il = b.il0; il < b.il1; il += b.ilstep ) {
+                for( int xl = b.xl0; xl < b.xl1; xl += b.xlstep ) {
+                    const int traceno = sorting == SEGY_INLINE_SORTING
+                                      ? il * xlines + xl
+                                      : xl * ilines + il;
+                    const auto* tr = traces_native.data() + traceno * samples;
+                    for( int s = b.s0; s < b.s1; s += b.sstep )
+                        expected.push_back( tr[ s ] );
+                }
+            }
+
+            std::vector< float > xs( expected.size() );
+            Err err = segy_read_subvolume_strided( fp, sorting,
+                                                   ilines, xlines,
+                                                   offsets, 0,
+                                                   b.il0, b.il1, b.ilstep,
+                                                   b.xl0, b.xl1, b.xlstep,
+                                                   b.s0, b.s1, b.sstep,
+                                                   format, SEGY_AS_NATIVE,
+                                                   1.0, 0.0, xs.data(),
+                                                   trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( xs == expected );
+        }
+    }
+
+    std::vector< float > xs( traces * samples );
+    Err err = segy_read_subvolume_strided( fp, sorting, ilines, xlines,
+                                           offsets, 0,
+                                           0, 5, 0, 0, 5, 1, 0, samples, 1,
+                                           format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                           xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "sub volume with bad arguments fails",
+                  "[c.segy]" ) {
+    std::vector< float > xs( (ilines + 1) * xlines * samples );
+
+    Err err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 0,
+                                   0, 6, 0, 5, 0, samples,
+                                   format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                   xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 0,
+                               0, 5, 3, 2, 0, samples,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 0,
+                               0, 5, 0, 5, 0, samples + 1,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 1,
+                               0, 5, 0, 5, 0, samples,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    err = segy_read_subvolume( fp, SEGY_UNKNOWN_SORTING, ilines, xlines,
+                               offsets, 0,
+                               0, 5, 0, 5, 0, samples,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    /* geometry that claims more traces than the file has */
+    err = segy_read_subvolume( fp, sorting, ilines + 1, xlines, offsets, 0,
+                               0, 6, 0, 5, 0, samples,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+namespace {
+
+struct segy_brick_fclose {
+    void operator()( segy_bricks* b ) {
+        if( b ) segy_brick_close( b );
+    }
+};
+
+using unique_bricks = std::unique_ptr< segy_bricks, segy_brick_fclose >;
+
+std::string brickname( int bricksize, int compression = SEGY_UNCOMPRESSED ) {
+    return std::string( "small-" ) + std::to_string( bricksize )
+         + "-" + std::to_string( compression )
+         + (testcfg::config().memmap ? "-mmap" : "")
+         + (testcfg::config().lsbit  ? "-lsb"  : "")
+         + ".segyio-bricks";
+}
+
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "brick cache reads match the file",
+                  "[c.segy]" ) {
+    struct box { int l0, l1, t0, t1, s0, s1; };
+    const std::vector< box > boxes = {
+        { 0, 5, 0, 5, 0, 50 },
+        { 2, 3, 0, 5, 0, 50 },
+        { 0, 5, 3, 4, 0, 50 },
+        { 0, 5, 0, 5, 17, 18 },
+        { 1, 4, 2, 5, 10, 37 },
+    };
+
+    for( int compression : { SEGY_UNCOMPRESSED, SEGY_LOSSLESS } )
+    for( int bricksize : { 2, 3, 64 } ) {
+        const auto name = brickname( bricksize, compression );
+        Err err = segy_brick_build( fp, name.c_str(), ilines, xlines, offsets,
+                                    bricksize, compression, 0,
+                                    format, trace0, trace_bsize );
+        REQUIRE( success( err ) );
+
+        unique_bricks ub( segy_brick_open( name.c_str() ) );
+        REQUIRE( ub );
+
+        int lines, line_length, offs, smps, fmt, bsize;
+        err = segy_brick_geometry( ub.get(), &lines, &line_length, &offs,
+                                   &smps, &fmt, &bsize );
+        CHECK( success( err ) );
+        CHECK( lines == ilines );
+        CHECK( line_length == xlines );
+        CHECK( offs == offsets );
+        CHECK( smps == samples );
+        CHECK( fmt == format );
+        CHECK( bsize == bricksize );
+
+        for( const auto& b : boxes ) {
+            INFO( "compression " << compression << ", "
+                  << "bricksize " << bricksize << ", box "
+                  << b.l0 << ":" << b.l1 << ", "
+                  << b.t0 << ":" << b.t1 << ", "
+                  << b.s0 << ":" << b.s1 );
+
+            const std::size_t size = (b.l1 - b.l0) * (b.t1 - b.t0)
+                                   * (b.s1 - b.s0);
+            std::vector< float > expected( size );
+            err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 0,
+                                       b.l0, b.l1, b.t0, b.t1, b.s0, b.s1,
+                                       format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                       expected.data(), trace0, trace_bsize );
+            REQUIRE( success( err ) );
+
+            std::vector< float > xs( size );
+            err = segy_brick_read( ub.get(), 0,
+                                   b.l0, b.l1, b.t0, b.t1, b.s0, b.s1,
+                                   xs.data() );
+            CHECK( success( err ) );
+            CHECK( xs == expected );
+        }
+
+        std::vector< float > xs( samples );
+        err = segy_brick_read( ub.get(), 1, 0, 1, 0, 1, 0, samples, xs.data() );
+        CHECK( err == Err::args() );
+        err = segy_brick_read( ub.get(), 0, 0, 6, 0, 1, 0, 1, xs.data() );
+        CHECK( err == Err::args() );
+        err = segy_brick_read( ub.get(), 0, 0, 1, 0, 1, 0, 51, xs.data() );
+        CHECK( err == Err::args() );
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "brick cache of pre-stack geometry reads offsets",
+                  "[c.segy]" ) {
+    /* read the file as if it had 5 lines of 1 trace with 5 offsets */
+    const auto name = brickname( 4 );
+    Err err = segy_brick_build( fp, name.c_str(), 5, 1, 5, 4,
+                                SEGY_UNCOMPRESSED, 0,
+                                format, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    unique_bricks ub( segy_brick_open( name.c_str() ) );
+    REQUIRE( ub );
+
+    for( int offset = 0; offset < 5; ++offset ) {
+        std::vector< float > expected( 5 * samples );
+        err = segy_read_subvolume( fp, SEGY_INLINE_SORTING, 5, 1, 5, offset,
+                                   0, 5, 0, 1, 0, samples,
+                                   format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                   expected.data(), trace0, trace_bsize );
+        REQUIRE( success( err ) );
+
+        std::vector< float > xs( expected.size() );
+        err = segy_brick_read( ub.get(), offset, 0, 5, 0, 1, 0, samples,
+                               xs.data() );
+        CHECK( success( err ) );
+        CHECK( xs == expected );
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "lossy brick cache is within tolerance",
+                  "[c.segy]" ) {
+    const auto name = brickname( 3, SEGY_LOSSY );
+    const double tolerance = 1e-3;
+    Err err = segy_brick_build( fp, name.c_str(), ilines, xlines, offsets, 3,
+                                SEGY_LOSSY, tolerance,
+                                format, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    unique_bricks ub( segy_brick_open( name.c_str() ) );
+    REQUIRE( ub );
+
+    const std::size_t size = ilines * xlines * samples;
+    std::vector< float > expected( size );
+    err = segy_read_subvolume( fp, sorting, ilines, xlines, offsets, 0,
+                               0, ilines, 0, xlines, 0, samples,
+                               format, SEGY_AS_NATIVE, 1.0, 0.0,
+                               expected.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( size );
+    err = segy_brick_read( ub.get(), 0, 0, ilines, 0, xlines, 0, samples,
+                           xs.data() );
+    CHECK( success( err ) );
+
+    for( std::size_t i = 0; i < size; ++i ) {
+        const double eps = std::abs( expected[ i ] ) * FLT_EPSILON;
+        CHECK( xs[ i ] == Approx( expected[ i ] ).margin( tolerance + eps ) );
+    }
+
+    err = segy_brick_build( fp, name.c_str(), ilines, xlines, offsets, 3,
+                            SEGY_LOSSY, 0,
+                            format, trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "brick cache records the size of its file",
+                  "[c.segy]" ) {
+    const auto name = brickname( 2 );
+    Err err = segy_brick_build( fp, name.c_str(), ilines, xlines, offsets, 2,
+                                SEGY_UNCOMPRESSED, 0,
+                                format, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    unique_bricks ub( segy_brick_open( name.c_str() ) );
+    REQUIRE( ub );
+
+    long long size = -1;
+    err = segy_brick_source_size( ub.get(), &size );
+    CHECK( success( err ) );
+    CHECK( size == trace0 + traces * (SEGY_TRACE_HEADER_SIZE + trace_bsize) );
+}
+
+TEST_CASE( "opening a file that is not a brick cache fails", "[c.segy]" ) {
+    CHECK( !segy_brick_open( "test-data/small.sgy" ) );
+    CHECK( !segy_brick_open( "not-exist" ) );
+}
+
+namespace {
+
+std::vector< float > seismic( std::size_t n ) {
+    std::vector< float > xs( n );
+    for( std::size_t i = 0; i < n; ++i )
+        xs[ i ] = 1000 * std::sin( i * 0.05 ) * std::exp( -double( i ) / n )
+                + float( (i * 7919) % 13 ) / 7;
+    return xs;
+}
+
+}
+
+TEST_CASE( "lossless compression round-trips", "[c.segy]" ) {
+    const auto floats = seismic( 5000 );
+
+    for( int elemsize : { 1, 2, 4, 8 } ) {
+        INFO( "elemsize " << elemsize );
+        const long long samples = floats.size() * sizeof( float ) / elemsize;
+
+        std::vector< char > packed( segy_compress_bound( samples, elemsize ) );
+        long long size = -1;
+        Err err = segy_compress( floats.data(), samples, elemsize, 0,
+                                 packed.data(), &size );
+        REQUIRE( success( err ) );
+        CHECK( size <= (long long)packed.size() );
+
+        std::vector< float > xs( floats.size() );
+        err = segy_decompress( packed.data(), size, samples, elemsize,
+                               xs.data() );
+        CHECK( success( err ) );
+        CHECK( xs == floats );
+    }
+}
+
+TEST_CASE( "lossless compression round-trips across decode chunks",
+           "[c.segy]" ) {
+    /* mostly very short codes, with the odd long one */
+    std::vector< unsigned char > bytes( 8 * 9001 );
+    unsigned int x = 1;
+    for( auto& b : bytes ) {
+        x = x * 1103515245 + 12345;
+        const int r = (x >> 16) % 100;
+        b = r < 60 ? 0 : r < 90 ? r % 4 : (x >> 8) & 0xFF;
+    }
+
+    for( int elemsize : { 1, 2, 4, 8 } )
+    for( long long samples : { 1, 15, 17, 4096, 4113, 9001 } ) {
+        INFO( "elemsize " << elemsize << ", samples " << samples );
+        const std::vector< unsigned char > src( bytes.begin(),
+                                                bytes.begin()
+                                                + samples * elemsize );
+
+        std::vector< char > packed( segy_compress_bound( samples, elemsize ) );
+        long long size = -1;
+        Err err = segy_compress( src.data(), samples, elemsize, 0,
+                                 packed.data(), &size );
+        REQUIRE( success( err ) );
+
+        std::vector< unsigned char > xs( src.size() );
+        err = segy_decompress( packed.data(), size, samples, elemsize,
+                               xs.data() );
+        CHECK( success( err ) );
+        CHECK( xs == src );
+    }
+}
+
+TEST_CASE( "compression of repetitive samples is small", "[c.segy]" ) {
+    const std::vector< float > zeros( 10000, 0.0f );
+    std::vector< char > packed( segy_compress_bound( zeros.size(), 4 ) );
+    long long size = -1;
+    Err err = segy_compress( zeros.data(), zeros.size(), 4, 0,
+                             packed.data(), &size );
+    REQUIRE( success( err ) );
+    CHECK( size < 16 );
+
+    std::vector< float > alternating( 10000 );
+    for( std::size_t i = 0; i < alternating.size(); ++i )
+        alternating[ i ] = i % 2 ? 1.5f : -1.5f;
+
+    err = segy_compress( alternating.data(), alternating.size(), 4, 0,
+                         packed.data(), &size );
+    REQUIRE( success( err ) );
+    CHECK( size < (long long)alternating.size() );
+
+    std::vector< float > xs( alternating.size() );
+    err = segy_decompress( packed.data(), size, xs.size(), 4, xs.data() );
+    CHECK( success( err ) );
+    CHECK( xs == alternating );
+}
+
+TEST_CASE( "lossy compression is within tolerance", "[c.segy]" ) {
+    const auto floats = seismic( 5000 );
+
+    for( double tolerance : { 1e-4, 1e-2, 1.0, 50.0 } ) {
+        INFO( "tolerance " << tolerance );
+        std::vector< char > packed( segy_compress_bound( floats.size(), 4 ) );
+        long long lossless = -1;
+        Err err = segy_compress( floats.data(), floats.size(), 4, 0,
+                                 packed.data(), &lossless );
+        REQUIRE( success( err ) );
+
+        long long size = -1;
+        err = segy_compress( floats.data(), floats.size(), 4, tolerance,
+                             packed.data(), &size );
+        REQUIRE( success( err ) );
+        CHECK( size < lossless );
+
+        std::vector< float > xs( floats.size() );
+        err = segy_decompress( packed.data(), size, xs.size(), 4, xs.data() );
+        CHECK( success( err ) );
+
+        /* the decompressed samples are floats, so allow for float rounding */
+        for( std::size_t i = 0; i < xs.size(); ++i ) {
+            const double eps = std::abs( floats[ i ] ) * FLT_EPSILON;
+            CHECK( xs[ i ] == Approx( floats[ i ] ).margin( tolerance + eps ) );
+        }
+    }
+}
+
+TEST_CASE( "lossy compression of non-finite samples is lossless",
+           "[c.segy]" ) {
+    auto floats = seismic( 100 );
+    floats[ 50 ] = std::numeric_limits< float >::infinity();
+
+    std::vector< char > packed( segy_compress_bound( floats.size(), 4 ) );
+    long long size = -1;
+    Err err = segy_compress( floats.data(), floats.size(), 4, 0.1,
+                             packed.data(), &size );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( floats.size() );
+    err = segy_decompress( packed.data(), size, xs.size(), 4, xs.data() );
+    CHECK( success( err ) );
+    CHECK( xs == floats );
+}
+
+TEST_CASE( "compression with bad arguments fails", "[c.segy]" ) {
+    const auto floats = seismic( 100 );
+    std::vector< char > packed( segy_compress_bound( floats.size(), 4 ) );
+    long long size = -1;
+
+    CHECK( segy_compress_bound( 10, 3 ) < 0 );
+    Err err = segy_compress( floats.data(), floats.size(), 3, 0,
+                             packed.data(), &size );
+    CHECK( err == Err::args() );
+    err = segy_compress( floats.data(), floats.size(), 4, -1,
+                         packed.data(), &size );
+    CHECK( err == Err::args() );
+    err = segy_compress( floats.data(), floats.size() * 2, 2, 0.1,
+                         packed.data(), &size );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE( "decompressing corrupt blocks fails", "[c.segy]" ) {
+    const auto floats = seismic( 1000 );
+    std::vector< char > packed( segy_compress_bound( floats.size(), 4 ) );
+    long long size = -1;
+    Err err = segy_compress( floats.data(), floats.size(), 4, 0,
+                             packed.data(), &size );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( floats.size() );
+    err = segy_decompress( packed.data(), size - 1, xs.size(), 4, xs.data() );
+    CHECK( err == Err::args() );
+    err = segy_decompress( packed.data(), size, xs.size(), 2, xs.data() );
+    CHECK( err == Err::args() );
+    err = segy_decompress( packed.data(), 1, xs.size(), 4, xs.data() );
+    CHECK( err == Err::args() );
+
+    packed[ 0 ] = 7;
+    err = segy_decompress( packed.data(), size, xs.size(), 4, xs.data() );
+    CHECK( err == Err::args() );
+}
+
+namespace {
+
+std::string containername( int compression ) {
+    return std::string( "small-container-" ) + std::to_string( compression )
+         + (testcfg::config().memmap ? "-mmap" : "")
+         + (testcfg::config().lsbit  ? "-lsb"  : "")
+         + ".sgy";
+}
+
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "compressed-trace container reads like the file",
+                  "[c.segy]" ) {
+    for( int compression : { SEGY_LOSSLESS, SEGY_LOSSY } ) {
+        INFO( "compression " << compression );
+        const double tolerance = compression == SEGY_LOSSY ? 1e-3 : 0;
+        const auto name = containername( compression );
+
+        /* blocks of 4 traces, so the last block is partial */
+        Err err = segy_container_build( fp, name.c_str(), compression,
+                                        tolerance, 4,
+                                        format, trace0, trace_bsize );
+        REQUIRE( success( err ) );
+
+        unique_segy ufp( segy_open( name.c_str(), "rb" ) );
+        REQUIRE( ufp );
+        /* the container is compressed on disk, so it can't be mapped */
+        testcfg::config().lsb( ufp.get() );
+        segy_file* cfp = ufp.get();
+        CHECK( segy_mmap( cfp ) == SEGY_MMAP_INVALID );
+
+        char text[ SEGY_TEXT_HEADER_SIZE + 1 ] = {};
+        char ctext[ SEGY_TEXT_HEADER_SIZE + 1 ] = {};
+        REQUIRE( success( segy_read_textheader( fp, text ) ) );
+        CHECK( success( segy_read_textheader( cfp, ctext ) ) );
+        CHECK( std::string( text ) == std::string( ctext ) );
+
+        char bin[ SEGY_BINARY_HEADER_SIZE ];
+        char cbin[ SEGY_BINARY_HEADER_SIZE ];
+        REQUIRE( success( segy_binheader( fp, bin ) ) );
+        CHECK( success( segy_binheader( cfp, cbin ) ) );
+        CHECK( std::memcmp( bin, cbin, sizeof( bin ) ) == 0 );
+
+        int count = -1;
+        err = segy_traces( cfp, &count, trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( count == traces );
+
+        for( int i = 0; i < traces; ++i ) {
+            INFO( "trace " << i );
+            char header[ SEGY_TRACE_HEADER_SIZE ];
+            char cheader[ SEGY_TRACE_HEADER_SIZE ];
+            err = segy_traceheader( fp, i, header, trace0, trace_bsize );
+            REQUIRE( success( err ) );
+            err = segy_traceheader( cfp, i, cheader, trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( std::memcmp( header, cheader, sizeof( header ) ) == 0 );
+
+            std::vector< float > expected( samples );
+            std::vector< float > xs( samples );
+            err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0, expected.data(),
+                                         trace0, trace_bsize );
+            REQUIRE( success( err ) );
+            err = segy_readtrace_native( cfp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0, xs.data(),
+                                         trace0, trace_bsize );
+            CHECK( success( err ) );
+
+            if( compression == SEGY_LOSSLESS ) {
+                CHECK( xs == expected );
+                continue;
+            }
+
+            /* ibm floats have a coarser mantissa than the decoded floats */
+            for( int k = 0; k < samples; ++k ) {
+                const double eps = std::abs( expected[ k ] ) * 1e-6;
+                CHECK( xs[ k ] == Approx( expected[ k ] )
+                                  .margin( tolerance + eps ) );
+            }
+        }
+
+        /*
+         * there are more blocks than the handle caches, so reading back to
+         * front, and from many threads, decodes blocks again
+         */
+        for( int i = traces - 1; i >= 0; --i ) {
+            INFO( "trace " << i );
+            char header[ SEGY_TRACE_HEADER_SIZE ];
+            char cheader[ SEGY_TRACE_HEADER_SIZE ];
+            err = segy_traceheader( fp, i, header, trace0, trace_bsize );
+            REQUIRE( success( err ) );
+            err = segy_traceheader( cfp, i, cheader, trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( std::memcmp( header, cheader, sizeof( header ) ) == 0 );
+        }
+
+        if( compression != SEGY_LOSSLESS ) continue;
+
+        std::vector< float > cube( traces * samples );
+        std::vector< float > ccube( traces * samples );
+        err = segy_read_cube( fp, 0, traces, format, SEGY_AS_NATIVE,
+                              1.0, 0.0, 1, cube.data(), trace0, trace_bsize );
+        REQUIRE( success( err ) );
+        err = segy_read_cube( cfp, 0, traces, format, SEGY_AS_NATIVE,
+                              1.0, 0.0, 4, ccube.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( ccube == cube );
+    }
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "compressed-trace container is read-only and validated",
+                  "[c.segy]" ) {
+    const auto name = containername( SEGY_LOSSLESS );
+    Err err = segy_container_build( fp, name.c_str(), SEGY_LOSSLESS, 0, 10,
+                                    format, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    CHECK( !segy_open( name.c_str(), "r+b" ) );
+
+    /* a truncated container is corrupt */
+    std::ifstream in( name, std::ios::binary );
+    std::string bytes( (std::istreambuf_iterator< char >( in )),
+                       std::istreambuf_iterator< char >() );
+    const auto truncated = name + ".truncated";
+    {
+        std::ofstream out( truncated, std::ios::binary );
+        out.write( bytes.data(), bytes.size() - 10 );
+    }
+    CHECK( !segy_open( truncated.c_str(), "rb" ) );
+
+    err = segy_container_build( fp, name.c_str(), SEGY_UNCOMPRESSED, 0, 10,
+                                format, trace0, trace_bsize );
+    CHECK( err == Err::args() );
+    err = segy_container_build( fp, name.c_str(), SEGY_LOSSY, 0, 10,
+                                format, trace0, trace_bsize );
+    CHECK( err == Err::args() );
+    err = segy_container_build( fp, name.c_str(), SEGY_LOSSLESS, 0, 0,
+                                format, trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallbasic,
+                  "positional read past end-of-file fails",
+                  "[c.segy]" ) {
+    std::vector< float > xs( samples );
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    Err err = segy_pread_trace( fp, 25, xs.data(), trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+    err = segy_pread_traceheader( fp, 25, header, trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+TEST_CASE_METHOD( smallstep,
+                  "cached trace reads match uncached reads",
+                  "[c.segy]" ) {
+    const int traces = 25;
+    std::vector< float > expected( traces * samples );
+    std::vector< char > headers( traces * SEGY_TRACE_HEADER_SIZE );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         expected.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+        err = segy_traceheader( fp, i,
+                                headers.data() + i * SEGY_TRACE_HEADER_SIZE,
+                                trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    /* room for two blocks of three traces */
+    const long long bytes = 2 * 3 * (SEGY_TRACE_HEADER_SIZE + trace_bsize);
+    Err err = segy_set_cache( fp, bytes, 3, format );
+    REQUIRE( success( err ) );
+
+    /* back and forth, so that blocks are both re-used and evicted */
+    const std::vector< int > order = { 0, 1, 2, 0, 4, 1, 24, 23, 3, 24, 0, 13 };
+    for( int traceno : order ) {
+        INFO( "trace " << traceno );
+
+        char header[ SEGY_TRACE_HEADER_SIZE ];
+        err = segy_traceheader( fp, traceno, header, trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( std::equal( header, header + SEGY_TRACE_HEADER_SIZE,
+                           headers.begin() + traceno * SEGY_TRACE_HEADER_SIZE ) );
+
+        std::vector< float > xs( samples );
+        err = segy_readtrace_native( fp, traceno, format, SEGY_AS_NATIVE,
+                                     1.0, 0.0,
+                                     xs.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( std::equal( xs.begin(), xs.end(),
+                           expected.begin() + traceno * samples ) );
+
+        std::vector< float > sub( 10 );
+        err = segy_readsubtr_native( fp, traceno, 40, 20, -2,
+                                     format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                     sub.data(), nullptr,
+                                     trace0, trace_bsize );
+        CHECK( success( err ) );
+        for( int i = 0; i < 10; ++i )
+            CHECK( sub[ i ] == expected[ traceno * samples + 40 - 2 * i ] );
+    }
+
+    std::vector< std::int64_t > tracenos( order.begin(), order.end() );
+    std::vector< float > xs( order.size() * samples );
+    err = segy_readtraces_native( fp, tracenos.data(), tracenos.size(), 0,
+                                  format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                  xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    for( std::size_t i = 0; i < order.size(); ++i )
+        CHECK( std::equal( xs.begin() + i * samples,
+                           xs.begin() + (i + 1) * samples,
+                           expected.begin() + order[ i ] * samples ) );
+
+    long long hits, misses;
+    err = segy_cache_stats( fp, &hits, &misses );
+    CHECK( success( err ) );
+    CHECK( hits + misses == 3 * 12 + 12 );
+    CHECK( misses < hits );
+
+    /* past the end is not cached, and fails like without the cache */
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    err = segy_traceheader( fp, traces, header, trace0, trace_bsize );
+    CHECK( !success( err ) );
+
+    err = segy_set_cache( fp, 0, 1, format );
+    CHECK( success( err ) );
+    err = segy_cache_stats( fp, &hits, &misses );
+    CHECK( hits == 0 );
+    CHECK( misses == 0 );
+}
+
+TEST_CASE_METHOD( smallstep,
+                  "repeated reads of a cached trace are hits",
+                  "[c.segy]" ) {
+    Err err = segy_set_cache( fp, 1 << 20, 4, format );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( samples );
+    for( int i = 0; i < 5; ++i ) {
+        err = segy_readtrace_native( fp, traceno, format, SEGY_AS_NATIVE,
+                                     1.0, 0.0,
+                                     xs.data(), trace0, trace_bsize );
+        CHECK( success( err ) );
+    }
+
+    /* the neighbour is in the same block */
+    err = segy_readtrace_native( fp, traceno + 1, format, SEGY_AS_NATIVE,
+                                 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+
+    long long hits, misses;
+    segy_cache_stats( fp, &hits, &misses );
+    CHECK( misses == 1 );
+    CHECK( hits == 5 );
+
+    err = segy_set_cache( fp, -1, 4, format );
+    CHECK( err == Err::args() );
+    err = segy_set_cache( fp, 1 << 20, 0, format );
+    CHECK( err == Err::args() );
+    err = segy_set_cache( fp, 1 << 20, 4, SEGY_SIGNED_SHORT_2_BYTE );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallstep,
+                  "reads with readahead match reads without",
+                  "[c.segy]" ) {
+    const int traces = 25;
+    std::vector< float > expected( traces * samples );
+    std::vector< char > headers( traces * SEGY_TRACE_HEADER_SIZE );
+    for( int i = 0; i < traces; ++i ) {
+        Err err = segy_readtrace_native( fp, i, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         expected.data() + i * samples,
+                                         trace0, trace_bsize );
+        REQUIRE( success( err ) );
+        err = segy_traceheader( fp, i,
+                                headers.data() + i * SEGY_TRACE_HEADER_SIZE,
+                                trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    struct pattern { int first, step; };
+    const std::vector< pattern > patterns = {
+        { 0, 1 }, { 0, 5 }, { 24, -1 }, { 22, -3 },
+    };
+
+    for( long long bytes : { 1LL, 1000LL, 1LL << 20 } )
+    for( const auto& p : patterns ) {
+        INFO( "readahead " << bytes << ", "
+              << "first " << p.first << ", step " << p.step );
+        Err err = segy_set_readahead( fp, bytes );
+        REQUIRE( success( err ) );
+
+        for( int t = p.first; t >= 0 && t < traces; t += p.step ) {
+            char header[ SEGY_TRACE_HEADER_SIZE ];
+            err = segy_traceheader( fp, t, header, trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( std::equal( header, header + SEGY_TRACE_HEADER_SIZE,
+                               headers.begin() + t * SEGY_TRACE_HEADER_SIZE ) );
+
+            std::vector< float > xs( samples );
+            err = segy_readtrace_native( fp, t, format, SEGY_AS_NATIVE,
+                                         1.0, 0.0,
+                                         xs.data(), trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( std::equal( xs.begin(), xs.end(),
+                               expected.begin() + t * samples ) );
+        }
+
+        for( int line = 0; line < 5; ++line ) {
+            std::vector< float > xs( 5 * samples );
+            err = segy_read_line_native( fp, line * 5, 5, 1, 1,
+                                         format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                         xs.data(), trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( std::equal( xs.begin(), xs.end(),
+                               expected.begin() + line * 5 * samples ) );
+        }
+    }
+
+    Err err = segy_set_readahead( fp, -1 );
+    CHECK( err == Err::args() );
+    err = segy_set_readahead( fp, 0 );
+    CHECK( success( err ) );
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "header scans with readahead match scans without",
+                  "[c.segy]" ) {
+    std::vector< int > expected( 25 );
+    Err err = segy_field_forall( fp, il, 0, 25, 1, expected.data(),
+                                 trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    for( long long blocksize : { 240LL, 1000LL } ) {
+        err = segy_set_scan_blocksize( fp, blocksize );
+        REQUIRE( success( err ) );
+        err = segy_set_readahead( fp, 1 << 20 );
+        REQUIRE( success( err ) );
+
+        std::vector< int > xs( 25 );
+        err = segy_field_forall( fp, il, 0, 25, 1, xs.data(),
+                                 trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( xs == expected );
+
+        err = segy_field_forall( fp, il, 24, -1, -1, xs.data(),
+                                 trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( std::equal( xs.rbegin(), xs.rend(), expected.begin() ) );
+    }
+}
+
+TEST_CASE( "header scans see preceding writes", "[c.segy]" ) {
+    const std::string name = std::string( "scan-write" )
+                           + (testcfg::config().memmap ? "-mmap" : "")
+                           + (testcfg::config().lsbit  ? "-lsb"  : "")
+                           + ".sgy";
+    copyfile( "test-data/small.sgy", name );
+    unique_segy ufp( openfile( name, "r+b" ) );
+    auto fp = ufp.get();
+
+    const long trace0 = 3600;
+    const int trace_bsize = 50 * 4;
+
+    int offset = 55;
+    for( long long blocksize : { 0LL, 1LL << 24 } ) {
+        Err err = segy_set_scan_blocksize( fp, blocksize );
+        REQUIRE( success( err ) );
+
+        char header[ SEGY_TRACE_HEADER_SIZE ];
+        err = segy_traceheader( fp, 0, header, trace0, trace_bsize );
+        REQUIRE( success( err ) );
+        err = segy_set_field( header, SEGY_TR_OFFSET, offset );
+        REQUIRE( success( err ) );
+        err = segy_write_traceheader( fp, 0, header, trace0, trace_bsize );
+        REQUIRE( success( err ) );
+
+        int x = 0;
+        err = segy_offset_indices( fp, SEGY_TR_OFFSET, 1, &x,
+                                   trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( x == offset );
+
+        offset += 1;
+    }
+}
+
+TEST_CASE( "writing through a cached handle drops the cache", "[c.segy]" ) {
+    const std::string name = std::string( "cache-write" )
+                           + (testcfg::config().memmap ? "-mmap" : "")
+                           + (testcfg::config().lsbit  ? "-lsb"  : "")
+                           + ".sgy";
+    copyfile( "test-data/small.sgy", name );
+    unique_segy ufp( openfile( name, "r+b" ) );
+    auto fp = ufp.get();
+
+    const long trace0 = 3600;
+    const int trace_bsize = 50 * 4;
+    const int format = SEGY_IBM_FLOAT_4_BYTE;
+
+    Err err = segy_set_cache( fp, 1 << 20, 8, format );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( 50 );
+    err = segy_readtrace_native( fp, 3, format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< float > written( 50 );
+    std::iota( written.begin(), written.end(), 1.0f );
+    std::vector< float > raw = written;
+    segy_from_native( format, raw.size(), raw.data() );
+    err = segy_writetrace( fp, 3, raw.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    err = segy_readtrace_native( fp, 3, format, SEGY_AS_NATIVE, 1.0, 0.0,
+                                 xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( xs == written );
+
+    char header[ SEGY_TRACE_HEADER_SIZE ];
+    err = segy_traceheader( fp, 3, header, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+    segy_set_field( header, SEGY_TR_INLINE, 1234 );
+    err = segy_write_traceheader( fp, 3, header, trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    err = segy_traceheader( fp, 3, header, trace0, trace_bsize );
+    CHECK( success( err ) );
+    int il;
+    segy_get_field( header, SEGY_TR_INLINE, &il );
+    CHECK( il == 1234 );
+}
+
+TEST_CASE_METHOD( smallcube,
+                  "geometry index of a sorted file matches its lines",
+                  "[c.segy]" ) {
+    std::vector< int > keys( 3 * traces );
+    Err err = segy_scan_geometry( fp, il, xl, of, 0, traces, 1, keys.data(),
+                                  trace0, trace_bsize );
+    REQUIRE( success( err ) );
+    const int offset = keys[ 2 ];
+
+    std::vector< std::int64_t > order( traces );
+    err = segy_sort_geometry( keys.data(), traces,
+                              SEGY_INLINE_SORTING, order.data() );
+    REQUIRE( success( err ) );
+
+    long long first = -1, count = -1;
+    err = segy_geometry_line( keys.data(), order.data(), traces,
+                              SEGY_INLINE_SORTING, 3, &first, &count );
+    CHECK( success( err ) );
+    CHECK( count == xlines );
+    const std::vector< std::int64_t > inline3( order.begin() + first,
+                                               order.begin() + first + count );
+    CHECK( inline3 == std::vector< std::int64_t >{ 10, 11, 12, 13, 14 } );
+
+    /* reading the traces of the line gives the same as reading the line */
+    std::vector< float > line( samples * count );
+    std::vector< float > viaindex( line.size() );
+    err = segy_read_line_native( fp, 10, xlines, stride, offsets,
+                                 format, SEGY_AS_NATIVE, 1.0, 0.0, line.data(),
+                                 trace0, trace_bsize );
+    REQUIRE( success( err ) );
+    err = segy_readtraces_native( fp, inline3.data(), count, 0,
+                                  format, SEGY_AS_NATIVE,
+                                  1.0, 0.0, viaindex.data(),
+                                  trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( viaindex == line );
+
+    std::vector< float > readline( line.size() );
+    long long read = -1;
+    err = segy_geometry_read_line( fp, keys.data(), order.data(), traces,
+                                   SEGY_INLINE_SORTING, 3, offset, 0,
+                                   format, SEGY_AS_NATIVE,
+                                   1.0, 0.0, readline.data(),
+                                   &read, trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( read == xlines );
+    CHECK( readline == line );
+
+    err = segy_geometry_read_line( fp, keys.data(), order.data(), traces,
+                                   SEGY_INLINE_SORTING, 3, offset + 1, 0,
+                                   format, SEGY_AS_NATIVE,
+                                   1.0, 0.0, readline.data(),
+                                   &read, trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( read == 0 );
+
+    err = segy_geometry_read_line( fp, keys.data(), order.data(), traces,
+                                   SEGY_INLINE_SORTING, 6, offset, 0,
+                                   format, SEGY_AS_NATIVE,
+                                   1.0, 0.0, readline.data(),
+                                   &read, trace0, trace_bsize );
+    CHECK( err == SEGY_MISSING_LINE_INDEX );
+
+    err = segy_sort_geometry( keys.data(), traces,
+                              SEGY_CROSSLINE_SORTING, order.data() );
+    REQUIRE( success( err ) );
+    err = segy_geometry_line( keys.data(), order.data(), traces,
+                              SEGY_CROSSLINE_SORTING, 22, &first, &count );
+    CHECK( success( err ) );
+    const std::vector< std::int64_t > xline22( order.begin() + first,
+                                               order.begin() + first + count );
+    CHECK( xline22 == std::vector< std::int64_t >{ 2, 7, 12, 17, 22 } );
+
+    std::int64_t traceno = -1;
+    err = segy_geometry_find( keys.data(), order.data(), traces,
+                              SEGY_CROSSLINE_SORTING, 4, 23, offset,
+                              &traceno );
+    CHECK( success( err ) );
+    CHECK( traceno == 18 );
+
+    err = segy_geometry_line( keys.data(), order.data(), traces,
+                              SEGY_CROSSLINE_SORTING, 25, &first, &count );
+    CHECK( err == SEGY_MISSING_LINE_INDEX );
+
+    err = segy_geometry_find( keys.data(), order.data(), traces,
+                              SEGY_CROSSLINE_SORTING, 6, 23, offset,
+                              &traceno );
+    CHECK( err == SEGY_NOTFOUND );
+
+    err = segy_sort_geometry( keys.data(), traces,
+                              SEGY_UNKNOWN_SORTING, order.data() );
+    CHECK( err == SEGY_INVALID_SORTING );
+}
+
+TEST_CASE_METHOD( smallsize,
+                  "geometry scan split across threads",
+                  "[c.segy]" ) {
+    std::vector< int > expected( 3 * traces );
+    Err err = segy_scan_geometry( fp, il, xl, of, 0, traces, 1,
+                                  expected.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< int > keys( expected.size() );
+    err = segy_scan_geometry( fp, il, xl, of, 0, traces, 3, keys.data(),
+                              trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( keys == expected );
+
+    /* callers can also split the scan themselves */
+    const int nthreads = 3;
+    std::fill( keys.begin(), keys.end(), 0 );
+    std::vector< int > errs( nthreads, SEGY_OK );
+    std::vector< std::thread > workers;
+    for( int t = 0; t < nthreads; ++t ) {
+        workers.emplace_back( [&, t] {
+            const int start = traces * t / nthreads;
+            const int stop  = traces * (t + 1) / nthreads;
+            errs[ t ] = segy_scan_geometry( fp, il, xl, of, start, stop, 1,
+                                            keys.data() + 3 * start,
+                                            trace0, trace_bsize );
+        });
+    }
+    for( auto& w : workers ) w.join();
+
+    CHECK( errs == std::vector< int >( nthreads, SEGY_OK ) );
+    CHECK( keys == expected );
+
+    err = segy_scan_geometry( fp, il + 1, xl, of, 0, traces, 1, keys.data(),
+                              trace0, trace_bsize );
+    CHECK( err == SEGY_INVALID_FIELD );
+}
+
+TEST_CASE( "geometry index of shuffled traces with holes", "[c.segy]" ) {
+    /* (il, xl, offset), pre-stack, shuffled, with (2, 11, 1) missing */
+    const std::vector< int > keys = {
+        2, 10, 2,
+        1, 11, 1,
+        2, 10, 1,
+        1, 10, 2,
+        3, 11, 2,
+        1, 10, 1,
+        2, 11, 2,
+        1, 11, 2,
+        3, 10, 1,
+        3, 11, 1,
+        3, 10, 2,
+        2, 10, 1,
+    };
+    const long long n = keys.size() / 3;
+
+    std::vector< std::int64_t > order( n );
+    Err err = segy_sort_geometry( keys.data(), n,
+                                  SEGY_INLINE_SORTING, order.data() );
+    REQUIRE( success( err ) );
+
+    long long first = -1, count = -1;
+    err = segy_geometry_line( keys.data(), order.data(), n,
+                              SEGY_INLINE_SORTING, 2, &first, &count );
+    CHECK( success( err ) );
+    /* the duplicated (2, 10, 1) keeps file order, before offset 2 */
+    const std::vector< std::int64_t > line2( order.begin() + first,
+                                             order.begin() + first + count );
+    CHECK( line2 == std::vector< std::int64_t >{ 2, 11, 0, 6 } );
+
+    err = segy_sort_geometry( keys.data(), n,
+                              SEGY_CROSSLINE_SORTING, order.data() );
+    REQUIRE( success( err ) );
+    err = segy_geometry_line( keys.data(), order.data(), n,
+                              SEGY_CROSSLINE_SORTING, 11, &first, &count );
+    CHECK( success( err ) );
+    const std::vector< std::int64_t > xline11( order.begin() + first,
+                                               order.begin() + first + count );
+    CHECK( xline11 == std::vector< std::int64_t >{ 1, 7, 6, 9, 4 } );
+
+    std::int64_t traceno = -1;
+    err = segy_geometry_find( keys.data(), order.data(), n,
+                              SEGY_CROSSLINE_SORTING, 3, 10, 2, &traceno );
+    CHECK( success( err ) );
+    CHECK( traceno == 10 );
+
+    err = segy_geometry_find( keys.data(), order.data(), n,
+                              SEGY_CROSSLINE_SORTING, 2, 11, 1, &traceno );
+    CHECK( err == SEGY_NOTFOUND );
+}
+
+TEST_CASE( "sorting rows is a stable sort", "[c.segy]" ) {
+    const int ncols = 3;
+    const long long n = 5000;
+
+    std::vector< std::int32_t > rows( n * ncols );
+    for( long long i = 0; i < n; ++i ) {
+        /* few distinct values in the first columns, to have many ties */
+        rows[ i * ncols + 0 ] = (i * 7919) % 7 - 3;
+        rows[ i * ncols + 1 ] = ((i * 31) % 3) * (1 << 20) - (1 << 20);
+        rows[ i * ncols + 2 ] = (i * 13) % 5 < 2 ? INT32_MIN : INT32_MAX;
+    }
+
+    /* sort a subset of the rows, in reverse, to check that ties keep order */
+    std::vector< std::int64_t > index;
+    for( long long i = n - 1; i >= 0; i -= 3 ) index.push_back( i );
+
+    std::vector< std::int64_t > expected = index;
+    std::stable_sort( expected.begin(), expected.end(),
+        [&]( std::int64_t a, std::int64_t b ) {
+            return std::lexicographical_compare(
+                rows.begin() + a * ncols, rows.begin() + (a + 1) * ncols,
+                rows.begin() + b * ncols, rows.begin() + (b + 1) * ncols
+            );
+        }
+    );
+
+    Err err = segy_sort_rows( rows.data(), ncols, index.size(), index.data() );
+    CHECK( success( err ) );
+    CHECK( index == expected );
+}
+
+TEST_CASE( "grouping rows keeps the order of appearance", "[c.segy]" ) {
+    /* (fldr, grnofr) of interleaved shots */
+    const std::vector< std::int32_t > rows = {
+        5, 1,
+        2, 1,
+        5, 2,
+        2, 1,
+        -1, 1,
+        5, 1,
+        2, 1,
+        -1, 1,
+    };
+    const long long n = rows.size() / 2;
+
+    std::vector< std::int64_t > index( n, -1 );
+    std::vector< std::int64_t > offsets( n + 1, -1 );
+    long long ngroups = -1;
+    Err err = segy_group_rows( rows.data(), 2, n,
+                               index.data(),
+                               offsets.data(),
+                               &ngroups );
+    CHECK( success( err ) );
+    CHECK( ngroups == 4 );
+
+    const std::vector< std::int64_t > expected_index = {
+        0, 5, 1, 3, 6, 2, 4, 7
+    };
+    const std::vector< std::int64_t > expected_offsets = { 0, 2, 5, 6, 8 };
+    CHECK( index == expected_index );
+    CHECK( std::vector< std::int64_t >( offsets.begin(),
+                                        offsets.begin() + 5 )
+           == expected_offsets );
+
+    err = segy_group_rows( rows.data(), 2, 0,
+                           index.data(),
+                           offsets.data(),
+                           &ngroups );
+    CHECK( success( err ) );
+    CHECK( ngroups == 0 );
+    CHECK( offsets[ 0 ] == 0 );
+}
+
 TEST_CASE_METHOD( smallcube,
                   "reading the first inline gives correct values",
                   "[c.segy]" ) {
@@ -1023,6 +2954,61 @@ TEST_CASE_METHOD( smallcube,
     CHECK_THAT( line, ApproxRange( expected ) );
 }
 
+TEST_CASE( "writing an inline preserves the trace headers",
+           "[c.segy]" ) {
+    const std::string name = std::string( "write-line" )
+                           + (testcfg::config().memmap ? "-mmap" : "")
+                           + (testcfg::config().lsbit  ? "-lsb"  : "")
+                           + ".sgy";
+    copyfile( "test-data/small.sgy", name );
+    unique_segy ufp( openfile( name, "r+b" ) );
+    auto fp = ufp.get();
+
+    const long trace0 = 3600;
+    const int trace_bsize = 50 * 4;
+    const int samples = 50;
+    const int line_length = 5;
+    const int line_trace0 = 10;
+
+    std::vector< char > headers( SEGY_TRACE_HEADER_SIZE * 25 );
+    for( int i = 0; i < 25; ++i ) {
+        Err err = segy_traceheader( fp, i,
+                                    headers.data() + i * SEGY_TRACE_HEADER_SIZE,
+                                    trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    std::vector< float > line( samples * line_length );
+    std::iota( line.begin(), line.end(), 1.0f );
+    segy_from_native( SEGY_IBM_FLOAT_4_BYTE, line.size(), line.data() );
+
+    Err err = segy_write_line( fp, line_trace0, line_length, 1, 1,
+                               line.data(), trace0, trace_bsize );
+    REQUIRE( success( err ) );
+
+    std::vector< float > xs( line.size() );
+    err = segy_read_line( fp, line_trace0, line_length, 1, 1,
+                          xs.data(), trace0, trace_bsize );
+    CHECK( success( err ) );
+    CHECK( xs == line );
+
+    for( int i = 0; i < line_length; ++i ) {
+        std::vector< float > tr( samples );
+        err = segy_readtrace( fp, line_trace0 + i, tr.data(),
+                              trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( std::equal( tr.begin(), tr.end(), line.begin() + i * samples ) );
+    }
+
+    for( int i = 0; i < 25; ++i ) {
+        char header[ SEGY_TRACE_HEADER_SIZE ];
+        err = segy_traceheader( fp, i, header, trace0, trace_bsize );
+        CHECK( success( err ) );
+        const char* expected = headers.data() + i * SEGY_TRACE_HEADER_SIZE;
+        CHECK( std::memcmp( header, expected, SEGY_TRACE_HEADER_SIZE ) == 0 );
+    }
+}
+
 template< int Start, int Stop, int Step >
 struct writesubtr {
     segy_file* fp = nullptr;
@@ -1263,6 +3249,279 @@ TEST_CASE_METHOD( smallfields,
     CHECK_THAT( out, Catch::Equals( crosslines ) );
 }
 
+TEST_CASE_METHOD( smallfields,
+                  "multi-field scan matches single-field scans",
+                  "[c.segy]" ) {
+    const std::vector< int > fields = {
+        il, xl, of, SEGY_TR_CDP_X, SEGY_TR_CDP_Y, SEGY_TR_SAMPLE_COUNT,
+    };
+
+    struct range { int start, stop, step; };
+    const range ranges[] = { { 0, 25, 1 }, { 3, 22, 2 }, { 24, -1, -5 } };
+
+    for( const auto r : ranges ) {
+        const int len = 1 + (r.stop - r.start - (r.step > 0 ? 1 : -1)) / r.step;
+
+        std::vector< std::vector< std::int32_t > > expected;
+        for( int field : fields ) {
+            std::vector< std::int32_t > xs( len );
+            Err err = segy_field_forall( fp, field,
+                                         r.start, r.stop, r.step,
+                                         xs.data(),
+                                         trace0, trace_bsize );
+            REQUIRE( success( err ) );
+            expected.push_back( xs );
+        }
+
+        for( int threads : { 1, 4 } ) {
+            INFO( "range " << r.start << ":" << r.stop << ":" << r.step
+                  << ", threads " << threads );
+
+            std::vector< std::vector< std::int32_t > > cols(
+                fields.size(), std::vector< std::int32_t >( len )
+            );
+            std::vector< std::int32_t* > out;
+            for( auto& col : cols ) out.push_back( col.data() );
+
+            Err err = segy_fields_forall( fp, fields.data(), fields.size(),
+                                          r.start, r.stop, r.step,
+                                          threads,
+                                          out.data(),
+                                          trace0, trace_bsize );
+            CHECK( success( err ) );
+            CHECK( cols == expected );
+        }
+    }
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "multi-field scan with invalid field fails",
+                  "[c.segy]" ) {
+    const int fields[] = { il, SEGY_TR_INLINE + 1 };
+    std::vector< std::int32_t > a( 25 ), b( 25 );
+    std::int32_t* out[] = { a.data(), b.data() };
+
+    Err err = segy_fields_forall( fp, fields, 2, 0, 25, 1, 1, out,
+                                  trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const int valid[] = { il, xl };
+    err = segy_fields_forall( fp, valid, 2, 0, 26, 1, 2, out,
+                              trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "strided multi-field scan fills a row-major table",
+                  "[c.segy]" ) {
+    const std::vector< int > fields = {
+        il, xl, of, SEGY_TR_CDP_X, SEGY_TR_CDP_Y, SEGY_TR_SAMPLE_COUNT,
+    };
+    const int nfields = fields.size();
+    const int start = 3, stop = 22, step = 2, len = 10;
+
+    std::vector< std::vector< std::int32_t > > expected;
+    for( int field : fields ) {
+        std::vector< std::int32_t > xs( len );
+        Err err = segy_field_forall( fp, field, start, stop, step,
+                                     xs.data(),
+                                     trace0, trace_bsize );
+        REQUIRE( success( err ) );
+        expected.push_back( xs );
+    }
+
+    for( int threads : { 1, 3 } ) {
+        INFO( "threads " << threads );
+
+        std::vector< std::int32_t > table( len * nfields );
+        std::vector< std::int32_t* > out;
+        for( int i = 0; i < nfields; ++i ) out.push_back( table.data() + i );
+
+        Err err = segy_fields_forall_strided( fp, fields.data(), nfields,
+                                              start, stop, step,
+                                              threads,
+                                              out.data(), nfields,
+                                              trace0, trace_bsize );
+        CHECK( success( err ) );
+
+        for( int k = 0; k < len; ++k ) {
+            for( int i = 0; i < nfields; ++i )
+                CHECK( table[ k * nfields + i ] == expected[ i ][ k ] );
+        }
+    }
+
+    std::vector< std::int32_t > table( len * nfields );
+    std::vector< std::int32_t* > out( nfields, table.data() );
+    Err err = segy_fields_forall_strided( fp, fields.data(), nfields,
+                                          start, stop, step, 1,
+                                          out.data(), 0,
+                                          trace0, trace_bsize );
+    CHECK( err == Err::args() );
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "field gather matches single-trace scans",
+                  "[c.segy]" ) {
+    const std::vector< int > fields = { il, xl, SEGY_TR_SAMPLE_COUNT };
+    const std::vector< std::int64_t > indices = {
+        24, 0, 7, 7, 13, 1, 23, 0, 12,
+    };
+    const long long n = indices.size();
+
+    std::vector< std::vector< std::int32_t > > expected;
+    for( int field : fields ) {
+        std::vector< std::int32_t > xs;
+        for( auto i : indices ) {
+            std::int32_t x;
+            Err err = segy_field_forall( fp, field, i, i + 1, 1, &x,
+                                         trace0, trace_bsize );
+            REQUIRE( success( err ) );
+            xs.push_back( x );
+        }
+        expected.push_back( xs );
+    }
+
+    for( long long blocksize : { 0LL, 1000LL, 1LL << 24 } ) {
+        INFO( "block size " << blocksize );
+        Err err = segy_set_scan_blocksize( fp, blocksize );
+        REQUIRE( success( err ) );
+
+        std::vector< std::vector< std::int32_t > > cols(
+            fields.size(), std::vector< std::int32_t >( n )
+        );
+        std::vector< std::int32_t* > out;
+        for( auto& col : cols ) out.push_back( col.data() );
+
+        err = segy_field_gather( fp, fields.data(), fields.size(),
+                                 indices.data(), n,
+                                 out.data(),
+                                 trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( cols == expected );
+    }
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "field gather with bad fields or indices fails",
+                  "[c.segy]" ) {
+    std::vector< std::int32_t > xs( 2, -1 );
+    std::int32_t* out[] = { xs.data() };
+
+    const int invalid[] = { il + 1 };
+    const std::int64_t indices[] = { 3, 4 };
+    Err err = segy_field_gather( fp, invalid, 1, indices, 2, out,
+                                 trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const int fields[] = { il };
+    const std::int64_t negative[] = { 3, -1 };
+    err = segy_field_gather( fp, fields, 1, negative, 2, out,
+                             trace0, trace_bsize );
+    CHECK( err == Err::args() );
+
+    const std::int64_t past_end[] = { 25, 3 };
+    err = segy_field_gather( fp, fields, 1, past_end, 2, out,
+                             trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+    CHECK( xs == std::vector< std::int32_t >( 2, -1 ) );
+}
+
+TEST_CASE_METHOD( smallfields,
+                  "trace header gather matches single-trace reads",
+                  "[c.segy]" ) {
+    const std::vector< std::int64_t > indices = { 24, 0, 7, 7, 13, 1, 23 };
+    const long long n = indices.size();
+
+    std::vector< char > expected( n * SEGY_TRACE_HEADER_SIZE );
+    for( long long k = 0; k < n; ++k ) {
+        Err err = segy_traceheader( fp, indices[ k ],
+                                    expected.data() + k * SEGY_TRACE_HEADER_SIZE,
+                                    trace0, trace_bsize );
+        REQUIRE( success( err ) );
+    }
+
+    for( long long blocksize : { 0LL, 1000LL, 1LL << 24 } ) {
+        INFO( "block size " << blocksize );
+        Err err = segy_set_scan_blocksize( fp, blocksize );
+        REQUIRE( success( err ) );
+
+        std::vector< char > headers( n * SEGY_TRACE_HEADER_SIZE );
+        err = segy_traceheader_gather( fp, indices.data(), n,
+                                       headers.data(),
+                                       trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( headers == expected );
+    }
+
+    std::vector< char > headers( 2 * SEGY_TRACE_HEADER_SIZE, 1 );
+    const std::int64_t past_end[] = { 25, 3 };
+    Err err = segy_traceheader_gather( fp, past_end, 2, headers.data(),
+                                       trace0, trace_bsize );
+    CHECK( err == SEGY_FREAD_ERROR );
+    CHECK( headers == std::vector< char >( 2 * SEGY_TRACE_HEADER_SIZE, 1 ) );
+}
+
+TEST_CASE_METHOD( smallshape,
+                  "block-buffered header scans match per-trace scans",
+                  "[c.segy]" ) {
+    for( long long blocksize : { 0LL, 240LL, 241LL, 1000LL, 1LL << 24 } ) {
+        Err err = segy_set_scan_blocksize( fp, blocksize );
+        REQUIRE( success( err ) );
+
+        std::vector< int > forward( 25 );
+        err = segy_field_forall( fp, xl, 0, 25, 1, forward.data(),
+                                 trace0, trace_bsize );
+        CHECK( success( err ) );
+        for( int i = 0; i < 25; ++i )
+            CHECK( forward[ i ] == 20 + i % 5 );
+
+        std::vector< int > backward( 5 );
+        err = segy_field_forall( fp, il, 24, -1, -5, backward.data(),
+                                 trace0, trace_bsize );
+        CHECK( success( err ) );
+        const std::vector< int > expected = { 5, 4, 3, 2, 1 };
+        CHECK_THAT( backward, Catch::Equals( expected ) );
+
+        int found_sorting;
+        err = segy_sorting( fp, il, xl, of, &found_sorting,
+                            trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( found_sorting == sorting );
+
+        int found_offsets;
+        err = segy_offsets( fp, il, xl, traces, &found_offsets,
+                            trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( found_offsets == offsets );
+
+        int count_inlines, count_crosslines;
+        err = segy_count_lines( fp, xl, offsets,
+                                &count_inlines, &count_crosslines,
+                                trace0, trace_bsize );
+        CHECK( success( err ) );
+        CHECK( count_inlines    == ilines );
+        CHECK( count_crosslines == xlines );
+
+        const int fields[] = { il, xl };
+        std::vector< std::int32_t > ils( 13 ), xls( 13 );
+        std::int32_t* out[] = { ils.data(), xls.data() };
+        err = segy_fields_forall( fp, fields, 2, 0, 25, 2, 2, out,
+                                  trace0, trace_bsize );
+        CHECK( success( err ) );
+        for( int i = 0; i < 13; ++i ) {
+            CHECK( ils[ i ] == 1 + (2 * i) / 5 );
+            CHECK( xls[ i ] == 20 + (2 * i) % 5 );
+        }
+    }
+}
+
+TEST_CASE_METHOD( smallfix,
+                  "negative scan block size fails",
+                  "[c.segy]" ) {
+    Err err = segy_set_scan_blocksize( fp, -1 );
+    CHECK( err == Err::args() );
+}
+
 TEST_CASE( "setting unaligned header-field fails",
            "[c.segy]" ) {
     char header[ SEGY_TRACE_HEADER_SIZE ];
@@ -1580,6 +3839,26 @@ static_assert(
     "int24 must be standard layout"
 );
 
+template < typename T >
+double as_double(T x) {
+    return double(x);
+}
+
+/* the 3-byte test files are zero-extended int16, so never negative */
+static double as_double(int24 x) {
+    return double(std::uint8_t(x.bytes[0]) << 0
+                | std::uint8_t(x.bytes[1]) << 8
+                | std::uint8_t(x.bytes[2]) << 16);
+}
+
+static std::int16_t as_int16(double x) {
+    if (x <= std::numeric_limits< std::int16_t >::min())
+        return std::numeric_limits< std::int16_t >::min();
+    if (x >= std::numeric_limits< std::int16_t >::max())
+        return std::numeric_limits< std::int16_t >::max();
+    return std::int16_t(std::lround(x));
+}
+
 /*
  * open a copy of f3, but pre-converted to a different format, to check that
  * other formats are read correctly
@@ -1630,10 +3909,93 @@ void f3_in_format(int fmt) {
             segy_trsize(f3fmt, samples));
     REQUIRE(err == Err::ok());
 
+    std::vector< T > nattrace(samples);
+    err = segy_readtrace_native(fp,
+            0,
+            fmt,
+            SEGY_AS_NATIVE,
+            1.0,
+            0.0,
+            nattrace.data(),
+            trace0,
+            segy_trsize(fmt, samples));
+    REQUIRE(err == Err::ok());
+
+    std::vector< T > natsubtr(samples / 2 + 1);
+    err = segy_readsubtr_native(fp,
+            0,
+            samples - 1,
+            -1,
+            -2,
+            fmt,
+            SEGY_AS_NATIVE,
+            1.0,
+            0.0,
+            natsubtr.data(),
+            nullptr,
+            trace0,
+            segy_trsize(fmt, samples));
+    REQUIRE(err == Err::ok());
+
     segy_to_native(fmt, fptrace.size(), fptrace.data());
     segy_to_native(f3fmt,  f3trace.size(), f3trace.data());
 
     CHECK_THAT(fptrace, SimilarRange< T >::from(f3trace));
+    CHECK(std::memcmp(nattrace.data(),
+                      fptrace.data(),
+                      fptrace.size() * sizeof(T)) == 0);
+
+    std::vector< T > reversed;
+    for (int i = samples - 1; i >= 0; i -= 2)
+        reversed.push_back(fptrace[i]);
+    REQUIRE(reversed.size() == natsubtr.size());
+    CHECK(std::memcmp(natsubtr.data(),
+                      reversed.data(),
+                      reversed.size() * sizeof(T)) == 0);
+
+    /* read the same trace converted to float, double and int16 */
+    std::vector< float > f32(samples);
+    std::vector< double > f64(samples);
+    std::vector< std::int16_t > i16(samples);
+    err = segy_readtrace_native(fp, 0, fmt, SEGY_AS_FLOAT32, 1.0, 0.0,
+                                f32.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+    err = segy_readtrace_native(fp, 0, fmt, SEGY_AS_FLOAT64, 1.0, 0.0,
+                                f64.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+    err = segy_readtrace_native(fp, 0, fmt, SEGY_AS_INT16, 1.0, 0.0,
+                                i16.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+
+    for (int i = 0; i < samples; ++i) {
+        const double x = as_double(fptrace[i]);
+        CHECK(f32[i] == float(x));
+        CHECK(f64[i] == x);
+        CHECK(i16[i] == as_int16(x));
+    }
+
+    /* batched reads of several traces, both widening and narrowing */
+    const std::int64_t tracenos[] = { 1, 0 };
+    std::vector< double > f64s(2 * samples);
+    std::vector< std::int16_t > i16s(2 * samples);
+    err = segy_readtraces_native(fp, tracenos, 2, 0, fmt, SEGY_AS_FLOAT64,
+                                 1.0, 0.0,
+                                 f64s.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+    err = segy_readtraces_native(fp, tracenos, 2, 0, fmt, SEGY_AS_INT16,
+                                 1.0, 0.0,
+                                 i16s.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+    CHECK(std::equal(f64.begin(), f64.end(), f64s.begin() + samples));
+    CHECK(std::equal(i16.begin(), i16.end(), i16s.begin() + samples));
+
+    std::vector< double > f64line(2 * samples);
+    err = segy_read_line_native(fp, 0, 2, 1, 1, fmt, SEGY_AS_FLOAT64, 1.0, 0.0,
+                                f64line.data(), trace0, trsize);
+    CHECK(err == Err::ok());
+    CHECK(std::equal(f64.begin(), f64.end(), f64line.begin()));
+    CHECK(std::equal(f64s.begin(), f64s.begin() + samples,
+                     f64line.begin() + samples));
 }
 
 /*
@@ -2008,3 +4370,58 @@ TEST_CASE("segy_samples uses ext-samples word", "[c.segy]") {
         CHECK(samples == 1);
     }
 }
+
+TEST_CASE("vectorised IBM conversion matches scalar", "[c.segy][simd]") {
+    /*
+     * Walk the full 32-bit range with a step that hits every exponent and
+     * mantissa bucket, and add the boundary values explicitly. The odd length
+     * makes sure the scalar tail handling is exercised too.
+     */
+    std::vector< std::uint32_t > input;
+    for( std::uint64_t x = 0; x <= 0xFFFFFFFF; x += 4093 )
+        input.push_back( std::uint32_t( x ) );
+
+    for( std::uint32_t x : { 0x00000000u, 0x80000000u, 0x7FFFFFFFu,
+                             0xFFFFFFFFu, 0x611FFFFFu, 0x61200000u,
+                             0x211FFFFFu, 0x21200000u, 0x00200000u,
+                             0x00400000u, 0x00800000u, 0x001FFFFFu,
+                             0x7F800000u, 0xFF800000u, 0x7FC00000u,
+                             0x00000001u, 0x3F800000u, 0xBF800000u } )
+        input.push_back( x );
+
+    input.push_back( 0x42640000u );
+    REQUIRE( input.size() % 16 != 0 );
+
+    const int best = segy_simd_level();
+    for( int level = SEGY_SIMD_SSE2; level <= best; ++level ) {
+        INFO( "simd level " << level );
+
+        auto expected = input;
+        auto xs = input;
+        Err err = segy_ibm_native_simd( SEGY_SIMD_SCALAR,
+                                        expected.size(),
+                                        expected.data() );
+        REQUIRE( success( err ) );
+        err = segy_ibm_native_simd( level, xs.size(), xs.data() );
+        REQUIRE( success( err ) );
+        CHECK( xs == expected );
+
+        expected = input;
+        xs = input;
+        err = segy_native_ibm_simd( SEGY_SIMD_SCALAR,
+                                    expected.size(),
+                                    expected.data() );
+        REQUIRE( success( err ) );
+        err = segy_native_ibm_simd( level, xs.size(), xs.data() );
+        REQUIRE( success( err ) );
+        CHECK( xs == expected );
+    }
+}
+
+TEST_CASE("unsupported SIMD level is an argument error", "[c.segy][simd]") {
+    float x = 1.0f;
+    Err err = segy_ibm_native_simd( SEGY_SIMD_AVX512 + 1, 1, &x );
+    CHECK( err == Err::args() );
+    err = segy_native_ibm_simd( -1, 1, &x );
+    CHECK( err == Err::args() );
+}
@@ -45,15 +45,18 @@ void mexFunction(int nlhs, mxArray *plhs[],
         goto cleanup;
     }
 
-    for( int i = first_trace; i <= last_trace; ++i ) {
-        err = segy_readtrace( fp, i, out, fmt.trace0, fmt.trace_bsize );
-        out += fmt.samples;
-
-        if( err != 0 ) {
-            msg1 = "segy:get_traces:segy_readtrace";
-            msg2 = strerror( errno );
-            goto cleanup;
-        }
+    int64_t* tracenos = mxMalloc( traces * sizeof( int64_t ) );
+    for( int i = 0; i < traces; ++i )
+        tracenos[ i ] = first_trace + i;
+
+    err = segy_readtraces( fp, tracenos, traces, 0, out,
+                           fmt.trace0, fmt.trace_bsize );
+    mxFree( tracenos );
+
+    if( err != 0 ) {
+        msg1 = "segy:get_traces:segy_readtraces";
+        msg2 = strerror( errno );
+        goto cleanup;
     }
 
     segy_close( fp );
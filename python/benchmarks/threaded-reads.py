@@ -0,0 +1,53 @@
+import os
+import sys
+import tempfile
+import threading
+import time
+
+import numpy as np
+import segyio
+
+
+def read(path, repeat):
+    with segyio.open(path) as f:
+        for _ in range(repeat):
+            f.trace.raw[:]
+
+
+def main():
+    """Time reading the same file from 1..N threads, each with its own handle
+
+    Since segyio releases the GIL while reading, the threads should scale
+    until the disk or the page cache is saturated.
+    """
+    workers = int(sys.argv[1]) if len(sys.argv) > 1 else 4
+    repeat = int(sys.argv[2]) if len(sys.argv) > 2 else 5
+
+    data = np.arange(64 * 64 * 500, dtype = np.single).reshape(64, 64, 500)
+    fd, path = tempfile.mkstemp(suffix = '.sgy')
+    os.close(fd)
+
+    try:
+        segyio.tools.from_array(path, data)
+
+        start = time.time()
+        for _ in range(workers):
+            read(path, repeat)
+        serial = time.time() - start
+
+        threads = [threading.Thread(target = read, args = (path, repeat))
+                   for _ in range(workers)]
+        start = time.time()
+        for t in threads: t.start()
+        for t in threads: t.join()
+        parallel = time.time() - start
+
+        print('{} readers, serial:   {:.3f}s'.format(workers, serial))
+        print('{} readers, threaded: {:.3f}s ({:.2f}x)'.format(
+              workers, parallel, serial / parallel))
+
+    finally:
+        os.remove(path)
+
+if __name__ == '__main__':
+    main()
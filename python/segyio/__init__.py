@@ -86,6 +86,7 @@ class Enum(object):
 from .binfield import BinField
 from .segysampleformat import SegySampleFormat
 from .tracesortingformat import TraceSortingFormat
+from .compression import Compression
 from .tracefield import TraceField
 from . import su
 from .open import open
@@ -0,0 +1,6 @@
+from . import Enum
+
+class Compression(Enum):
+    UNCOMPRESSED = 0
+    LOSSLESS = 1
+    LOSSY = 2
@@ -37,6 +37,10 @@ class Depth(Sequence):
         depths, consider using a faster mode.
     """
 
+    # depth slices are read in batches of up to this many bytes, where every
+    # batch costs a single pass over the file
+    pass_bytes = 256 * 1024 * 1024
+
     def __init__(self, fd):
         super(Depth, self).__init__(len(fd.samples))
         self.filehandle = fd.xfd
@@ -78,6 +82,10 @@ class Depth(Sequence):
         -----
         .. versionadded:: 1.1
 
+        .. versionchanged:: 1.10
+            slices read many depths in a single pass over the file, and every
+            yielded array is a separate object
+
         .. warning::
             The segyio 1.5 and 1.6 series, and 1.7.0, would return the depth_slice in the
             wrong shape for most files. Since segyio 1.7.1, the arrays have the
@@ -126,13 +134,21 @@ class Depth(Sequence):
                 raise TypeError(msg.format(type(i).__name__))
 
             def gen():
-                x = np.empty(self.shape, dtype=self.dtype)
-                y = np.copy(x)
-
-                for j in range(*indices):
-                    self.filehandle.getdepth(j, x.size, self.offsets, x)
-                    x, y = y, x
-                    yield y
+                depths = np.arange(*indices, dtype=np.intc)
+                shape = self.shape
+                if not isinstance(shape, tuple):
+                    shape = (shape,)
+
+                size = int(np.prod(shape))
+                itemsize = np.dtype(self.dtype).itemsize
+                batch = max(1, self.pass_bytes // max(1, size * itemsize))
+
+                for k in range(0, len(depths), batch):
+                    chunk = depths[k:k + batch]
+                    buf = np.empty((len(chunk),) + shape, dtype=self.dtype)
+                    self.filehandle.getdepths(chunk, size, self.offsets, 1, buf)
+                    for x in buf:
+                        yield x
 
             return gen()
 
@@ -10,8 +10,10 @@ import numpy as np
 try: from future_builtins import zip
 except ImportError: pass
 
+import segyio
 import segyio.tools as tools
 
+from .field import Field
 from .line import sanitize_slice
 
 
@@ -189,6 +191,36 @@ class Gather(object):
 
         return gen()
 
+def unique_words(words):
+    """The header words as ints, without duplicates, in order"""
+    seen = set()
+    out = []
+    for word in words:
+        word = int(word)
+        if word not in seen:
+            seen.add(word)
+            out.append(word)
+    return out
+
+def sort_index(header, index, fields):
+    """
+    Stable sort of the trace numbers `index` by the header words `fields`, most
+    significant first. Only the headers of the range of traces spanned by the
+    index are read, which for the typical group is little more than the group
+    itself.
+    """
+    from . import _segyio
+    index = np.array(index, dtype = np.int64)
+    fields = unique_words(fields)
+    if len(index) == 0 or len(fields) == 0:
+        return index
+
+    lo, hi = int(index.min()), int(index.max()) + 1
+    table = header.table(fields, traces = slice(lo, hi))
+    rows = index - lo
+    _segyio.sort_rows(table.view(np.int32), len(fields), rows)
+    return rows + lo
+
 class Group(object):
     """
     The inner representation of the Groups abstraction provided by Group.
@@ -199,11 +231,40 @@ class Group(object):
     -----
     .. versionadded:: 1.9
     """
+
+    # traces and headers are read this many at a time
+    blocksize = 1024
+
     def __init__(self, key, parent, index):
         self.parent = parent
         self.index = index
         self.key = key
 
+    @property
+    def index(self):
+        """
+        The trace numbers in this group, as a list
+
+        The groups keep the trace numbers in compact arrays, and the list is
+        only made when asked for.
+
+        Notes
+        -----
+        .. versionadded:: 1.10
+        """
+        if not isinstance(self._index, list):
+            self._index = np.asarray(self._index, dtype = np.int64).tolist()
+        return self._index
+
+    @index.setter
+    def index(self, index):
+        self._index = index
+
+    def blocks(self):
+        index = np.asarray(self._index, dtype = np.int64)
+        for i in range(0, len(index), self.blocksize):
+            yield index[i:i + self.blocksize]
+
     @property
     def header(self):
         """
@@ -218,11 +279,23 @@ class Group(object):
         The generator respects the order of the index - to iterate over headers
         in a different order, the index attribute can be re-organised.
 
+        The headers are read in blocks, and every block is read in file order
+        with a single call, with headers close together on disk merged into
+        larger reads.
+
         .. versionadded:: 1.9
         """
-        source = self.parent.header
-        for i in self.index:
-            yield source[i]
+        segy = self.parent
+        size = segyio._segyio.thsize()
+        for block in self.blocks():
+            buf = bytearray(len(block) * size)
+            segy.xfd.getths(buf, block)
+            for i, traceno in enumerate(block):
+                yield Field(buf[i * size:(i + 1) * size],
+                            kind = 'trace',
+                            traceno = int(traceno),
+                            filehandle = segy.xfd,
+                            readonly = segy.readonly)
 
     @property
     def trace(self):
@@ -238,11 +311,17 @@ class Group(object):
         The generator respects the order of the index - to iterate over headers
         in a different order, the index attribute can be re-organised.
 
+        The traces are read in blocks, and every block is read in file order,
+        with traces close together on disk merged into larger reads.
+
         .. versionadded:: 1.9
         """
         source = self.parent.trace
-        for i in self.index:
-            yield source[i]
+        for block in self.blocks():
+            buf = np.empty((len(block), source.shape), dtype = source.dtype)
+            source.filehandle.gettraces(buf, block)
+            for trace in buf:
+                yield trace
 
     def sort(self, fields):
         """
@@ -250,17 +329,7 @@ class Group(object):
         most-to-least significant word.
         """
         # TODO: examples
-
-        headers = [dict(self.parent.header[i]) for i in self.index]
-        index = list(zip(headers, self.index))
-        # sorting is stable, so sort the whole set by field, applied in the
-        # reverse order:
-        for field in reversed(fields):
-            index.sort(key = lambda x: x[0][field])
-
-        # strip off all the headers
-        index = [i for _, i in index]
-        self.index = index
+        self.index = sort_index(self.parent.header, self._index, fields)
 
 class Groups(Mapping):
     """
@@ -299,13 +368,33 @@ class Groups(Mapping):
     # TODO: only group in range of traces?
     # TODO: cache header dicts?
     def __init__(self, trace, header, key):
+        from . import _segyio
+
+        # group in native code, on a table of the key words of all traces. The
+        # groups are kept as slices of a single index array, in order of
+        # appearance, and only the fingerprints are made in python
+        try:
+            words = [int(key)]
+            single = True
+        except TypeError:
+            words = unique_words(key)
+            single = False
+
+        table = header.table(words).view(np.int32)
+        rows = table.reshape(-1, len(words))
+        index = np.empty(len(rows), dtype = np.int64)
+        offsets = np.empty(len(rows) + 1, dtype = np.int64)
+        ngroups = _segyio.group_rows(table, len(words), index, offsets)
+
         bins = collections.OrderedDict()
-        for i, h in enumerate(header[:]):
-            k = self.fingerprint(h[key])
-            if k in bins:
-                bins[k].append(i)
+        firsts = rows[index[offsets[:ngroups]]].tolist()
+        for g, values in enumerate(firsts):
+            if single:
+                k = values[0]
             else:
-                bins[k] = [i]
+                k = frozenset(zip(words, values))
+
+            bins[k] = index[offsets[g]:offsets[g + 1]]
 
         self.trace = trace
         self.header = header
@@ -434,11 +523,32 @@ class Groups(Mapping):
         """
         Reorganise the indices in all groups by fields
         """
-        bins = collections.OrderedDict()
+        from . import _segyio
+        fields = unique_words(fields)
+        if len(self.bins) == 0 or len(fields) == 0:
+            return
+
+        # sort all groups at once, by (group, fields...), which reads the
+        # headers of the file only once
+        keys = list(self.bins.keys())
+        index = [np.asarray(i, dtype = np.int64) for i in self.bins.values()]
+        lengths = [len(i) for i in index]
+        index = np.concatenate(index)
+
+        table = self.header.table(fields).view(np.int32)
+        table = table.reshape(-1, len(fields))
+        rank = np.repeat(np.arange(len(keys), dtype = np.int32), lengths)
+        rows = np.empty((len(index), len(fields) + 1), dtype = np.int32)
+        rows[:, 0] = rank
+        rows[:, 1:] = table[index]
+
+        order = np.arange(len(index), dtype = np.int64)
+        _segyio.sort_rows(rows, len(fields) + 1, order)
+        index = index[order]
 
-        for key, index in self.bins.items():
-            g = Group(key, self, index)
-            g.sort(fields)
-            bins[key] = g.index
+        bins = collections.OrderedDict()
+        offsets = np.cumsum([0] + lengths)
+        for g, key in enumerate(keys):
+            bins[key] = index[offsets[g]:offsets[g + 1]]
 
         self.bins = bins
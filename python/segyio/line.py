@@ -9,6 +9,7 @@ except ImportError: pass
 import numpy as np
 
 from .utils import castarray
+from .tracesortingformat import TraceSortingFormat
 
 # in order to support [:end] syntax, we must make sure
 # start has a non-None value. lineno.indices() would set it
@@ -346,6 +347,98 @@ class Line(Mapping):
         """D.values() -> generator of D's (key,values), as 2-tuples"""
         return zip(self.keys(), self[:])
 
+class IndexedLine(Line):
+    """
+    Lines of a file that is not sorted, or has missing or duplicated traces,
+    read through a geometry index of all the trace headers.
+
+    Like Line, lines are accessed by their number, and offsets by sub
+    indexing, i.e. line[10, 4] is line 10 at offset 4. The traces of a line
+    are ordered by their number in the other direction, and traces missing
+    from the file are skipped, so lines can have different lengths.
+
+    IndexedLine is read-only.
+
+    Notes
+    -----
+    .. versionadded:: 1.10
+    """
+
+    # shares __len__, keys(), ranges() etc. with Line, but finds lines in the
+    # index instead of computing where they start
+    def __init__(self, filehandle, keys, sorting):
+        from . import _segyio
+
+        self.filehandle = filehandle.xfd
+        self.geometry = keys
+        self.sorting = int(sorting)
+        self.samplecount = len(filehandle.samples)
+        self.dtype = filehandle.dtype
+
+        self.order = np.empty(len(keys), dtype = np.int64)
+        _segyio.sort_geometry(keys, self.sorting, self.order)
+
+        major = 0 if self.sorting == TraceSortingFormat.INLINE_SORTING else 1
+        labels, counts = np.unique(keys[self.order, major],
+                                   return_counts = True)
+        self.heads = { int(label): int(count)
+                       for label, count in zip(labels, counts) }
+
+        self.offsets = { int(x): i for i, x in enumerate(np.unique(keys[:, 2])) }
+        self.default_offset = min(self.offsets.keys())
+
+    def read(self, line, offset):
+        x = np.empty((self.heads[line], self.samplecount), dtype = self.dtype)
+        n = self.filehandle.getgeometryline(self.geometry,
+                                            self.order,
+                                            self.sorting,
+                                            line,
+                                            offset,
+                                            x)
+        return x[:n]
+
+    def __getitem__(self, index):
+        """line[i] or line[i, o]
+
+        The line `i`, or the line `i` at a specific offset `o`, as a numpy
+        array with one row per trace. Follows the same rules for indexing and
+        slicing as ``Line``.
+
+        Parameters
+        ----------
+        i : int or slice
+        o : int or slice
+
+        Returns
+        -------
+        line : numpy.ndarray of dtype or generator of numpy.ndarray of dtype
+
+        Raises
+        ------
+        KeyError
+            If `i` or `o` don't exist
+        """
+        offset = self.default_offset
+        try: index, offset = index
+        except TypeError: pass
+
+        if not isinstance(index, slice) and not isinstance(offset, slice):
+            if index not in self.heads: raise KeyError(index)
+            if offset not in self.offsets: raise KeyError(offset)
+            return self.read(index, offset)
+
+        irange, orange = self.ranges(index, offset)
+
+        def gen():
+            for line in irange:
+                for off in orange:
+                    yield self.read(line, off)
+
+        return gen()
+
+    def __setitem__(self, index, val):
+        raise TypeError('lines read through a geometry index are read-only')
+
 class HeaderLine(Line):
     """
     The Line implements the dict interface, with a fixed set of int_like keys,
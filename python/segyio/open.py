@@ -1,9 +1,134 @@
+import hashlib
+import io
+import os
+
 import numpy
 
 import segyio
 
-def infer_geometry(f, metrics, iline, xline, strict):
+# The geometry index is a small header followed by the inline, crossline and
+# offset numbers as little-endian int32. The key fields identify the file the
+# index was built from, and the index is rebuilt if any of them change.
+index_magic = b'SEGYIDX1'
+index_header = numpy.dtype([
+    ('magic',        'S8'),
+    ('digest',       'S40'),
+    ('size',         '<i8'),
+    ('mtime',        '<f8'),
+    ('sorting',      '<i4'),
+    ('iline_count',  '<i4'),
+    ('xline_count',  '<i4'),
+    ('offset_count', '<i4'),
+])
+
+def index_key(f, filename, iline, xline):
+    """Identify the file and interpretation the geometry index is valid for
+
+    A hash of the binary header, a sample of the trace headers and the
+    iline/xline words is combined with the file size and modification time.
+    Only a handful of headers are read, so this is cheap even for huge files.
+    """
+    st = os.stat(filename)
+
+    digest = hashlib.sha1()
+    digest.update(bytes(f.xfd.getbin()))
+    digest.update(str((iline, xline, f.endian)).encode('ascii'))
+
+    from . import _segyio
+    header = bytearray(_segyio.thsize())
+    for traceno in sorted({0, f.tracecount // 2, f.tracecount - 1}):
+        digest.update(bytes(f.xfd.getth(traceno, header)))
+
+    digest = digest.hexdigest().encode('ascii')
+    return digest, st.st_size, st.st_mtime
+
+def load_index(path, key):
+    """Load the geometry index at path
+
+    Returns None if there is no usable index, i.e. it is missing, unreadable,
+    or was built from a different file.
+    """
+    try:
+        raw = numpy.memmap(path, dtype=numpy.uint8, mode='r')
+    except (IOError, OSError, ValueError):
+        return None
+
+    if raw.size < index_header.itemsize:
+        return None
+
+    head = raw[:index_header.itemsize].view(index_header)[0]
+    digest, size, mtime = key
+    if head['magic'] != index_magic: return None
+    if head['digest'] != digest: return None
+    if head['size'] != size: return None
+    if head['mtime'] != mtime: return None
+
+    ilen = int(head['iline_count'])
+    xlen = int(head['xline_count'])
+    olen = int(head['offset_count'])
+
+    lines = raw[index_header.itemsize:]
+    if lines.size != 4 * (ilen + xlen + olen):
+        return None
+
+    lines = lines.view('<i4')
+    return {
+        'sorting': int(head['sorting']),
+        'ilines':  lines[:ilen],
+        'xlines':  lines[ilen:ilen + xlen],
+        'offsets': lines[ilen + xlen:],
+    }
+
+def store_index(path, key, sorting, ilines, xlines, offsets):
+    """Write the geometry index to path
+
+    The index is written to a temporary file and moved in place, so that
+    concurrent opens never see a partially written index. Failing to write the
+    index is not an error, the next open will just scan the headers again.
+    """
+    head = numpy.zeros(1, dtype=index_header)
+    head['magic'] = index_magic
+    head['digest'], head['size'], head['mtime'] = key
+    head['sorting'] = sorting
+    head['iline_count'] = len(ilines)
+    head['xline_count'] = len(xlines)
+    head['offset_count'] = len(offsets)
+
+    tmp = '{}.{}.tmp'.format(path, os.getpid())
+    try:
+        with io.open(tmp, 'wb') as fd:
+            fd.write(head.tobytes())
+            for xs in (ilines, xlines, offsets):
+                fd.write(numpy.asarray(xs, dtype='<i4').tobytes())
+        try:
+            os.replace(tmp, path)
+        except AttributeError:
+            # python 2 has no os.replace, and rename won't overwrite on windows
+            if os.path.exists(path): os.remove(path)
+            os.rename(tmp, path)
+    except (IOError, OSError):
+        try:
+            os.remove(tmp)
+        except (IOError, OSError):
+            pass
+
+def infer_geometry(f, metrics, iline, xline, strict, index=None,
+                   irregular=False, threads=1):
     try:
+        key = None
+        if index is not None:
+            key = index_key(f, f._filename, iline, xline)
+            cached = load_index(index, key)
+            if cached is not None:
+                try:
+                    return f.interpret(cached['ilines'],
+                                       cached['xlines'],
+                                       cached['offsets'],
+                                       cached['sorting'])
+                except ValueError:
+                    # inconsistent with the file - scan and rebuild the index
+                    pass
+
         cube_metrics = f.xfd.cube_metrics(iline, xline)
         f._sorting   = cube_metrics['sorting']
         iline_count  = cube_metrics['iline_count']
@@ -18,8 +143,11 @@ def infer_geometry(f, metrics, iline, xline, strict):
         f.xfd.indices(metrics, ilines, xlines, offsets)
         f.interpret(ilines, xlines, offsets, f._sorting)
 
+        if key is not None:
+            store_index(index, key, f._sorting, ilines, xlines, offsets)
+
     except:
-        if not strict:
+        if not strict or irregular:
             f._ilines  = None
             f._xlines  = None
             f._offsets = None
@@ -27,6 +155,34 @@ def infer_geometry(f, metrics, iline, xline, strict):
             f.close()
             raise
 
+        if irregular:
+            try:
+                keys = numpy.empty((f.tracecount, 3), dtype=numpy.intc)
+                f._geometry = f.xfd.scan_geometry(keys,
+                                                  int(iline),
+                                                  int(xline),
+                                                  int(segyio.TraceField.offset),
+                                                  int(threads))
+            except:
+                f.close()
+                raise
+
+    return f
+
+def attach_bricks(f, filename, path):
+    """Read lines and slices from the brick cache at path, if it is usable
+
+    The cache is only used if it is at least as new as the file, and built for
+    a file of the same size, geometry and sample format. Otherwise it's
+    silently ignored, and everything is read from the file.
+    """
+    try:
+        if os.stat(path).st_mtime < os.stat(filename).st_mtime:
+            return f
+    except (IOError, OSError):
+        return f
+
+    f.xfd.brick_attach(path, len(f.fast), len(f.slow), len(f.offsets))
     return f
 
 
@@ -34,7 +190,13 @@ def open(filename, mode="r", iline = 189,
                              xline = 193,
                              strict = True,
                              ignore_geometry = False,
-                             endian = 'big'):
+                             endian = 'big',
+                             index = None,
+                             bricks = None,
+                             cache = None,
+                             readahead = 8 * 1024 * 1024,
+                             irregular = False,
+                             threads = 1):
     """Open a segy file.
 
     Opens a segy file and tries to figure out its sorting, inline numbers,
@@ -90,6 +252,38 @@ def open(filename, mode="r", iline = 189,
     endian : {'big', 'msb', 'little', 'lsb'}
         File endianness, big/msb (default) or little/lsb
 
+    index : str or bool, optional
+        Path to a geometry index file. If True, use the filename with
+        ``.segyio-index`` appended. The index is written on the first open, and
+        on later opens the geometry is read from it instead of scanning the
+        trace headers. Defaults to None (no index).
+
+    bricks : str or bool, optional
+        Path to a brick cache, built with ``segyio.tools.bricks``. If True, use
+        the filename with ``.segyio-bricks`` appended. Lines, depth slices and
+        sub volumes are read from the cache when it is valid for the file.
+        Only used in read-only mode. Defaults to None (no brick cache).
+
+    cache : int, optional
+        Keep up to this many bytes of recently read traces and headers in
+        memory, see ``SegyFile.cache``. Defaults to None (no cache).
+
+    readahead : int, optional
+        When traces, headers or lines are read one after another, or with a
+        fixed stride, have the OS read up to this many bytes ahead in the
+        background. Random access is not affected. 0 turns it off. Defaults to
+        8MB.
+
+    irregular : bool, optional
+        If the file is not a regular cube, scan the inline, crossline and
+        offset of every trace, and read lines through this index instead. The
+        file is still unstructured, but ``iline`` and ``xline`` work, and
+        lines may have different lengths. Defaults to False.
+
+    threads : int, optional
+        Split the header scan for irregular files between this many threads.
+        Defaults to 1
+
     Returns
     -------
 
@@ -110,9 +304,24 @@ def open(filename, mode="r", iline = 189,
     .. versionchanged:: 1.8
         endian argument
 
+    .. versionchanged:: 1.10
+        index, bricks, cache, readahead, irregular and threads arguments,
+        compressed files
+
+    Files compressed with segyio.tools.compress are read transparently, like
+    the file they were compressed from. Blocks of traces are decoded as they
+    are read, and compressed files can only be opened read-only, and can not
+    be memory mapped.
+
     When a file is opened non-strict, only raw traces access is allowed, and
     using modes such as ``iline`` raise an error.
 
+    The geometry index is keyed on the file size, modification time, and a
+    hash of the binary header and a few trace headers, and is rebuilt when any
+    of them change. It does not notice a file being modified in a way that
+    preserves all of these, e.g. rewriting only the inline numbers of traces
+    in the middle of the file.
+
 
     Examples
     --------
@@ -139,6 +348,18 @@ def open(filename, mode="r", iline = 189,
     >>> with segyio.open(path, endian = 'little') as f:
     ...     f.trace[0]
 
+    Open a large file many times, but only scan the headers once:
+
+    >>> for job in jobs:
+    ...     with segyio.open(path, index = True) as f:
+    ...         job(f.iline[f.ilines[0]])
+
+    Read the lines of a file with missing traces:
+
+    >>> with segyio.open(path, irregular = True) as f:
+    ...     for il in f.iline.keys():
+    ...         print(il, len(f.iline[il]))
+
     """
 
     if 'w' in mode:
@@ -158,10 +379,15 @@ def open(filename, mode="r", iline = 189,
         opts = ' '.join(endians.keys())
         raise ValueError(problem.format(endian) + opts)
 
+    if readahead < 0:
+        raise ValueError('readahead must be non-negative, was {}'.format(readahead))
+
     from . import _segyio
     fd = _segyio.segyiofd(str(filename), mode, endians[endian])
     fd.segyopen()
     metrics = fd.metrics()
+    if cache: fd.cache(int(cache), 16)
+    fd.readahead(int(readahead))
 
     f = segyio.SegyFile(fd,
             filename = str(filename),
@@ -184,4 +410,24 @@ def open(filename, mode="r", iline = 189,
     if ignore_geometry:
         return f
 
-    return infer_geometry(f, metrics, iline, xline, strict)
+    if index is True:
+        index = str(filename) + '.segyio-index'
+    elif index is False:
+        index = None
+    elif index is not None:
+        index = str(index)
+
+    if bricks is True:
+        bricks = str(filename) + '.segyio-bricks'
+    elif bricks is False:
+        bricks = None
+    elif bricks is not None:
+        bricks = str(bricks)
+
+    f = infer_geometry(f, metrics, iline, xline, strict, index,
+                       irregular, threads)
+
+    if bricks is None or mode != 'r' or f.unstructured:
+        return f
+
+    return attach_bricks(f, str(filename), bricks)
@@ -7,10 +7,11 @@ except (NameError, ImportError): pass
 import numpy as np
 
 from .gather import Gather, Groups
-from .line import Line
+from .line import Line, IndexedLine
 from .trace import Trace, Header, Attributes, Text
 from .field import Field
 
+from .segysampleformat import SegySampleFormat
 from .tracesortingformat import TraceSortingFormat
 
 
@@ -40,6 +41,9 @@ class SegyFile(object):
         self._samples = None
         self._sorting = None
 
+        # (il, xl, offset) of every trace, for files that are not sorted
+        self._geometry = None
+
         # private values
         self._iline_length = None
         self._iline_stride = None
@@ -69,7 +73,7 @@ class SegyFile(object):
             }[self._fmt])
         except KeyError:
             problem = 'Unknown trace value format {}'.format(self._fmt)
-            solution = 'falling back to ibm float'
+            solution = 'samples can not be read'
             warnings.warn(', '.join((problem, solution)))
             self._fmt = 1
             self._dtype = np.dtype(np.float32)
@@ -84,6 +88,7 @@ class SegyFile(object):
         self._iline = None
         self._xline = None
         self._gather = None
+        self._subvolume = None
         self.depth = None
         self.endian = endian
 
@@ -221,6 +226,152 @@ class SegyFile(object):
         """
         return self.xfd.mmap()
 
+    def view(self):
+        """A numpy array over the samples in the file, without copying
+
+        Memory map the file, and give a 2-dimensional array of shape (traces,
+        samples) that reads the samples straight from the mapping. The trace
+        headers between the traces are skipped by the stride of the array, so
+        no samples are copied, and reading the whole file costs no memory
+        beyond the OS page cache. The array has the byte order of the file,
+        which for little-endian files is the native order of most machines.
+
+        The view is read-only, unless the file is opened with 'r+', in which
+        case writes to the array go straight to the file. Such writes bypass
+        the trace cache set with `cache`. The view is valid also after the file
+        is closed, and the file is unmapped when the last view is gone.
+
+        This only works for files with the samples stored in a format numpy
+        understands, i.e. integers and IEEE floats, but not IBM floats.
+
+        Returns
+        -------
+
+        view : numpy.ndarray
+
+        Raises
+        ------
+
+        ValueError
+            If the sample format has no numpy equivalent
+        IOError
+            If the file could not be memory mapped
+
+        Notes
+        -----
+
+        .. versionadded:: 1.10
+
+        Examples
+        --------
+
+        Sum all the samples in a little-endian IEEE float file:
+
+        >>> with segyio.open(path, endian = 'little') as f:
+        ...     total = f.view().sum()
+
+        A post-stack cube, without copying:
+
+        >>> cube = f.view().reshape(len(f.fast), len(f.slow), len(f.samples))
+        """
+        # formats numpy has a dtype for - IBM floats and 3-byte integers must
+        # be converted
+        viewable = (
+            SegySampleFormat.SIGNED_INTEGER_4_BYTE,
+            SegySampleFormat.SIGNED_SHORT_2_BYTE,
+            SegySampleFormat.IEEE_FLOAT_4_BYTE,
+            SegySampleFormat.IEEE_FLOAT_8_BYTE,
+            SegySampleFormat.SIGNED_CHAR_1_BYTE,
+            SegySampleFormat.SIGNED_INTEGER_8_BYTE,
+            SegySampleFormat.UNSIGNED_INTEGER_4_BYTE,
+            SegySampleFormat.UNSIGNED_SHORT_2_BYTE,
+            SegySampleFormat.UNSIGNED_INTEGER_8_BYTE,
+            SegySampleFormat.UNSIGNED_CHAR_1_BYTE,
+        )
+        if self._fmt not in viewable:
+            msg = 'cannot view samples of format {} in place'
+            raise ValueError(msg.format(self.format))
+
+        if not self.xfd.mmap():
+            raise IOError('unable to memory map {}'.format(self._filename))
+
+        from . import _segyio
+        metrics = self.xfd.metrics()
+        order = '<' if self.endian in ('little', 'lsb') else '>'
+        dtype = self.dtype.newbyteorder(order)
+        header = _segyio.thsize()
+        stride = metrics['trace_bsize'] + header
+
+        view = np.ndarray(shape = (self.tracecount, len(self.samples)),
+                          dtype = dtype,
+                          buffer = self.xfd,
+                          offset = metrics['trace0'] + header,
+                          strides = (stride, dtype.itemsize))
+
+        if self.readonly:
+            view.flags.writeable = False
+
+        return view
+
+    def cache(self, size, block = 16):
+        """Keep recently read traces in memory
+
+        Keep up to `size` bytes of recently read traces and headers in memory,
+        so that reading them again, e.g. when moving back and forth through
+        gathers, is served without reading from disk or converting samples.
+        Traces are read and cached in blocks of `block` consecutive traces,
+        and the least recently used block is dropped when the cache is full.
+        A size of 0 removes the cache.
+
+        Only single traces and trace headers, i.e. ``f.trace[i]`` and
+        ``f.header[i]``, go through the cache. Writing through this file drops
+        all cached traces.
+
+        Parameters
+        ----------
+
+        size : int
+            Cache size in bytes
+        block : int, optional
+            Number of traces read and cached together. Defaults to 16
+
+        Notes
+        -----
+
+        .. versionadded:: 1.10
+
+        Examples
+        --------
+
+        Cache 64MB of traces:
+
+        >>> f.cache(64 * 1024 * 1024)
+        >>> for i in itertools.chain(range(100), range(100)):
+        ...     trace = f.trace[i]
+        >>> f.cache_stats()
+        {'hits': 193, 'misses': 7}
+        """
+        self.xfd.cache(int(size), int(block))
+
+    def cache_stats(self):
+        """Trace cache hits and misses
+
+        The number of traces and headers read from the cache (hits) and from
+        the file (misses) since the cache was set with `cache`.
+
+        Returns
+        -------
+
+        stats : dict
+            ``{'hits': int, 'misses': int}``
+
+        Notes
+        -----
+
+        .. versionadded:: 1.10
+        """
+        return self.xfd.cachestats()
+
     @property
     def dtype(self):
         """
@@ -504,7 +655,7 @@ class SegyFile(object):
 
         Returns
         -------
-        iline : Line or None
+        iline : Line or IndexedLine
 
         Raises
         ------
@@ -514,14 +665,24 @@ class SegyFile(object):
         Notes
         -----
         .. versionadded:: 1.1
-        """
 
-        if self.unstructured:
-            raise ValueError(self._unstructured_errmsg)
+        .. versionchanged:: 1.10
+            IndexedLine for files opened with irregular=True
+        """
 
         if self._iline is not None:
             return self._iline
 
+        if self.unstructured and self._geometry is not None:
+            self._iline = IndexedLine(self,
+                                      self._geometry,
+                                      TraceSortingFormat.INLINE_SORTING,
+                                     )
+            return self._iline
+
+        if self.unstructured:
+            raise ValueError(self._unstructured_errmsg)
+
         self._iline = Line(self,
                            self.ilines,
                            self._iline_length,
@@ -576,7 +737,7 @@ class SegyFile(object):
 
         Returns
         -------
-        xline : Line or None
+        xline : Line or IndexedLine
 
         Raises
         ------
@@ -586,13 +747,23 @@ class SegyFile(object):
         Notes
         -----
         .. versionadded:: 1.1
-        """
-        if self.unstructured:
-            raise ValueError(self._unstructured_errmsg)
 
+        .. versionchanged:: 1.10
+            IndexedLine for files opened with irregular=True
+        """
         if self._xline is not None:
             return self._xline
 
+        if self.unstructured and self._geometry is not None:
+            self._xline = IndexedLine(self,
+                                      self._geometry,
+                                      TraceSortingFormat.CROSSLINE_SORTING,
+                                     )
+            return self._xline
+
+        if self.unstructured:
+            raise ValueError(self._unstructured_errmsg)
+
         self._xline = Line(self,
                            self.xlines,
                            self._xline_length,
@@ -743,6 +914,34 @@ class SegyFile(object):
         self._gather = Gather(self.trace, self.iline, self.xline, self.offsets)
         return self._gather
 
+    @property
+    def subvolume(self):
+        """
+        Interact with segy in sub volume mode, reading boxes of the cube
+
+        Returns
+        -------
+        subvolume : SubVolume
+
+        Raises
+        ------
+        ValueError
+            If the file is unstructured
+
+        Notes
+        -----
+        .. versionadded:: 1.10
+        """
+        if self.unstructured:
+            raise ValueError(self._unstructured_errmsg)
+
+        if self._subvolume is not None:
+            return self._subvolume
+
+        from .subvolume import SubVolume
+        self._subvolume = SubVolume(self)
+        return self._subvolume
+
     @property
     def text(self):
         """Interact with segy in text mode
@@ -4,15 +4,18 @@
 #  undef _DEBUG
 #  include <Python.h>
 #  include <bytesobject.h>
+#  include <pythread.h>
 #  define _DEBUG 1
 #else
 #  include <Python.h>
 #  include <bytesobject.h>
+#  include <pythread.h>
 #endif
 
 #include <segyio/segy.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
 #include <stdexcept>
@@ -42,6 +45,7 @@ std::string segy_errstr( int err ) {
         case SEGY_MMAP_INVALID:        return "segyio.mmap.invalid";
         case SEGY_READONLY:            return "segyio.readonly";
         case SEGY_NOTFOUND:            return "segyio.notfound";
+        case SEGY_MEMORY_ERROR:        return "segyio.memory";
 
         default:
             ss << "code " << err << "";
@@ -145,6 +149,7 @@ PyObject* Error( int err ) {
                                                "likely corrupted file" );
         case SEGY_READONLY:    return IOError( "file not open for writing. "
                                                "open with 'r+'" );
+        case SEGY_MEMORY_ERROR: return PyErr_NoMemory();
         default:               return RuntimeError( err );
     }
 }
@@ -182,6 +187,63 @@ struct segyiofd {
     int samplecount;
     int format;
     int elemsize;
+
+    /*
+     * optional brick cache, with the geometry it's addressed by - when
+     * attached, line and depth reads are served from it
+     */
+    segy_bricks* bricks;
+    int brick_lines;
+    int brick_line_length;
+    int brick_offsets;
+
+    /*
+     * calls into segyio run without the GIL, see nogil. The lock serialises
+     * them, since a segy_file is not safe to use from several threads, and
+     * busy counts the calls in flight, so the file isn't closed under them.
+     */
+    PyThread_type_lock lock;
+    int busy;
+
+    /*
+     * the file can be exported as a buffer when memory mapped. While there
+     * are exports, closing it only moves it to exported, which is closed
+     * when the last export is released.
+     */
+    int writable;
+    int exports;
+    autofd exported;
+};
+
+/*
+ * Release the GIL for the duration of a call into segyio, so other Python
+ * threads can run, e.g. read other files, while this one waits for I/O. Any
+ * buffers passed must be held by a buffer_guard (or the argument tuple) for
+ * the lifetime of the nogil, and no Python objects can be touched while it's
+ * alive.
+ *
+ * The handle's lock is only waited for without the GIL, and is released
+ * before the GIL is taken back, so this can't deadlock.
+ */
+struct nogil {
+    explicit nogil( segyiofd* s ) : self( s ) {
+        ++this->self->busy;
+        this->state = PyEval_SaveThread();
+        PyThread_acquire_lock( this->self->lock, WAIT_LOCK );
+    }
+
+    ~nogil() {
+        PyThread_release_lock( this->self->lock );
+        PyEval_RestoreThread( this->state );
+        --this->self->busy;
+    }
+
+    segyiofd* self;
+    PyThreadState* state;
+
+private:
+    nogil( const nogil& );
+    nogil& operator=( const nogil& );
 };
 
 struct buffer_guard {
@@ -238,6 +300,22 @@ int init( segyiofd* self, PyObject* args, PyObject* kwargs ) {
     if( !PyArg_ParseTuple( args, "ssi", &filename, &mode, &endian ) )
         return -1;
 
+    if( self->busy ) {
+        IOError( "file is in use by another thread" );
+        return -1;
+    }
+
+    if( self->exports ) {
+        BufferError( "cannot re-open file with exported buffers" );
+        return -1;
+    }
+
+    if( !self->lock ) self->lock = PyThread_allocate_lock();
+    if( !self->lock ) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
     if( std::strlen( mode ) == 0 ) {
         ValueError( "mode string must be non-empty" );
         return -1;
@@ -288,6 +366,9 @@ int init( segyiofd* self, PyObject* args, PyObject* kwargs ) {
      * properly closed before the new file is set
      */
     self->fd.swap( fd );
+    segy_brick_close( self->bricks );
+    self->bricks = NULL;
+    self->writable = std::strchr( mode, '+' ) || std::strchr( mode, 'w' );
 
     return 0;
 }
@@ -299,7 +380,11 @@ PyObject* segyopen( segyiofd* self ) {
     int tracecount = 0;
 
     char binary[ SEGY_BINARY_HEADER_SIZE ] = {};
-    int err = segy_binheader( fp, binary );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_binheader( fp, binary );
+    }
     if( err ) return Error( err );
 
     const long trace0 = segy_trace0( binary );
@@ -337,7 +422,10 @@ PyObject* segyopen( segyiofd* self ) {
             break;
     }
 
-    err = segy_traces( fp, &tracecount, trace0, trace_bsize );
+    {
+        nogil guard( self );
+        err = segy_traces( fp, &tracecount, trace0, trace_bsize );
+    }
     switch( err ) {
         case SEGY_OK: break;
 
@@ -492,7 +580,10 @@ PyObject* suopen( segyiofd* self, PyObject* args ) {
 
     char header[ SEGY_TRACE_HEADER_SIZE ] = {};
 
-    err = segy_traceheader( fp, 0, header, 0, 0 );
+    {
+        nogil guard( self );
+        err = segy_traceheader( fp, 0, header, 0, 0 );
+    }
     if( err )
         return IOError( "unable to read first trace header in SU file" );
 
@@ -505,7 +596,10 @@ PyObject* suopen( segyiofd* self, PyObject* args ) {
     int trace_bsize = elemsize * samplecount;
 
     int tracecount;
-    err = segy_traces( fp, &tracecount, trace0, trace_bsize );
+    {
+        nogil guard( self );
+        err = segy_traces( fp, &tracecount, trace0, trace_bsize );
+    }
     switch( err ) {
         case SEGY_OK: break;
 
@@ -537,6 +631,9 @@ PyObject* suopen( segyiofd* self, PyObject* args ) {
 
 void dealloc( segyiofd* self ) {
     self->fd.close();
+    self->exported.close();
+    segy_brick_close( self->bricks );
+    if( self->lock ) PyThread_free_lock( self->lock );
     Py_TYPE( self )->tp_free( (PyObject*) self );
 }
 
@@ -544,8 +641,25 @@ PyObject* close( segyiofd* self ) {
     /* multiple close() is a no-op */
     if( !self->fd ) return Py_BuildValue( "" );
 
+    if( self->busy )
+        return IOError( "file is in use by another thread" );
+
+    if( self->exports ) {
+        /* buffers still refer to the mapping, so close when they're gone */
+        self->fd.swap( self->exported );
+        segy_brick_close( self->bricks );
+        self->bricks = NULL;
+        return Py_BuildValue( "" );
+    }
+
+    /* PyEval_RestoreThread preserves errno */
     errno = 0;
-    self->fd.close();
+    {
+        nogil guard( self );
+        self->fd.close();
+        segy_brick_close( self->bricks );
+        self->bricks = NULL;
+    }
 
     if( errno ) return IOErrno();
 
@@ -557,7 +671,11 @@ PyObject* flush( segyiofd* self ) {
     if( !fp ) return NULL;
 
     errno = 0;
-    segy_flush( self->fd, false );
+    {
+        nogil guard( self );
+        segy_flush( fp, false );
+    }
+
     if( errno ) return IOErrno();
 
     return Py_BuildValue( "" );
@@ -568,7 +686,11 @@ PyObject* mmap( segyiofd* self ) {
 
     if( !fp ) return NULL;
 
-    const int err = segy_mmap( fp );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_mmap( fp );
+    }
 
     if( err != SEGY_OK )
         Py_RETURN_FALSE;
@@ -576,6 +698,43 @@ PyObject* mmap( segyiofd* self ) {
     Py_RETURN_TRUE;
 }
 
+/*
+ * The buffer protocol - a memory mapped file exports the whole mapping,
+ * read-only unless the file is open for writing, which numpy can view in
+ * place.
+ */
+int getbuffer( segyiofd* self, Py_buffer* view, int flags ) {
+    view->obj = NULL;
+
+    segy_file* fp = self->fd;
+    if( !fp ) return -1;
+
+    void* addr;
+    long long size;
+    if( segy_mmap_region( fp, &addr, &size ) != SEGY_OK ) {
+        BufferError( "file is not memory mapped" );
+        return -1;
+    }
+
+    const int readonly = !self->writable;
+    if( PyBuffer_FillInfo( view, (PyObject*) self,
+                           addr, size,
+                           readonly,
+                           flags ) != 0 )
+        return -1;
+
+    ++self->exports;
+    return 0;
+}
+
+void releasebuffer( segyiofd* self, Py_buffer* ) {
+    if( --self->exports > 0 ) return;
+
+    Py_BEGIN_ALLOW_THREADS
+    self->exported.close();
+    Py_END_ALLOW_THREADS
+}
+
 /*
  * No C++11, so no std::vector::data. single-alloc automatic heap buffer,
  * without resize
@@ -611,9 +770,13 @@ PyObject* gettext( segyiofd* self, PyObject* args ) {
     heapbuffer buffer( segy_textheader_size() );
     if( !buffer ) return NULL;
 
-    const int err = index == 0
-              ? segy_read_textheader( fp, buffer )
-              : segy_read_ext_textheader( fp, index - 1, buffer );
+    int err;
+    {
+        nogil guard( self );
+        err = index == 0
+            ? segy_read_textheader( fp, buffer )
+            : segy_read_ext_textheader( fp, index - 1, buffer );
+    }
 
     if( err ) return Error( err );
     /*
@@ -640,7 +803,11 @@ PyObject* puttext( segyiofd* self, PyObject* args ) {
     const char* src = buffer.buf< const char >();
     std::copy( src, src + size, buf.ptr );
 
-    const int err = segy_write_textheader( fp, index, buf );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_write_textheader( fp, index, buf );
+    }
 
     if( err ) return Error( err );
 
@@ -653,7 +820,11 @@ PyObject* getbin( segyiofd* self ) {
 
     char buffer[ SEGY_BINARY_HEADER_SIZE ] = {};
 
-    const int err = segy_binheader( fp, buffer );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_binheader( fp, buffer );
+    }
     if( err ) return Error( err );
 
     return PyByteArray_FromStringAndSize( buffer, sizeof( buffer ) );
@@ -671,7 +842,11 @@ PyObject* putbin( segyiofd* self, PyObject* args ) {
                            "expected %i, was %zd",
                            SEGY_BINARY_HEADER_SIZE, buffer.len() );
 
-    const int err = segy_write_binheader( fp, buffer.buf< const char >() );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_write_binheader( fp, buffer.buf< const char >() );
+    }
 
     if( err == SEGY_INVALID_ARGS )
         return IOError( "file not open for writing. open with 'r+'" );
@@ -697,10 +872,14 @@ PyObject* getth( segyiofd* self, PyObject *args ) {
                            "expected %i, was %zd",
                            SEGY_TRACE_HEADER_SIZE, buffer.len() );
 
-    int err = segy_traceheader( fp, traceno,
+    int err;
+    {
+        nogil guard( self );
+        err = segy_traceheader( fp, traceno,
                                     buffer.buf(),
                                     self->trace0,
                                     self->trace_bsize );
+    }
 
     switch( err ) {
         case SEGY_OK:
@@ -716,6 +895,51 @@ PyObject* getth( segyiofd* self, PyObject *args ) {
     }
 }
 
+PyObject* getths( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* bufferobj;
+    buffer_guard indices;
+    if( !PyArg_ParseTuple( args, "Os*", &bufferobj, &indices ) )
+        return NULL;
+
+    buffer_guard bufout( bufferobj, PyBUF_CONTIG );
+    if( !bufout ) return NULL;
+
+    const Py_ssize_t len = indices.len() / sizeof( std::int64_t );
+    if( bufout.len() != len * SEGY_TRACE_HEADER_SIZE )
+        return ValueError( "internal: trace header buffer size mismatch "
+                           "(expected %zd, was %zd)",
+                           len * SEGY_TRACE_HEADER_SIZE, bufout.len() );
+
+    const std::int64_t* xs = indices.buf< const std::int64_t >();
+    for( Py_ssize_t i = 0; i < len; ++i ) {
+        if( xs[ i ] < 0 || xs[ i ] >= self->tracecount )
+            return IndexError( "trace %zd out of range [0, %d)",
+                               Py_ssize_t( xs[ i ] ),
+                               self->tracecount );
+    }
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_traceheader_gather( fp,
+                                       xs,
+                                       len,
+                                       bufout.buf(),
+                                       self->trace0,
+                                       self->trace_bsize );
+    }
+
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed on trace headers" );
+    if( err ) return Error( err );
+
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
 PyObject* putth( segyiofd* self, PyObject* args ) {
     segy_file* fp = self->fd;
     if( !fp ) return NULL;
@@ -731,11 +955,15 @@ PyObject* putth( segyiofd* self, PyObject* args ) {
 
     const char* buffer = buf.buf< const char >();
 
-    const int err = segy_write_traceheader( fp,
-                                            traceno,
-                                            buffer,
-                                            self->trace0,
-                                            self->trace_bsize );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_write_traceheader( fp,
+                                      traceno,
+                                      buffer,
+                                      self->trace0,
+                                      self->trace_bsize );
+    }
 
     switch( err ) {
         case SEGY_OK:
@@ -769,14 +997,21 @@ PyObject* field_forall( segyiofd* self, PyObject* args ) {
     buffer_guard buffer( bufferobj, PyBUF_CONTIG );
     if( !buffer ) return NULL;
 
-    const int err = segy_field_forall( fp,
-                                       field,
-                                       start,
-                                       stop,
-                                       step,
-                                       buffer.buf< int >(),
-                                       self->trace0,
-                                       self->trace_bsize );
+    std::int32_t* out = buffer.buf< std::int32_t >();
+    int err;
+    {
+        nogil guard( self );
+        err = segy_fields_forall( fp,
+                                  &field,
+                                  1,
+                                  start,
+                                  stop,
+                                  step,
+                                  1,
+                                  &out,
+                                  self->trace0,
+                                  self->trace_bsize );
+    }
 
     if( err ) return Error( err );
 
@@ -797,23 +1032,106 @@ PyObject* field_foreach( segyiofd* self, PyObject* args ) {
     buffer_guard bufout( bufferobj, PyBUF_CONTIG );
     if( !bufout ) return NULL;
 
-    if( bufout.len() != indices.len() )
+    const Py_ssize_t len = indices.len() / sizeof( std::int64_t );
+    if( bufout.len() != len * Py_ssize_t( sizeof( std::int32_t ) ) )
         return ValueError( "internal: array size mismatch "
                            "(output %zd, indices %zd)",
-                           bufout.len(), indices.len() );
+                           bufout.len() / Py_ssize_t( sizeof( std::int32_t ) ),
+                           len );
+
+    const std::int64_t* xs = indices.buf< const std::int64_t >();
+    for( Py_ssize_t i = 0; i < len; ++i ) {
+        if( xs[ i ] < 0 || xs[ i ] >= self->tracecount )
+            return IndexError( "trace %zd out of range [0, %d)",
+                               Py_ssize_t( xs[ i ] ),
+                               self->tracecount );
+    }
 
-    const int* ind = indices.buf< const int >();
-    int* out = bufout.buf< int >();
-    Py_ssize_t len = bufout.len() / sizeof(int);
-    int err = 0;
-    for( int i = 0; err == 0 && i < len; ++i ) {
-        err = segy_field_forall( fp, field,
-                                     ind[ i ],
-                                     ind[ i ] + 1,
-                                     1,
-                                     out + i,
-                                     self->trace0,
-                                     self->trace_bsize );
+    std::int32_t* out = bufout.buf< std::int32_t >();
+    int err;
+    {
+        nogil guard( self );
+        err = segy_field_gather( fp,
+                                 &field,
+                                 1,
+                                 xs,
+                                 len,
+                                 &out,
+                                 self->trace0,
+                                 self->trace_bsize );
+    }
+
+    if( err ) return Error( err );
+
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
+PyObject* fields_forall( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* bufferobj;
+    buffer_guard fields;
+    int start, stop, step;
+    int threads;
+
+    if( !PyArg_ParseTuple( args, "Os*iiii", &bufferobj,
+                                            &fields,
+                                            &start,
+                                            &stop,
+                                            &step,
+                                            &threads ) )
+        return NULL;
+
+    if( step == 0 ) return ValueError( "slice step cannot be zero" );
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    /*
+     * the output is a table with one row per trace and one int32 column per
+     * field, i.e. the memory of a structured array, so column i starts i
+     * words into the buffer and the words of a column are nfields apart
+     */
+    const int nfields = fields.len() / sizeof( int );
+    if( nfields == 0 ) {
+        Py_INCREF( bufferobj );
+        return bufferobj;
+    }
+
+    int len = 0;
+    if( step > 0 && start < stop ) len = (stop - start - 1) / step + 1;
+    if( step < 0 && start > stop ) len = (stop - start + 1) / step + 1;
+
+    const Py_ssize_t size = Py_ssize_t( len ) * nfields * sizeof( std::int32_t );
+    if( buffer.len() < size )
+        return ValueError( "internal: table too small, "
+                           "expected %zd, was %zd",
+                           size, buffer.len() );
+
+    heapbuffer outbuf( nfields * sizeof( std::int32_t* ) );
+    if( !outbuf ) return NULL;
+
+    std::int32_t* table = buffer.buf< std::int32_t >();
+    std::int32_t** out = reinterpret_cast< std::int32_t** >( outbuf.ptr );
+    for( int i = 0; i < nfields; ++i )
+        out[ i ] = table + i;
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_fields_forall_strided( fp,
+                                          fields.buf< const int >(),
+                                          nfields,
+                                          start,
+                                          stop,
+                                          step,
+                                          threads,
+                                          out,
+                                          nfields,
+                                          self->trace0,
+                                          self->trace_bsize );
     }
 
     if( err ) return Error( err );
@@ -866,35 +1184,37 @@ PyObject* cube_metrics( segyiofd* self, PyObject* args ) {
     metrics_errmsg errmsg = { il, xl, SEGY_TR_OFFSET };
 
     int sorting = -1;
-    int err = segy_sorting( fp, il,
+    int offset_count = -1;
+    int xl_count = 0;
+    int il_count = 0;
+    int err;
+    {
+        nogil guard( self );
+        err = segy_sorting( fp, il,
                                 xl,
                                 SEGY_TR_OFFSET,
                                 &sorting,
                                 self->trace0,
                                 self->trace_bsize );
 
-    if( err ) return errmsg( err );
-
-    int offset_count = -1;
-    err = segy_offsets( fp, il,
-                            xl,
-                            self->tracecount,
-                            &offset_count,
-                            self->trace0,
-                            self->trace_bsize );
-
-    if( err ) return errmsg( err );
+        if( !err )
+            err = segy_offsets( fp, il,
+                                    xl,
+                                    self->tracecount,
+                                    &offset_count,
+                                    self->trace0,
+                                    self->trace_bsize );
 
-    int xl_count = 0;
-    int il_count = 0;
-    err = segy_lines_count( fp, il,
-                                xl,
-                                sorting,
-                                offset_count,
-                                &il_count,
-                                &xl_count,
-                                self->trace0,
-                                self->trace_bsize );
+        if( !err )
+            err = segy_lines_count( fp, il,
+                                        xl,
+                                        sorting,
+                                        offset_count,
+                                        &il_count,
+                                        &xl_count,
+                                        self->trace0,
+                                        self->trace_bsize );
+    }
 
     if( err == SEGY_NOTFOUND )
         return ValueError( "could not parse geometry, "
@@ -958,7 +1278,10 @@ PyObject* indices( segyiofd* self, PyObject* args ) {
 
     metrics_errmsg errmsg = { il_field, xl_field, SEGY_TR_OFFSET };
 
-    int err = segy_inline_indices( fp, il_field,
+    int err;
+    {
+        nogil guard( self );
+        err = segy_inline_indices( fp, il_field,
                                        sorting,
                                        iline_count,
                                        xline_count,
@@ -966,28 +1289,333 @@ PyObject* indices( segyiofd* self, PyObject* args ) {
                                        iline_out.buf< int >(),
                                        self->trace0,
                                        self->trace_bsize );
-    if( err ) return errmsg( err );
 
-    err = segy_crossline_indices( fp, xl_field,
-                                      sorting,
-                                      iline_count,
-                                      xline_count,
-                                      offset_count,
-                                      xline_out.buf< int >(),
-                                      self->trace0,
-                                      self->trace_bsize );
+        if( !err )
+            err = segy_crossline_indices( fp, xl_field,
+                                              sorting,
+                                              iline_count,
+                                              xline_count,
+                                              offset_count,
+                                              xline_out.buf< int >(),
+                                              self->trace0,
+                                              self->trace_bsize );
+
+        if( !err )
+            err = segy_offset_indices( fp, offset_field,
+                                           offset_count,
+                                           offset_out.buf< int >(),
+                                           self->trace0,
+                                           self->trace_bsize );
+    }
     if( err ) return errmsg( err );
 
-    err = segy_offset_indices( fp, offset_field,
-                                   offset_count,
-                                   offset_out.buf< int >(),
-                                   self->trace0,
-                                   self->trace_bsize );
-    if( err ) return errmsg( err );
+    return Py_BuildValue( "" );
+}
+
+/*
+ * Bytes of unrequested traces segy_readtraces may read through to merge two
+ * reads into one. Small enough to not waste much bandwidth on sparse reads,
+ * large enough to cover the typical strided trace[::n] access.
+ */
+const long long readtraces_gap = 64 * 1024;
+
+/*
+ * The format to give the fused read-and-convert functions. The samples of
+ * files with a rubbish format field can't be converted, so rather than
+ * guessing, raise ValueError and return -1.
+ */
+int native_format( const segyiofd* self ) {
+    if( segy_trsize( self->format, 1 ) >= 0 ) return self->format;
+
+    ValueError( "unknown sample format %d, unable to convert samples",
+                self->format );
+    return -1;
+}
+
+PyObject* cache( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    long long bytes;
+    int block_traces;
+    if( !PyArg_ParseTuple( args, "Li", &bytes, &block_traces ) ) return NULL;
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+    int err;
+    {
+        nogil guard( self );
+        err = segy_set_cache( fp, bytes, block_traces, format );
+    }
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "invalid cache size %lld or block %d",
+                           bytes, block_traces );
+
+    if( err ) return Error( err );
+    return Py_BuildValue( "" );
+}
+
+PyObject* readahead( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    long long bytes;
+    if( !PyArg_ParseTuple( args, "L", &bytes ) ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_set_readahead( fp, bytes );
+    }
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "invalid readahead %lld", bytes );
+
+    if( err ) return Error( err );
+    return Py_BuildValue( "" );
+}
+
+PyObject* cachestats( segyiofd* self ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    long long hits, misses;
+    {
+        nogil guard( self );
+        segy_cache_stats( fp, &hits, &misses );
+    }
+    return Py_BuildValue( "{s:L, s:L}", "hits", hits, "misses", misses );
+}
+
+/*
+ * Position of a trace in the brick cache geometry, i.e. its line,
+ * trace-in-line and offset in file order
+ */
+struct brickpos {
+    int line;
+    int pos;
+    int offset;
+};
+
+brickpos brick_position( const segyiofd* self, long long traceno ) {
+    brickpos p;
+    p.offset = traceno % self->brick_offsets;
+    traceno /= self->brick_offsets;
+    p.pos = traceno % self->brick_line_length;
+    p.line = traceno / self->brick_line_length;
+    return p;
+}
+
+/*
+ * Read length traces starting at traceno0, step traces apart, from the brick
+ * cache. This only works when the traces make up a straight line through the
+ * cache, otherwise SEGY_INVALID_ARGS is returned, and the caller should read
+ * from the file instead.
+ */
+int brick_line( segyiofd* self,
+                long long traceno0,
+                int length,
+                long long step,
+                int s0,
+                int s1,
+                void* buf ) {
+    if( !self->bricks || length < 1 ) return SEGY_INVALID_ARGS;
+
+    const long long lastno = traceno0 + (length - 1) * step;
+    if( traceno0 < 0 || lastno < traceno0 ) return SEGY_INVALID_ARGS;
+
+    const brickpos first = brick_position( self, traceno0 );
+    const brickpos last  = brick_position( self, lastno );
+    if( first.offset != last.offset ) return SEGY_INVALID_ARGS;
+
+    const int lines = last.line - first.line + 1;
+    const int width = last.pos - first.pos + 1;
+    if( lines != 1 && width != 1 ) return SEGY_INVALID_ARGS;
+    if( lines * width != length ) return SEGY_INVALID_ARGS;
+
+    return segy_brick_read( self->bricks, first.offset,
+                            first.line, last.line + 1,
+                            first.pos, last.pos + 1,
+                            s0, s1,
+                            buf );
+}
+
+/*
+ * Read depth from every trace at offset 0, count traces in all, from the
+ * brick cache. Returns SEGY_INVALID_ARGS if that's not the whole cache.
+ */
+int brick_depth( segyiofd* self,
+                 int depth,
+                 int count,
+                 int offsets,
+                 void* buf ) {
+    if( !self->bricks ) return SEGY_INVALID_ARGS;
+    if( offsets != self->brick_offsets ) return SEGY_INVALID_ARGS;
+    if( count != self->brick_lines * self->brick_line_length )
+        return SEGY_INVALID_ARGS;
+
+    return segy_brick_read( self->bricks, 0,
+                            0, self->brick_lines,
+                            0, self->brick_line_length,
+                            depth, depth + 1,
+                            buf );
+}
+
+PyObject* brick_build( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    char* path;
+    int lines, line_length, offsets, bricksize;
+    int compression;
+    double tolerance;
+
+    if( !PyArg_ParseTuple( args, "siiiiid", &path,
+                                            &lines,
+                                            &line_length,
+                                            &offsets,
+                                            &bricksize,
+                                            &compression,
+                                            &tolerance ) )
+        return NULL;
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_brick_build( fp, path,
+                                lines, line_length, offsets,
+                                bricksize,
+                                compression,
+                                tolerance,
+                                format,
+                                self->trace0,
+                                self->trace_bsize );
+    }
+
+    if( err == SEGY_FOPEN_ERROR )
+        return IOError( "unable to create brick cache %s", path );
+
+    if( err == SEGY_FWRITE_ERROR )
+        return IOError( "unable to write brick cache %s", path );
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "invalid brick cache geometry or compression" );
+
+    if( err ) return Error( err );
 
     return Py_BuildValue( "" );
 }
 
+PyObject* container_build( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    char* path;
+    int compression;
+    double tolerance;
+    int block_traces;
+
+    if( !PyArg_ParseTuple( args, "sidi", &path,
+                                         &compression,
+                                         &tolerance,
+                                         &block_traces ) )
+        return NULL;
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_container_build( fp, path,
+                                    compression,
+                                    tolerance,
+                                    block_traces,
+                                    format,
+                                    self->trace0,
+                                    self->trace_bsize );
+    }
+
+    if( err == SEGY_FOPEN_ERROR )
+        return IOError( "unable to create compressed file %s", path );
+
+    if( err == SEGY_FWRITE_ERROR )
+        return IOError( "unable to write compressed file %s", path );
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "invalid compression, tolerance or block size" );
+
+    if( err ) return Error( err );
+
+    return Py_BuildValue( "" );
+}
+
+PyObject* brick_attach( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    char* path;
+    int lines, line_length, offsets;
+
+    if( !PyArg_ParseTuple( args, "siii", &path,
+                                         &lines,
+                                         &line_length,
+                                         &offsets ) )
+        return NULL;
+
+    bool attached = false;
+    {
+        nogil guard( self );
+        segy_bricks* bricks = segy_brick_open( path );
+
+        int blines, blength, boffsets, bsamples, bformat, bsize;
+        long long bsource;
+        if( bricks ) {
+            segy_brick_geometry( bricks, &blines, &blength, &boffsets,
+                                         &bsamples, &bformat, &bsize );
+            segy_brick_source_size( bricks, &bsource );
+        }
+
+        /* segyopen has checked that the traces fill the file exactly */
+        const long long fsize = self->trace0
+                              + (long long)self->tracecount
+                              * (SEGY_TRACE_HEADER_SIZE + self->trace_bsize);
+
+        /* a cache for some other file or geometry is not used */
+        if( bricks
+         && bsource == fsize
+         && blines == lines
+         && blength == line_length
+         && boffsets == offsets
+         && bsamples == self->samplecount
+         && bformat == self->format ) {
+            segy_brick_close( self->bricks );
+            self->bricks = bricks;
+            self->brick_lines = lines;
+            self->brick_line_length = line_length;
+            self->brick_offsets = offsets;
+            attached = true;
+        } else {
+            segy_brick_close( bricks );
+        }
+    }
+
+    if( attached ) Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+PyObject* brick_detach( segyiofd* self ) {
+    if( self->lock ) {
+        nogil guard( self );
+        segy_brick_close( self->bricks );
+        self->bricks = NULL;
+    }
+    return Py_BuildValue( "" );
+}
+
 PyObject* gettr( segyiofd* self, PyObject* args ) {
     segy_file* fp = self->fd;
     if( !fp ) return NULL;
@@ -1002,7 +1630,6 @@ PyObject* gettr( segyiofd* self, PyObject* args ) {
     buffer_guard buffer( bufferobj, PyBUF_CONTIG );
     if( !buffer) return NULL;
 
-    const int skip = samples * self->elemsize;
     const long long bufsize = (long long) length * samples;
     const long trace0 = self->trace0;
     const int trace_bsize = self->trace_bsize;
@@ -1012,26 +1639,96 @@ PyObject* gettr( segyiofd* self, PyObject* args ) {
                            "expected %zi, was %zd",
                             bufsize, buffer.len() );
 
-    int err = 0;
-    int i = 0;
-    char* buf = buffer.buf();
-    for( ; err == 0 && i < length; ++i, buf += skip ) {
-        err = segy_readsubtr( fp, start + (i * step),
-                                  sample_start,
-                                  sample_stop,
-                                  sample_step,
-                                  buf,
-                                  NULL,
-                                  trace0,
-                                  trace_bsize );
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    /*
+     * read the whole range in one go, and let segyio plan the reads - nearby
+     * traces are merged into fewer, larger reads
+     */
+    int err;
+    {
+        nogil guard( self );
+        err = segy_read_trace_range( fp, start, step, length,
+                                         sample_start,
+                                         sample_stop,
+                                         sample_step,
+                                         readtraces_gap,
+                                         format,
+                                         SEGY_AS_NATIVE,
+                                         1.0,
+                                         0.0,
+                                         buffer.buf(),
+                                         trace0,
+                                         trace_bsize );
     }
 
     if( err == SEGY_FREAD_ERROR )
-        return IOError( "I/O operation failed on data trace %d", i );
+        return IOError( "I/O operation failed on data trace %d", start );
 
     if( err ) return Error( err );
 
-    segy_to_native( self->format, bufsize, buffer.buf() );
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
+PyObject* gettraces( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* bufferobj;
+    buffer_guard tracenos;
+
+    if( !PyArg_ParseTuple( args, "Os*", &bufferobj, &tracenos ) )
+        return NULL;
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    const long long n = tracenos.len() / sizeof( std::int64_t );
+    const std::int64_t* xs = tracenos.buf< const std::int64_t >();
+    for( long long i = 0; i < n; ++i ) {
+        if( xs[ i ] < 0 || xs[ i ] >= self->tracecount )
+            return IndexError( "trace %zd out of range [0, %d)",
+                               Py_ssize_t( xs[ i ] ),
+                               self->tracecount );
+    }
+
+    const Py_ssize_t bufsize = Py_ssize_t( n )
+                             * self->samplecount
+                             * self->elemsize;
+    if( buffer.len() < bufsize )
+        return ValueError( "internal: data trace buffer too small, "
+                           "expected %zd, was %zd",
+                           bufsize, buffer.len() );
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    /*
+     * the traces are read in file order, and nearby traces are merged into
+     * larger reads, regardless of the order they're requested in
+     */
+    int err;
+    {
+        nogil guard( self );
+        err = segy_readtraces_native( fp,
+                                      xs,
+                                      n,
+                                      readtraces_gap,
+                                      format,
+                                      SEGY_AS_NATIVE,
+                                      1.0,
+                                      0.0,
+                                      buffer.buf(),
+                                      self->trace0,
+                                      self->trace_bsize );
+    }
+
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed reading traces" );
+
+    if( err ) return Error( err );
 
     Py_INCREF( bufferobj );
     return bufferobj;
@@ -1053,14 +1750,18 @@ PyObject* puttr( segyiofd* self, PyObject* args ) {
                           self->trace_bsize,
                           buflen );
 
-    segy_from_native( self->format, self->samplecount, buffer );
+    int err;
+    {
+        nogil guard( self );
+        segy_from_native( self->format, self->samplecount, buffer );
 
-    int err = segy_writetrace( fp, traceno,
+        err = segy_writetrace( fp, traceno,
                                    buffer,
                                    self->trace0,
                                    self->trace_bsize );
 
-    segy_to_native( self->format, self->samplecount, buffer );
+        segy_to_native( self->format, self->samplecount, buffer );
+    }
 
     switch( err ) {
         case SEGY_OK:
@@ -1094,19 +1795,33 @@ PyObject* getline( segyiofd* self, PyObject* args) {
     buffer_guard buffer( bufferobj, PyBUF_CONTIG );
     if( !buffer ) return NULL;
 
-    int err = segy_read_line( fp, line_trace0,
-                                  line_length,
-                                  stride,
-                                  offsets,
-                                  buffer.buf(),
-                                  self->trace0,
-                                  self->trace_bsize);
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = brick_line( self, line_trace0,
+                                line_length,
+                                (long long)stride * offsets,
+                                0, self->samplecount,
+                                buffer.buf() );
+
+        if( err != SEGY_OK )
+            err = segy_read_line_native( fp, line_trace0,
+                                             line_length,
+                                             stride,
+                                             offsets,
+                                             format,
+                                             SEGY_AS_NATIVE,
+                                             1.0,
+                                             0.0,
+                                             buffer.buf(),
+                                             self->trace0,
+                                             self->trace_bsize);
+    }
     if( err ) return Error( err );
 
-    segy_to_native( self->format,
-                    self->samplecount * line_length,
-                    buffer.buf() );
-
     Py_INCREF( bufferobj );
     return bufferobj;
 }
@@ -1140,9 +1855,12 @@ PyObject* putline( segyiofd* self, PyObject* args) {
                           buffer.len() / self->elemsize );
 
     const int elems = line_length * self->samplecount;
-    segy_from_native( self->format, elems, buffer.buf() );
+    int err;
+    {
+        nogil guard( self );
+        segy_from_native( self->format, elems, buffer.buf() );
 
-    int err = segy_write_line( fp, line_trace0,
+        err = segy_write_line( fp, line_trace0,
                                    line_length,
                                    stride,
                                    offsets,
@@ -1150,7 +1868,8 @@ PyObject* putline( segyiofd* self, PyObject* args) {
                                    self->trace0,
                                    self->trace_bsize );
 
-    segy_to_native( self->format, elems, buffer.buf() );
+        segy_to_native( self->format, elems, buffer.buf() );
+    }
 
     switch( err ) {
         case SEGY_OK:
@@ -1183,32 +1902,260 @@ PyObject* getdepth( segyiofd* self, PyObject* args ) {
     buffer_guard buffer( bufferobj, PyBUF_CONTIG );
     if( !buffer ) return NULL;
 
-    int traceno = 0;
-    int err = 0;
-    char* buf = buffer.buf();
-    const int skip = self->elemsize;
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = brick_depth( self, depth, count, offsets, buffer.buf() );
+
+        if( err != SEGY_OK )
+            err = segy_read_depth_slices( fp,
+                                          &depth,
+                                          1,
+                                          0,
+                                          count * offsets,
+                                          offsets,
+                                          format,
+                                          SEGY_AS_NATIVE,
+                                          1.0,
+                                          0.0,
+                                          1,
+                                          buffer.buf(),
+                                          self->trace0,
+                                          self->trace_bsize );
+    }
 
-    const long trace0 = self->trace0;
-    const int trace_bsize = self->trace_bsize;
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed reading depth %d", depth );
 
-    for( ; err == 0 && traceno < count; ++traceno, buf += skip ) {
-        err = segy_readsubtr( fp,
-                              traceno * offsets,
-                              depth,
-                              depth + 1,
-                              1,
-                              buf,
-                              NULL,
-                              trace0, trace_bsize);
+    if( err ) return Error( err );
+
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
+PyObject* getdepths( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* depthsobj;
+    int count;
+    int offsets;
+    int threads;
+    PyObject* bufferobj;
+
+    if( !PyArg_ParseTuple( args, "OiiiO", &depthsobj,
+                                          &count,
+                                          &offsets,
+                                          &threads,
+                                          &bufferobj ) )
+        return NULL;
+
+    buffer_guard depths( depthsobj );
+    if( !depths ) return NULL;
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    const int n = depths.len() / sizeof( int );
+    if( (Py_ssize_t)n * count * self->elemsize > buffer.len() )
+        return ValueError( "buffer too short for %d depths", n );
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err = SEGY_INVALID_ARGS;
+    {
+        nogil guard( self );
+        if( self->bricks ) {
+            err = SEGY_OK;
+            for( int i = 0; i < n && err == SEGY_OK; ++i ) {
+                char* plane = buffer.buf()
+                            + (Py_ssize_t)i * count * self->elemsize;
+                err = brick_depth( self, depths.buf< int >()[ i ],
+                                         count,
+                                         offsets,
+                                         plane );
+            }
+        }
+
+        if( err != SEGY_OK )
+            err = segy_read_depth_slices( fp,
+                                          depths.buf< int >(),
+                                          n,
+                                          0,
+                                          count * offsets,
+                                          offsets,
+                                          format,
+                                          SEGY_AS_NATIVE,
+                                          1.0,
+                                          0.0,
+                                          threads,
+                                          buffer.buf(),
+                                          self->trace0,
+                                          self->trace_bsize );
     }
 
     if( err == SEGY_FREAD_ERROR )
-        return IOError( "I/O operation failed on data trace %d at depth %d",
-                        traceno, depth );
+        return IOError( "I/O operation failed reading %d depths", n );
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "depth index out of range" );
+
+    if( err ) return Error( err );
+
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
+PyObject* getcube( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* bufferobj;
+    int threads;
+
+    int outtype = SEGY_AS_NATIVE;
+    double scale = 1.0;
+    double bias = 0.0;
+
+    if( !PyArg_ParseTuple( args, "Oi|idd", &bufferobj, &threads,
+                                            &outtype, &scale, &bias ) )
+        return NULL;
+
+    int outsize;
+    switch( outtype ) {
+        case SEGY_AS_NATIVE:  outsize = self->elemsize;    break;
+        case SEGY_AS_FLOAT32: outsize = sizeof( float );   break;
+        case SEGY_AS_FLOAT64: outsize = sizeof( double );  break;
+        case SEGY_AS_INT16:   outsize = sizeof( std::int16_t ); break;
+        default:
+            return ValueError( "unknown output type %d", outtype );
+    }
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    const Py_ssize_t bufsize = Py_ssize_t( self->tracecount )
+                             * self->samplecount
+                             * outsize;
+    if( buffer.len() < bufsize )
+        return ValueError( "internal: cube buffer too small, "
+                           "expected %zd, was %zd",
+                           bufsize, buffer.len() );
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_read_cube( fp,
+                              0,
+                              self->tracecount,
+                              format,
+                              outtype,
+                              scale,
+                              bias,
+                              threads,
+                              buffer.buf(),
+                              self->trace0,
+                              self->trace_bsize );
+    }
+
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed reading the cube" );
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "the native type can't be scaled" );
 
     if( err ) return Error( err );
 
-    segy_to_native( self->format, count, buffer.buf() );
+    Py_INCREF( bufferobj );
+    return bufferobj;
+}
+
+PyObject* getsubvolume( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    int sorting;
+    int ilines, xlines, offsets;
+    int offset;
+    int il0, il1, ilstep;
+    int xl0, xl1, xlstep;
+    int s0, s1, sstep;
+    PyObject* bufferobj;
+
+    if( !PyArg_ParseTuple( args, "iiiiiiiiiiiiiiO", &sorting,
+                                                    &ilines,
+                                                    &xlines,
+                                                    &offsets,
+                                                    &offset,
+                                                    &il0, &il1, &ilstep,
+                                                    &xl0, &xl1, &xlstep,
+                                                    &s0, &s1, &sstep,
+                                                    &bufferobj ) )
+        return NULL;
+
+    if( ilstep < 1 || xlstep < 1 || sstep < 1 )
+        return ValueError( "sub volume steps must be positive" );
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    const Py_ssize_t ils = ( il1 - il0 + ilstep - 1 ) / ilstep;
+    const Py_ssize_t xls = ( xl1 - xl0 + xlstep - 1 ) / xlstep;
+    const Py_ssize_t window = ( s1 - s0 + sstep - 1 ) / sstep;
+    const Py_ssize_t size = ils * xls * window * self->elemsize;
+    if( size > buffer.len() )
+        return ValueError( "buffer too short for sub volume" );
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    int err = SEGY_INVALID_ARGS;
+    {
+        nogil guard( self );
+
+        /* the cache is in file order, which is inline-major for inline sorting */
+        if( self->bricks && sorting == SEGY_INLINE_SORTING
+                         && offsets == self->brick_offsets
+                         && ilstep == 1 && xlstep == 1 && sstep == 1 )
+            err = segy_brick_read( self->bricks, offset,
+                                   il0, il1,
+                                   xl0, xl1,
+                                   s0, s1,
+                                   buffer.buf() );
+
+        if( err != SEGY_OK )
+            err = segy_read_subvolume_strided( fp,
+                                               sorting,
+                                               ilines,
+                                               xlines,
+                                               offsets,
+                                               offset,
+                                               il0, il1, ilstep,
+                                               xl0, xl1, xlstep,
+                                               s0, s1, sstep,
+                                               format,
+                                               SEGY_AS_NATIVE,
+                                               1.0,
+                                               0.0,
+                                               buffer.buf(),
+                                               self->trace0,
+                                               self->trace_bsize );
+    }
+
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed reading sub volume" );
+
+    if( err == SEGY_INVALID_ARGS )
+        return ValueError( "sub volume out of range" );
+
+    if( err ) return Error( err );
 
     Py_INCREF( bufferobj );
     return bufferobj;
@@ -1244,22 +2191,25 @@ PyObject* putdepth( segyiofd* self, PyObject* args ) {
     const long trace0 = self->trace0;
     const int trace_bsize = self->trace_bsize;
 
-    segy_from_native( self->format, count, buffer.buf() );
+    {
+        nogil guard( self );
+        segy_from_native( self->format, count, buffer.buf() );
+
+        for( ; err == 0 && traceno < count; ++traceno, buf += skip ) {
+            err = segy_writesubtr( fp,
+                                   traceno * offsets,
+                                   depth,
+                                   depth + 1,
+                                   1,
+                                   buf,
+                                   NULL,
+                                   trace0,
+                                   trace_bsize );
+        }
 
-    for( ; err == 0 && traceno < count; ++traceno, buf += skip ) {
-        err = segy_writesubtr( fp,
-                               traceno * offsets,
-                               depth,
-                               depth + 1,
-                               1,
-                               buf,
-                               NULL,
-                               trace0,
-                               trace_bsize );
+        segy_to_native( self->format, count, buffer.buf() );
     }
 
-    segy_to_native( self->format, count, buffer.buf() );
-
     if( err == SEGY_FREAD_ERROR )
         return IOError( "I/O operation failed on data trace %d at depth %d",
                         traceno, depth );
@@ -1277,7 +2227,11 @@ PyObject* getdt( segyiofd* self, PyObject* args ) {
     if( !PyArg_ParseTuple(args, "f", &fallback ) ) return NULL;
 
     float dt;
-    int err = segy_sample_interval( fp, fallback, &dt );
+    int err;
+    {
+        nogil guard( self );
+        err = segy_sample_interval( fp, fallback, &dt );
+    }
 
     if( err == SEGY_OK )
         return PyFloat_FromDouble( dt );
@@ -1290,13 +2244,21 @@ PyObject* getdt( segyiofd* self, PyObject* args ) {
      * or the binary header
      */
     char buffer[ SEGY_BINARY_HEADER_SIZE ];
-    err = segy_binheader( fp, buffer );
+    {
+        nogil guard( self );
+        err = segy_binheader( fp, buffer );
+    }
 
     if( err )
         return IOError( "I/O operation failed on binary header, "
                         "likely corrupted file" );
 
-    err = segy_traceheader( fp, 0, buffer, self->trace0, self->trace_bsize );
+    {
+        nogil guard( self );
+        err = segy_traceheader( fp, 0, buffer,
+                                    self->trace0,
+                                    self->trace_bsize );
+    }
 
     if( err == SEGY_FREAD_ERROR )
         return IOError( "I/O operation failed on trace header 0, "
@@ -1321,7 +2283,10 @@ PyObject* rotation( segyiofd* self, PyObject* args ) {
         return NULL;
 
     float rotation;
-    int err = segy_rotation_cw( fp, line_length,
+    int err;
+    {
+        nogil guard( self );
+        err = segy_rotation_cw( fp, line_length,
                                     stride,
                                     offsets,
                                     linenos.buf< const int >(),
@@ -1329,12 +2294,138 @@ PyObject* rotation( segyiofd* self, PyObject* args ) {
                                     &rotation,
                                     self->trace0,
                                     self->trace_bsize );
+    }
 
     if( err ) return Error( err );
 
     return PyFloat_FromDouble( rotation );
 }
 
+PyObject* scan_geometry( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    PyObject* keysobj;
+    int il, xl, offset;
+    int threads;
+
+    if( !PyArg_ParseTuple( args, "Oiiii", &keysobj,
+                                          &il,
+                                          &xl,
+                                          &offset,
+                                          &threads ) )
+        return NULL;
+
+    buffer_guard keys( keysobj, PyBUF_CONTIG );
+    if( !keys ) return NULL;
+
+    const Py_ssize_t size = Py_ssize_t( self->tracecount ) * 3 * sizeof( int );
+    if( keys.len() < size )
+        return ValueError( "internal: geometry keys too small, "
+                           "expected %zd, was %zd",
+                           size, keys.len() );
+
+    metrics_errmsg errmsg = { il, xl, offset };
+
+    int err;
+    {
+        nogil guard( self );
+        err = segy_scan_geometry( fp, il,
+                                      xl,
+                                      offset,
+                                      0,
+                                      self->tracecount,
+                                      threads,
+                                      keys.buf< int >(),
+                                      self->trace0,
+                                      self->trace_bsize );
+    }
+
+    if( err ) return errmsg( err );
+
+    Py_INCREF( keysobj );
+    return keysobj;
+}
+
+PyObject* getgeometryline( segyiofd* self, PyObject* args ) {
+    segy_file* fp = self->fd;
+    if( !fp ) return NULL;
+
+    buffer_guard keys;
+    buffer_guard order;
+    int sorting;
+    int lineno;
+    int offset;
+    PyObject* bufferobj;
+
+    if( !PyArg_ParseTuple( args, "s*s*iiiO", &keys,
+                                             &order,
+                                             &sorting,
+                                             &lineno,
+                                             &offset,
+                                             &bufferobj ) )
+        return NULL;
+
+    buffer_guard buffer( bufferobj, PyBUF_CONTIG );
+    if( !buffer ) return NULL;
+
+    const long long n = order.len() / sizeof( std::int64_t );
+    if( keys.len() != Py_ssize_t( n * 3 * sizeof( int ) ) )
+        return ValueError( "internal: geometry keys and order mismatch "
+                           "(keys %zd, order %zd)",
+                           keys.len() / Py_ssize_t( 3 * sizeof( int ) ),
+                           Py_ssize_t( n ) );
+
+    long long first = 0, count = 0;
+    int err = segy_geometry_line( keys.buf< const int >(),
+                                  order.buf< const std::int64_t >(),
+                                  n,
+                                  sorting,
+                                  lineno,
+                                  &first,
+                                  &count );
+
+    if( err == SEGY_MISSING_LINE_INDEX )
+        return KeyError( "no such line %d", lineno );
+    if( err ) return Error( err );
+
+    const Py_ssize_t bufsize = Py_ssize_t( count )
+                             * self->samplecount
+                             * self->elemsize;
+    if( buffer.len() < bufsize )
+        return ValueError( "internal: line buffer too small, "
+                           "expected %zd, was %zd",
+                           bufsize, buffer.len() );
+
+    const int format = native_format( self );
+    if( format < 0 ) return NULL;
+
+    {
+        nogil guard( self );
+        err = segy_geometry_read_line( fp, keys.buf< const int >(),
+                                           order.buf< const std::int64_t >(),
+                                           n,
+                                           sorting,
+                                           lineno,
+                                           offset,
+                                           readtraces_gap,
+                                           format,
+                                           SEGY_AS_NATIVE,
+                                           1.0,
+                                           0.0,
+                                           buffer.buf(),
+                                           &count,
+                                           self->trace0,
+                                           self->trace_bsize );
+    }
+
+    if( err == SEGY_FREAD_ERROR )
+        return IOError( "I/O operation failed reading line %d", lineno );
+    if( err ) return Error( err );
+
+    return PyLong_FromLongLong( count );
+}
+
 PyMethodDef methods [] = {
     { "segyopen", (PyCFunction) fd::segyopen, METH_NOARGS, "Open file." },
     { "segymake", (PyCFunction) fd::segycreate,
@@ -1345,6 +2436,9 @@ PyMethodDef methods [] = {
     { "close", (PyCFunction) fd::close, METH_VARARGS, "Close file." },
     { "flush", (PyCFunction) fd::flush, METH_VARARGS, "Flush file." },
     { "mmap",  (PyCFunction) fd::mmap,  METH_NOARGS,  "mmap file."  },
+    { "cache", (PyCFunction) fd::cache, METH_VARARGS, "Set trace cache." },
+    { "cachestats", (PyCFunction) fd::cachestats, METH_NOARGS, "Trace cache statistics." },
+    { "readahead", (PyCFunction) fd::readahead, METH_VARARGS, "Set readahead." },
 
     { "gettext", (PyCFunction) fd::gettext, METH_VARARGS, "Get text header." },
     { "puttext", (PyCFunction) fd::puttext, METH_VARARGS, "Put text header." },
@@ -1353,17 +2447,28 @@ PyMethodDef methods [] = {
     { "putbin", (PyCFunction) fd::putbin, METH_VARARGS, "Put binary header." },
 
     { "getth", (PyCFunction) fd::getth, METH_VARARGS, "Get trace header." },
+    { "getths", (PyCFunction) fd::getths, METH_VARARGS, "Get trace headers by trace number." },
     { "putth", (PyCFunction) fd::putth, METH_VARARGS, "Put trace header." },
 
     { "field_forall",  (PyCFunction) fd::field_forall,  METH_VARARGS, "Field for-all."  },
     { "field_foreach", (PyCFunction) fd::field_foreach, METH_VARARGS, "Field for-each." },
+    { "fields_forall", (PyCFunction) fd::fields_forall, METH_VARARGS, "Fields for-all, as a table." },
 
     { "gettr", (PyCFunction) fd::gettr, METH_VARARGS, "Get trace." },
+    { "gettraces", (PyCFunction) fd::gettraces, METH_VARARGS, "Get traces by trace number." },
     { "puttr", (PyCFunction) fd::puttr, METH_VARARGS, "Put trace." },
 
     { "getline",  (PyCFunction) fd::getline,  METH_VARARGS, "Get line." },
     { "putline",  (PyCFunction) fd::putline,  METH_VARARGS, "Put line." },
     { "getdepth", (PyCFunction) fd::getdepth, METH_VARARGS, "Get depth." },
+    { "getdepths", (PyCFunction) fd::getdepths, METH_VARARGS, "Get depths." },
+    { "getsubvolume", (PyCFunction) fd::getsubvolume, METH_VARARGS, "Get sub volume." },
+    { "getcube", (PyCFunction) fd::getcube, METH_VARARGS, "Get all traces, in file order." },
+
+    { "brick_build",  (PyCFunction) fd::brick_build,  METH_VARARGS, "Build brick cache."  },
+    { "brick_attach", (PyCFunction) fd::brick_attach, METH_VARARGS, "Attach brick cache." },
+    { "brick_detach", (PyCFunction) fd::brick_detach, METH_NOARGS,  "Detach brick cache." },
+    { "container_build", (PyCFunction) fd::container_build, METH_VARARGS, "Build compressed-trace container." },
     { "putdepth", (PyCFunction) fd::putdepth, METH_VARARGS, "Put depth." },
 
     { "getdt",    (PyCFunction) fd::getdt, METH_VARARGS,    "Get sample interval (dt)." },
@@ -1373,11 +2478,31 @@ PyMethodDef methods [] = {
     { "cube_metrics", (PyCFunction) fd::cube_metrics, METH_VARARGS, "Cube metrics."    },
     { "indices",      (PyCFunction) fd::indices,      METH_VARARGS, "Indices."         },
 
+    { "scan_geometry",   (PyCFunction) fd::scan_geometry,   METH_VARARGS, "Scan geometry keys."         },
+    { "getgeometryline", (PyCFunction) fd::getgeometryline, METH_VARARGS, "Get line by geometry index." },
+
     { NULL }
 };
 
 }
 
+PyBufferProcs buffer_procs = {
+#ifndef IS_PY3K
+    0,                              /* bf_getreadbuffer */
+    0,                              /* bf_getwritebuffer */
+    0,                              /* bf_getsegcount */
+    0,                              /* bf_getcharbuffer */
+#endif
+    (getbufferproc)fd::getbuffer,         /* bf_getbuffer */
+    (releasebufferproc)fd::releasebuffer, /* bf_releasebuffer */
+};
+
+#ifdef IS_PY3K
+const long tpflags = Py_TPFLAGS_DEFAULT;
+#else
+const long tpflags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+
 PyTypeObject Segyiofd = {
     PyVarObject_HEAD_INIT( NULL, 0 )
     "_segyio.segyfd",               /* name */
@@ -1397,8 +2522,8 @@ PyTypeObject Segyiofd = {
     0,                              /* tp_str */
     0,                              /* tp_getattro */
     0,                              /* tp_setattro */
-    0,                              /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,             /* tp_flags */
+    &buffer_procs,                  /* tp_as_buffer */
+    tpflags,                        /* tp_flags */
     "segyio file descriptor",       /* tp_doc */
     0,                              /* tp_traverse */
     0,                              /* tp_clear */
@@ -1576,12 +2701,131 @@ PyObject* format( PyObject* , PyObject* args ) {
     buffer_guard buffer( out, PyBUF_CONTIG );
 
     const int len = buffer.len() / sizeof( float );
+    Py_BEGIN_ALLOW_THREADS
     segy_to_native( format, len, buffer.buf() );
+    Py_END_ALLOW_THREADS
 
     Py_INCREF( out );
     return out;
 }
 
+PyObject* sort_rows( PyObject*, PyObject* args ) {
+    buffer_guard table;
+    int ncols;
+    PyObject* indexobj;
+
+    if( !PyArg_ParseTuple( args, "s*iO", &table, &ncols, &indexobj ) )
+        return NULL;
+
+    buffer_guard index( indexobj, PyBUF_CONTIG );
+    if( !index ) return NULL;
+
+    if( ncols <= 0 ) return ValueError( "expected columns > 0, was %d", ncols );
+
+    const long long rows = table.len() / (ncols * sizeof( std::int32_t ));
+    const long long n = index.len() / sizeof( std::int64_t );
+    std::int64_t* xs = index.buf< std::int64_t >();
+    for( long long i = 0; i < n; ++i ) {
+        if( xs[ i ] < 0 || xs[ i ] >= rows )
+            return IndexError( "row %zd out of range [0, %zd)",
+                               Py_ssize_t( xs[ i ] ),
+                               Py_ssize_t( rows ) );
+    }
+
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    err = segy_sort_rows( table.buf< const std::int32_t >(), ncols, n, xs );
+    Py_END_ALLOW_THREADS
+
+    if( err ) return Error( err );
+
+    Py_INCREF( indexobj );
+    return indexobj;
+}
+
+PyObject* sort_geometry( PyObject*, PyObject* args ) {
+    buffer_guard keys;
+    int sorting;
+    PyObject* orderobj;
+
+    if( !PyArg_ParseTuple( args, "s*iO", &keys, &sorting, &orderobj ) )
+        return NULL;
+
+    buffer_guard order( orderobj, PyBUF_CONTIG );
+    if( !order ) return NULL;
+
+    const long long n = keys.len() / (3 * sizeof( int ));
+    if( order.len() != Py_ssize_t( n * sizeof( std::int64_t ) ) )
+        return ValueError( "internal: geometry order and keys mismatch "
+                           "(order %zd, keys %zd)",
+                           order.len() / Py_ssize_t( sizeof( std::int64_t ) ),
+                           Py_ssize_t( n ) );
+
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    err = segy_sort_geometry( keys.buf< const int >(),
+                              n,
+                              sorting,
+                              order.buf< std::int64_t >() );
+    Py_END_ALLOW_THREADS
+
+    if( err == SEGY_INVALID_SORTING )
+        return ValueError( "invalid sorting %d", sorting );
+    if( err ) return Error( err );
+
+    Py_INCREF( orderobj );
+    return orderobj;
+}
+
+PyObject* group_rows( PyObject*, PyObject* args ) {
+    buffer_guard table;
+    int ncols;
+    PyObject* indexobj;
+    PyObject* offsetsobj;
+
+    if( !PyArg_ParseTuple( args, "s*iOO", &table,
+                                          &ncols,
+                                          &indexobj,
+                                          &offsetsobj ) )
+        return NULL;
+
+    buffer_guard index( indexobj, PyBUF_CONTIG );
+    if( !index ) return NULL;
+
+    buffer_guard offsets( offsetsobj, PyBUF_CONTIG );
+    if( !offsets ) return NULL;
+
+    if( ncols <= 0 ) return ValueError( "expected columns > 0, was %d", ncols );
+
+    const Py_ssize_t n = index.len() / sizeof( std::int64_t );
+    const Py_ssize_t tablesize = n * ncols * sizeof( std::int32_t );
+    if( table.len() < tablesize )
+        return ValueError( "internal: table too small, "
+                           "expected %zd, was %zd",
+                           tablesize, table.len() );
+
+    const Py_ssize_t offsetssize = (n + 1) * sizeof( std::int64_t );
+    if( offsets.len() < offsetssize )
+        return ValueError( "internal: offsets too small, "
+                           "expected %zd, was %zd",
+                           offsetssize, offsets.len() );
+
+    long long ngroups = 0;
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    err = segy_group_rows( table.buf< const std::int32_t >(),
+                           ncols,
+                           n,
+                           index.buf< std::int64_t >(),
+                           offsets.buf< std::int64_t >(),
+                           &ngroups );
+    Py_END_ALLOW_THREADS
+
+    if( err ) return Error( err );
+
+    return PyLong_FromLongLong( ngroups );
+}
+
 PyMethodDef SegyMethods[] = {
     { "binsize",  (PyCFunction) binsize,  METH_NOARGS, "Size of the binary header." },
     { "thsize",   (PyCFunction) thsize,   METH_NOARGS, "Size of the trace header."  },
@@ -1596,6 +2840,11 @@ PyMethodDef SegyMethods[] = {
     { "fread_trace0", (PyCFunction) fread_trace0,  METH_VARARGS, "Find trace0 of a line."               },
     { "native",       (PyCFunction) format,        METH_VARARGS, "Convert to native float."             },
 
+    { "sort_rows",  (PyCFunction) sort_rows,  METH_VARARGS, "Stable sort of row numbers by rows." },
+    { "group_rows", (PyCFunction) group_rows, METH_VARARGS, "Group identical rows."              },
+
+    { "sort_geometry", (PyCFunction) sort_geometry, METH_VARARGS, "Order traces by line." },
+
     { NULL }
 };
 
@@ -103,6 +103,7 @@ def open(filename, mode = 'r', iline = 189,
         mode = mode,
         iline = iline,
         xline = xline,
+        endian = endian,
     )
 
     h0 = f.header[0]
@@ -0,0 +1,197 @@
+import numpy as np
+
+from .line import sanitize_slice
+
+def select(key, labels):
+    """Labels picked by a slice of labels, in slice order"""
+    key = sanitize_slice(key, labels)
+    start, stop = key.start, key.stop
+    step = 1 if key.step is None else key.step
+
+    if step > 0:
+        keep = [x for x in labels
+                if start <= x < stop and (x - start) % step == 0]
+    else:
+        keep = [x for x in labels
+                if stop < x <= start and (start - x) % -step == 0]
+
+    return sorted(keep, reverse = step < 0)
+
+def strided(positions):
+    """
+    The (start, stop, step) with a positive step that selects positions in
+    ascending order, or None if they are not evenly spaced
+    """
+    xs = sorted(positions)
+    if len(xs) == 1:
+        return xs[0], xs[0] + 1, 1
+
+    step = xs[1] - xs[0]
+    if step <= 0 or any(b - a != step for a, b in zip(xs, xs[1:])):
+        return None
+
+    return xs[0], xs[-1] + 1, step
+
+class SubVolume(object):
+    """
+    The SubVolume reads boxes of the cube, i.e. a range of inlines, a range of
+    crosslines and a range of samples, into a single numpy.ndarray. Only the
+    sample windows of the traces inside the box are read, and traces that are
+    close together in the file are read in a single request, which makes this
+    much faster than reading whole lines and cropping them. Strided boxes only
+    read the selected lines and samples.
+
+    Notes
+    -----
+    .. versionadded:: 1.10
+    """
+
+    def __init__(self, fd):
+        self.filehandle = fd.xfd
+        self.dtype = fd.dtype
+        self.sorting = fd.sorting
+        self.samplecount = len(fd.samples)
+        self.ilines = list(fd.ilines)
+        self.xlines = list(fd.xlines)
+        self.offsets = list(fd.offsets)
+
+        self.ilpos = { x: i for i, x in enumerate(self.ilines) }
+        self.xlpos = { x: i for i, x in enumerate(self.xlines) }
+        self.offpos = { x: i for i, x in enumerate(self.offsets) }
+
+    def positions(self, key, labels, pos, name):
+        if isinstance(key, slice):
+            return [pos[x] for x in select(key, labels)], False
+
+        try:
+            return [pos[key]], True
+        except KeyError:
+            raise KeyError('{} {} not in file'.format(name, key))
+
+    def read(self, offset, ils, xls, ts):
+        """
+        Read the traces of the inline positions `ils` and crossline positions
+        `xls`, and the samples `ts`. Evenly spaced selections are read with a
+        step, so only the selected lines and samples are read - only irregular
+        selections read the range that covers them.
+        """
+        selections = (ils, xls, ts)
+        ranges = []
+        for xs in selections:
+            r = strided(xs)
+            ranges.append(r if r is not None else (min(xs), max(xs) + 1, 1))
+
+        (il0, il1, ilstep), (xl0, xl1, xlstep), (t0, t1, tstep) = ranges
+        shape = tuple(len(range(*r)) for r in ranges)
+        box = np.empty(shape, dtype = self.dtype)
+        self.filehandle.getsubvolume(self.sorting,
+                                     len(self.ilines),
+                                     len(self.xlines),
+                                     len(self.offsets),
+                                     offset,
+                                     il0, il1, ilstep,
+                                     xl0, xl1, xlstep,
+                                     t0, t1, tstep,
+                                     box)
+
+        # the box is read in ascending order, so pick from it if the
+        # selection is reversed or irregular
+        picks = [[(x - start) // step for x in xs]
+                 for xs, (start, _, step) in zip(selections, ranges)]
+        if all(p == list(range(n)) for p, n in zip(picks, shape)):
+            return box
+
+        return box[np.ix_(*picks)]
+
+    def __getitem__(self, index):
+        """subvolume[il, xl, t] or subvolume[il, xl, t, o]
+
+        The box of inlines `il`, crosslines `xl` and samples `t`, at offset
+        `o`, as a numpy.ndarray of shape (inlines, crosslines, samples),
+        regardless of the sorting of the file. Changes to this array will
+        *not* be reflected on disk.
+
+        `il`, `xl` and `o` are *keys*, like for `iline` and `xline`, and `t`
+        are sample *indices*, like for `depth_slice`. If no offset is given,
+        the first offset is used.
+
+        Slices can contain lines not in the file, which are ignored. When any
+        of `il`, `xl` or `t` is an int, that dimension is dropped from the
+        result, like for numpy arrays.
+
+        Parameters
+        ----------
+        il : int or slice
+        xl : int or slice
+        t  : int or slice
+        o  : int
+
+        Returns
+        -------
+        box : numpy.ndarray of dtype
+
+        Raises
+        ------
+        TypeError
+            If the index is not a tuple of 3 or 4 items
+        KeyError
+            If an inline, crossline or offset is not in the file
+
+        Notes
+        -----
+        .. versionadded:: 1.10
+
+        Examples
+        --------
+        Read a 64x64x64 patch:
+
+        >>> patch = f.subvolume[100:164, 200:264, 300:364]
+
+        Read a time window of a single inline:
+
+        >>> window = f.subvolume[100, :, 50:150]
+
+        Read a patch at the offset 250 of a pre-stack file:
+
+        >>> patch = f.subvolume[100:110, 200:210, :, 250]
+        """
+        if not isinstance(index, tuple):
+            msg = 'sub volume indices must be a tuple (il, xl, t) or ' \
+                  '(il, xl, t, o), not {}'
+            raise TypeError(msg.format(type(index).__name__))
+
+        if len(index) == 3:
+            il, xl, t = index
+            offset = self.offsets[0]
+        elif len(index) == 4:
+            il, xl, t, offset = index
+        else:
+            msg = 'sub volume indices must be a tuple (il, xl, t) or ' \
+                  '(il, xl, t, o), not a tuple of {} items'
+            raise TypeError(msg.format(len(index)))
+
+        ils, ilint = self.positions(il, self.ilines, self.ilpos, 'inline')
+        xls, xlint = self.positions(xl, self.xlines, self.xlpos, 'crossline')
+
+        try:
+            off = self.offpos[offset]
+        except KeyError:
+            raise KeyError('offset {} not in file'.format(offset))
+
+        if isinstance(t, slice):
+            ts, tint = list(range(*t.indices(self.samplecount))), False
+        else:
+            if t < 0: t += self.samplecount
+            if not 0 <= t < self.samplecount:
+                raise IndexError('sample {} out of range'.format(t))
+            ts, tint = [t], True
+
+        shape = (len(ils), len(xls), len(ts))
+        if 0 in shape:
+            box = np.empty(shape, dtype = self.dtype)
+        else:
+            box = self.read(off, ils, xls, ts)
+
+        squeeze = tuple(0 if drop else slice(None)
+                        for drop in (ilint, xlint, tint))
+        return box[squeeze]
@@ -1,8 +1,10 @@
 import segyio
 from . import TraceSortingFormat
 from . import SegySampleFormat
+from . import Compression
 
 import numpy as np
+import os
 import textwrap
 
 
@@ -206,7 +208,7 @@ def collect(itr):
     """
     return np.stack([np.copy(x) for x in itr])
 
-def cube(f):
+def cube(f, out = None, threads = 1, dtype = None, scale = 1, bias = 0):
     """Read a full cube from a file
 
     Takes an open segy file (created with segyio.open) or a file name.
@@ -219,30 +221,285 @@ def cube(f):
     ----------
 
     f : str or segyio.SegyFile
+    out : numpy.ndarray, optional
+        Read the cube into this array, which must be C-contiguous, writable,
+        and have the shape of the cube and the dtype of the file, or dtype if
+        given. Can be a memory-mapped array, e.g. from
+        ``numpy.lib.format.open_memmap``
+    threads : int, optional
+        Split the file between this many threads. Defaults to 1
+    dtype : {None, numpy.float32, numpy.float64, numpy.int16}, optional
+        Convert the samples to this type while reading, regardless of the
+        sample format of the file. Defaults to None (the dtype of the file)
+    scale, bias : float, optional
+        Store the samples as ``sample * scale + bias``. Only with dtype. int16
+        is rounded to nearest, and saturates. Defaults to 1 and 0
 
     Returns
     -------
 
     cube : numpy.ndarray
+        out, if given
 
     Notes
     -----
 
     .. versionadded:: 1.1
 
+    .. versionchanged:: 1.10
+        out, threads, dtype, scale and bias
+
+    Examples
+    --------
+
+    Read a cube using 8 threads:
+
+    >>> cube = segyio.tools.cube(f, threads = 8)
+
+    Read a large cube straight into a .npy file:
+
+    >>> shape = segyio.tools.cube_shape(f)
+    >>> out = np.lib.format.open_memmap('cube.npy', mode = 'w+',
+    ...                                 dtype = f.dtype, shape = shape)
+    >>> segyio.tools.cube(f, out = out, threads = 8)
+
+    Read a cube of samples in [-1, 1] as int16:
+
+    >>> cube = segyio.tools.cube(f, dtype = np.int16, scale = 32767)
     """
 
     if not isinstance(f, segyio.SegyFile):
         with segyio.open(f) as fl:
-            return cube(fl)
+            return cube(fl, out = out, threads = threads,
+                            dtype = dtype, scale = scale, bias = bias)
+
+    # SEGY_OUTTYPE
+    outtypes = {
+        np.dtype(np.float32): 1,
+        np.dtype(np.float64): 2,
+        np.dtype(np.int16):   3,
+    }
+
+    if dtype is None:
+        if scale != 1 or bias != 0:
+            raise ValueError('scale and bias can only be used with dtype')
+        outtype = 0
+        dtype = f.dtype
+    else:
+        dtype = np.dtype(dtype)
+        if dtype not in outtypes:
+            msg = 'dtype must be one of float32, float64 or int16, was {}'
+            raise ValueError(msg.format(dtype))
+        outtype = outtypes[dtype]
+
+    dims = cube_shape(f)
+
+    if out is None:
+        out = np.empty(dims, dtype = dtype)
+    else:
+        if tuple(out.shape) != dims:
+            msg = 'expected out with shape {}, was {}'
+            raise ValueError(msg.format(dims, out.shape))
+
+        if out.dtype != dtype:
+            msg = 'expected out with dtype {}, was {}'
+            raise ValueError(msg.format(dtype, out.dtype))
+
+        if not out.flags.c_contiguous or not out.flags.writeable:
+            raise ValueError('out must be C-contiguous and writable')
+
+    return f.xfd.getcube(out, threads, outtype, float(scale), float(bias))
+
+def cube_shape(f):
+    """The shape of the cube of a file
+
+    The shape of the array returned by ``cube``, i.e. ``(fast, slow,
+    sample)`` for post-stack files, and ``(fast, slow, offset, sample)`` for
+    pre-stack files.
+
+    Parameters
+    ----------
+
+    f : segyio.SegyFile
+
+    Returns
+    -------
+
+    shape : tuple of int
+
+    Notes
+    -----
 
+    .. versionadded:: 1.10
+    """
     ilsort = f.sorting == segyio.TraceSortingFormat.INLINE_SORTING
     fast = f.ilines if ilsort else f.xlines
     slow = f.xlines if ilsort else f.ilines
     fast, slow, offs = len(fast), len(slow), len(f.offsets)
     smps = len(f.samples)
-    dims = (fast, slow, smps) if offs == 1 else (fast, slow, offs, smps)
-    return f.trace.raw[:].reshape(dims)
+    return (fast, slow, smps) if offs == 1 else (fast, slow, offs, smps)
+
+def bricks(f, path = None, bricksize = 64, compress = False, tolerance = None):
+    """Build a brick cache for a file
+
+    The brick cache is a copy of the samples of the file, rearranged into
+    cubes of ``bricksize`` lines by ``bricksize`` traces by ``bricksize``
+    samples, and stored in native byte order. Reading an inline, a crossline,
+    a depth slice or a sub volume then only reads the bricks it passes through,
+    which makes slicing equally fast in every direction, regardless of the
+    sorting of the file.
+
+    The cache is used by files opened with ``segyio.open(..., bricks = True)``
+    (or the path given here).
+
+    Parameters
+    ----------
+
+    f : str or segyio.SegyFile
+    path : str, optional
+        Where to write the brick cache. Defaults to the filename with
+        ``.segyio-bricks`` appended
+    bricksize : int, optional
+        Size of a brick edge. Defaults to 64
+    compress : bool, optional
+        Compress the bricks. Defaults to False
+    tolerance : float, optional
+        With compress, allow every sample to differ up to tolerance from the
+        original, which compresses much better. Only for floating point
+        files. Defaults to None, i.e. lossless
+
+    Returns
+    -------
+
+    path : str
+        Path of the brick cache
+
+    Notes
+    -----
+
+    .. versionadded:: 1.10
+
+    The cache is written to a temporary file and moved in place, so concurrent
+    opens never see a partially written cache. It is considered stale, and not
+    used, if the file is modified after the cache is written, or its size
+    changes.
+
+    Compressed bricks are decompressed transparently when read. Lossless
+    compression typically gives a modest size reduction, as the low bytes of
+    floats are essentially noise, while lossy compression with a tolerance
+    well below the noise level of the data usually saves a lot more.
+
+    Examples
+    --------
+
+    Build a brick cache, and use it for reading:
+
+    >>> segyio.tools.bricks('file.sgy')
+    >>> with segyio.open('file.sgy', bricks = True) as f:
+    ...     slice = f.depth_slice[100]
+
+    Build a compressed brick cache, accurate to 0.01:
+
+    >>> segyio.tools.bricks('file.sgy', compress = True, tolerance = 0.01)
+    """
+
+    if tolerance is not None and not compress:
+        raise ValueError('tolerance requires compress = True')
+
+    if not isinstance(f, segyio.SegyFile):
+        with segyio.open(f) as fl:
+            return bricks(fl, path, bricksize, compress, tolerance)
+
+    if f.unstructured:
+        raise ValueError(f._unstructured_errmsg)
+
+    if path is None:
+        path = f._filename + '.segyio-bricks'
+
+    if not compress:
+        compression = Compression.UNCOMPRESSED
+    elif not tolerance:
+        compression = Compression.LOSSLESS
+    else:
+        compression = Compression.LOSSY
+
+    tmp = '{}.{}.tmp'.format(path, os.getpid())
+    try:
+        f.xfd.brick_build(tmp, len(f.fast), len(f.slow), len(f.offsets),
+                          bricksize, compression, float(tolerance or 0))
+        try:
+            os.replace(tmp, path)
+        except AttributeError:
+            # python 2 has no os.replace, and rename won't overwrite on windows
+            if os.path.exists(path): os.remove(path)
+            os.rename(tmp, path)
+    except:
+        if os.path.exists(tmp): os.remove(tmp)
+        raise
+
+    return path
+
+def compress(f, path, tolerance = None, blocksize = 128):
+    """Write a compressed copy of a file
+
+    Write a compressed-trace container, which segyio.open reads exactly like
+    the file it was built from. The traces are compressed in blocks of
+    ``blocksize`` traces. The trace headers and the textual and binary headers
+    are always compressed losslessly.
+
+    Parameters
+    ----------
+
+    f : str or segyio.SegyFile
+    path : str
+        Where to write the compressed file
+    tolerance : float, optional
+        Allow every sample to differ up to tolerance from the original, which
+        compresses much better. Only for 4-byte floating point files. Defaults
+        to None, i.e. a lossless copy
+    blocksize : int, optional
+        Traces per block. Defaults to 128
+
+    Returns
+    -------
+
+    path : str
+        Path of the compressed file
+
+    Notes
+    -----
+
+    .. versionadded:: 1.10
+
+    The compressed file is read by decoding the blocks of `blocksize` traces
+    that are read, and keeping the last few, so opening it and reading a
+    trace is cheap even for huge files. It can only be opened read-only.
+
+    Examples
+    --------
+
+    Compress a file, and read it:
+
+    >>> segyio.tools.compress('file.sgy', 'file.sgy.z')
+    >>> with segyio.open('file.sgy.z') as f:
+    ...     data = segyio.tools.cube(f)
+
+    Compress a file, accurate to 0.01:
+
+    >>> segyio.tools.compress('file.sgy', 'file.sgy.z', tolerance = 0.01)
+    """
+
+    if not isinstance(f, segyio.SegyFile):
+        with segyio.open(f, ignore_geometry = True) as fl:
+            return compress(fl, path, tolerance, blocksize)
+
+    if tolerance:
+        compression = Compression.LOSSY
+    else:
+        compression = Compression.LOSSLESS
+
+    f.xfd.container_build(path, compression, float(tolerance or 0), blocksize)
+    return path
 
 def rotation(f, line = 'fast'):
     """ Find rotation of the survey
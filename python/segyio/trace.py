@@ -14,6 +14,7 @@ import numpy as np
 
 from .line import HeaderLine
 from .field import Field
+from .tracefield import keys as tracefield_keys
 from .utils import castarray
 
 class Sequence(Sequence):
@@ -348,7 +349,7 @@ class RawTrace(Trace):
         super(RawTrace, self).__init__(*args)
 
     def __getitem__(self, i):
-        """trace[i]
+        """trace[i] or trace[i, j]
 
         Eagerly read the ith trace of the file, starting at 0. trace[i] returns
         a numpy array, and changes to this array will *not* be reflected on
@@ -356,9 +357,13 @@ class RawTrace(Trace):
 
         When i is a slice, this returns a 2-dimensional numpy.ndarray .
 
+        When j is given, only the samples j of the traces are read, like for
+        trace[i, j].
+
         Parameters
         ----------
         i : int or slice
+        j : int or slice
 
         Returns
         -------
@@ -368,6 +373,9 @@ class RawTrace(Trace):
         -----
         .. versionadded:: 1.1
 
+        .. versionchanged:: 1.10
+            support for sample slicing
+
         Behaves like [] for lists.
 
         .. note::
@@ -376,21 +384,51 @@ class RawTrace(Trace):
             extra memory usage. It reads the requested traces immediately to
             memory.
 
+        Examples
+        --------
+        Read every other trace, and the first 100 samples of them:
+
+        >>> traces = trace.raw[::2, :100]
         """
         try:
             i = self.wrapindex(i)
             buf = np.zeros(self.shape, dtype = self.dtype)
             return self.filehandle.gettr(buf, i, 1, 1, 0, self.shape, 1, self.shape)
+        except TypeError:
+            pass
+
+        single = False
+        if isinstance(i, tuple):
+            i, j = i
+            try:
+                start, stop, step = j.indices(self.shape)
+            except AttributeError:
+                start = int(j) % self.shape
+                stop, step = start + 1, 1
+                single = True
+        else:
+            start, stop, step = 0, self.shape, 1
+
+        n_elements = len(range(start, stop, step))
+
+        try:
+            i = self.wrapindex(i)
+            buf = np.zeros(n_elements, dtype = self.dtype)
+            tr = self.filehandle.gettr(buf, i, 1, 1, start, stop, step, n_elements)
+            return tr[0] if single else tr
         except TypeError:
             try:
                 indices = i.indices(len(self))
             except AttributeError:
                 msg = 'trace indices must be integers or slices, not {}'
                 raise TypeError(msg.format(type(i).__name__))
-            start, _, step = indices
-            length = len(range(*indices))
-            buf = np.empty((length, self.shape), dtype = self.dtype)
-            return self.filehandle.gettr(buf, start, step, length, 0, self.shape, 1, self.shape)
+
+        first, _, stride = indices
+        length = len(range(*indices))
+        buf = np.empty((length, n_elements), dtype = self.dtype)
+        self.filehandle.gettr(buf, first, stride, length,
+                              start, stop, step, n_elements)
+        return buf[:, 0] if single else buf
 
 
 def fingerprint(x):
@@ -767,6 +805,69 @@ class Header(Sequence):
         for i, src in zip(self.segy.xlines, value):
             self.xline[i] = src
 
+    def table(self, fields = None, traces = slice(None), threads = 1):
+        """Header words of many traces, as a table
+
+        Read the header words `fields` of the traces `traces` into a numpy
+        structured array, with one record per trace and one int32 column per
+        field, named after the TraceField. All the header words of a trace are
+        decoded from the same read, so this is much faster than reading every
+        field with attributes, and the traces can be split across `threads`
+        threads.
+
+        Parameters
+        ----------
+        fields : iterable of int or TraceField, optional
+            Defaults to all the header words in the standard, in byte order
+        traces : slice, optional
+            Defaults to all traces
+        threads : int, optional
+
+        Returns
+        -------
+        table : numpy.ndarray of structured dtype
+
+        Raises
+        ------
+        KeyError
+            If a field is not a trace header word
+
+        Notes
+        -----
+        .. versionadded:: 1.10
+
+        Examples
+        --------
+        Read all trace headers into a pandas DataFrame:
+
+        >>> df = pandas.DataFrame(f.header.table())
+
+        Read the coordinates of every other trace:
+
+        >>> xy = f.header.table([TraceField.CDP_X, TraceField.CDP_Y], traces = slice(None, None, 2))
+        >>> xy['CDP_X']
+        """
+        if fields is None:
+            fields = sorted(Field._tr_keys)
+
+        names = { v: k for k, v in tracefield_keys.items() }
+        fields = [int(field) for field in fields]
+
+        try:
+            dtype = [(names[field], np.int32) for field in fields]
+        except KeyError as e:
+            msg = 'no trace header word at byte {}'
+            raise KeyError(msg.format(e.args[0]))
+
+        start, stop, step = traces.indices(len(self))
+        table = np.empty(len(range(start, stop, step)), dtype = dtype)
+        if len(table) == 0 or len(fields) == 0:
+            return table
+
+        fields = np.asarray(fields, dtype = np.intc)
+        return self.segy.xfd.fields_forall(table, fields, start, stop, step,
+                                           threads)
+
 class Attributes(Sequence):
     """File-wide attribute (header word) reading
 
@@ -825,8 +926,8 @@ class Attributes(Sequence):
         >>> scatter(gx, gy)
         """
         try:
-            xs = np.asarray(i, dtype = self.dtype)
-            xs = xs.astype(dtype = self.dtype, order = 'C', copy = False)
+            xs = np.asarray(i, dtype = np.int64)
+            xs = xs.astype(dtype = np.int64, order = 'C', copy = False)
             attrs = np.empty(len(xs), dtype = self.dtype)
             return self.filehandle.field_foreach(attrs, xs, self.field)
 
@@ -10,9 +10,11 @@ except ImportError:
 from types import GeneratorType
 
 import itertools
+import sys
 import filecmp
 import shutil
 import os
+import threading
 import numpy as np
 import numpy.testing as npt
 import pytest
@@ -216,6 +218,304 @@ def test_open_ignore_geometry():
             _ = f.iline[0]
 
 
+def shift_indexed_ilines(index, shift):
+    # the index ends with the 5 ilines, 5 xlines and 1 offset of small.sgy
+    raw = np.fromfile(index, dtype=np.uint8)
+    tail = raw[-4 * 11:].view('<i4').copy()
+    tail[:5] += shift
+    raw[-4 * 11:] = tail.view(np.uint8)
+    raw.tofile(index)
+
+
+def test_open_geometry_index(small, tmpdir):
+    index = str(tmpdir / 'small.idx')
+    with segyio.open(small, index=index) as f:
+        assert list(f.ilines) == [1, 2, 3, 4, 5]
+        assert list(f.xlines) == [20, 21, 22, 23, 24]
+
+    assert os.path.exists(index)
+
+    # the index is trusted on reopen, so doctored line numbers show up
+    shift_indexed_ilines(index, 10)
+    with segyio.open(small, index=index) as f:
+        assert list(f.ilines) == [11, 12, 13, 14, 15]
+        assert list(f.xlines) == [20, 21, 22, 23, 24]
+        assert f.sorting == TraceSortingFormat.INLINE_SORTING
+
+    # a different interpretation of the file does not use the same index
+    with segyio.open(small, index=index, iline=193, xline=189) as f:
+        assert list(f.ilines) == [20, 21, 22, 23, 24]
+
+
+def test_open_geometry_index_stale(small, tmpdir):
+    index = str(tmpdir / 'small.idx')
+    with segyio.open(small, index=index) as f:
+        pass
+
+    shift_indexed_ilines(index, 10)
+
+    with segyio.open(small, mode='r+') as f:
+        f.bin[BinField.JobID] = 10
+
+    # the binary header changed, so the index is rebuilt from the file
+    with segyio.open(small, index=index) as f:
+        assert list(f.ilines) == [1, 2, 3, 4, 5]
+
+    with segyio.open(small, index=index) as f:
+        assert list(f.ilines) == [1, 2, 3, 4, 5]
+
+
+def test_open_geometry_index_default_path(small):
+    with segyio.open(small, index=True) as f:
+        assert list(f.ilines) == [1, 2, 3, 4, 5]
+
+    assert os.path.exists(str(small) + '.segyio-index')
+
+
+def test_trace_cache(small):
+    with segyio.open(small) as f, segyio.open(small, cache=2**20) as g:
+        assert g.cache_stats() == {'hits': 0, 'misses': 0}
+
+        for i in [0, 1, 0, 24, 3, 0, 2]:
+            npt.assert_array_equal(f.trace[i], g.trace[i])
+            assert f.header[i] == g.header[i]
+
+        stats = g.cache_stats()
+        assert stats['misses'] < stats['hits']
+
+        g.cache(0)
+        assert g.cache_stats() == {'hits': 0, 'misses': 0}
+
+
+def test_trace_cache_write(small):
+    with segyio.open(small, mode='r+', cache=2**20) as f:
+        _ = f.trace[3]
+        f.trace[3] = np.arange(50, dtype=np.single)
+        npt.assert_array_equal(f.trace[3], np.arange(50, dtype=np.single))
+
+        f.header[3] = { TraceField.INLINE_3D: 1234 }
+        assert f.header[3][TraceField.INLINE_3D] == 1234
+
+
+@pytest.mark.parametrize('readahead', [0, 1, 2**20])
+def test_readahead(readahead):
+    with segyio.open(testdata / 'small.sgy') as f:
+        traces = [np.copy(x) for x in f.trace]
+        ilines = [np.copy(x) for x in f.iline]
+
+    with segyio.open(testdata / 'small.sgy', readahead=readahead) as f:
+        for expected, trace in zip(traces, f.trace):
+            npt.assert_array_equal(expected, trace)
+
+        for i in range(24, -1, -3):
+            npt.assert_array_equal(traces[i], f.trace[i])
+
+        for expected, line in zip(ilines, f.iline):
+            npt.assert_array_equal(expected, line)
+
+    with pytest.raises(ValueError):
+        segyio.open(testdata / 'small.sgy', readahead=-1)
+
+
+@pytest.mark.parametrize(('openfn', 'kwargs'), small_sus)
+def test_view(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        view = f.view()
+        traces = f.trace.raw[:]
+
+        assert view.shape == traces.shape
+        assert not view.flags.writeable
+        npt.assert_array_equal(view, traces)
+        npt.assert_array_equal(view[::-2, 5:10], traces[::-2, 5:10])
+
+        little = kwargs.get('endian') == 'lsb'
+        assert view.dtype == f.dtype.newbyteorder('<' if little else '>')
+
+    # the view outlives the file
+    npt.assert_array_equal(view, traces)
+
+
+def test_view_writes(tmpdir):
+    shutil.copy(str(testdata / 'small-lsb.su'), str(tmpdir))
+    path = str(tmpdir / 'small-lsb.su')
+    kwargs = { 'iline': 5, 'xline': 21, 'endian': 'lsb' }
+
+    with segyio.su.open(path, 'r+', **kwargs) as f:
+        view = f.view()
+        view[3, 5] = 42.0
+        assert f.trace[3][5] == 42.0
+        del view
+
+    with segyio.su.open(path, **kwargs) as f:
+        assert f.trace[3][5] == 42.0
+
+
+def test_view_ibm_float():
+    with segyio.open(testdata / 'small.sgy') as f:
+        with pytest.raises(ValueError):
+            _ = f.view()
+
+
+def test_threaded_reads_same_handle():
+    with segyio.open(testdata / 'small.sgy') as f:
+        expected = f.trace.raw[:]
+        ilines = f.iline[:]
+
+        errors = []
+        def read():
+            try:
+                for _ in range(50):
+                    npt.assert_array_equal(expected, f.trace.raw[:])
+                    npt.assert_array_equal(ilines, f.iline[:])
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target = read) for _ in range(4)]
+        for t in threads: t.start()
+        for t in threads: t.join()
+        assert not errors
+
+
+@pytest.mark.skipif(not hasattr(sys, 'setswitchinterval'),
+                    reason = 'needs a configurable switch interval')
+def test_threaded_reads_release_gil(tmpdir):
+    # The observer thread is woken right before every read, and can only set
+    # the flag while the reader is in segyio if the read releases the GIL. The
+    # switch interval is longer than the test, so the reader never hands the
+    # GIL over on its own. Timing is in benchmarks/threaded-reads.py
+    data = np.arange(64 * 64 * 500, dtype = np.single).reshape(64, 64, 500)
+    path = str(tmpdir / 'threads.sgy')
+    segyio.tools.from_array(path, data)
+
+    entered = threading.Event()
+    progressed = threading.Event()
+    stop = []
+
+    def observe():
+        while True:
+            entered.wait()
+            entered.clear()
+            if stop: return
+            progressed.set()
+
+    observer = threading.Thread(target = observe)
+    observer.start()
+
+    interval = sys.getswitchinterval()
+    sys.setswitchinterval(1000)
+    try:
+        with segyio.open(path) as f:
+            out = np.empty(segyio.tools.cube_shape(f), dtype = f.dtype)
+            for _ in range(1000):
+                entered.set()
+                f.xfd.getcube(out, 1)
+                if progressed.is_set(): break
+    finally:
+        sys.setswitchinterval(interval)
+        stop.append(True)
+        entered.set()
+        observer.join()
+
+    assert progressed.is_set()
+    npt.assert_array_equal(out, data)
+
+
+@pytest.mark.parametrize('compress', [False, True])
+@pytest.mark.parametrize('bricksize', [2, 3, 64])
+def test_open_bricks(small, bricksize, compress):
+    path = segyio.tools.bricks(str(small), bricksize=bricksize,
+                               compress=compress)
+    assert path == str(small) + '.segyio-bricks'
+
+    with segyio.open(small) as f, segyio.open(small, bricks=True) as g:
+        for il in f.ilines:
+            npt.assert_array_equal(f.iline[il], g.iline[il])
+
+        for xl in f.xlines:
+            npt.assert_array_equal(f.xline[xl], g.xline[xl])
+
+        for depth in range(len(f.samples)):
+            npt.assert_array_equal(f.depth_slice[depth], g.depth_slice[depth])
+
+        npt.assert_array_equal(f.subvolume[2:5, 21:24, 10:40],
+                               g.subvolume[2:5, 21:24, 10:40])
+
+
+def test_open_bricks_lossy(small):
+    segyio.tools.bricks(str(small), bricksize=4, compress=True, tolerance=1e-3)
+
+    with segyio.open(small) as f, segyio.open(small, bricks=True) as g:
+        for il in f.ilines:
+            npt.assert_allclose(f.iline[il], g.iline[il], rtol=0, atol=1.001e-3)
+
+        npt.assert_allclose(f.depth_slice[10], g.depth_slice[10],
+                            rtol=0, atol=1.001e-3)
+
+
+def test_open_bricks_prestack(smallps):
+    segyio.tools.bricks(str(smallps), bricksize=2)
+
+    with segyio.open(smallps) as f, segyio.open(smallps, bricks=True) as g:
+        for il in f.ilines:
+            for off in f.offsets:
+                npt.assert_array_equal(f.iline[il, off], g.iline[il, off])
+
+        for depth in range(len(f.samples)):
+            npt.assert_array_equal(f.depth_slice[depth], g.depth_slice[depth])
+
+
+def test_open_bricks_stale(small):
+    segyio.tools.bricks(str(small), bricksize=2)
+
+    with segyio.open(small, mode='r+') as f:
+        f.iline[1] = f.iline[1] + 1.0
+        expected = np.copy(f.iline[1])
+
+    # the file is newer than the cache, which is then not used
+    cache = str(small) + '.segyio-bricks'
+    stat = os.stat(str(small))
+    os.utime(cache, (stat.st_atime, stat.st_mtime - 10))
+
+    with segyio.open(small, bricks=True) as f:
+        npt.assert_array_equal(f.iline[1], expected)
+
+
+def test_bricks_tolerance_requires_compress(small):
+    with pytest.raises(ValueError):
+        segyio.tools.bricks(str(small), tolerance=1e-3)
+
+
+def test_open_compressed(small):
+    path = segyio.tools.compress(str(small), str(small) + '.z', blocksize=4)
+    assert path == str(small) + '.z'
+    assert os.path.getsize(path) < os.path.getsize(str(small))
+
+    with segyio.open(small) as f, segyio.open(path) as g:
+        assert f.text[0] == g.text[0]
+        assert f.bin == g.bin
+        assert list(f.ilines) == list(g.ilines)
+        assert list(f.xlines) == list(g.xlines)
+
+        for i in range(f.tracecount):
+            assert f.header[i] == g.header[i]
+            npt.assert_array_equal(f.trace[i], g.trace[i])
+
+        npt.assert_array_equal(f.depth_slice[10], g.depth_slice[10])
+
+    with pytest.raises(IOError):
+        segyio.open(path, mode='r+')
+
+
+def test_open_compressed_lossy(small):
+    path = segyio.tools.compress(str(small), str(small) + '.z',
+                                 tolerance=1e-3)
+
+    with segyio.open(small) as f, segyio.open(path) as g:
+        assert f.header[10] == g.header[10]
+        for il in f.ilines:
+            npt.assert_allclose(f.iline[il], g.iline[il], rtol=0, atol=1.001e-3)
+
+
 @pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
 def test_traces_slicing(openfn, kwargs):
     with openfn(**kwargs) as f:
@@ -461,6 +761,49 @@ def test_attributes(openfn, kwargs):
         attrils = list(map(int, f.attributes(il)[indices]))
         assert ils == attrils
 
+@pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
+def test_header_table(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        table = f.header.table()
+        assert len(table) == f.tracecount
+        assert table.dtype.names[0] == 'TRACE_SEQUENCE_LINE'
+        for name in table.dtype.names:
+            field = getattr(TraceField, name)
+            assert np.array_equal(table[name], f.attributes(field)[:])
+
+        il = kwargs.get('iline', TraceField.INLINE_3D)
+        xl = kwargs.get('xline', TraceField.CROSSLINE_3D)
+        for threads in [1, 3]:
+            table = f.header.table([xl, il],
+                                   traces = slice(20, 1, -3),
+                                   threads = threads)
+            assert table.dtype.names == (str(TraceField(xl)),
+                                         str(TraceField(il)))
+            assert np.array_equal(table[str(TraceField(il))],
+                                  f.attributes(il)[20:1:-3])
+            assert np.array_equal(table[str(TraceField(xl))],
+                                  f.attributes(xl)[20:1:-3])
+
+        assert len(f.header.table(traces = slice(5, 5))) == 0
+
+        with pytest.raises(KeyError):
+            f.header.table([TraceField.INLINE_3D + 1])
+
+@pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
+def test_attributes_shuffled_indices(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        il = kwargs.get('iline', TraceField.INLINE_3D)
+        indices = [24, 3, 3, 17, 0, 11]
+        expected = [(i // 5) + 1 for i in indices]
+        assert list(f.attributes(il)[indices]) == expected
+        assert len(f.attributes(il)[[]]) == 0
+
+        with pytest.raises(IndexError):
+            f.attributes(il)[[0, 25]]
+
+        with pytest.raises(IndexError):
+            f.attributes(il)[[-1]]
+
 
 def test_iline_offset():
     with segyio.open(testdata / 'small-ps.sgy') as f:
@@ -646,6 +989,19 @@ def test_traces_raw(openfn, kwargs):
         for raw, gen in zip(f.trace.raw[::-1], f.trace[::-1]):
             assert np.array_equal(raw, gen)
 
+@pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
+def test_traces_raw_sample_slices(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        traces = f.trace.raw[:]
+
+        assert np.array_equal(f.trace.raw[:, 10:20], traces[:, 10:20])
+        assert np.array_equal(f.trace.raw[::2, ::3], traces[::2, ::3])
+        assert np.array_equal(f.trace.raw[::-3, 40:2:-4], traces[::-3, 40:2:-4])
+        assert np.array_equal(f.trace.raw[5:1:-1, -1], traces[5:1:-1, -1])
+        assert np.array_equal(f.trace.raw[7, ::-1], traces[7, ::-1])
+        assert f.trace.raw[7, 9] == traces[7, 9]
+        assert f.trace.raw[30:, 5:10].shape == (0, 5)
+
 def test_read_header_embedded_null():
     with segyio.open(testdata / 'text-embed-null.sgy', ignore_geometry = True) as f:
         text = f.text[0]
@@ -1016,6 +1372,46 @@ def test_open_fails_unstructured():
                 [(i // 5) + 1 for i in range(len(f.trace))])
 
 
+def test_open_irregular(small):
+    with segyio.open(small) as f:
+        traces = f.trace.raw[:]
+        tracesize = len(f.samples) * 4 + 240
+
+    # drop the last trace, so inline 5 is one trace short
+    with open(str(small), 'r+b') as f:
+        f.truncate(os.path.getsize(str(small)) - tracesize)
+
+    with pytest.raises(ValueError):
+        segyio.open(small).close()
+
+    with segyio.open(small, irregular = True, threads = 2) as f:
+        assert f.unstructured
+        assert f.tracecount == 24
+        assert list(f.iline.keys()) == [1, 2, 3, 4, 5]
+        assert list(f.xline.keys()) == [20, 21, 22, 23, 24]
+
+        npt.assert_array_equal(f.iline[1], traces[0:5])
+        npt.assert_array_equal(f.iline[5], traces[20:24])
+        npt.assert_array_equal(f.xline[20], traces[[0, 5, 10, 15, 20]])
+        npt.assert_array_equal(f.xline[24], traces[[4, 9, 14, 19]])
+
+        lines = list(f.iline[4:])
+        assert len(lines) == 2
+        npt.assert_array_equal(lines[1], traces[20:24])
+
+        with pytest.raises(KeyError):
+            _ = f.iline[6]
+
+        with pytest.raises(KeyError):
+            _ = f.iline[1, 5]
+
+        with pytest.raises(TypeError):
+            f.iline[1] = traces[0:5]
+
+        # geometry-free access is unchanged
+        npt.assert_array_equal(f.trace[23], traces[23])
+
+
 def test_write_with_narrowing(small):
     with segyio.open(small, mode = 'r+') as f:
 
@@ -1684,6 +2080,82 @@ def test_depth_slice_reading(openfn, kwargs):
         _ = f.depth_slice[len(f.samples)]
 
 
+@pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
+def test_depth_slice_batched_reading(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        cube = segyio.tools.cube(f)
+        expected = [cube[:, :, i] for i in range(len(f.samples))][::-3]
+
+        # force a few depths per pass over the file
+        f.depth_slice.pass_bytes = 2 * 5 * 5 * 4
+        got = list(f.depth_slice[::-3])
+        assert len(got) == len(expected)
+        for x, y in zip(got, expected):
+            np.testing.assert_array_equal(x, y)
+
+        # the yielded arrays are independent
+        assert not np.shares_memory(got[0], got[1])
+
+        f.depth_slice.pass_bytes = 1
+        np.testing.assert_array_equal(next(f.depth_slice[7:]), cube[:, :, 7])
+
+
+@pytest.mark.parametrize(('openfn', 'kwargs'), smallfiles)
+def test_subvolume(openfn, kwargs):
+    with openfn(**kwargs) as f:
+        cube = np.array([f.iline[x] for x in f.ilines])
+        assert cube.shape == (5, 5, 50)
+
+        np.testing.assert_array_equal(f.subvolume[:, :, :], cube)
+        np.testing.assert_array_equal(f.subvolume[2:4, 21:24, 10:20],
+                                      cube[1:3, 1:4, 10:20])
+        np.testing.assert_array_equal(f.subvolume[5:0:-2, 20:25:2, 3:40:7],
+                                      cube[4::-2, 0::2, 3:40:7])
+        np.testing.assert_array_equal(f.subvolume[1:6:4, 24:19:-3, 40:3:-9],
+                                      cube[0::4, 4::-3, 40:3:-9])
+
+        # ints drop the dimension
+        np.testing.assert_array_equal(f.subvolume[3, :, 5:9], cube[2, :, 5:9])
+        np.testing.assert_array_equal(f.subvolume[1:3, 22, -1], cube[0:2, 2, -1])
+
+        # lines outside the file are ignored in slices
+        np.testing.assert_array_equal(f.subvolume[0:100, 24:30, :],
+                                      cube[:, 4:, :])
+        assert f.subvolume[10:20, :, :].shape == (0, 5, 50)
+
+        with pytest.raises(KeyError):
+            _ = f.subvolume[10, :, :]
+
+        with pytest.raises(IndexError):
+            _ = f.subvolume[1, 20, 50]
+
+        with pytest.raises(TypeError):
+            _ = f.subvolume[1]
+
+        with pytest.raises(TypeError):
+            _ = f.subvolume[1, 20]
+
+
+def test_subvolume_prestack():
+    with segyio.open(testdata / 'small-ps.sgy') as f:
+        for offset in f.offsets:
+            cube = np.array([f.iline[x, offset] for x in f.ilines])
+            box = f.subvolume[2:4, 21:23, 5:15, offset]
+            np.testing.assert_array_equal(box, cube[1:3, 1:3, 5:15])
+
+        np.testing.assert_array_equal(f.subvolume[1, :, :],
+                                      f.iline[1, f.offsets[0]])
+
+        with pytest.raises(KeyError):
+            _ = f.subvolume[1, :, :, 3]
+
+
+def test_subvolume_unstructured():
+    with segyio.open(testdata / 'small.sgy', ignore_geometry = True) as f:
+        with pytest.raises(ValueError):
+            _ = f.subvolume
+
+
 def test_depth_slice_array_shape():
     with segyio.open(testdata / '1xN.sgy') as f:
         shape = (len(f.fast), len(f.slow))
@@ -1968,3 +2440,32 @@ def test_groups_gather_equivalence():
 
         # group[(il, xl)] == gather[il, xl]
         npt.assert_array_equal(from_group, from_gather)
+
+def test_group_traces_follow_index():
+    with segyio.open(testdata / 'shot-gather.sgy', ignore_geometry = True) as f:
+        group = f.group(segyio.su.fldr)
+        shot = group[8]
+        assert shot.index == list(range(35, 61))
+
+        # blocks smaller than the group, and not in file order
+        shot.blocksize = 4
+        shot.index = shot.index[::-1]
+        traces = np.stack([tr.copy() for tr in shot.trace])
+        npt.assert_array_equal(traces, f.trace.raw[60:34:-1])
+
+        tracf = [h[segyio.su.tracf] for h in shot.header]
+        assert tracf == list(f.attributes(segyio.su.tracf)[60:34:-1])
+
+def test_group_sort_matches_python_sort():
+    with segyio.open(testdata / 'shot-gather.sgy', ignore_geometry = True) as f:
+        fields = [segyio.su.grnofr, segyio.su.tracf]
+        groups = f.group(segyio.su.fldr)
+        groups.sort(fields)
+
+        for shot in groups.values():
+            headers = [f.header[i] for i in range(f.tracecount)
+                       if f.header[i][segyio.su.fldr] == shot.key]
+            expected = sorted(range(len(headers)),
+                              key = lambda i: [headers[i][x] for x in fields])
+            first = min(shot.index)
+            assert shot.index == [first + i for i in expected]
@@ -126,6 +126,66 @@ def test_cube_identity_prestack():
         assert np.all(x == segyio.tools.cube(f))
 
 
+@pytest.mark.parametrize('threads', [1, 2, 7])
+def test_cube_threads(threads):
+    with segyio.open(testdata / 'small-ps.sgy') as f:
+        x = segyio.tools.collect(f.trace[:])
+        x = x.reshape(segyio.tools.cube_shape(f))
+        assert np.array_equal(x, segyio.tools.cube(f, threads = threads))
+
+        f.mmap()
+        assert np.array_equal(x, segyio.tools.cube(f, threads = threads))
+
+
+def test_cube_out(tmpdir):
+    with segyio.open(testdata / 'small.sgy') as f:
+        expected = segyio.tools.cube(f)
+        shape = segyio.tools.cube_shape(f)
+        assert shape == (5, 5, 50)
+
+        path = str(tmpdir / 'cube.npy')
+        out = np.lib.format.open_memmap(path, mode = 'w+',
+                                        dtype = f.dtype, shape = shape)
+        cube = segyio.tools.cube(f, out = out, threads = 2)
+        assert cube is out
+        del cube, out
+
+        assert np.array_equal(np.load(path), expected)
+
+        with pytest.raises(ValueError):
+            segyio.tools.cube(f, out = np.empty((5, 5, 49), dtype = f.dtype))
+
+        with pytest.raises(ValueError):
+            segyio.tools.cube(f, out = np.empty(shape, dtype = np.float64))
+
+        with pytest.raises(ValueError):
+            out = np.empty((5, 5, 100), dtype = f.dtype)[:, :, ::2]
+            segyio.tools.cube(f, out = out)
+
+
+def test_cube_dtype():
+    with segyio.open(testdata / 'small.sgy') as f:
+        expected = segyio.tools.cube(f)
+
+        x = segyio.tools.cube(f, dtype = np.float64)
+        assert x.dtype == np.float64
+        assert np.array_equal(x, expected.astype(np.float64))
+
+        x = segyio.tools.cube(f, dtype = np.int16, scale = 1000, bias = -3000)
+        assert x.dtype == np.int16
+        assert np.array_equal(x, np.round(expected * 1000 - 3000))
+
+        out = np.empty(segyio.tools.cube_shape(f), dtype = np.float64)
+        x = segyio.tools.cube(f, out = out, dtype = np.float64, threads = 2)
+        assert x is out
+
+        with pytest.raises(ValueError):
+            segyio.tools.cube(f, dtype = np.int32)
+
+        with pytest.raises(ValueError):
+            segyio.tools.cube(f, scale = 2)
+
+
 def test_unstructured_rotation():
     with pytest.raises(ValueError):
         with segyio.open(testdata / 'small.sgy', ignore_geometry=True) as f: